@@ -0,0 +1,63 @@
+#ifndef BENCHMARK_SCENE_HPP
+#define BENCHMARK_SCENE_HPP
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "../../include/planner_setup.hpp"
+
+/**
+ * @brief Sets up a planner as main.cpp does (configurePlanner and the scene of plannerSceneSources), with the given
+ *        obstacle scan, downsampling and end-effector mesh.
+ *
+ * @param planner   The planner to set up.
+ * @param pcd_path  Obstacle point cloud.
+ * @param leaf_size Voxel leaf size for downsampling the cloud (0 keeps every point).
+ * @param stl_path  End-effector mesh.
+ * @return False if the point cloud could not be loaded.
+ */
+template <typename Planner>
+bool loadBenchmarkScene(Planner& planner,
+                        const std::string& pcd_path = "../data/vine_simple_streo_scan.pcd",
+                        float leaf_size             = 0.03f,
+                        const std::string& stl_path = "../data/cutter.stl") {
+    configurePlanner(planner);
+    SceneSources sources = plannerSceneSources(planner, pcd_path, stl_path);
+    sources.leaf_size    = leaf_size;
+    if (!buildScene(planner, sources)) {
+        return false;
+    }
+    planner.min_visible_points = static_cast<int>(planner.min_visible_ratio * planner.obstacle_cloud->points.size());
+    return true;
+}
+
+/**
+ * @brief The start pose used in main.cpp.
+ */
+inline Eigen::Isometry3d benchmarkStartPose() {
+    Eigen::Isometry3d H_0 = Eigen::Isometry3d::Identity();
+    H_0.translation()     = Eigen::Vector3d(0.0, 0.0, 0.725);
+    H_0.linear()          = Eigen::AngleAxisd(-M_PI_2, Eigen::Vector3d::UnitX()).matrix();
+    return H_0;
+}
+
+/**
+ * @brief The goal poses (from the real robot) used in main.cpp.
+ */
+inline std::vector<Eigen::Isometry3d> benchmarkGoals() {
+    Eigen::Isometry3d H_goal_1;
+    H_goal_1.linear() << 0.9907284963734801, 0.01923310699281764, -0.13441684452520866, 0.1337577243239575,
+        0.032219489672272936, 0.9904804604618397, 0.02338085880431727, -0.9992957480549294, 0.029348189933893397;
+    H_goal_1.translation() << 0.243274508481936, 0.39056617285391136, 0.6743629428023914;
+
+    Eigen::Isometry3d H_goal_2;
+    H_goal_2.linear() << 0.6425468638021853, 0.7591589463428162, -0.10393779340133653, 0.07738188639841208,
+        0.07066251869164698, 0.9944846379633997, 0.7623164161794022, -0.6470583456225703, -0.013341171570557007;
+    H_goal_2.translation() << 0.2930928703755895, 0.3962194264333198, 0.7255900206364525;
+
+    return {H_goal_2, H_goal_1};
+}
+
+#endif  // BENCHMARK_SCENE_HPP
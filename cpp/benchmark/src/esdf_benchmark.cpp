@@ -0,0 +1,94 @@
+#include <Eigen/Dense>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "benchmark_scene.hpp"
+
+// Compares the kd-tree and ESDF collision backends on the stereo scan of the vine.
+int main() {
+    using Clock = std::chrono::high_resolution_clock;
+    PlannerMpc<6, 6, 1, double> planner;
+
+    // 1) Load and downsample the scan as in main.cpp
+    if (!loadBenchmarkScene(planner)) {
+        return -1;
+    }
+    const auto& downsampled_cloud = planner.obstacle_cloud;
+    std::cout << "[ESDF benchmark] Cloud points: " << downsampled_cloud->size() << "\n";
+
+    // 2) Build the distance field
+    planner.esdf_resolution = 0.01;
+    auto start              = Clock::now();
+    planner.buildEsdf();
+    auto end = Clock::now();
+    std::cout << "[ESDF benchmark] ESDF build (resolution " << planner.esdf_resolution
+              << " m): " << std::chrono::duration<double, std::milli>(end - start).count() << " ms\n";
+
+    // 3) Random query poses around the cloud
+    Eigen::Vector3f min_pt = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector3f max_pt = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+    for (const auto& pt : downsampled_cloud->points) {
+        min_pt = min_pt.cwiseMin(Eigen::Vector3f(pt.x, pt.y, pt.z));
+        max_pt = max_pt.cwiseMax(Eigen::Vector3f(pt.x, pt.y, pt.z));
+    }
+    const int num_poses = 2000;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<Eigen::Isometry3d> poses;
+    for (int i = 0; i < num_poses; ++i) {
+        Eigen::Isometry3d H = Eigen::Isometry3d::Identity();
+        for (int j = 0; j < 3; ++j) {
+            H.translation()(j) = min_pt(j) + unit(gen) * (max_pt(j) - min_pt(j));
+        }
+        H.linear() = stateToIsometry<double>(Eigen::Vector3d::Zero(),
+                                             Eigen::Vector3d(unit(gen), unit(gen), unit(gen)) * 2 * M_PI)
+                         .linear();
+        poses.push_back(H);
+    }
+
+    // 4) Point queries and mesh collision cost per backend
+    for (CollisionBackend backend : {CollisionBackend::KdTree, CollisionBackend::Esdf}) {
+        planner.collision_backend = backend;
+        const char* name          = backend == CollisionBackend::KdTree ? "KD-tree" : "ESDF";
+
+        double checksum = 0.0;
+        start           = Clock::now();
+        for (const auto& H : poses) {
+            checksum += std::min(planner.obstacleDistance(H.translation().cast<float>()), planner.collision_margin);
+        }
+        end = Clock::now();
+        std::cout << "[ESDF benchmark] " << name << " point query: "
+                  << std::chrono::duration<double, std::micro>(end - start).count() / num_poses
+                  << " us (checksum " << checksum << ")\n";
+
+        double total_cost = 0.0;
+        start             = Clock::now();
+        for (const auto& H : poses) {
+            total_cost += planner.meshCollisionCost(H);
+        }
+        end = Clock::now();
+        std::cout << "[ESDF benchmark] " << name << " meshCollisionCost (" << planner.ee_mesh_cloud->size()
+                  << " points): " << std::chrono::duration<double, std::micro>(end - start).count() / num_poses
+                  << " us (total cost " << total_cost << ")\n";
+    }
+
+    // 5) Accuracy of the ESDF within the collision margin
+    double max_error = 0.0;
+    int num_close    = 0;
+    for (const auto& H : poses) {
+        const Eigen::Vector3f p   = H.translation().cast<float>();
+        planner.collision_backend = CollisionBackend::KdTree;
+        const double d_kd         = planner.obstacleDistance(p);
+        planner.collision_backend = CollisionBackend::Esdf;
+        const double d_esdf       = planner.obstacleDistance(p);
+        if (d_kd < planner.collision_margin) {
+            max_error = std::max(max_error, std::abs(d_kd - d_esdf));
+            ++num_close;
+        }
+    }
+    std::cout << "[ESDF benchmark] Max |ESDF - KD-tree| within margin: " << max_error << " m over " << num_close
+              << " queries\n";
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+#ifndef JSON_REPORTER_HPP
+#define JSON_REPORTER_HPP
+
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Catch2 reporter that writes benchmark results as JSON.
+ *
+ * The layout follows the Google Benchmark JSON format (a "context" object and a "benchmarks" array with name,
+ * iterations, real_time, cpu_time and time_unit), so results from two releases can be compared with the usual
+ * tooling. Catch2 only measures wall time, so cpu_time repeats real_time. Standard output from the code under test is
+ * captured by Catch2 and never mixed into the report.
+ */
+class JsonReporter : public Catch::StreamingReporterBase<JsonReporter> {
+public:
+    explicit JsonReporter(const Catch::ReporterConfig& config) : StreamingReporterBase(config) {
+        m_reporterPrefs.shouldRedirectStdOut = true;
+    }
+
+    static std::string getDescription() {
+        return "Reports benchmark results as JSON (Google Benchmark layout)";
+    }
+
+    void assertionStarting(const Catch::AssertionInfo&) override {}
+
+    bool assertionEnded(const Catch::AssertionStats& stats) override {
+        if (!stats.assertionResult.isOk()) {
+            ++failed_assertions_;
+        }
+        return true;
+    }
+
+    void benchmarkEnded(const Catch::BenchmarkStats<>& stats) override {
+        Result result;
+        result.test_case        = currentTestCaseInfo->name;
+        result.name             = stats.info.name;
+        result.iterations       = stats.info.iterations;
+        result.samples          = stats.info.samples;
+        result.mean             = stats.mean.point.count();
+        result.mean_lower       = stats.mean.lower_bound.count();
+        result.mean_upper       = stats.mean.upper_bound.count();
+        result.std_dev          = stats.standardDeviation.point.count();
+        result.outlier_variance = stats.outlierVariance;
+        results_.push_back(result);
+    }
+
+    void benchmarkFailed(const std::string& error) override {
+        errors_.push_back(error);
+    }
+
+    void testRunEnded(const Catch::TestRunStats& stats) override {
+        std::time_t now = std::time(nullptr);
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+        stream << "{\n";
+        stream << "  \"context\": {\n";
+        stream << "    \"date\": \"" << date << "\",\n";
+        stream << "    \"executable\": \"" << escape(stats.runInfo.name) << "\",\n";
+        stream << "    \"build_type\": \"" << buildType() << "\",\n";
+        stream << "    \"samples\": " << m_config->benchmarkSamples() << ",\n";
+        stream << "    \"failed_assertions\": " << failed_assertions_ << ",\n";
+        stream << "    \"errors\": [";
+        for (std::size_t i = 0; i < errors_.size(); ++i) {
+            stream << (i ? ", " : "") << "\"" << escape(errors_[i]) << "\"";
+        }
+        stream << "]\n";
+        stream << "  },\n";
+        stream << "  \"benchmarks\": [";
+        for (std::size_t i = 0; i < results_.size(); ++i) {
+            const Result& r = results_[i];
+            stream << (i ? "," : "") << "\n    {\n";
+            stream << "      \"name\": \"" << escape(r.name) << "\",\n";
+            stream << "      \"run_name\": \"" << escape(r.name) << "\",\n";
+            stream << "      \"run_type\": \"iteration\",\n";
+            stream << "      \"test_case\": \"" << escape(r.test_case) << "\",\n";
+            stream << "      \"iterations\": " << r.iterations << ",\n";
+            stream << "      \"samples\": " << r.samples << ",\n";
+            stream << "      \"real_time\": " << r.mean << ",\n";
+            stream << "      \"cpu_time\": " << r.mean << ",\n";
+            stream << "      \"real_time_lower_bound\": " << r.mean_lower << ",\n";
+            stream << "      \"real_time_upper_bound\": " << r.mean_upper << ",\n";
+            stream << "      \"real_time_stddev\": " << r.std_dev << ",\n";
+            stream << "      \"outlier_variance\": " << r.outlier_variance << ",\n";
+            stream << "      \"time_unit\": \"ns\"\n";
+            stream << "    }";
+        }
+        stream << (results_.empty() ? "" : "\n  ") << "]\n";
+        stream << "}\n";
+        stream.flush();
+        StreamingReporterBase::testRunEnded(stats);
+    }
+
+private:
+    /// One benchmark, times in nanoseconds.
+    struct Result {
+        std::string test_case;
+        std::string name;
+        int iterations          = 0;
+        int samples             = 0;
+        double mean             = 0.0;
+        double mean_lower       = 0.0;
+        double mean_upper       = 0.0;
+        double std_dev          = 0.0;
+        double outlier_variance = 0.0;
+    };
+
+    static std::string escape(const std::string& str) {
+        std::string escaped;
+        escaped.reserve(str.size());
+        for (char c : str) {
+            switch (c) {
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                case '\n': escaped += "\\n"; break;
+                case '\t': escaped += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char buffer[8];
+                        std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                        escaped += buffer;
+                    }
+                    else {
+                        escaped += c;
+                    }
+            }
+        }
+        return escaped;
+    }
+
+    static const char* buildType() {
+#ifdef __OPTIMIZE__
+        return "release";
+#else
+        return "debug";
+#endif
+    }
+
+    std::vector<Result> results_;
+    std::vector<std::string> errors_;
+    std::size_t failed_assertions_ = 0;
+};
+
+#endif  // JSON_REPORTER_HPP
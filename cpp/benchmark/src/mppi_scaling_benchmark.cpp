@@ -0,0 +1,116 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "benchmark_scene.hpp"
+
+// Reports getActionMPPI wall time from 1 to N threads and checks that the result does not depend on the thread count,
+// then the time, pruned fraction and deviation of the update with cost-bound pruning, and finally the spread of the
+// update over seeds for each noise engine and sample count (lower is a better estimate for the same samples).
+int main() {
+    using Clock = std::chrono::high_resolution_clock;
+    PlannerMpc<6, 6, 1, double> planner;
+    if (!loadBenchmarkScene(planner)) {
+        return -1;
+    }
+    planner.num_samples  = 2048;
+    planner.mppi_pruning = false;  // The thread scaling runs are the unpruned reference.
+    planner.H_goal       = benchmarkGoals().front();
+
+    const Eigen::Isometry3d H_0 = benchmarkStartPose();
+    const int repeats           = 5;
+
+    // Powers of two up to the core count, plus the core count itself.
+    const int max_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    double time_1 = 0.0;
+    std::vector<double> U_ref;
+    for (int threads : thread_counts) {
+        planner.num_threads = threads;
+
+        double total_ms = 0.0;
+        std::vector<double> U_opt;
+        for (int r = 0; r < repeats; ++r) {
+            // Same seed and call index for every run, so every thread count sees identical noise.
+            planner.mppi_seed       = 42;
+            planner.mppi_call_count = 0;
+            planner.U.clear();
+            auto start = Clock::now();
+            U_opt      = planner.getActionMPPI(H_0);
+            auto end   = Clock::now();
+            total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+        }
+        const double ms = total_ms / repeats;
+        if (threads == 1) {
+            time_1 = ms;
+            U_ref  = U_opt;
+        }
+
+        std::cout << "[MPPI scaling] threads=" << threads << " samples=" << planner.num_samples << " time=" << ms
+                  << " ms speedup=" << time_1 / ms << " deterministic=" << (U_opt == U_ref ? "yes" : "no") << "\n";
+    }
+
+    // Cost-bound pruning on all cores: time, pruned fraction and deviation from the full update.
+    planner.mppi_pruning = true;
+    double total_ms      = 0.0;
+    std::vector<double> U_pruned;
+    for (int r = 0; r < repeats; ++r) {
+        planner.mppi_seed       = 42;
+        planner.mppi_call_count = 0;
+        planner.U.clear();
+        auto start = Clock::now();
+        U_pruned   = planner.getActionMPPI(H_0);
+        auto end   = Clock::now();
+        total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    double deviation = 0.0;
+    for (std::size_t j = 0; j < U_pruned.size(); ++j) {
+        deviation = std::max(deviation, std::abs(U_pruned[j] - U_ref[j]));
+    }
+    std::cout << "[MPPI scaling] pruning threads=" << planner.num_threads << " time=" << total_ms / repeats
+              << " ms pruned=" << static_cast<double>(planner.mppi_pruned) / planner.mppi_candidates
+              << " max_deviation=" << deviation << "\n";
+
+    // Noise engines: RMS deviation of the update from its mean over seeds.
+    planner.mppi_pruning = false;
+    const int seeds      = 8;
+    for (NoiseEngine engine : {NoiseEngine::Philox, NoiseEngine::Sobol, NoiseEngine::Halton}) {
+        planner.noise_engine = engine;
+        for (int samples : {64, 256, 1024}) {
+            planner.num_samples = samples;
+            std::vector<std::vector<double>> updates;
+            total_ms = 0.0;
+            for (int seed = 0; seed < seeds; ++seed) {
+                planner.mppi_seed       = seed;
+                planner.mppi_call_count = 0;
+                planner.U.clear();
+                auto start = Clock::now();
+                updates.push_back(planner.getActionMPPI(H_0));
+                auto end = Clock::now();
+                total_ms += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+            double spread = 0.0;
+            for (std::size_t j = 0; j < updates.front().size(); ++j) {
+                double mean = 0.0;
+                for (const auto& U_opt : updates) {
+                    mean += U_opt[j] / seeds;
+                }
+                for (const auto& U_opt : updates) {
+                    spread += (U_opt[j] - mean) * (U_opt[j] - mean) / seeds;
+                }
+            }
+            std::cout << "[MPPI scaling] noise=" << noiseEngineName(engine) << " samples=" << samples
+                      << " time=" << total_ms / seeds << " ms spread=" << std::sqrt(spread) << "\n";
+        }
+    }
+    return 0;
+}
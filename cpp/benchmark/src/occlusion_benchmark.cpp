@@ -0,0 +1,94 @@
+#include <Eigen/Dense>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include "benchmark_scene.hpp"
+
+// Compares the per-point and octree frustum counts with the occlusion-aware count on the stereo scan of the vine.
+int main() {
+    using Clock = std::chrono::high_resolution_clock;
+
+    for (float leaf_size : {0.0f, 0.01f, 0.03f}) {
+        PlannerMpc<6, 6, 1, double> planner;
+        if (!loadBenchmarkScene(planner, "../data/vine_simple_streo_scan.pcd", leaf_size)) {
+            return -1;
+        }
+        const auto& cloud = planner.obstacle_cloud;
+
+        // Viewpoints 0.3-0.5 m from the cloud centroid, looking at it (the camera views along the pose z-axis).
+        Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+        for (const auto& pt : cloud->points) {
+            centroid += Eigen::Vector3d(pt.x, pt.y, pt.z);
+        }
+        centroid /= static_cast<double>(cloud->size());
+        const int num_poses = 500;
+        std::mt19937 gen(42);
+        std::normal_distribution<double> normal(0.0, 1.0);
+        std::uniform_real_distribution<double> range(0.3, 0.5);
+        std::vector<Eigen::Isometry3d> poses;
+        for (int i = 0; i < num_poses; ++i) {
+            const Eigen::Vector3d offset = Eigen::Vector3d(normal(gen), normal(gen), normal(gen)).normalized();
+            Eigen::Isometry3d H          = Eigen::Isometry3d::Identity();
+            H.translation()              = centroid + range(gen) * offset;
+            H.linear() = Eigen::Quaterniond::FromTwoVectors(Eigen::Vector3d::UnitZ(), -offset).toRotationMatrix();
+            poses.push_back(H);
+        }
+
+        // Frustum count, per point and through the octree
+        planner.visibility_backend    = VisibilityBackend::Frustum;
+        planner.use_visibility_octree = false;
+        planner.prepareScene();
+        double frustum_total = 0.0;
+        auto start           = Clock::now();
+        for (const auto& H : poses) {
+            frustum_total += planner.countVisiblePoints(H);
+        }
+        auto end = Clock::now();
+        std::cout << "[Occlusion benchmark] leaf " << leaf_size << " (" << cloud->size() << " points) frustum count: "
+                  << std::chrono::duration<double, std::micro>(end - start).count() / num_poses << " us, mean "
+                  << frustum_total / num_poses << " points\n";
+
+        // Octree at every cloud size, to show where visibility_octree_min_points should sit.
+        planner.use_visibility_octree        = true;
+        planner.visibility_octree_min_points = 0;
+        start                                = Clock::now();
+        planner.prepareScene();
+        end = Clock::now();
+
+        const double octree_build_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        double octree_total          = 0.0;
+        start                        = Clock::now();
+        for (const auto& H : poses) {
+            octree_total += planner.countVisiblePoints(H);
+        }
+        end = Clock::now();
+        std::cout << "[Occlusion benchmark]   octree (" << planner.visibility_octree.nodes().size() << " nodes, build "
+                  << octree_build_ms << " ms) frustum count: "
+                  << std::chrono::duration<double, std::micro>(end - start).count() / num_poses << " us, "
+                  << (octree_total == frustum_total ? "same count" : "COUNT MISMATCH") << "\n";
+
+        // Occlusion-aware count at several voxel sizes
+        planner.visibility_backend = VisibilityBackend::Occlusion;
+        for (double resolution : {0.01, 0.02, 0.04}) {
+            planner.occlusion_resolution = resolution;
+            start                        = Clock::now();
+            planner.prepareScene();
+            end = Clock::now();
+            const double build_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+            double visible_total = 0.0;
+            start                = Clock::now();
+            for (const auto& H : poses) {
+                visible_total += planner.countVisiblePoints(H);
+            }
+            end = Clock::now();
+            std::cout << "[Occlusion benchmark]   voxel " << resolution << " (" << planner.occlusion_grid.numOccupied()
+                      << " occupied, build " << build_ms << " ms) occlusion count: "
+                      << std::chrono::duration<double, std::micro>(end - start).count() / num_poses << " us, mean "
+                      << visible_total / num_poses << " points ("
+                      << 100.0 * visible_total / std::max(frustum_total, 1.0) << " % of frustum)\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,296 @@
+#define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <Eigen/Dense>
+#include <catch2/catch.hpp>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark_scene.hpp"
+#include "json_reporter.hpp"
+
+CATCH_REGISTER_REPORTER("json", JsonReporter)
+
+// Micro and macro benchmarks of the planner hot paths on the bundled scans.
+//
+//   ./planner_benchmark                      all benchmarks, JSON on stdout
+//   ./planner_benchmark -o planner.json      write the JSON report to a file
+//   ./planner_benchmark "[micro]"            cost terms only
+//   ./planner_benchmark "[macro]" -r console solvers and full planning, human readable
+//
+// Run from the build directory so that ../data resolves.
+
+namespace {
+    using Planner = PlannerMpc<6, 6, 1, double>;
+
+    /// A scan and the voxel leaf size it is downsampled with (0 keeps every point).
+    struct SceneCase {
+        std::string pcd;
+        float leaf_size;
+    };
+
+    /// Raw and downsampled stereo scan plus the filtered scan, each at several leaf sizes.
+    std::vector<SceneCase> sceneCases() {
+        std::vector<SceneCase> cases;
+        for (const char* pcd : {"vine_simple_streo_scan", "vine_simple_streo_scan_downsampled", "filtered_cloud"}) {
+            for (float leaf_size : {0.0f, 0.01f, 0.03f}) {
+                cases.push_back({pcd, leaf_size});
+            }
+        }
+        return cases;
+    }
+
+    /// Benchmark name suffix, e.g. "vine_simple_streo_scan/leaf:0.03/points:5012".
+    std::string sceneLabel(const SceneCase& scene, const Planner& planner) {
+        std::ostringstream label;
+        label << scene.pcd << "/leaf:" << scene.leaf_size << "/points:" << planner.obstacle_cloud->size();
+        return label.str();
+    }
+
+    /// Random actions within the planner bounds.
+    std::vector<double> randomAction(const Planner& planner, std::mt19937& gen) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::vector<double> U(6);
+        for (std::size_t i = 0; i < U.size(); ++i) {
+            U[i] = i < 3 ? planner.dp_min + unit(gen) * (planner.dp_max - planner.dp_min)
+                         : planner.dtheta_min + unit(gen) * (planner.dtheta_max - planner.dtheta_min);
+        }
+        return U;
+    }
+
+    /// Poses of a random rollout from the main.cpp start pose.
+    std::vector<Eigen::Isometry3d> randomPoses(Planner& planner, std::size_t count) {
+        std::mt19937 gen(42);
+        planner.H_0 = benchmarkStartPose();
+        std::vector<Eigen::Isometry3d> poses;
+        while (poses.size() < count) {
+            for (const auto& s : planner.rollout(randomAction(planner, gen))) {
+                poses.push_back(stateToIsometry<double>(s.head(3), s.tail(3)));
+            }
+        }
+        poses.resize(count);
+        return poses;
+    }
+}  // namespace
+
+TEST_CASE("Rollout and pose error", "[micro]") {
+    Planner planner;
+    planner.H_0    = benchmarkStartPose();
+    planner.H_goal = benchmarkGoals().front();
+    planner.w_p    = 1e4;
+    planner.w_q    = 1e2;
+
+    std::mt19937 gen(42);
+    const std::vector<double> U                = randomAction(planner, gen);
+    const std::vector<Eigen::Isometry3d> poses = randomPoses(planner, 64);
+
+    BENCHMARK("rollout") {
+        return planner.rollout(U);
+    };
+
+    const Planner::ActionSequence U_fixed = Eigen::Map<const Planner::ActionSequence>(U.data());
+    Planner::StateTrajectory trajectory;
+    BENCHMARK("rollout/fixed_size") {
+        planner.rollout(U_fixed, trajectory);
+        return trajectory(0, 1);
+    };
+
+    BENCHMARK("homogeneousError") {
+        Eigen::Matrix<double, 6, 1> sum = Eigen::Matrix<double, 6, 1>::Zero();
+        for (const auto& H : poses) {
+            sum += homogeneousError(H, planner.H_goal);
+        }
+        return sum;
+    };
+
+    BENCHMARK("poseCost") {
+        double sum = 0.0;
+        for (const auto& H : poses) {
+            sum += planner.poseCost(H, planner.w_p, planner.w_q);
+        }
+        return sum;
+    };
+}
+
+TEST_CASE("Collision and visibility cost", "[micro]") {
+    const SceneCase scene = GENERATE(from_range(sceneCases()));
+    Planner planner;
+    REQUIRE(loadBenchmarkScene(planner, "../data/" + scene.pcd + ".pcd", scene.leaf_size));
+    planner.prepareScene();
+    const std::string label                    = sceneLabel(scene, planner);
+    const std::vector<Eigen::Isometry3d> poses = randomPoses(planner, 64);
+
+    for (CollisionBackend backend : {CollisionBackend::KdTree, CollisionBackend::Esdf}) {
+        planner.collision_backend = backend;
+        if (backend == CollisionBackend::Esdf) {
+            planner.buildEsdf();
+        }
+        const std::string name = backend == CollisionBackend::KdTree ? "kdtree" : "esdf";
+        BENCHMARK("meshCollisionCost/" + name + "/" + label) {
+            double sum = 0.0;
+            for (const auto& H : poses) {
+                sum += planner.meshCollisionCost(H);
+            }
+            return sum;
+        };
+    }
+
+    for (VisibilityBackend backend : {VisibilityBackend::Frustum, VisibilityBackend::Occlusion}) {
+        planner.visibility_backend = backend;
+        planner.prepareScene();
+        const std::string name = backend == VisibilityBackend::Frustum ? "frustum" : "occlusion";
+        BENCHMARK("visibilityCost/" + name + "/" + label) {
+            double sum = 0.0;
+            for (const auto& H : poses) {
+                sum += planner.visibilityCost(H);
+            }
+            return sum;
+        };
+    }
+}
+
+TEST_CASE("Collision cost per cutter mesh", "[micro]") {
+    const std::string stl = GENERATE(as<std::string>{}, "cutter", "cutter_m", "cutter_simple");
+    Planner planner;
+    REQUIRE(loadBenchmarkScene(planner, "../data/vine_simple_streo_scan.pcd", 0.03f, "../data/" + stl + ".stl"));
+    planner.prepareScene();
+    const std::vector<Eigen::Isometry3d> poses = randomPoses(planner, 64);
+
+    BENCHMARK("meshCollisionCost/" + stl + "/mesh_points:" + std::to_string(planner.ee_mesh_cloud->size())) {
+        double sum = 0.0;
+        for (const auto& H : poses) {
+            sum += planner.meshCollisionCost(H);
+        }
+        return sum;
+    };
+}
+
+TEST_CASE("Batched cost", "[micro]") {
+    Planner planner;
+    REQUIRE(loadBenchmarkScene(planner, "../data/vine_simple_streo_scan.pcd", 0.03f));
+    planner.collision_backend = CollisionBackend::Esdf;
+    planner.H_0               = benchmarkStartPose();
+    planner.H_goal            = benchmarkGoals().front();
+    planner.prepareScene();
+
+    std::mt19937 gen(42);
+    const int K = 256;
+    Planner::CandidateMatrix candidates(K, 6);
+    for (int i = 0; i < K; ++i) {
+        const std::vector<double> U = randomAction(planner, gen);
+        candidates.row(i)           = Eigen::Map<const Eigen::Matrix<double, 1, 6>>(U.data());
+    }
+    const std::string label = "samples:" + std::to_string(K);
+    CollisionWorkspace workspace;
+    Planner::BatchWorkspace batch;
+    Eigen::VectorXd costs(K);
+
+    BENCHMARK("cost/per_sample/" + label) {
+        for (int i = 0; i < K; ++i) {
+            costs(i) = planner.cost(candidates.row(i).transpose(), workspace);
+        }
+        return costs.sum();
+    };
+
+    BENCHMARK("costBatch/" + label) {
+        planner.costBatch(candidates, costs, workspace, batch);
+        return costs.sum();
+    };
+}
+
+TEST_CASE("Obstacle map update", "[micro]") {
+    // The raw stereo scan split into eight batches, standing in for successive scans.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr scan(new pcl::PointCloud<pcl::PointXYZ>);
+    REQUIRE(pcl::io::loadPCDFile("../data/vine_simple_streo_scan.pcd", *scan) != -1);
+    const std::size_t num_batches = 8;
+    std::vector<pcl::PointCloud<pcl::PointXYZ>> batches(num_batches);
+    for (std::size_t i = 0; i < scan->size(); ++i) {
+        batches[i % num_batches].points.push_back(scan->points[i]);
+    }
+    const std::string label = "batch_points:" + std::to_string(batches.front().size());
+
+    VoxelObstacleMap map(0.03f);
+    for (const auto& batch : batches) {
+        map.insert(batch);
+    }
+    BENCHMARK("VoxelObstacleMap::insert+remove/" + label) {
+        return map.remove(map.insert(batches.front()));
+    };
+
+    // The planner's first cost evaluation after an update, including the refresh of its visibility points.
+    Planner planner;
+    REQUIRE(loadBenchmarkScene(planner, "../data/vine_simple_streo_scan.pcd", 0.03f));
+    planner.obstacle_map      = std::make_shared<VoxelObstacleMap>(0.03f);
+    planner.collision_backend = CollisionBackend::VoxelMap;
+    for (const auto& batch : batches) {
+        planner.obstacle_map->insert(batch);
+    }
+    planner.H_0               = benchmarkStartPose();
+    planner.H_goal            = benchmarkGoals().front();
+    planner.prepareScene();
+    std::mt19937 gen(42);
+    const std::vector<double> U = randomAction(planner, gen);
+    std::vector<double> no_grad;
+    BENCHMARK("VoxelObstacleMap::insert+cost+remove/" + label) {
+        const auto id     = planner.obstacle_map->insert(batches.front());
+        planner.prepareScene();
+        const double cost = planner.cost(U, no_grad);
+        planner.obstacle_map->remove(id);
+        return cost;
+    };
+
+    BENCHMARK("VoxelGrid+KdTreeFLANN rebuild/" + label) {
+        pcl::PointCloud<pcl::PointXYZ>::Ptr downsampled(new pcl::PointCloud<pcl::PointXYZ>);
+        pcl::VoxelGrid<pcl::PointXYZ> voxel;
+        voxel.setInputCloud(scan);
+        voxel.setLeafSize(0.03f, 0.03f, 0.03f);
+        voxel.filter(*downsampled);
+        pcl::KdTreeFLANN<pcl::PointXYZ> kd_tree;
+        kd_tree.setInputCloud(downsampled);
+        return downsampled->size();
+    };
+}
+
+TEST_CASE("Solvers and full planning", "[macro]") {
+    const SceneCase scene = GENERATE(from_range(sceneCases()));
+    Planner planner;
+    REQUIRE(loadBenchmarkScene(planner, "../data/" + scene.pcd + ".pcd", scene.leaf_size));
+    planner.prepareScene();
+    const std::string label                    = sceneLabel(scene, planner);
+    const Eigen::Isometry3d H_0                = benchmarkStartPose();
+    const std::vector<Eigen::Isometry3d> goals = benchmarkGoals();
+    planner.H_goal                             = goals.front();
+
+    BENCHMARK("getAction/" + label) {
+        planner.U.clear();
+        return planner.getAction(H_0);
+    };
+
+    BENCHMARK("getActionMPPI/" + label) {
+        planner.U.clear();
+        planner.mppi_call_count = 0;
+        return planner.getActionMPPI(H_0);
+    };
+
+    BENCHMARK("generateWaypoints/" + label) {
+        planner.U.clear();
+        return planner.generateWaypoints(H_0, goals.front());
+    };
+}
+
+int main(int argc, char* argv[]) {
+    Catch::Session session;
+
+    // Planning a full trajectory takes seconds on the raw scan, so use fewer samples than Catch2's default of 100.
+    // Both defaults can be overridden on the command line (--benchmark-samples, -r).
+    session.configData().benchmarkSamples = 10;
+    session.configData().reporterName     = "json";
+
+    const int result = session.applyCommandLine(argc, argv);
+    if (result != 0) {
+        return result;
+    }
+    return session.run();
+}
@@ -0,0 +1,68 @@
+#include <Eigen/Dense>
+#include <iostream>
+#include <vector>
+
+#include "benchmark_scene.hpp"
+
+// Plans the main.cpp goal set with a solver mode, rotation integrator and number of COBYLA starts and reports cost
+// evaluations, wall time and final error; total receives the sums over the goals.
+bool planGoalSet(SolverStats& total, SolverMode mode, RotationIntegrator integrator, int cobyla_starts = 1) {
+    PlannerMpc<6, 6, 1, double> planner;
+    if (!loadBenchmarkScene(planner)) {
+        return false;
+    }
+    planner.solver_mode         = mode;
+    planner.rotation_integrator = integrator;
+    planner.cobyla_starts       = cobyla_starts;
+
+    const std::vector<Eigen::Isometry3d> goals = benchmarkGoals();
+    Eigen::Isometry3d H_0                      = benchmarkStartPose();
+    total           = SolverStats();
+    total.mode      = mode;
+    total.converged = true;
+    for (const auto& goal : goals) {
+        std::vector<Eigen::Isometry3d> waypoints = planner.generateWaypoints(H_0, goal);
+        total.cost_evaluations += planner.stats.cost_evaluations;
+        total.iterations += planner.stats.iterations;
+        total.wall_time_ms += planner.stats.wall_time_ms;
+        total.final_position_error    = std::max(total.final_position_error, planner.stats.final_position_error);
+        total.final_orientation_error = std::max(total.final_orientation_error, planner.stats.final_orientation_error);
+        total.converged               = total.converged && planner.stats.converged;
+        H_0 = waypoints.size() >= 2 ? waypoints[waypoints.size() - 2] : waypoints.back();
+    }
+
+    std::cout << "[Solver benchmark] " << solverModeName(mode) << " (" << rotationIntegratorName(integrator)
+              << ", starts=" << cobyla_starts << "): evaluations=" << total.cost_evaluations
+              << " iterations=" << total.iterations
+              << " time=" << total.wall_time_ms << " ms max_pos_err=" << total.final_position_error
+              << " max_ori_err=" << total.final_orientation_error
+              << " converged=" << (total.converged ? "yes" : "no") << "\n";
+    return true;
+}
+
+// Compares the solver modes, each with the Euler and the exponential-map rotation integrator, and COBYLA with
+// parallel starts.
+int main() {
+    for (SolverMode mode : {SolverMode::Cobyla, SolverMode::Mppi, SolverMode::MppiCobyla}) {
+        SolverStats euler, exp_map;
+        if (!planGoalSet(euler, mode, RotationIntegrator::Euler)
+            || !planGoalSet(exp_map, mode, RotationIntegrator::ExpMap)) {
+            return -1;
+        }
+        // Evaluations to convergence only compare when both integrators converged on every goal.
+        std::cout << "[Solver benchmark] " << solverModeName(mode) << " ExpMap vs Euler: evaluations "
+                  << exp_map.cost_evaluations << " vs " << euler.cost_evaluations << " (ratio "
+                  << static_cast<double>(exp_map.cost_evaluations) / static_cast<double>(euler.cost_evaluations)
+                  << "), iterations " << exp_map.iterations << " vs " << euler.iterations;
+        if (!euler.converged || !exp_map.converged) {
+            std::cout << ", not comparable (converged: Euler " << (euler.converged ? "yes" : "no") << ", ExpMap "
+                      << (exp_map.converged ? "yes" : "no") << ")";
+        }
+        std::cout << "\n";
+    }
+    SolverStats starts;
+    if (!planGoalSet(starts, SolverMode::Cobyla, RotationIntegrator::Euler, 4)) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,297 @@
+#ifndef ESDF_HPP
+#define ESDF_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <vector>
+
+/**
+ * @brief Bounded Euclidean distance field over a regular voxel grid.
+ *
+ * The field stores, at every grid node, the distance to the nearest point of the source cloud clamped at a bound
+ * (typically the collision margin, beyond which the collision costs are zero anyway). A point cloud has no inside,
+ * so distances are non-negative. Queries trilinearly interpolate the eight surrounding nodes, so distance and
+ * gradient lookups are O(1) regardless of the cloud size.
+ *
+ * The node distances are either owned by the grid (build) or borrowed from external memory such as a memory-mapped
+ * scene cache (attach).
+ */
+class EsdfGrid {
+public:
+    /// Largest number of nodes build() allocates (4 bytes each); a finer grid is coarsened to fit.
+    std::int64_t max_nodes = std::int64_t(1) << 28;
+
+    /**
+     * @brief Builds the distance field from a point cloud.
+     *
+     * Each point only updates the nodes within the bound around it, so building costs
+     * O(N * (bound / resolution)^3). If the grid would need more than max_nodes nodes, the spacing is enlarged until
+     * it fits and an error is logged; resolution() then reports the spacing actually used.
+     *
+     * @param cloud      The obstacle cloud.
+     * @param resolution Grid spacing in metres.
+     * @param bound      Distance at which the field is clamped.
+     */
+    void build(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud, float resolution, float bound) {
+        clear();
+        source_               = cloud;
+        source_size_          = cloud ? cloud->points.size() : 0;
+        requested_resolution_ = resolution;
+        resolution_           = resolution;
+        bound_                = bound;
+        if (!cloud || cloud->points.empty() || resolution <= 0.0f || bound <= 0.0f) {
+            return;
+        }
+
+        // Grid bounds: cloud AABB padded by the bound plus one cell.
+        Eigen::Vector3f min_pt = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+        Eigen::Vector3f max_pt = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+        for (const auto& pt : cloud->points) {
+            const Eigen::Vector3f p(pt.x, pt.y, pt.z);
+            min_pt = min_pt.cwiseMin(p);
+            max_pt = max_pt.cwiseMax(p);
+        }
+        // Node counts are computed in double, so that a large extent cannot overflow before it is checked.
+        auto nodesAlong = [&](int i, float spacing) {
+            return std::ceil((static_cast<double>(max_pt(i)) - min_pt(i) + 2.0 * (bound + spacing)) / spacing) + 1.0;
+        };
+        auto numNodesAt = [&](float spacing) {
+            return nodesAlong(0, spacing) * nodesAlong(1, spacing) * nodesAlong(2, spacing);
+        };
+        // A grid has at least 4 nodes along each axis, however coarse.
+        const double cap             = static_cast<double>(std::max<std::int64_t>(max_nodes, 64));
+        const double requested_nodes = numNodesAt(resolution);
+        if (requested_nodes > cap) {
+            resolution *= static_cast<float>(std::cbrt(requested_nodes / cap));
+            while (numNodesAt(resolution) > cap) {
+                resolution *= 1.01f;
+            }
+            std::cerr << "[EsdfGrid::build] A spacing of " << requested_resolution_ << " m needs " << requested_nodes
+                      << " nodes, more than max_nodes (" << max_nodes << "); using " << resolution << " m.\n";
+            resolution_ = resolution;
+        }
+
+        const float pad = bound + resolution;
+        origin_         = min_pt - Eigen::Vector3f::Constant(pad);
+        for (int i = 0; i < 3; ++i) {
+            dims_(i) = static_cast<int>(nodesAlong(i, resolution));
+        }
+        distance_.assign(static_cast<std::size_t>(dims_.cast<std::int64_t>().prod()), bound);
+
+        // Splat each point's exact distance into the nodes within the bound.
+        const int reach    = static_cast<int>(std::ceil(bound / resolution));
+        const float bound2 = bound * bound;
+        for (const auto& pt : cloud->points) {
+            const Eigen::Vector3f p(pt.x, pt.y, pt.z);
+            const Eigen::Vector3i c  = ((p - origin_) / resolution).array().round().cast<int>();
+            const Eigen::Vector3i lo = (c.array() - reach).max(0);
+            const Eigen::Vector3i hi = (c.array() + reach).min(dims_.array() - 1);
+            for (int z = lo.z(); z <= hi.z(); ++z) {
+                for (int y = lo.y(); y <= hi.y(); ++y) {
+                    for (int x = lo.x(); x <= hi.x(); ++x) {
+                        const Eigen::Vector3f node = origin_ + resolution * Eigen::Vector3f(x, y, z);
+                        const float d2             = (node - p).squaredNorm();
+                        if (d2 < bound2) {
+                            float& d = distance_[index(x, y, z)];
+                            d        = std::min(d, std::sqrt(d2));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Uses node distances stored elsewhere instead of building them; nothing is copied.
+     *
+     * @param cloud      The obstacle cloud the distances were computed from.
+     * @param resolution Grid spacing in metres.
+     * @param bound      Distance at which the field is clamped.
+     * @param origin     World position of node (0, 0, 0).
+     * @param dims       Number of nodes along each axis.
+     * @param values     Node distances, x fastest.
+     * @param owner      Keeps the memory behind values alive for the lifetime of the grid.
+     */
+    void attach(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud,
+                float resolution,
+                float bound,
+                const Eigen::Vector3f& origin,
+                const Eigen::Vector3i& dims,
+                const float* values,
+                std::shared_ptr<const void> owner) {
+        source_               = cloud;
+        source_size_          = cloud ? cloud->points.size() : 0;
+        requested_resolution_ = resolution;
+        resolution_           = resolution;
+        bound_                = bound;
+        origin_               = origin;
+        dims_                 = dims;
+        distance_.clear();
+        external_ = values;
+        owner_    = std::move(owner);
+    }
+
+    /**
+     * @brief Drops the field; isBuiltFrom is false afterwards.
+     */
+    void clear() {
+        source_.reset();
+        source_size_ = 0;
+        distance_.clear();
+        external_ = nullptr;
+        owner_.reset();
+        dims_.setZero();
+    }
+
+    /**
+     * @brief Returns true if the field was built from the given cloud and parameters; a cloud allocated after the
+     *        source was released never matches, even at the same address.
+     */
+    bool isBuiltFrom(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud, float resolution, float bound) const {
+        return cloud && source_.lock() == cloud && cloud->points.size() == source_size_
+               && resolution == requested_resolution_ && bound == bound_;
+    }
+
+    /// True if no field has been built.
+    bool empty() const {
+        return numNodes() == 0;
+    }
+
+    /// Clamp distance of the field.
+    float bound() const {
+        return bound_;
+    }
+
+    /// Grid spacing of the field (coarser than requested if build() had to fit max_nodes).
+    float resolution() const {
+        return resolution_;
+    }
+
+    /// World position of node (0, 0, 0).
+    const Eigen::Vector3f& origin() const {
+        return origin_;
+    }
+
+    /// Number of nodes along each axis.
+    const Eigen::Vector3i& dims() const {
+        return dims_;
+    }
+
+    /// Number of grid nodes.
+    std::size_t numNodes() const {
+        return (external_ || !distance_.empty()) ? static_cast<std::size_t>(dims_.cast<std::int64_t>().prod()) : 0;
+    }
+
+    /// Node distances, x fastest.
+    const float* values() const {
+        return external_ ? external_ : distance_.data();
+    }
+
+    /**
+     * @brief Interpolated distance to the nearest obstacle point, clamped at the bound.
+     *
+     * @param p Query point in world coordinates.
+     * @return The distance; the bound if p lies outside the grid.
+     */
+    float distance(const Eigen::Vector3f& p) const {
+        Eigen::Vector3f gradient;
+        return distanceAndGradient(p, gradient);
+    }
+
+    /**
+     * @brief Interpolated distance and its gradient with respect to the query point.
+     *
+     * @param p        Query point in world coordinates.
+     * @param gradient Output gradient of the trilinear interpolant (zero outside the grid).
+     * @return The distance; the bound if p lies outside the grid.
+     */
+    float distanceAndGradient(const Eigen::Vector3f& p, Eigen::Vector3f& gradient) const {
+        gradient.setZero();
+        if (empty()) {
+            return bound_;
+        }
+        const Eigen::Vector3f g = (p - origin_) / resolution_;
+        const int x0            = static_cast<int>(std::floor(g.x()));
+        const int y0            = static_cast<int>(std::floor(g.y()));
+        const int z0            = static_cast<int>(std::floor(g.z()));
+        if (x0 < 0 || y0 < 0 || z0 < 0 || x0 >= dims_.x() - 1 || y0 >= dims_.y() - 1 || z0 >= dims_.z() - 1) {
+            return bound_;
+        }
+        const float fx = g.x() - x0;
+        const float fy = g.y() - y0;
+        const float fz = g.z() - z0;
+
+        const float* d   = values();
+        const float c000 = d[index(x0, y0, z0)];
+        const float c100 = d[index(x0 + 1, y0, z0)];
+        const float c010 = d[index(x0, y0 + 1, z0)];
+        const float c110 = d[index(x0 + 1, y0 + 1, z0)];
+        const float c001 = d[index(x0, y0, z0 + 1)];
+        const float c101 = d[index(x0 + 1, y0, z0 + 1)];
+        const float c011 = d[index(x0, y0 + 1, z0 + 1)];
+        const float c111 = d[index(x0 + 1, y0 + 1, z0 + 1)];
+
+        // Interpolate along x, then y, then z.
+        const float c00 = c000 + fx * (c100 - c000);
+        const float c10 = c010 + fx * (c110 - c010);
+        const float c01 = c001 + fx * (c101 - c001);
+        const float c11 = c011 + fx * (c111 - c011);
+        const float c0  = c00 + fy * (c10 - c00);
+        const float c1  = c01 + fy * (c11 - c01);
+
+        const float dx0 = (c100 - c000) + fy * ((c110 - c010) - (c100 - c000));
+        const float dx1 = (c101 - c001) + fy * ((c111 - c011) - (c101 - c001));
+        gradient.x()    = (dx0 + fz * (dx1 - dx0)) / resolution_;
+        gradient.y()    = ((c10 - c00) + fz * ((c11 - c01) - (c10 - c00))) / resolution_;
+        gradient.z()    = (c1 - c0) / resolution_;
+        return c0 + fz * (c1 - c0);
+    }
+
+    /**
+     * @brief Interpolated distances for a batch of query points.
+     *
+     * @param points    Query points in world coordinates (3 x N).
+     * @param distances Output distances (N), must already have the right size.
+     */
+    void distances(const Eigen::Ref<const Eigen::Matrix3Xf>& points, Eigen::Ref<Eigen::VectorXf> distances) const {
+        Eigen::Vector3f gradient;
+        for (Eigen::Index i = 0; i < points.cols(); ++i) {
+            distances(i) = distanceAndGradient(points.col(i), gradient);
+        }
+    }
+
+private:
+    std::size_t index(int x, int y, int z) const {
+        return (static_cast<std::size_t>(z) * dims_.y() + y) * dims_.x() + x;
+    }
+
+    /// Cloud the field was built from (identity only, never dereferenced).
+    std::weak_ptr<const pcl::PointCloud<pcl::PointXYZ>> source_;
+    /// Number of points in the source cloud.
+    std::size_t source_size_ = 0;
+    /// Grid spacing passed to build or attach.
+    float requested_resolution_ = 0.0f;
+    /// Grid spacing.
+    float resolution_ = 0.0f;
+    /// Clamp distance.
+    float bound_ = 0.0f;
+    /// World position of node (0, 0, 0).
+    Eigen::Vector3f origin_ = Eigen::Vector3f::Zero();
+    /// Number of nodes along each axis.
+    Eigen::Vector3i dims_ = Eigen::Vector3i::Zero();
+    /// Node distances owned by the grid, x fastest.
+    std::vector<float> distance_;
+    /// Node distances borrowed by attach (null when owned).
+    const float* external_ = nullptr;
+    /// Keeps the borrowed distances alive.
+    std::shared_ptr<const void> owner_;
+};
+
+#endif  // ESDF_HPP
@@ -0,0 +1,302 @@
+#ifndef FRUSTUM_OCTREE_HPP
+#define FRUSTUM_OCTREE_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <vector>
+
+#include "frustum_visibility.hpp"
+
+/**
+ * @brief Octree over a point cloud with a point count per node, for counting the points inside a camera frustum.
+ *
+ * Each node splits its cube into eight octants until at most leaf_size points remain, and stores the tight bounding
+ * box and the contiguous range of its points. A query classifies a node's box against the frustum planes: a box
+ * inside every plane contributes its point count without visiting the points, a box outside one plane is skipped,
+ * and only boxes crossing the frustum boundary are refined. The points of the leaves reached that way are tested
+ * with the per-point test of FrustumPointsSoA::countInFrustum.
+ *
+ * The box test keeps a margin that covers the rounding of the float plane test, so a box is only accepted or
+ * rejected when every point in it would be, and the count equals FrustumPointsSoA::countInFrustum (and therefore
+ * getFrustrumCloud(...)->size()) exactly.
+ */
+class FrustumOctree {
+public:
+    /// Largest subdivision depth accepted by setInputCloud.
+    static constexpr int MaxDepth = 32;
+
+    struct Node {
+        /// Tight bounding box of the points below the node.
+        Eigen::Vector3f min_pt = Eigen::Vector3f::Zero();
+        Eigen::Vector3f max_pt = Eigen::Vector3f::Zero();
+        /// Range [begin, end) of the points below the node; end - begin is its point count.
+        std::uint32_t begin = 0;
+        std::uint32_t end   = 0;
+        /// Children nodes()[first_child, first_child + num_children); a leaf has none.
+        std::uint32_t first_child  = 0;
+        std::uint32_t num_children = 0;
+    };
+
+    /**
+     * @brief Builds the octree over a cloud.
+     *
+     * @param cloud     The point cloud to count against.
+     * @param leaf_size Maximum number of points of a leaf (cells at max_depth may hold more).
+     * @param max_depth Maximum subdivision depth (at most MaxDepth).
+     */
+    void setInputCloud(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud, int leaf_size = 32, int max_depth = 16) {
+        clear();
+        source_ = cloud;
+        size_   = cloud ? cloud->points.size() : 0;
+
+        // Non-finite points cannot be placed in a cell; they are kept aside and tested on every query.
+        std::vector<std::uint32_t> order;
+        order.reserve(size_);
+        for (std::size_t i = 0; i < size_; ++i) {
+            const auto& pt = cloud->points[i];
+            if (std::isfinite(pt.x) && std::isfinite(pt.y) && std::isfinite(pt.z))
+                order.push_back(static_cast<std::uint32_t>(i));
+            else
+                loose_.push_back(Eigen::Vector3f(pt.x, pt.y, pt.z));
+        }
+        if (order.empty())
+            return;
+
+        Eigen::Vector3f min_pt = cloud->points[order[0]].getVector3fMap();
+        Eigen::Vector3f max_pt = min_pt;
+        for (std::uint32_t i : order) {
+            min_pt = min_pt.cwiseMin(cloud->points[i].getVector3fMap());
+            max_pt = max_pt.cwiseMax(cloud->points[i].getVector3fMap());
+        }
+        const float half = 0.5f * (max_pt - min_pt).maxCoeff();
+        nodes_.emplace_back();
+        buildNode(*cloud,
+                  order,
+                  0,
+                  0,
+                  static_cast<std::uint32_t>(order.size()),
+                  0.5f * (min_pt + max_pt),
+                  half,
+                  std::max(leaf_size, 1),
+                  std::min(std::max(max_depth, 0), MaxDepth));
+
+        x_.resize(order.size());
+        y_.resize(order.size());
+        z_.resize(order.size());
+        for (std::size_t j = 0; j < order.size(); ++j) {
+            x_[j] = cloud->points[order[j]].x;
+            y_[j] = cloud->points[order[j]].y;
+            z_[j] = cloud->points[order[j]].z;
+        }
+    }
+
+    /**
+     * @brief Drops the octree; isBuiltFrom is false afterwards.
+     */
+    void clear() {
+        source_.reset();
+        size_   = 0;
+        nodes_.clear();
+        loose_.clear();
+        x_.clear();
+        y_.clear();
+        z_.clear();
+    }
+
+    /**
+     * @brief Returns true if the octree was built from the given cloud; a cloud allocated after the source was
+     *        released never matches, even at the same address.
+     */
+    bool isBuiltFrom(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud) const {
+        return cloud && source_.lock() == cloud && cloud->points.size() == size_;
+    }
+
+    /// Number of points (including the non-finite ones).
+    std::size_t size() const {
+        return size_;
+    }
+
+    /// Nodes with every node's children stored contiguously; the root is nodes()[0].
+    const std::vector<Node>& nodes() const {
+        return nodes_;
+    }
+
+    /**
+     * @brief Counts the points inside the frustum.
+     *
+     * @param planes The frustum planes from computeFrustumPlanes.
+     * @param tested Optional output: number of points tested individually.
+     * @return The number of points inside the frustum.
+     */
+    std::size_t countInFrustum(const FrustumPlanes& planes, std::size_t* tested = nullptr) const {
+        float a[6], b[6], c[6], d[6];
+        for (int i = 0; i < 6; ++i) {
+            a[i] = planes(i, 0);
+            b[i] = planes(i, 1);
+            c[i] = planes(i, 2);
+            d[i] = planes(i, 3);
+        }
+
+        std::size_t count      = 0;
+        std::size_t num_tested = loose_.size();
+        for (const Eigen::Vector3f& p : loose_) {
+            count += insideAll(p.x(), p.y(), p.z(), a, b, c, d);
+        }
+        if (!nodes_.empty()) {
+            // Depth-first; at most 7 pending siblings per level plus the children of the deepest node.
+            std::uint32_t stack[7 * MaxDepth + 8];
+            int top      = 0;
+            stack[top++] = 0;
+            while (top > 0) {
+                const Node& node = nodes_[stack[--top]];
+                const int side   = classify(node, a, b, c, d);
+                if (side > 0)
+                    continue;
+                if (side < 0) {
+                    count += node.end - node.begin;
+                    continue;
+                }
+                if (node.num_children == 0) {
+                    for (std::uint32_t j = node.begin; j < node.end; ++j) {
+                        count += insideAll(x_[j], y_[j], z_[j], a, b, c, d);
+                    }
+                    num_tested += node.end - node.begin;
+                    continue;
+                }
+                for (std::uint32_t k = 0; k < node.num_children; ++k) {
+                    stack[top++] = node.first_child + k;
+                }
+            }
+        }
+        if (tested)
+            *tested = num_tested;
+        return count;
+    }
+
+private:
+    /// The per-point test of FrustumPointsSoA::countInFrustum.
+    static std::size_t insideAll(
+        float x, float y, float z, const float* a, const float* b, const float* c, const float* d) {
+        std::int32_t inside = 1;
+        for (int i = 0; i < 6; ++i) {
+            const float dist = (x * a[i] + z * c[i]) + (y * b[i] + d[i]);
+            inside &= static_cast<std::int32_t>(dist <= 0.0f);
+        }
+        return static_cast<std::size_t>(inside);
+    }
+
+    /**
+     * @brief Classifies a node's box: -1 if every point passes every plane test, +1 if every point fails one, else 0.
+     *
+     * The float plane distance of a point is within 3 rounding errors of |x a| + |z c| + |y b| + |d| of its exact
+     * value; the bounds here are evaluated in double with a margin of twice that.
+     */
+    static int classify(const Node& node, const float* a, const float* b, const float* c, const float* d) {
+        const Eigen::Vector3d min_pt = node.min_pt.cast<double>();
+        const Eigen::Vector3d max_pt = node.max_pt.cast<double>();
+        const Eigen::Vector3d centre = 0.5 * (min_pt + max_pt);
+        const Eigen::Vector3d extent = 0.5 * (max_pt - min_pt);
+        const Eigen::Vector3d reach  = min_pt.cwiseAbs().cwiseMax(max_pt.cwiseAbs());
+        const double rounding        = 6.0 * std::numeric_limits<float>::epsilon();
+        bool inside                  = true;
+        for (int i = 0; i < 6; ++i) {
+            const Eigen::Vector3d n(a[i], b[i], c[i]);
+            const double dist   = n.dot(centre) + d[i];
+            const double radius = n.cwiseAbs().dot(extent);
+            const double margin = rounding * (n.cwiseAbs().dot(reach) + std::abs(d[i]));
+            if (dist - radius > margin)
+                return 1;
+            inside = inside && dist + radius <= -margin;
+        }
+        return inside ? -1 : 0;
+    }
+
+    void buildNode(const pcl::PointCloud<pcl::PointXYZ>& cloud,
+                   std::vector<std::uint32_t>& order,
+                   std::uint32_t id,
+                   std::uint32_t begin,
+                   std::uint32_t end,
+                   const Eigen::Vector3f& centre,
+                   float half,
+                   int leaf_size,
+                   int depth_left) {
+        Eigen::Vector3f min_pt = cloud.points[order[begin]].getVector3fMap();
+        Eigen::Vector3f max_pt = min_pt;
+        for (std::uint32_t j = begin + 1; j < end; ++j) {
+            min_pt = min_pt.cwiseMin(cloud.points[order[j]].getVector3fMap());
+            max_pt = max_pt.cwiseMax(cloud.points[order[j]].getVector3fMap());
+        }
+        nodes_[id].min_pt = min_pt;
+        nodes_[id].max_pt = max_pt;
+        nodes_[id].begin  = begin;
+        nodes_[id].end    = end;
+        if (static_cast<int>(end - begin) <= leaf_size || depth_left == 0 || min_pt == max_pt)
+            return;
+
+        // Group the points by octant (bit 0: x, bit 1: y, bit 2: z above the centre).
+        auto octant = [&](std::uint32_t i) {
+            const auto& pt = cloud.points[i];
+            return (pt.x > centre.x() ? 1 : 0) | (pt.y > centre.y() ? 2 : 0) | (pt.z > centre.z() ? 4 : 0);
+        };
+        std::uint32_t bounds[9] = {};
+        for (std::uint32_t j = begin; j < end; ++j) {
+            ++bounds[octant(order[j]) + 1];
+        }
+        for (int o = 0; o < 8; ++o) {
+            bounds[o + 1] += bounds[o];
+        }
+        std::vector<std::uint32_t> sorted(end - begin);
+        std::uint32_t fill[8];
+        std::copy(bounds, bounds + 8, fill);
+        for (std::uint32_t j = begin; j < end; ++j) {
+            sorted[fill[octant(order[j])]++] = order[j];
+        }
+        std::copy(sorted.begin(), sorted.end(), order.begin() + begin);
+
+        // Children of a node are allocated together, so they stay contiguous.
+        const auto first_child     = static_cast<std::uint32_t>(nodes_.size());
+        std::uint32_t num_children = 0;
+        for (int o = 0; o < 8; ++o) {
+            num_children += bounds[o + 1] > bounds[o];
+        }
+        nodes_[id].first_child  = first_child;
+        nodes_[id].num_children = num_children;
+        nodes_.resize(nodes_.size() + num_children);
+
+        const float quarter = 0.5f * half;
+        std::uint32_t child = first_child;
+        for (int o = 0; o < 8; ++o) {
+            if (bounds[o + 1] == bounds[o])
+                continue;
+            const Eigen::Vector3f offset(
+                (o & 1) ? quarter : -quarter, (o & 2) ? quarter : -quarter, (o & 4) ? quarter : -quarter);
+            buildNode(cloud,
+                      order,
+                      child++,
+                      begin + bounds[o],
+                      begin + bounds[o + 1],
+                      centre + offset,
+                      quarter,
+                      leaf_size,
+                      depth_left - 1);
+        }
+    }
+
+    /// Cloud the octree was built from (identity only, never dereferenced).
+    std::weak_ptr<const pcl::PointCloud<pcl::PointXYZ>> source_;
+    /// Number of points in the source cloud.
+    std::size_t size_ = 0;
+    std::vector<Node> nodes_;
+    /// Point coordinates in node order.
+    std::vector<float> x_, y_, z_;
+    /// Non-finite points, tested individually.
+    std::vector<Eigen::Vector3f> loose_;
+};
+
+#endif  // FRUSTUM_OCTREE_HPP
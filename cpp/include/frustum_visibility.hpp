@@ -0,0 +1,338 @@
+#ifndef FRUSTUM_VISIBILITY_HPP
+#define FRUSTUM_VISIBILITY_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <vector>
+
+/// Six frustum planes (left, right, top, bottom, far, near), one (a, b, c, d) row per plane.
+using FrustumPlanes = Eigen::Matrix<float, 6, 4, Eigen::RowMajor>;
+
+/**
+ * @brief Converts a pose (X forward, Y left, Z up) into the camera pose expected by pcl::FrustumCulling.
+ *
+ * @param pose The pose in world coordinates.
+ * @return The 4x4 PCL camera pose (view, up and right vectors in the first three columns).
+ */
+template <typename Scalar>
+Eigen::Matrix4f frustumCameraPose(const Eigen::Transform<Scalar, 3, Eigen::Isometry>& pose) {
+    Eigen::Matrix4f camera_pose = pose.matrix().template cast<float>();
+    Eigen::Matrix4f cam2robot;
+    cam2robot << 0, 0, 1, 0, 0, -1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1;  // X right, Y down, Z forward
+    return camera_pose * cam2robot;
+}
+
+/**
+ * @brief Pose-independent part of the frustum construction: the plane distances and extents.
+ *
+ * Computed once and shared by every pose whose frustum is built with the same field of view and ranges.
+ */
+struct FrustumGeometry {
+    float np_dist = 0.0f;
+    float fp_dist = 0.0f;
+    float np_h    = 0.0f;
+    float np_w    = 0.0f;
+    float fp_h    = 0.0f;
+    float fp_w    = 0.0f;
+
+    FrustumGeometry() = default;
+
+    /**
+     * @param fov_degs   Field of view in degrees (horizontal & vertical).
+     * @param near_plane Near plane distance.
+     * @param far_plane  Far plane distance.
+     */
+    template <typename Scalar>
+    FrustumGeometry(Scalar fov_degs, Scalar near_plane, Scalar far_plane) {
+        np_dist             = static_cast<float>(near_plane);
+        fp_dist             = static_cast<float>(far_plane);
+        // pcl::FrustumCulling calls the unqualified tan on a float, which is ::tan(double); the extents follow its
+        // rounding so that points on the faces are classified the same way.
+        const float fov_rad = static_cast<float>(static_cast<float>(fov_degs) * M_PI / 180);
+        np_h                = static_cast<float>(2 * std::tan(static_cast<double>(fov_rad / 2)) * np_dist);
+        np_w                = np_h;
+        fp_h                = static_cast<float>(2 * std::tan(static_cast<double>(fov_rad / 2)) * fp_dist);
+        fp_w                = fp_h;
+    }
+};
+
+/**
+ * @brief Computes the six frustum planes for a pose, using the same construction as pcl::FrustumCulling.
+ *
+ * A point p lies inside the frustum when a * x + b * y + c * z + d <= 0 holds for every plane.
+ *
+ * @param geometry The frustum distances and extents.
+ * @param pose     The pose in world coordinates.
+ * @return The frustum planes.
+ */
+template <typename Scalar>
+FrustumPlanes computeFrustumPlanes(const FrustumGeometry& geometry,
+                                   const Eigen::Transform<Scalar, 3, Eigen::Isometry>& pose) {
+    const Eigen::Matrix4f camera_pose = frustumCameraPose(pose);
+    const Eigen::Vector3f view        = camera_pose.block<3, 1>(0, 0);
+    const Eigen::Vector3f up          = camera_pose.block<3, 1>(0, 1);
+    const Eigen::Vector3f right       = camera_pose.block<3, 1>(0, 2);
+    const Eigen::Vector3f T           = camera_pose.block<3, 1>(0, 3);
+
+    const float np_dist = geometry.np_dist;
+    const float fp_dist = geometry.fp_dist;
+    const float np_h    = geometry.np_h;
+    const float np_w    = geometry.np_w;
+    const float fp_h    = geometry.fp_h;
+    const float fp_w    = geometry.fp_w;
+
+    // Far and near plane corners
+    const Eigen::Vector3f fp_c(T + view * fp_dist);
+    const Eigen::Vector3f fp_tl(fp_c + (up * fp_h / 2) - (right * fp_w / 2));
+    const Eigen::Vector3f fp_tr(fp_c + (up * fp_h / 2) + (right * fp_w / 2));
+    const Eigen::Vector3f fp_bl(fp_c - (up * fp_h / 2) - (right * fp_w / 2));
+    const Eigen::Vector3f fp_br(fp_c - (up * fp_h / 2) + (right * fp_w / 2));
+    const Eigen::Vector3f np_c(T + view * np_dist);
+    const Eigen::Vector3f np_tr(np_c + (up * np_h / 2) + (right * np_w / 2));
+    const Eigen::Vector3f np_bl(np_c - (up * np_h / 2) - (right * np_w / 2));
+    const Eigen::Vector3f np_br(np_c - (up * np_h / 2) + (right * np_w / 2));
+
+    // Vectors from the camera to the far plane corners
+    const Eigen::Vector3f a(fp_bl - T);
+    const Eigen::Vector3f b(fp_br - T);
+    const Eigen::Vector3f c(fp_tr - T);
+    const Eigen::Vector3f d(fp_tl - T);
+
+    FrustumPlanes planes;
+    planes.block<1, 3>(0, 0) = d.cross(a).transpose();                            // Left
+    planes.block<1, 3>(1, 0) = b.cross(c).transpose();                            // Right
+    planes.block<1, 3>(2, 0) = c.cross(d).transpose();                            // Top
+    planes.block<1, 3>(3, 0) = a.cross(b).transpose();                            // Bottom
+    planes.block<1, 3>(4, 0) = (fp_bl - fp_br).cross(fp_tr - fp_br).transpose();  // Far
+    planes.block<1, 3>(5, 0) = (np_tr - np_br).cross(np_bl - np_br).transpose();  // Near
+    for (int i = 0; i < 4; ++i) {
+        planes(i, 3) = -T.dot(planes.block<1, 3>(i, 0).transpose());
+    }
+    planes(4, 3) = -fp_c.dot(planes.block<1, 3>(4, 0).transpose());
+    planes(5, 3) = -np_c.dot(planes.block<1, 3>(5, 0).transpose());
+    return planes;
+}
+
+/**
+ * @brief Computes the six frustum planes for a pose, using the same construction as pcl::FrustumCulling.
+ *
+ * @param fov_degs   Field of view in degrees (horizontal & vertical).
+ * @param near_plane Near plane distance.
+ * @param far_plane  Far plane distance.
+ * @param pose       The pose in world coordinates.
+ * @return The frustum planes.
+ */
+template <typename Scalar>
+FrustumPlanes computeFrustumPlanes(Scalar fov_degs,
+                                   Scalar near_plane,
+                                   Scalar far_plane,
+                                   const Eigen::Transform<Scalar, 3, Eigen::Isometry>& pose) {
+    return computeFrustumPlanes(FrustumGeometry(fov_degs, near_plane, far_plane), pose);
+}
+
+/**
+ * @brief Structure-of-arrays copy of a point cloud for counting the points inside a camera frustum.
+ *
+ * The cloud is copied once into contiguous x, y and z arrays padded to a multiple of BatchSize. Counting then runs
+ * over fixed-size batches without branches or allocations, so the compiler vectorizes the plane tests.
+ */
+class FrustumPointsSoA {
+public:
+    /// Number of points tested per batch.
+    static constexpr std::size_t BatchSize = 8;
+
+    /**
+     * @brief Copies the cloud into the structure-of-arrays buffers.
+     *
+     * @param cloud The point cloud to count against.
+     */
+    void setInputCloud(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud) {
+        source_ = cloud;
+        size_   = cloud ? cloud->points.size() : 0;
+
+        // Padding is NaN so it fails every plane test and never contributes to the count.
+        const std::size_t padded = ((size_ + BatchSize - 1) / BatchSize) * BatchSize;
+        x_.assign(padded, std::numeric_limits<float>::quiet_NaN());
+        y_.assign(padded, std::numeric_limits<float>::quiet_NaN());
+        z_.assign(padded, std::numeric_limits<float>::quiet_NaN());
+        for (std::size_t i = 0; i < size_; ++i) {
+            x_[i] = cloud->points[i].x;
+            y_[i] = cloud->points[i].y;
+            z_[i] = cloud->points[i].z;
+        }
+    }
+
+    /**
+     * @brief Refreshes the buffers after the cloud they were built from changed in place.
+     *
+     * @param cloud The source cloud, at its new size.
+     * @param slots Indices of the changed points; those at or beyond the new size are ignored.
+     * @return False (and nothing is changed) if the buffers were not built from this cloud.
+     */
+    bool updatePoints(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud, const std::vector<std::uint32_t>& slots) {
+        if (!cloud || source_.lock() != cloud)
+            return false;
+        const std::size_t old_size = size_;
+        size_                      = cloud->points.size();
+        const std::size_t padded   = ((size_ + BatchSize - 1) / BatchSize) * BatchSize;
+        x_.resize(padded);
+        y_.resize(padded);
+        z_.resize(padded);
+        for (std::size_t i = std::min(old_size, size_); i < padded; ++i) {
+            x_[i] = y_[i] = z_[i] = std::numeric_limits<float>::quiet_NaN();
+        }
+        for (std::uint32_t i : slots) {
+            if (i < size_) {
+                x_[i] = cloud->points[i].x;
+                y_[i] = cloud->points[i].y;
+                z_[i] = cloud->points[i].z;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Returns true if the buffers were built from the given cloud; a cloud allocated after the source was
+     *        released never matches, even at the same address.
+     */
+    bool isBuiltFrom(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud) const {
+        return cloud && source_.lock() == cloud && cloud->points.size() == size_;
+    }
+
+    /// Number of points (excluding padding).
+    std::size_t size() const {
+        return size_;
+    }
+
+    /**
+     * @brief Counts the points inside the frustum.
+     *
+     * The plane test uses the same coefficients and summation order as the Eigen::Vector4f dot product in
+     * pcl::FrustumCulling, so the count matches getFrustrumCloud(...)->size().
+     *
+     * @param planes The frustum planes from computeFrustumPlanes.
+     * @return The number of points inside the frustum.
+     */
+    std::size_t countInFrustum(const FrustumPlanes& planes) const {
+        float a[6], b[6], c[6], d[6];
+        for (int i = 0; i < 6; ++i) {
+            a[i] = planes(i, 0);
+            b[i] = planes(i, 1);
+            c[i] = planes(i, 2);
+            d[i] = planes(i, 3);
+        }
+
+        std::int32_t lane_count[BatchSize] = {};
+        const std::size_t padded           = x_.size();
+        for (std::size_t start = 0; start < padded; start += BatchSize) {
+            const float* xs = x_.data() + start;
+            const float* ys = y_.data() + start;
+            const float* zs = z_.data() + start;
+            for (std::size_t j = 0; j < BatchSize; ++j) {
+                std::int32_t inside = 1;
+                for (int i = 0; i < 6; ++i) {
+                    const float dist = (xs[j] * a[i] + zs[j] * c[i]) + (ys[j] * b[i] + d[i]);
+                    inside &= static_cast<std::int32_t>(dist <= 0.0f);
+                }
+                lane_count[j] += inside;
+            }
+        }
+
+        std::size_t count = 0;
+        for (std::size_t j = 0; j < BatchSize; ++j) {
+            count += static_cast<std::size_t>(lane_count[j]);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Smoothed point count of a view frustum, with its derivatives.
+     *
+     * Each point contributes the product of six logistic functions of its signed margins to the frustum faces, in
+     * the camera frame q = R^T (p - t) with +Z forward. As the temperature goes to zero the result approaches the
+     * hard count. Points more than 8 temperatures outside a face are skipped, as are non-finite points (the NaNs of an
+     * organized cloud), which the hard count never counts either.
+     *
+     * @param R            Camera rotation in the world frame.
+     * @param t            Camera position in the world frame.
+     * @param tan_half_fov Tangent of half the field of view.
+     * @param near_plane   Near plane distance.
+     * @param far_plane    Far plane distance.
+     * @param temperature  Width of the logistic transition in metres.
+     * @param grad_q_sum   Output sum over points of d(count)/dq.
+     * @param grad_q_outer Output sum over points of (p - t) * d(count)/dq^T.
+     * @return The smoothed count.
+     */
+    float softCountInFrustum(const Eigen::Matrix3f& R,
+                             const Eigen::Vector3f& t,
+                             float tan_half_fov,
+                             float near_plane,
+                             float far_plane,
+                             float temperature,
+                             Eigen::Vector3f& grad_q_sum,
+                             Eigen::Matrix3f& grad_q_outer) const {
+        grad_q_sum.setZero();
+        grad_q_outer.setZero();
+        const float inv_temperature = 1.0f / temperature;
+        const float cutoff          = -8.0f * temperature;
+        const Eigen::Matrix3f Rt    = R.transpose();
+
+        float count = 0.0f;
+        for (std::size_t i = 0; i < size_; ++i) {
+            const Eigen::Vector3f w(x_[i] - t.x(), y_[i] - t.y(), z_[i] - t.z());
+            const Eigen::Vector3f q = Rt * w;
+
+            // Signed margins to the near, far and four side faces (positive inside).
+            const float side = q.z() * tan_half_fov;
+            float margin[6]  = {q.z() - near_plane,
+                                far_plane - q.z(),
+                                side - q.x(),
+                                side + q.x(),
+                                side - q.y(),
+                                side + q.y()};
+            bool skip = false;
+            for (float m : margin) {
+                skip = skip || !(m >= cutoff);  // Also true for the NaN margins of a non-finite point.
+            }
+            if (skip) {
+                continue;
+            }
+
+            float sigma[6];
+            float membership = 1.0f;
+            for (int j = 0; j < 6; ++j) {
+                sigma[j] = 1.0f / (1.0f + std::exp(-margin[j] * inv_temperature));
+                membership *= sigma[j];
+            }
+            count += membership;
+
+            // d(membership)/d(margin_j) = membership * (1 - sigma_j) / temperature
+            float dm[6];
+            for (int j = 0; j < 6; ++j) {
+                dm[j] = membership * (1.0f - sigma[j]) * inv_temperature;
+            }
+            const Eigen::Vector3f grad_q(-dm[2] + dm[3],
+                                         -dm[4] + dm[5],
+                                         dm[0] - dm[1] + tan_half_fov * (dm[2] + dm[3] + dm[4] + dm[5]));
+            grad_q_sum += grad_q;
+            grad_q_outer.noalias() += w * grad_q.transpose();
+        }
+        return count;
+    }
+
+private:
+    /// Cloud the buffers were built from (identity only, never dereferenced).
+    std::weak_ptr<const pcl::PointCloud<pcl::PointXYZ>> source_;
+    /// Number of points in the source cloud.
+    std::size_t size_ = 0;
+    /// Point coordinates, padded to a multiple of BatchSize.
+    std::vector<float> x_, y_, z_;
+};
+
+#endif  // FRUSTUM_VISIBILITY_HPP
@@ -0,0 +1,242 @@
+#ifndef MPPI_NOISE_HPP
+#define MPPI_NOISE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Source of the standard normal noise of the MPPI samples.
+ */
+enum class NoiseEngine {
+    /// Pseudo-random: the Philox4x32-10 counter-based generator.
+    Philox,
+    /// Quasi-random: a Sobol sequence randomized only by a digital shift per call (each coordinate XORed with
+    /// one random word), not scrambled: every call sees the same point set up to the shift. Dimensions past
+    /// MppiNoiseSampler::SobolDimensions come from Philox.
+    Sobol,
+    /// Quasi-random: a Halton sequence with a random shift modulo one per call.
+    Halton
+};
+
+inline const char* noiseEngineName(NoiseEngine engine) {
+    switch (engine) {
+        case NoiseEngine::Philox: return "Philox";
+        case NoiseEngine::Sobol: return "Sobol";
+        case NoiseEngine::Halton: return "Halton";
+    }
+    return "Unknown";
+}
+
+/**
+ * @brief Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"): four 32-bit outputs as a
+ *        bijective function of a 128-bit counter under a 64-bit key.
+ *
+ * The output depends only on the counter and the key, so any sample can be generated independently of the others.
+ */
+inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> ctr, std::array<std::uint32_t, 2> key) {
+    for (int round = 0; round < 10; ++round) {
+        const std::uint64_t p0 = std::uint64_t(0xD2511F53u) * ctr[0];
+        const std::uint64_t p1 = std::uint64_t(0xCD9E8D57u) * ctr[2];
+        ctr = {static_cast<std::uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0], static_cast<std::uint32_t>(p1),
+               static_cast<std::uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1], static_cast<std::uint32_t>(p0)};
+        key[0] += 0x9E3779B9u;
+        key[1] += 0xBB67AE85u;
+    }
+    return ctr;
+}
+
+/**
+ * @brief Inverse of the standard normal CDF (Acklam's rational approximation, relative error below 1.2e-9).
+ *
+ * @param p A probability in (0, 1).
+ */
+inline double inverseNormalCdf(double p) {
+    static constexpr double a[] = {-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+                                   1.383577518672690e+02,  -3.066479806614716e+01, 2.506628277459239e+00};
+    static constexpr double b[] = {-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+                                   6.680131188771972e+01,  -1.328068155288572e+01};
+    static constexpr double c[] = {-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+                                   -2.549732539343734e+00, 4.374664141464968e+00,  2.938163982698783e+00};
+    static constexpr double d[] = {7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+                                   3.754408661907416e+00};
+    constexpr double p_low = 0.02425;
+    if (p < p_low || p > 1.0 - p_low) {
+        // Tails.
+        const double q = std::sqrt(-2.0 * std::log(p < p_low ? p : 1.0 - p));
+        const double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+                         / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+        return p < p_low ? x : -x;
+    }
+    const double q = p - 0.5;
+    const double r = q * q;
+    return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+           / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+
+/**
+ * @brief Standard normal noise for the MPPI samples of one call, addressable by sample index.
+ *
+ * Every engine maps uniform numbers to normal ones through the inverse CDF, so the quasi-random engines keep their
+ * even spread. The noise of a sample depends only on (seed, call, sample index), not on which thread draws it or
+ * in which order, and a sample's whole row is drawn in one pass: four dimensions per Philox block, or one
+ * direction-number XOR or radical inverse per dimension.
+ */
+class MppiNoiseSampler {
+public:
+    /// Dimensions covered by the built-in Sobol direction numbers (Joe and Kuo).
+    static constexpr int SobolDimensions = 21;
+
+    /**
+     * @param engine The noise source.
+     * @param dim    Dimensions per sample (ActionDim * HorizonDim), below 2^16 - 1.
+     * @param seed   Seed of the noise (PlannerMpc::mppi_seed).
+     * @param call   Index of the MPPI call; each of the 2^64 calls gets independent noise.
+     */
+    MppiNoiseSampler(NoiseEngine engine, int dim, std::uint64_t seed, std::uint64_t call)
+        : engine_(engine)
+        , dim_(dim)
+        , key_{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)}
+        , call_{static_cast<std::uint32_t>(call), static_cast<std::uint32_t>(call >> 32)} {
+        // Per-dimension randomization of the quasi-random sequences, drawn from counters no sample uses: the low
+        // 16 bits of a sample's second counter word hold its dimension, which never reaches 0xFFFF.
+        shifts_.resize(dim);
+        for (int j = 0; j < dim; ++j) {
+            shifts_[j] = philox4x32({static_cast<std::uint32_t>(j), 0xFFFFFFFFu, call_[0], call_[1]}, key_)[0];
+        }
+        if (engine_ == NoiseEngine::Halton) {
+            primes_.reserve(dim);
+            for (std::uint32_t n = 2; static_cast<int>(primes_.size()) < dim; ++n) {
+                bool prime = true;
+                for (std::uint32_t p : primes_) {
+                    if (p * p > n)
+                        break;
+                    if (n % p == 0) {
+                        prime = false;
+                        break;
+                    }
+                }
+                if (prime)
+                    primes_.push_back(n);
+            }
+        }
+    }
+
+    /**
+     * @brief Writes the dim standard normal values of a sample to out(0) ... out(dim - 1).
+     *
+     * @param index Index of the sample, below 2^48; together with the dimension and the full 64-bit call it makes
+     *              up the Philox counter, so no two (call, index, dimension) share a block.
+     */
+    template <typename Row>
+    void sample(std::uint64_t index, Row&& out) const {
+        const auto i_lo = static_cast<std::uint32_t>(index);
+        const auto i_hi = static_cast<std::uint32_t>(index >> 32);
+        int j           = 0;
+        if (engine_ == NoiseEngine::Sobol) {
+            const auto& v   = sobolDirections();
+            const auto gray = index ^ (index >> 1);
+            const int sobol = dim_ < SobolDimensions ? dim_ : SobolDimensions;
+            for (; j < sobol; ++j) {
+                std::uint32_t x = shifts_[j];
+                for (int b = 0; b < 32 && (gray >> b) != 0; ++b) {
+                    if ((gray >> b) & 1)
+                        x ^= v[j][b];
+                }
+                out(j) = inverseNormalCdf(toUnit(x));
+            }
+        }
+        else if (engine_ == NoiseEngine::Halton) {
+            for (; j < dim_; ++j) {
+                // Radical inverse of index + 1 in base p_j, shifted modulo one.
+                const double base = primes_[j];
+                double inv        = 1.0 / base;
+                double radical    = 0.0;
+                for (std::uint64_t n = index + 1; n > 0; n /= primes_[j], inv /= base) {
+                    radical += static_cast<double>(n % primes_[j]) * inv;
+                }
+                radical += shifts_[j] * 0x1p-32;
+                radical -= std::floor(radical);
+                out(j) = inverseNormalCdf(std::min(std::max(radical, 0x1p-33), 1.0 - 0x1p-33));
+            }
+        }
+        for (; j < dim_; j += 4) {
+            const auto r = philox4x32({i_lo, (i_hi << 16) | static_cast<std::uint32_t>(j), call_[0], call_[1]}, key_);
+            for (int m = 0; m < 4 && j + m < dim_; ++m) {
+                out(j + m) = inverseNormalCdf(toUnit(r[m]));
+            }
+        }
+    }
+
+private:
+    /// Maps 32 random bits to the centre of their cell in (0, 1).
+    static double toUnit(std::uint32_t x) {
+        return (static_cast<double>(x) + 0.5) * 0x1p-32;
+    }
+
+    /// Direction numbers of the first SobolDimensions dimensions, 32 bits each.
+    static const std::vector<std::array<std::uint32_t, 32>>& sobolDirections() {
+        static const std::vector<std::array<std::uint32_t, 32>> directions = [] {
+            // Degree s, interior coefficients a and initial numbers m of the primitive polynomial of each dimension
+            // after the first (new-joe-kuo-6.21201).
+            struct Polynomial {
+                int s;
+                std::uint32_t a;
+                std::uint32_t m[7];
+            };
+            static constexpr Polynomial table[SobolDimensions - 1] = {
+                {1, 0, {1}},
+                {2, 1, {1, 3}},
+                {3, 1, {1, 3, 1}},
+                {3, 2, {1, 1, 1}},
+                {4, 1, {1, 1, 3, 3}},
+                {4, 4, {1, 3, 5, 13}},
+                {5, 2, {1, 1, 5, 5, 17}},
+                {5, 4, {1, 1, 5, 5, 5}},
+                {5, 7, {1, 1, 7, 11, 19}},
+                {5, 11, {1, 1, 5, 1, 1}},
+                {5, 13, {1, 1, 1, 3, 11}},
+                {5, 14, {1, 3, 5, 5, 31}},
+                {6, 1, {1, 3, 3, 9, 7, 49}},
+                {6, 13, {1, 1, 1, 15, 21, 21}},
+                {6, 16, {1, 3, 1, 13, 27, 49}},
+                {6, 19, {1, 1, 1, 15, 7, 5}},
+                {6, 22, {1, 3, 1, 15, 13, 25}},
+                {6, 25, {1, 1, 5, 5, 19, 61}},
+                {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+                {7, 4, {1, 3, 7, 13, 13, 15, 69}},
+            };
+            std::vector<std::array<std::uint32_t, 32>> v(SobolDimensions);
+            for (int b = 0; b < 32; ++b) {
+                v[0][b] = 1u << (31 - b);
+            }
+            for (int d = 1; d < SobolDimensions; ++d) {
+                const Polynomial& poly = table[d - 1];
+                for (int b = 0; b < 32; ++b) {
+                    if (b < poly.s) {
+                        v[d][b] = poly.m[b] << (31 - b);
+                        continue;
+                    }
+                    v[d][b] = v[d][b - poly.s] ^ (v[d][b - poly.s] >> poly.s);
+                    for (int k = 1; k < poly.s; ++k) {
+                        if ((poly.a >> (poly.s - 1 - k)) & 1)
+                            v[d][b] ^= v[d][b - k];
+                    }
+                }
+            }
+            return v;
+        }();
+        return directions;
+    }
+
+    NoiseEngine engine_;
+    int dim_;
+    std::array<std::uint32_t, 2> key_;
+    std::array<std::uint32_t, 2> call_;
+    std::vector<std::uint32_t> shifts_;
+    std::vector<std::uint32_t> primes_;
+};
+
+#endif  // MPPI_NOISE_HPP
@@ -0,0 +1,314 @@
+#ifndef OBSTACLE_MAP_HPP
+#define OBSTACLE_MAP_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Voxel-hashed obstacle map that accepts and retracts scan batches incrementally.
+ *
+ * Every occupied voxel holds one point, the centroid of all scan points that fell into it (the same downsampling as
+ * pcl::VoxelGrid). The voxels are found through a hash map and their points are kept densely in a PCL cloud, so that
+ * the map can stand in for obstacle_cloud. Inserting or removing a batch costs time proportional to the batch;
+ * removing a voxel moves the last point of the cloud into its slot.
+ *
+ * Nearest-obstacle queries are bounded by a search radius and only visit the voxels within it, so they need neither
+ * a kd-tree nor a rebuild after an update. Copies of the cloud are kept up to date through changedSlots(), which
+ * lists the slots written since a given version.
+ */
+class VoxelObstacleMap {
+public:
+    /// Handle of an inserted batch, used to remove it again.
+    using BatchId = std::uint64_t;
+
+    VoxelObstacleMap() = default;
+
+    /**
+     * @brief Creates an empty map.
+     *
+     * @param resolution Voxel edge length in metres (the downsampling leaf size).
+     */
+    explicit VoxelObstacleMap(float resolution) {
+        setResolution(resolution);
+    }
+
+    /**
+     * @brief Sets the voxel edge length and clears the map.
+     */
+    void setResolution(float resolution) {
+        resolution_ = resolution;
+        clear();
+    }
+
+    /// Voxel edge length.
+    float resolution() const {
+        return resolution_;
+    }
+
+    /**
+     * @brief Removes every point and batch.
+     */
+    void clear() {
+        index_.clear();
+        keys_.clear();
+        sums_.clear();
+        counts_.clear();
+        batches_.clear();
+        cloud_->clear();
+        ++version_;
+        journal_.clear();
+        journal_start_ = version_;
+    }
+
+    /**
+     * @brief Adds a scan batch to the map.
+     *
+     * @param scan The scan points in world coordinates.
+     * @return The handle for remove().
+     */
+    BatchId insert(const pcl::PointCloud<pcl::PointXYZ>& scan) {
+        // Accumulate the batch per voxel first, so each voxel of the map is touched once.
+        std::unordered_map<std::int64_t, std::size_t> batch_index;
+        std::vector<Contribution> contributions;
+        for (const auto& pt : scan.points) {
+            if (!std::isfinite(pt.x) || !std::isfinite(pt.y) || !std::isfinite(pt.z))
+                continue;
+            const Eigen::Vector3d p(pt.x, pt.y, pt.z);
+            const std::int64_t key = keyOf(voxelOf(p.cast<float>()));
+            auto it                = batch_index.emplace(key, contributions.size());
+            if (it.second)
+                contributions.push_back({key, Eigen::Vector3d::Zero(), 0});
+            Contribution& c = contributions[it.first->second];
+            c.sum += p;
+            ++c.count;
+        }
+
+        for (const Contribution& c : contributions) {
+            auto it = index_.find(c.key);
+            if (it == index_.end()) {
+                it = index_.emplace(c.key, static_cast<std::uint32_t>(keys_.size())).first;
+                keys_.push_back(c.key);
+                sums_.push_back(Eigen::Vector3d::Zero());
+                counts_.push_back(0);
+                cloud_->points.emplace_back();
+            }
+            const std::uint32_t slot = it->second;
+            sums_[slot] += c.sum;
+            counts_[slot] += c.count;
+            updatePoint(slot);
+            journal_.push_back({version_ + 1, slot});
+        }
+        cloud_->width  = static_cast<std::uint32_t>(cloud_->points.size());
+        cloud_->height = 1;
+
+        const BatchId id = next_batch_++;
+        batches_.emplace(id, std::move(contributions));
+        ++version_;
+        trimJournal();
+        return id;
+    }
+
+    /**
+     * @brief Retracts a batch added by insert(); voxels left without points are removed.
+     *
+     * @param id The batch handle.
+     * @return False if the batch is unknown (e.g. already removed).
+     */
+    bool remove(BatchId id) {
+        auto batch = batches_.find(id);
+        if (batch == batches_.end())
+            return false;
+        for (const Contribution& c : batch->second) {
+            auto it = index_.find(c.key);
+            if (it == index_.end())
+                continue;
+            const std::uint32_t slot = it->second;
+            counts_[slot] -= c.count;
+            if (counts_[slot] == 0) {
+                eraseSlot(slot);
+            }
+            else {
+                sums_[slot] -= c.sum;
+                updatePoint(slot);
+            }
+            journal_.push_back({version_ + 1, slot});
+        }
+        cloud_->width  = static_cast<std::uint32_t>(cloud_->points.size());
+        cloud_->height = 1;
+        batches_.erase(batch);
+        ++version_;
+        trimJournal();
+        return true;
+    }
+
+    /// One point per occupied voxel. The pointer stays the same across updates; its contents change in place.
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr cloud() const {
+        return cloud_;
+    }
+
+    /// Number of occupied voxels.
+    std::size_t size() const {
+        return keys_.size();
+    }
+
+    /// Number of batches currently in the map.
+    std::size_t numBatches() const {
+        return batches_.size();
+    }
+
+    /// Incremented by every change, so that derived structures can tell when to refresh.
+    std::uint64_t version() const {
+        return version_;
+    }
+
+    /**
+     * @brief Lists the cloud slots written after a given version.
+     *
+     * A copy of cloud() taken at version `since` is brought up to date by resizing it to cloud()->size() and
+     * recopying the listed slots that are below that size. The list may hold duplicates. The journal is dropped once
+     * it outgrows the cloud, when a full copy is as cheap.
+     *
+     * @param since The version of the copy.
+     * @param slots Receives the slots.
+     * @return False if the journal does not reach back to `since`; the copy has to be rebuilt from cloud().
+     */
+    bool changedSlots(std::uint64_t since, std::vector<std::uint32_t>& slots) const {
+        slots.clear();
+        if (since < journal_start_ || since > version_)
+            return false;
+        auto first = std::upper_bound(journal_.begin(), journal_.end(), since, [](std::uint64_t v, const Change& c) {
+            return v < c.version;
+        });
+        for (; first != journal_.end(); ++first) {
+            slots.push_back(first->slot);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Distance from a point to the nearest map point within a search radius.
+     *
+     * @param p            The query point.
+     * @param max_distance The search radius.
+     * @param nearest      Receives the nearest map point if one lies within the radius (may be null).
+     * @return The distance, or infinity if no map point lies within the radius.
+     */
+    float nearestDistance(const Eigen::Vector3f& p, float max_distance, Eigen::Vector3f* nearest = nullptr) const {
+        float best2 = max_distance * max_distance;
+        bool found  = false;
+        if (index_.empty() || resolution_ <= 0.0f) {
+            return std::numeric_limits<float>::infinity();
+        }
+        const Eigen::Vector3i lo = voxelOf(p - Eigen::Vector3f::Constant(max_distance));
+        const Eigen::Vector3i hi = voxelOf(p + Eigen::Vector3f::Constant(max_distance));
+        for (int z = lo.z(); z <= hi.z(); ++z) {
+            for (int y = lo.y(); y <= hi.y(); ++y) {
+                for (int x = lo.x(); x <= hi.x(); ++x) {
+                    // Skip voxels whose box is already farther than the best point, before the hash lookup.
+                    const Eigen::Vector3f box_min = resolution_ * Eigen::Vector3f(x, y, z);
+                    const Eigen::Vector3f gap =
+                        (box_min - p).cwiseMax(p - box_min - Eigen::Vector3f::Constant(resolution_)).cwiseMax(0.0f);
+                    if (gap.squaredNorm() > best2)
+                        continue;
+                    auto it = index_.find(keyOf(Eigen::Vector3i(x, y, z)));
+                    if (it == index_.end())
+                        continue;
+                    const auto& pt = cloud_->points[it->second];
+                    const Eigen::Vector3f q(pt.x, pt.y, pt.z);
+                    const float d2 = (q - p).squaredNorm();
+                    if (d2 <= best2) {
+                        best2 = d2;
+                        found = true;
+                        if (nearest)
+                            *nearest = q;
+                    }
+                }
+            }
+        }
+        return found ? std::sqrt(best2) : std::numeric_limits<float>::infinity();
+    }
+
+private:
+    /// Points a batch added to one voxel.
+    struct Contribution {
+        std::int64_t key;
+        Eigen::Vector3d sum;
+        std::uint32_t count;
+    };
+
+    /// A cloud slot written by the change that produced a version.
+    struct Change {
+        std::uint64_t version;
+        std::uint32_t slot;
+    };
+
+    Eigen::Vector3i voxelOf(const Eigen::Vector3f& p) const {
+        return (p / resolution_).array().floor().cast<int>().matrix();
+    }
+
+    /// Packs 21 bits per axis, enough for +-1e6 voxels.
+    static std::int64_t keyOf(const Eigen::Vector3i& v) {
+        const std::int64_t mask = (std::int64_t(1) << 21) - 1;
+        return ((static_cast<std::int64_t>(v.x()) & mask) << 42) | ((static_cast<std::int64_t>(v.y()) & mask) << 21)
+               | (static_cast<std::int64_t>(v.z()) & mask);
+    }
+
+    void updatePoint(std::uint32_t slot) {
+        const Eigen::Vector3d centroid = sums_[slot] / static_cast<double>(counts_[slot]);
+        auto& pt                       = cloud_->points[slot];
+        pt.x                           = static_cast<float>(centroid.x());
+        pt.y                           = static_cast<float>(centroid.y());
+        pt.z                           = static_cast<float>(centroid.z());
+    }
+
+    void trimJournal() {
+        if (journal_.size() > std::max<std::size_t>(2 * keys_.size(), 1024)) {
+            journal_.clear();
+            journal_start_ = version_;
+        }
+    }
+
+    void eraseSlot(std::uint32_t slot) {
+        const std::uint32_t last = static_cast<std::uint32_t>(keys_.size() - 1);
+        index_.erase(keys_[slot]);
+        if (slot != last) {
+            keys_[slot]          = keys_[last];
+            sums_[slot]          = sums_[last];
+            counts_[slot]        = counts_[last];
+            cloud_->points[slot] = cloud_->points[last];
+            index_[keys_[slot]]  = slot;
+        }
+        keys_.pop_back();
+        sums_.pop_back();
+        counts_.pop_back();
+        cloud_->points.pop_back();
+    }
+
+    /// Voxel edge length.
+    float resolution_ = 0.03f;
+    /// Slot of each occupied voxel.
+    std::unordered_map<std::int64_t, std::uint32_t> index_;
+    /// Voxel key, point sum and point count of each slot.
+    std::vector<std::int64_t> keys_;
+    std::vector<Eigen::Vector3d> sums_;
+    std::vector<std::uint32_t> counts_;
+    /// Centroid of each slot.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_ =
+        pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>);
+    /// Per-voxel contributions of each batch.
+    std::unordered_map<BatchId, std::vector<Contribution>> batches_;
+    BatchId next_batch_    = 0;
+    std::uint64_t version_ = 0;
+    /// Slots written by each change since journal_start_, in version order.
+    std::vector<Change> journal_;
+    std::uint64_t journal_start_ = 0;
+};
+
+#endif  // OBSTACLE_MAP_HPP
@@ -0,0 +1,348 @@
+#ifndef OCCLUSION_VISIBILITY_HPP
+#define OCCLUSION_VISIBILITY_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <vector>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include "frustum_visibility.hpp"
+
+/**
+ * @brief Voxel occupancy grid of a point cloud for counting the points a camera can actually see.
+ *
+ * The cloud is binned into cubic voxels. The points are stored grouped by voxel, and every occupied voxel is tested
+ * as a unit. Voxels entirely outside the frustum are skipped. The points of the remaining voxels are tested against
+ * the frustum individually, and one ray is cast from the camera to the voxel centre. The ray walks the grid with a
+ * 3D-DDA (Amanatides & Woo) and stops at the first occupied voxel. Voxels within surface_tolerance of the target are
+ * ignored, so that neighbours on the same surface do not hide each other. Non-finite points (the NaNs of an organized
+ * cloud) have no voxel; they only get the frustum test, as in FrustumOctree.
+ */
+class OcclusionGrid {
+public:
+    /// Rays are cast in parallel when at least this many voxels are tested and no parallel region is active.
+    std::size_t parallel_min_voxels = 512;
+    /// Largest number of voxels build() allocates (1 byte each); a finer grid is coarsened to fit.
+    std::int64_t max_voxels = std::int64_t(1) << 30;
+
+    /**
+     * @brief Builds the occupancy grid.
+     *
+     * The grid spans the bounding box of the finite points. If it would need more than max_voxels voxels, e.g. for a
+     * far outlier, the voxels are enlarged until it fits and an error is logged; resolution() then reports the voxel
+     * size actually used.
+     *
+     * @param cloud      The obstacle cloud.
+     * @param resolution Voxel edge length in metres.
+     */
+    void build(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud, float resolution) {
+        clear();
+        source_               = cloud;
+        source_size_          = cloud ? cloud->points.size() : 0;
+        requested_resolution_ = resolution;
+        resolution_           = resolution;
+        if (!cloud || cloud->points.empty() || resolution <= 0.0f) {
+            return;
+        }
+
+        // Non-finite points cannot be placed in a voxel; they are kept aside and tested on every query.
+        std::vector<std::uint32_t> finite;
+        finite.reserve(cloud->points.size());
+        Eigen::Vector3f min_pt = Eigen::Vector3f::Constant(std::numeric_limits<float>::max());
+        Eigen::Vector3f max_pt = Eigen::Vector3f::Constant(-std::numeric_limits<float>::max());
+        for (std::size_t i = 0; i < cloud->points.size(); ++i) {
+            const auto& pt = cloud->points[i];
+            const Eigen::Vector3f p(pt.x, pt.y, pt.z);
+            if (!p.allFinite()) {
+                loose_.push_back(p);
+                continue;
+            }
+            finite.push_back(static_cast<std::uint32_t>(i));
+            min_pt = min_pt.cwiseMin(p);
+            max_pt = max_pt.cwiseMax(p);
+        }
+        if (finite.empty()) {
+            return;
+        }
+        // Voxel counts are computed in double, so that a large extent cannot overflow before it is checked.
+        auto voxelsAlong = [&](int i, float size) {
+            return std::floor((static_cast<double>(max_pt(i)) - min_pt(i)) / size) + 1.0;
+        };
+        auto numVoxelsAt = [&](float size) {
+            return voxelsAlong(0, size) * voxelsAlong(1, size) * voxelsAlong(2, size);
+        };
+        const double cap              = static_cast<double>(std::max<std::int64_t>(max_voxels, 1));
+        const double requested_voxels = numVoxelsAt(resolution);
+        if (requested_voxels > cap) {
+            resolution *= static_cast<float>(std::cbrt(requested_voxels / cap));
+            while (numVoxelsAt(resolution) > cap) {
+                resolution *= 1.01f;
+            }
+            std::cerr << "[OcclusionGrid::build] A voxel size of " << requested_resolution_ << " m needs "
+                      << requested_voxels << " voxels, more than max_voxels (" << max_voxels << "); using "
+                      << resolution << " m.\n";
+            resolution_ = resolution;
+        }
+
+        origin_ = min_pt;
+        for (int i = 0; i < 3; ++i) {
+            dims_(i) = static_cast<int>(voxelsAlong(i, resolution));
+        }
+
+        // Sort the points by voxel.
+        const std::size_t n = finite.size();
+        std::vector<std::pair<std::int64_t, std::uint32_t>> order(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto& pt = cloud->points[finite[i]];
+            order[i]       = {linearIndex(voxelOf(Eigen::Vector3f(pt.x, pt.y, pt.z))), finite[i]};
+        }
+        std::sort(order.begin(), order.end());
+
+        occupied_.assign(static_cast<std::size_t>(dims_.cast<std::int64_t>().prod()), 0);
+        x_.reserve(n);
+        y_.reserve(n);
+        z_.reserve(n);
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto& pt = cloud->points[order[i].second];
+            if (i == 0 || order[i].first != order[i - 1].first) {
+                if (i > 0)
+                    voxel_begin_.push_back(static_cast<std::uint32_t>(i));
+                occupied_[static_cast<std::size_t>(order[i].first)] = 1;
+                voxel_coords_.push_back(voxelOf(Eigen::Vector3f(pt.x, pt.y, pt.z)));
+            }
+            x_.push_back(pt.x);
+            y_.push_back(pt.y);
+            z_.push_back(pt.z);
+        }
+        voxel_begin_.push_back(static_cast<std::uint32_t>(n));
+    }
+
+    /**
+     * @brief Drops the grid; isBuiltFrom is false afterwards.
+     */
+    void clear() {
+        source_.reset();
+        source_size_ = 0;
+        occupied_.clear();
+        voxel_coords_.clear();
+        loose_.clear();
+        voxel_begin_.assign(1, 0);
+        x_.clear();
+        y_.clear();
+        z_.clear();
+        dims_.setZero();
+    }
+
+    /**
+     * @brief Returns true if the grid was built from the given cloud and requested resolution; a cloud allocated
+     *        after the source was released never matches, even at the same address.
+     */
+    bool isBuiltFrom(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud, float resolution) const {
+        return cloud && source_.lock() == cloud && cloud->points.size() == source_size_
+               && resolution == requested_resolution_;
+    }
+
+    /// True if no grid has been built.
+    bool empty() const {
+        return voxel_coords_.empty();
+    }
+
+    /// Number of occupied voxels.
+    std::size_t numOccupied() const {
+        return voxel_coords_.size();
+    }
+
+    /// Number of voxels in the grid, occupied or not.
+    std::size_t numVoxels() const {
+        return occupied_.size();
+    }
+
+    /// Voxel edge length (coarser than requested if build() had to fit max_voxels).
+    float resolution() const {
+        return resolution_;
+    }
+
+    /// Number of voxels along each axis.
+    const Eigen::Vector3i& dims() const {
+        return dims_;
+    }
+
+    /// Distance from a target voxel centre within which occupied voxels do not occlude it.
+    float surfaceTolerance() const {
+        return 1.5f * resolution_;
+    }
+
+    /**
+     * @brief Counts the points inside the frustum whose voxel is not hidden from the camera.
+     *
+     * @param planes The frustum planes from computeFrustumPlanes.
+     * @param camera The camera position.
+     * @return The number of visible points.
+     */
+    std::size_t countVisible(const FrustumPlanes& planes, const Eigen::Vector3f& camera) const {
+        float a[6], b[6], c[6], d[6], extent[6];
+        const float half = 0.5f * resolution_;
+        for (int i = 0; i < 6; ++i) {
+            a[i]      = planes(i, 0);
+            b[i]      = planes(i, 1);
+            c[i]      = planes(i, 2);
+            d[i]      = planes(i, 3);
+            extent[i] = half * (std::abs(a[i]) + std::abs(b[i]) + std::abs(c[i]));
+        }
+
+        // Non-finite points have no voxel to cast a ray to; only the frustum test applies to them.
+        std::int64_t count = 0;
+        for (const Eigen::Vector3f& p : loose_) {
+            std::int32_t inside = 1;
+            for (int i = 0; i < 6; ++i) {
+                const float dist = (p.x() * a[i] + p.z() * c[i]) + (p.y() * b[i] + d[i]);
+                inside &= static_cast<std::int32_t>(dist <= 0.0f);
+            }
+            count += inside;
+        }
+
+        const std::int64_t num_voxels = static_cast<std::int64_t>(voxel_coords_.size());
+#ifdef _OPENMP
+        const bool parallel = !omp_in_parallel() && voxel_coords_.size() >= parallel_min_voxels;
+#endif
+#pragma omp parallel for reduction(+ : count) schedule(dynamic, 64) if (parallel)
+        for (std::int64_t v = 0; v < num_voxels; ++v) {
+            const Eigen::Vector3i& voxel = voxel_coords_[v];
+            const Eigen::Vector3f centre = voxelCentre(voxel);
+
+            // Skip voxels entirely outside one of the planes.
+            bool outside = false;
+            for (int i = 0; i < 6; ++i) {
+                outside = outside || centre.x() * a[i] + centre.y() * b[i] + centre.z() * c[i] + d[i] > extent[i];
+            }
+            if (outside)
+                continue;
+
+            // Same plane test as FrustumPointsSoA::countInFrustum, so fully visible clouds give the same count.
+            std::int64_t in_frustum = 0;
+            for (std::uint32_t p = voxel_begin_[v]; p < voxel_begin_[v + 1]; ++p) {
+                std::int32_t inside = 1;
+                for (int i = 0; i < 6; ++i) {
+                    const float dist = (x_[p] * a[i] + z_[p] * c[i]) + (y_[p] * b[i] + d[i]);
+                    inside &= static_cast<std::int32_t>(dist <= 0.0f);
+                }
+                in_frustum += inside;
+            }
+            if (in_frustum > 0 && !isOccluded(camera, voxel)) {
+                count += in_frustum;
+            }
+        }
+        return static_cast<std::size_t>(count);
+    }
+
+    /**
+     * @brief Returns true if an occupied voxel lies between the camera and the centre of a target voxel.
+     *
+     * @param camera The camera position.
+     * @param target The target voxel.
+     */
+    bool isOccluded(const Eigen::Vector3f& camera, const Eigen::Vector3i& target) const {
+        const Eigen::Vector3f dir  = voxelCentre(target) - camera;
+        const float length         = dir.norm();
+        const float t_stop         = 1.0f - surfaceTolerance() / std::max(length, 1e-6f);
+        if (t_stop <= 0.0f)
+            return false;
+
+        // Clip the ray to the grid box.
+        const Eigen::Vector3f box_max = origin_ + dims_.cast<float>() * resolution_;
+        float t_enter                 = 0.0f;
+        for (int i = 0; i < 3; ++i) {
+            if (dir(i) != 0.0f) {
+                const float t0 = (origin_(i) - camera(i)) / dir(i);
+                const float t1 = (box_max(i) - camera(i)) / dir(i);
+                t_enter        = std::max(t_enter, std::min(t0, t1));
+            }
+        }
+        if (t_enter >= t_stop)
+            return false;
+
+        // 3D-DDA from the entry point.
+        const Eigen::Vector3f start = camera + t_enter * dir;
+        Eigen::Vector3i voxel       = voxelOf(start).cwiseMax(0).cwiseMin(dims_ - Eigen::Vector3i::Ones());
+        Eigen::Vector3i step;
+        Eigen::Vector3f t_max, t_delta;
+        for (int i = 0; i < 3; ++i) {
+            if (dir(i) > 0.0f) {
+                step(i)    = 1;
+                t_delta(i) = resolution_ / dir(i);
+                t_max(i)   = (origin_(i) + (voxel(i) + 1) * resolution_ - camera(i)) / dir(i);
+            }
+            else if (dir(i) < 0.0f) {
+                step(i)    = -1;
+                t_delta(i) = -resolution_ / dir(i);
+                t_max(i)   = (origin_(i) + voxel(i) * resolution_ - camera(i)) / dir(i);
+            }
+            else {
+                step(i)    = 0;
+                t_delta(i) = std::numeric_limits<float>::infinity();
+                t_max(i)   = std::numeric_limits<float>::infinity();
+            }
+        }
+
+        float t = t_enter;
+        while (t < t_stop && voxel != target) {
+            if (occupied_[static_cast<std::size_t>(linearIndex(voxel))])
+                return true;
+            int axis;
+            t_max.minCoeff(&axis);
+            t = t_max(axis);
+            t_max(axis) += t_delta(axis);
+            voxel(axis) += step(axis);
+            if (voxel(axis) < 0 || voxel(axis) >= dims_(axis))
+                return false;
+        }
+        return false;
+    }
+
+private:
+    Eigen::Vector3i voxelOf(const Eigen::Vector3f& p) const {
+        return ((p - origin_) / resolution_).array().floor().cast<int>().matrix();
+    }
+
+    Eigen::Vector3f voxelCentre(const Eigen::Vector3i& voxel) const {
+        return origin_ + (voxel.cast<float>() + Eigen::Vector3f::Constant(0.5f)) * resolution_;
+    }
+
+    std::int64_t linearIndex(const Eigen::Vector3i& voxel) const {
+        return (static_cast<std::int64_t>(voxel.z()) * dims_.y() + voxel.y()) * dims_.x() + voxel.x();
+    }
+
+    /// Cloud the grid was built from (identity only, never dereferenced).
+    std::weak_ptr<const pcl::PointCloud<pcl::PointXYZ>> source_;
+    /// Number of points in the source cloud.
+    std::size_t source_size_ = 0;
+    /// Voxel edge length used.
+    float resolution_ = 0.0f;
+    /// Voxel edge length passed to build(), for isBuiltFrom.
+    float requested_resolution_ = 0.0f;
+    /// Minimum corner of voxel (0, 0, 0).
+    Eigen::Vector3f origin_ = Eigen::Vector3f::Zero();
+    /// Number of voxels along each axis.
+    Eigen::Vector3i dims_ = Eigen::Vector3i::Zero();
+    /// Occupancy flag of every voxel, x fastest.
+    std::vector<std::uint8_t> occupied_;
+    /// Coordinates of the occupied voxels.
+    std::vector<Eigen::Vector3i> voxel_coords_;
+    /// Points of occupied voxel v are [voxel_begin_[v], voxel_begin_[v + 1]) in x_, y_, z_.
+    std::vector<std::uint32_t> voxel_begin_;
+    /// Point coordinates grouped by voxel.
+    std::vector<float> x_, y_, z_;
+    /// Non-finite points, tested individually.
+    std::vector<Eigen::Vector3f> loose_;
+};
+
+#endif  // OCCLUSION_VISIBILITY_HPP
@@ -0,0 +1,274 @@
+#ifndef PLANNER_PROFILER_HPP
+#define PLANNER_PROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Whether PLANNER_LOG writes to std::cout.
+ *
+ * On by default, off if the PLANNER_QUIET environment variable is set; assign to it to switch the console logging of
+ * the planning loop at run time. A runtime flag rather than a macro keeps the inline planner code identical in every
+ * translation unit. Errors are still reported on std::cerr.
+ */
+inline std::atomic<bool>& plannerLogging() {
+    static std::atomic<bool> enabled(std::getenv("PLANNER_QUIET") == nullptr);
+    return enabled;
+}
+
+/**
+ * @brief Console logging from the planning loop; the message is only formatted while plannerLogging() is on.
+ */
+#define PLANNER_LOG(message)                                  \
+    do {                                                      \
+        if (plannerLogging().load(std::memory_order_relaxed)) \
+            std::cout << message;                             \
+    } while (0)
+
+/**
+ * @brief Work counters of the cost function, accumulated per thread and merged into the PlannerProfiler.
+ */
+struct PlannerCounters {
+    /// Number of cost() calls (with or without gradient).
+    long cost_evaluations = 0;
+    /// Number of kd-tree nearest-neighbour searches.
+    long nn_queries = 0;
+    /// Number of distance field lookups.
+    long esdf_queries = 0;
+    /// Time spent in the pose tracking and look-at terms, in nanoseconds.
+    std::int64_t pose_ns = 0;
+    /// Time spent in the collision term, in nanoseconds.
+    std::int64_t collision_ns = 0;
+    /// Time spent in the visibility term, in nanoseconds.
+    std::int64_t visibility_ns = 0;
+
+    PlannerCounters& operator+=(const PlannerCounters& other) {
+        cost_evaluations += other.cost_evaluations;
+        nn_queries += other.nn_queries;
+        esdf_queries += other.esdf_queries;
+        pose_ns += other.pose_ns;
+        collision_ns += other.collision_ns;
+        visibility_ns += other.visibility_ns;
+        return *this;
+    }
+
+    PlannerCounters operator-(const PlannerCounters& other) const {
+        PlannerCounters d;
+        d.cost_evaluations = cost_evaluations - other.cost_evaluations;
+        d.nn_queries       = nn_queries - other.nn_queries;
+        d.esdf_queries     = esdf_queries - other.esdf_queries;
+        d.pose_ns          = pose_ns - other.pose_ns;
+        d.collision_ns     = collision_ns - other.collision_ns;
+        d.visibility_ns    = visibility_ns - other.visibility_ns;
+        return d;
+    }
+};
+
+/**
+ * @brief Adds the time between construction and destruction to a counter, if enabled.
+ *
+ * When disabled the clock is never read, so an idle timer costs one branch.
+ */
+class PhaseTimer {
+public:
+    PhaseTimer(bool enabled, std::int64_t& counter_ns) : counter_ns_(enabled ? &counter_ns : nullptr) {
+        if (counter_ns_)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    ~PhaseTimer() {
+        if (counter_ns_) {
+            const auto elapsed = std::chrono::steady_clock::now() - start_;
+            *counter_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&)            = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    std::int64_t* counter_ns_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * @brief Per-iteration record of generateWaypoints.
+ */
+struct IterationProfile {
+    /// Receding-horizon iteration (1-based).
+    int iteration = 0;
+    /// Wall time of the iteration in milliseconds.
+    double wall_time_ms = 0.0;
+    /// Work done during the iteration.
+    PlannerCounters counters;
+};
+
+/**
+ * @brief Collects per-phase timings and counters of the planner, and exports them as a Chrome trace.
+ *
+ * Everything is off by default. With enabled set, the planner records a span for each planning phase (solver calls,
+ * iterations, waypoint fusion), per-iteration counters and the time spent in each cost term. The trace can be opened
+ * in chrome://tracing or https://ui.perfetto.dev.
+ */
+class PlannerProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Master switch; when false no clocks are read and nothing is recorded.
+    bool enabled = false;
+
+    /// Counters accumulated over all planning calls since the last clear().
+    PlannerCounters totals;
+
+    /// One record per generateWaypoints iteration since the last clear().
+    std::vector<IterationProfile> iterations;
+
+    PlannerProfiler() : epoch_(Clock::now()) {}
+
+    /**
+     * @brief Drops all recorded data and restarts the trace clock.
+     */
+    void clear() {
+        totals = PlannerCounters();
+        iterations.clear();
+        events_.clear();
+        epoch_ = Clock::now();
+    }
+
+    /**
+     * @brief Records a completed span.
+     *
+     * @param name  Span name.
+     * @param start Start time.
+     * @param end   End time.
+     */
+    void addSpan(const char* name, Clock::time_point start, Clock::time_point end) {
+        if (!enabled)
+            return;
+        TraceEvent event;
+        event.name   = name;
+        event.phase  = 'X';
+        event.ts_us  = microseconds(start);
+        event.dur_us = std::chrono::duration<double, std::micro>(end - start).count();
+        events_.push_back(event);
+    }
+
+    /**
+     * @brief Records the running totals as trace counter tracks at the given time.
+     */
+    void addCounterSample(Clock::time_point time) {
+        if (!enabled)
+            return;
+        TraceEvent terms;
+        terms.name  = "cost terms (ms)";
+        terms.phase = 'C';
+        terms.ts_us = microseconds(time);
+        terms.args  = "\"pose\": " + std::to_string(totals.pose_ns * 1e-6)
+                     + ", \"collision\": " + std::to_string(totals.collision_ns * 1e-6)
+                     + ", \"visibility\": " + std::to_string(totals.visibility_ns * 1e-6);
+        events_.push_back(terms);
+
+        TraceEvent queries;
+        queries.name  = "queries";
+        queries.phase = 'C';
+        queries.ts_us = terms.ts_us;
+        queries.args  = "\"cost_evaluations\": " + std::to_string(totals.cost_evaluations)
+                       + ", \"nn_queries\": " + std::to_string(totals.nn_queries)
+                       + ", \"esdf_queries\": " + std::to_string(totals.esdf_queries);
+        events_.push_back(queries);
+    }
+
+    /**
+     * @brief Writes the recorded spans and counters in the Chrome trace-event JSON format.
+     *
+     * @param path Output file.
+     * @return False if the file could not be written.
+     */
+    bool writeChromeTrace(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "[PlannerProfiler::writeChromeTrace] Could not open " << path << " for writing.\n";
+            return false;
+        }
+        out << std::fixed;
+        out.precision(3);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        for (std::size_t i = 0; i < events_.size(); ++i) {
+            const TraceEvent& e = events_[i];
+            out << "  {\"name\": \"" << e.name << "\", \"cat\": \"planner\", \"ph\": \"" << e.phase
+                << "\", \"ts\": " << e.ts_us << ", \"pid\": 0, \"tid\": 0";
+            if (e.phase == 'X')
+                out << ", \"dur\": " << e.dur_us;
+            if (!e.args.empty())
+                out << ", \"args\": {" << e.args << "}";
+            out << "}" << (i + 1 < events_.size() ? ",\n" : "\n");
+        }
+        out << "]}\n";
+        return static_cast<bool>(out);
+    }
+
+    /**
+     * @brief Prints the totals and the per-iteration breakdown.
+     */
+    void print(std::ostream& os) const {
+        os << "[PlannerProfiler] cost evaluations: " << totals.cost_evaluations
+           << ", nn queries: " << totals.nn_queries << ", esdf queries: " << totals.esdf_queries
+           << ", pose: " << totals.pose_ns * 1e-6 << " ms, collision: " << totals.collision_ns * 1e-6
+           << " ms, visibility: " << totals.visibility_ns * 1e-6 << " ms\n";
+        for (const auto& it : iterations) {
+            os << "[PlannerProfiler]   iter " << it.iteration << ": " << it.wall_time_ms << " ms, "
+               << it.counters.cost_evaluations << " evaluations, " << it.counters.nn_queries << " nn queries, "
+               << "pose " << it.counters.pose_ns * 1e-6 << " ms, collision " << it.counters.collision_ns * 1e-6
+               << " ms, visibility " << it.counters.visibility_ns * 1e-6 << " ms\n";
+        }
+    }
+
+private:
+    /// One Chrome trace event ('X' complete span or 'C' counter).
+    struct TraceEvent {
+        std::string name;
+        char phase    = 'X';
+        double ts_us  = 0.0;
+        double dur_us = 0.0;
+        std::string args;
+    };
+
+    double microseconds(Clock::time_point time) const {
+        return std::chrono::duration<double, std::micro>(time - epoch_).count();
+    }
+
+    Clock::time_point epoch_;
+    std::vector<TraceEvent> events_;
+};
+
+/**
+ * @brief Records a span in a PlannerProfiler for the lifetime of the object.
+ */
+class ScopedSpan {
+public:
+    ScopedSpan(PlannerProfiler& profiler, const char* name) : profiler_(profiler), name_(name) {
+        if (profiler_.enabled)
+            start_ = PlannerProfiler::Clock::now();
+    }
+
+    ~ScopedSpan() {
+        if (profiler_.enabled)
+            profiler_.addSpan(name_, start_, PlannerProfiler::Clock::now());
+    }
+
+    ScopedSpan(const ScopedSpan&)            = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+private:
+    PlannerProfiler& profiler_;
+    const char* name_;
+    PlannerProfiler::Clock::time_point start_;
+};
+
+#endif  // PLANNER_PROFILER_HPP
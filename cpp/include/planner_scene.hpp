@@ -0,0 +1,46 @@
+#ifndef PLANNER_SCENE_HPP
+#define PLANNER_SCENE_HPP
+
+#include <Eigen/Dense>
+#include <memory>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "esdf.hpp"
+#include "frustum_octree.hpp"
+#include "frustum_visibility.hpp"
+#include "occlusion_visibility.hpp"
+#include "sphere_tree.hpp"
+
+/**
+ * @brief Read-only planning scene shared by concurrent queries.
+ *
+ * Holds the obstacle cloud, its kd-tree, the end-effector mesh and the structures derived from them. A scene is
+ * created by PlannerMpc::shareScene and is never modified afterwards, so any number of planners can bind the same
+ * std::shared_ptr<const PlannerScene> (PlannerMpc::setScene) and plan concurrently without copying it. All queries
+ * on the members used by the planner are const.
+ */
+struct PlannerScene {
+    /// Obstacle cloud for avoidance and visibility.
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr obstacle_cloud;
+    /// KD-tree over obstacle_cloud (may be null if only the Esdf backend is used).
+    std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> kd_tree;
+    /// End-effector mesh cloud.
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr ee_mesh_cloud;
+    /// End-effector mesh points (3 x N) in the end-effector frame.
+    Eigen::Matrix3Xf ee_mesh_points;
+    /// Bounding-sphere hierarchy over ee_mesh_points.
+    BoundingSphereTree ee_sphere_tree;
+    /// Distance field of obstacle_cloud; empty unless the Esdf backend was selected when the scene was shared.
+    EsdfGrid esdf;
+    /// Structure-of-arrays copy of obstacle_cloud for counting visible points.
+    FrustumPointsSoA visibility_points;
+    /// Octree over obstacle_cloud; empty unless the Frustum backend counted through the octree when the scene was
+    /// shared (see PlannerMpc::countsThroughOctree).
+    FrustumOctree visibility_octree;
+    /// Occupancy grid; empty unless the Occlusion backend was selected when the scene was shared.
+    OcclusionGrid occlusion_grid;
+};
+
+#endif  // PLANNER_SCENE_HPP
@@ -0,0 +1,724 @@
+#ifndef PLANNER_SERVICE_HPP
+#define PLANNER_SERVICE_HPP
+
+#include <Eigen/Dense>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "scene_cache.hpp"
+#include "waypoints_planner.hpp"
+
+// Binary protocol of the planner service. Every message is a PlannerMessageHeader followed by `size` payload bytes.
+// The payload fields are packed without padding in native byte order (the socket is local): u32/u64/f32/f64 scalars,
+// strings as a u32 length and the bytes, and poses as 7 f64 (x, y, z, qw, qx, qy, qz).
+//
+//   Plan           (client) start pose, u32 n, n goal poses, u32 m, m x (u32 PlannerParameter, f64 value)
+//   ReloadScene    (client) string cloud path, string mesh path, f32 leaf size; empty paths keep the current ones
+//   Shutdown       (client) no payload; stops the service after the reply
+//   Waypoint       (server) u32 goal, u32 index, pose
+//   GoalDone       (server) u32 goal, u32 waypoints, u32 PlanOutcome, u32 iterations, f64 wall time [ms],
+//                           f64 final position error, f64 final orientation error
+//   PlanDone       (server) u32 goals, f64 wall time [ms]
+//   SceneReloaded  (server) u64 obstacle points, f64 load time [ms]
+//   Error          (server) string message
+//   Ok             (server) no payload; acknowledges a Shutdown
+//
+// A Plan request is answered with the Waypoint messages of each goal as soon as that goal is planned, followed by
+// its GoalDone, and a final PlanDone (or an Error instead of any of them). A client that sends nothing for
+// PlannerReceiveTimeoutMs is disconnected, so that it cannot hold the service from the next one.
+
+/// "WPSV" in native byte order.
+constexpr std::uint32_t PlannerMessageMagic = 0x56535057;
+/// Protocol version; messages of any other version are rejected.
+constexpr std::uint16_t PlannerProtocolVersion = 1;
+/// Upper bound on the payload of a message, guards against reading garbage as a size.
+constexpr std::uint32_t PlannerMaxPayload = 1u << 24;
+/// Largest max_iterations a Plan request may set.
+constexpr int PlannerMaxIterations = 100000;
+/// Largest num_samples a Plan request may set.
+constexpr int PlannerMaxSamples = 1 << 20;
+/// Default time a connection may wait for the next bytes of a request before it is closed.
+constexpr int PlannerReceiveTimeoutMs = 30000;
+
+/// Message types; client requests below 16, service replies from 16.
+enum class PlannerMessageType : std::uint16_t {
+    Plan          = 1,
+    ReloadScene   = 2,
+    Shutdown      = 3,
+    Waypoint      = 16,
+    GoalDone      = 17,
+    PlanDone      = 18,
+    SceneReloaded = 19,
+    Error         = 20,
+    Ok            = 21
+};
+
+/**
+ * @brief Planner parameters a Plan request can override for that request only.
+ *
+ * Parameters the shared scene is built from (collision margin, distance field, camera frustum) cannot be
+ * overridden; reload the scene to change those.
+ */
+enum class PlannerParameter : std::uint32_t {
+    WeightPosition = 1,
+    WeightOrientation,
+    WeightPositionTerminal,
+    WeightOrientationTerminal,
+    WeightLookAtGoal,
+    LookAtGoalDistance,
+    WeightObstacle,
+    MinVisibleRatio,
+    AlphaVisibility,
+    MaxIterations,
+    SolverMode,  // Value of the SolverMode enum.
+    NumSamples,
+    MppiLambda,
+    NoiseStdPosition,
+    NoiseStdOrientation,
+    MaxStepPosition,     // Sets dp_max and dp_min = -value.
+    MaxStepOrientation,  // Sets dtheta_max and dtheta_min = -value.
+    PositionTolerance,
+    OrientationTolerance,
+    FusionPositionTolerance,
+    FusionOrientationTolerance,
+    TimeBudgetMs,
+    StepTimeBudgetMs,
+    RotationIntegrator,  // Value of the RotationIntegrator enum.
+    WarmStart            // Value of the WarmStartMode enum.
+};
+
+/// Fixed-size frame header preceding every payload.
+struct PlannerMessageHeader {
+    std::uint32_t magic;    // PlannerMessageMagic.
+    std::uint16_t version;  // PlannerProtocolVersion.
+    std::uint16_t type;     // PlannerMessageType.
+    std::uint32_t size;     // Payload size in bytes.
+};
+
+/**
+ * @brief Appends packed fields to a message payload.
+ */
+class PlannerMessageWriter {
+public:
+    template <typename T>
+    void put(T value) {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        payload.insert(payload.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putString(const std::string& s) {
+        put(static_cast<std::uint32_t>(s.size()));
+        payload.insert(payload.end(), s.begin(), s.end());
+    }
+
+    void putPose(const Eigen::Isometry3d& pose) {
+        const Eigen::Quaterniond q(pose.rotation());
+        for (double v : {pose.translation().x(), pose.translation().y(), pose.translation().z(), q.w(), q.x(), q.y(),
+                         q.z()}) {
+            put(v);
+        }
+    }
+
+    std::vector<char> payload;
+};
+
+/**
+ * @brief Reads packed fields from a message payload; every read fails once the payload is exhausted.
+ */
+class PlannerMessageReader {
+public:
+    explicit PlannerMessageReader(const std::vector<char>& payload) : data_(payload.data()), size_(payload.size()) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (sizeof(T) > size_ - pos_)
+            return false;
+        std::memcpy(&value, data_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& s) {
+        std::uint32_t n = 0;
+        if (!get(n) || n > size_ - pos_)
+            return false;
+        s.assign(data_ + pos_, n);
+        pos_ += n;
+        return true;
+    }
+
+    bool getPose(Eigen::Isometry3d& pose) {
+        double v[7];
+        for (double& x : v) {
+            if (!get(x) || !std::isfinite(x))
+                return false;
+        }
+        Eigen::Quaterniond q(v[3], v[4], v[5], v[6]);
+        if (!(q.norm() > 0.0))
+            return false;
+        pose.setIdentity();
+        pose.linear()      = q.normalized().toRotationMatrix();
+        pose.translation() = Eigen::Vector3d(v[0], v[1], v[2]);
+        return true;
+    }
+
+    /// Number of bytes not read yet.
+    std::size_t remaining() const {
+        return size_ - pos_;
+    }
+
+    /// True if all bytes were read; trailing bytes mean a malformed message.
+    bool done() const {
+        return pos_ == size_;
+    }
+
+private:
+    const char* data_;
+    std::size_t size_;
+    std::size_t pos_ = 0;
+};
+
+/**
+ * @brief Plan request: a start pose, the goals to plan in order and per-request parameter overrides.
+ */
+struct PlanRequest {
+    Eigen::Isometry3d start = Eigen::Isometry3d::Identity();
+    /// Goals planned in order; each after the first starts from the second to last waypoint of the previous one.
+    std::vector<Eigen::Isometry3d> goals;
+    std::vector<std::pair<PlannerParameter, double>> overrides;
+
+    void encode(PlannerMessageWriter& w) const {
+        w.putPose(start);
+        w.put(static_cast<std::uint32_t>(goals.size()));
+        for (const auto& goal : goals) {
+            w.putPose(goal);
+        }
+        w.put(static_cast<std::uint32_t>(overrides.size()));
+        for (const auto& o : overrides) {
+            w.put(static_cast<std::uint32_t>(o.first));
+            w.put(o.second);
+        }
+    }
+
+    bool decode(PlannerMessageReader& r) {
+        std::uint32_t n = 0, m = 0;
+        // Bound the counts by the payload before allocating.
+        if (!r.getPose(start) || !r.get(n) || n > r.remaining() / (7 * sizeof(double)))
+            return false;
+        goals.assign(n, Eigen::Isometry3d::Identity());
+        for (auto& goal : goals) {
+            if (!r.getPose(goal))
+                return false;
+        }
+        if (!r.get(m) || m > r.remaining() / (sizeof(std::uint32_t) + sizeof(double)))
+            return false;
+        overrides.assign(m, {});
+        for (auto& o : overrides) {
+            std::uint32_t id = 0;
+            if (!r.get(id) || !r.get(o.second))
+                return false;
+            o.first = static_cast<PlannerParameter>(id);
+        }
+        return r.done();
+    }
+};
+
+/**
+ * @brief Scene reload request: new scene sources; empty paths keep the current ones.
+ */
+struct SceneReloadRequest {
+    std::string cloud_path;
+    std::string mesh_path;
+    float leaf_size = 0.03f;
+
+    void encode(PlannerMessageWriter& w) const {
+        w.putString(cloud_path);
+        w.putString(mesh_path);
+        w.put(leaf_size);
+    }
+
+    bool decode(PlannerMessageReader& r) {
+        return r.getString(cloud_path) && r.getString(mesh_path) && r.get(leaf_size) && r.done();
+    }
+};
+
+/**
+ * @brief One streamed waypoint of a goal.
+ */
+struct WaypointMessage {
+    std::uint32_t goal     = 0;
+    std::uint32_t index    = 0;
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+
+    void encode(PlannerMessageWriter& w) const {
+        w.put(goal);
+        w.put(index);
+        w.putPose(pose);
+    }
+
+    bool decode(PlannerMessageReader& r) {
+        return r.get(goal) && r.get(index) && r.getPose(pose) && r.done();
+    }
+};
+
+/**
+ * @brief Sent after the waypoints of a goal: their number and the SolverStats of the goal.
+ */
+struct GoalDoneMessage {
+    std::uint32_t goal             = 0;
+    std::uint32_t num_waypoints    = 0;
+    PlanOutcome outcome            = PlanOutcome::Snapped;
+    std::uint32_t iterations       = 0;
+    double wall_time_ms            = 0.0;
+    double final_position_error    = 0.0;
+    double final_orientation_error = 0.0;
+
+    void encode(PlannerMessageWriter& w) const {
+        w.put(goal);
+        w.put(num_waypoints);
+        w.put(static_cast<std::uint32_t>(outcome));
+        w.put(iterations);
+        w.put(wall_time_ms);
+        w.put(final_position_error);
+        w.put(final_orientation_error);
+    }
+
+    bool decode(PlannerMessageReader& r) {
+        std::uint32_t o = 0;
+        if (!r.get(goal) || !r.get(num_waypoints) || !r.get(o) || !r.get(iterations) || !r.get(wall_time_ms) ||
+            !r.get(final_position_error) || !r.get(final_orientation_error))
+            return false;
+        outcome = static_cast<PlanOutcome>(o);
+        return r.done();
+    }
+};
+
+/**
+ * @brief Writes all bytes to a socket, retrying on interrupts and short writes.
+ */
+inline bool writeAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief Reads exactly size bytes from a socket; fails on end of stream or an error.
+ */
+inline bool readAll(int fd, char* data, std::size_t size) {
+    // A receive timeout (SO_RCVTIMEO) ends the read with EAGAIN.
+    while (size > 0) {
+        const ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief Sends one framed message.
+ */
+inline bool sendMessage(int fd, PlannerMessageType type, const std::vector<char>& payload = {}) {
+    const PlannerMessageHeader h{PlannerMessageMagic,
+                                 PlannerProtocolVersion,
+                                 static_cast<std::uint16_t>(type),
+                                 static_cast<std::uint32_t>(payload.size())};
+    return writeAll(fd, reinterpret_cast<const char*>(&h), sizeof(h)) && writeAll(fd, payload.data(), payload.size());
+}
+
+/**
+ * @brief Encodes and sends a message struct.
+ */
+template <typename Message>
+bool sendMessage(int fd, PlannerMessageType type, const Message& message) {
+    PlannerMessageWriter w;
+    message.encode(w);
+    return sendMessage(fd, type, w.payload);
+}
+
+/**
+ * @brief Receives one framed message.
+ *
+ * @return False on end of stream, a read error, or a header of another protocol or version.
+ */
+inline bool receiveMessage(int fd, PlannerMessageType& type, std::vector<char>& payload) {
+    PlannerMessageHeader h{};
+    if (!readAll(fd, reinterpret_cast<char*>(&h), sizeof(h)))
+        return false;
+    if (h.magic != PlannerMessageMagic || h.version != PlannerProtocolVersion || h.size > PlannerMaxPayload)
+        return false;
+    type = static_cast<PlannerMessageType>(h.type);
+    payload.resize(h.size);
+    return readAll(fd, payload.data(), payload.size());
+}
+
+/**
+ * @brief Connects to a planner service listening on a Unix-domain socket.
+ *
+ * @return The connected socket, or -1.
+ */
+inline int connectPlannerService(const std::string& socket_path) {
+    sockaddr_un addr{};
+    if (socket_path.size() >= sizeof(addr.sun_path))
+        return -1;
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Sets one overridable parameter of a planner.
+ *
+ * @return False if the parameter is unknown or the value is out of range.
+ */
+template <typename Planner>
+bool applyPlannerParameter(Planner& planner, PlannerParameter parameter, double value) {
+    using Scalar = typename Planner::IsometryT::Scalar;
+    if (!std::isfinite(value))
+        return false;
+    switch (parameter) {
+        case PlannerParameter::WeightPosition: planner.w_p = Scalar(value); return true;
+        case PlannerParameter::WeightOrientation: planner.w_q = Scalar(value); return true;
+        case PlannerParameter::WeightPositionTerminal: planner.w_p_term = Scalar(value); return true;
+        case PlannerParameter::WeightOrientationTerminal: planner.w_q_term = Scalar(value); return true;
+        case PlannerParameter::WeightLookAtGoal: planner.w_look_at_goal = Scalar(value); return true;
+        case PlannerParameter::LookAtGoalDistance: planner.look_at_goal_distance = Scalar(value); return true;
+        case PlannerParameter::WeightObstacle: planner.w_obs = Scalar(value); return true;
+        case PlannerParameter::MinVisibleRatio: planner.min_visible_ratio = value; return true;
+        case PlannerParameter::AlphaVisibility: planner.alpha_visibility = Scalar(value); return true;
+        case PlannerParameter::MaxIterations:
+            if (value < 1 || value > PlannerMaxIterations)
+                return false;
+            planner.max_iterations = static_cast<int>(value);
+            return true;
+        case PlannerParameter::SolverMode:
+            if (value != 0 && value != 1 && value != 2)
+                return false;
+            planner.solver_mode = static_cast<SolverMode>(static_cast<int>(value));
+            return true;
+        case PlannerParameter::NumSamples:
+            if (value < 1 || value > PlannerMaxSamples)
+                return false;
+            planner.num_samples = static_cast<int>(value);
+            return true;
+        case PlannerParameter::MppiLambda:
+            if (value <= 0)
+                return false;
+            planner.mppi_lambda = Scalar(value);
+            return true;
+        case PlannerParameter::NoiseStdPosition:
+            if (value < 0)
+                return false;
+            planner.noise_std_pos = Scalar(value);
+            return true;
+        case PlannerParameter::NoiseStdOrientation:
+            if (value < 0)
+                return false;
+            planner.noise_std_ori = Scalar(value);
+            return true;
+        case PlannerParameter::MaxStepPosition:
+            if (value < 0)
+                return false;
+            planner.dp_max = Scalar(value);
+            planner.dp_min = Scalar(-value);
+            return true;
+        case PlannerParameter::MaxStepOrientation:
+            if (value < 0)
+                return false;
+            planner.dtheta_max = Scalar(value);
+            planner.dtheta_min = Scalar(-value);
+            return true;
+        case PlannerParameter::PositionTolerance: planner.position_tolerance = value; return true;
+        case PlannerParameter::OrientationTolerance: planner.orientation_tolerance = value; return true;
+        case PlannerParameter::FusionPositionTolerance: planner.fusion_position_tolerance = value; return true;
+        case PlannerParameter::FusionOrientationTolerance: planner.fusion_orientation_tolerance = value; return true;
+        case PlannerParameter::TimeBudgetMs: planner.time_budget_ms = value; return true;
+        case PlannerParameter::StepTimeBudgetMs: planner.step_time_budget_ms = value; return true;
+        case PlannerParameter::RotationIntegrator:
+            if (value != 0 && value != 1)
+                return false;
+            planner.rotation_integrator = static_cast<RotationIntegrator>(static_cast<int>(value));
+            return true;
+        case PlannerParameter::WarmStart:
+            if (value != 0 && value != 1 && value != 2)
+                return false;
+            planner.warm_start = static_cast<WarmStartMode>(static_cast<int>(value));
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Long-running planner that keeps its scene in memory and serves plan requests over a Unix-domain socket.
+ *
+ * The scene of the planner is shared once (PlannerMpc::shareScene); each Plan request runs on a queryContext with
+ * the request's parameter overrides, so a request never changes the planner or the next request. ReloadScene
+ * rebuilds the scene (through the scene cache) into a fresh copy of the planner, which replaces the planner only if
+ * the reload succeeds. Connections are served one at a time, in order; a connection idle for longer than the receive
+ * timeout is closed.
+ */
+template <typename Planner>
+class PlannerService {
+public:
+    using IsometryT = typename Planner::IsometryT;
+
+    /**
+     * @param planner    The configured planner; its scene should already be loaded from sources.
+     * @param sources    The sources of the scene, the defaults of a ReloadScene request.
+     * @param cache_path The scene cache used by reloads (see loadOrBuildScene).
+     */
+    PlannerService(Planner& planner, SceneSources sources, std::string cache_path)
+        : planner_(planner)
+        , sources_(std::move(sources))
+        , cache_path_(std::move(cache_path)) {
+        planner_.shareScene();
+    }
+
+    PlannerService(const PlannerService&)            = delete;
+    PlannerService& operator=(const PlannerService&) = delete;
+
+    ~PlannerService() {
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            ::unlink(socket_path_.c_str());
+        }
+    }
+
+    /**
+     * @brief Binds and listens on a socket path, replacing a stale socket file.
+     *
+     * @return False if the socket could not be created or bound.
+     */
+    bool listen(const std::string& socket_path) {
+        sockaddr_un addr{};
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "[PlannerService] Socket path too long: " << socket_path << "\n";
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(socket_path.c_str());
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd_ < 0 || ::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 8) != 0) {
+            std::cerr << "[PlannerService] Could not listen on " << socket_path << ": " << std::strerror(errno) << "\n";
+            if (listen_fd_ >= 0)
+                ::close(listen_fd_);
+            listen_fd_ = -1;
+            return false;
+        }
+        socket_path_ = socket_path;
+        PLANNER_LOG("[PlannerService] Listening on " << socket_path << "\n");
+        return true;
+    }
+
+    /**
+     * @brief Accepts and serves connections until a client sends Shutdown.
+     */
+    void run() {
+        while (listen_fd_ >= 0) {
+            const int fd = ::accept(listen_fd_, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR)
+                    continue;
+                std::cerr << "[PlannerService] accept failed: " << std::strerror(errno) << "\n";
+                return;
+            }
+            const bool keep_running = serveConnection(fd);
+            ::close(fd);
+            if (!keep_running)
+                return;
+        }
+    }
+
+    /**
+     * @brief Sets how long a connection may wait for the next bytes of a request; 0 waits forever.
+     */
+    void setReceiveTimeout(int timeout_ms) {
+        receive_timeout_ms_ = timeout_ms;
+    }
+
+    /**
+     * @brief Serves the requests of one connected client until it disconnects, sends Shutdown or times out.
+     *
+     * @return False if the client asked the service to stop.
+     */
+    bool serveConnection(int fd) {
+        timeval timeout{};
+        timeout.tv_sec  = receive_timeout_ms_ / 1000;
+        timeout.tv_usec = (receive_timeout_ms_ % 1000) * 1000;
+        if (::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+            std::cerr << "[PlannerService] Could not set the receive timeout: " << std::strerror(errno) << "\n";
+        PlannerMessageType type;
+        std::vector<char> payload;
+        while (receiveMessage(fd, type, payload)) {
+            PlannerMessageReader reader(payload);
+            bool sent = true;
+            switch (type) {
+                case PlannerMessageType::Plan: {
+                    PlanRequest request;
+                    sent = request.decode(reader) ? guarded(fd, [&] { return plan(fd, request); })
+                                                  : sendError(fd, "Malformed plan request");
+                    break;
+                }
+                case PlannerMessageType::ReloadScene: {
+                    SceneReloadRequest request;
+                    sent = request.decode(reader) ? guarded(fd, [&] { return reload(fd, request); })
+                                                  : sendError(fd, "Malformed reload request");
+                    break;
+                }
+                case PlannerMessageType::Shutdown:
+                    sendMessage(fd, PlannerMessageType::Ok);
+                    return false;
+                default: sent = sendError(fd, "Unknown message type " + std::to_string(static_cast<int>(type)));
+            }
+            if (!sent)
+                break;  // The client went away mid-reply.
+        }
+        return true;
+    }
+
+    /**
+     * @brief Plans the goals of a request in order and streams the waypoints of each goal as soon as it is planned.
+     *
+     * @return False if the client disconnected.
+     */
+    bool plan(int fd, const PlanRequest& request) {
+        const auto start_time = std::chrono::steady_clock::now();
+        Planner context       = planner_.queryContext();
+        for (const auto& o : request.overrides) {
+            if (!applyPlannerParameter(context, o.first, o.second))
+                return sendError(fd, "Invalid override of parameter " + std::to_string(static_cast<int>(o.first)));
+        }
+
+        std::vector<IsometryT> waypoints;
+        for (std::size_t i = 0; i < request.goals.size(); ++i) {
+            // As in main.cpp: later goals start from the second to last waypoint of the previous segment.
+            if (i == 0)
+                context.H_0 = IsometryT(request.start.matrix().template cast<typename IsometryT::Scalar>());
+            else if (waypoints.size() >= 2)
+                context.H_0 = waypoints[waypoints.size() - 2];
+            else if (!waypoints.empty())
+                context.H_0 = waypoints.back();
+            context.H_goal = IsometryT(request.goals[i].matrix().template cast<typename IsometryT::Scalar>());
+            waypoints      = context.generateWaypoints(context.H_0, context.H_goal);
+
+            WaypointMessage wp;
+            wp.goal = static_cast<std::uint32_t>(i);
+            for (std::size_t k = 0; k < waypoints.size(); ++k) {
+                wp.index = static_cast<std::uint32_t>(k);
+                wp.pose  = Eigen::Isometry3d(waypoints[k].matrix().template cast<double>());
+                if (!sendMessage(fd, PlannerMessageType::Waypoint, wp))
+                    return false;
+            }
+            GoalDoneMessage done;
+            done.goal                    = static_cast<std::uint32_t>(i);
+            done.num_waypoints           = static_cast<std::uint32_t>(waypoints.size());
+            done.outcome                 = context.stats.outcome;
+            done.iterations              = static_cast<std::uint32_t>(context.stats.iterations);
+            done.wall_time_ms            = context.stats.wall_time_ms;
+            done.final_position_error    = context.stats.final_position_error;
+            done.final_orientation_error = context.stats.final_orientation_error;
+            if (!sendMessage(fd, PlannerMessageType::GoalDone, done))
+                return false;
+        }
+
+        PlannerMessageWriter w;
+        w.put(static_cast<std::uint32_t>(request.goals.size()));
+        w.put(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
+        return sendMessage(fd, PlannerMessageType::PlanDone, w.payload);
+    }
+
+    /**
+     * @brief Rebuilds the scene from new (or the current) sources; the planner keeps its scene if this fails.
+     *
+     * @return False if the client disconnected.
+     */
+    bool reload(int fd, const SceneReloadRequest& request) {
+        const auto start_time = std::chrono::steady_clock::now();
+        SceneSources sources  = sources_;
+        if (!request.cloud_path.empty())
+            sources.cloud_path = request.cloud_path;
+        if (!request.mesh_path.empty())
+            sources.mesh_path = request.mesh_path;
+        sources.leaf_size = request.leaf_size;
+
+        Planner fresh = planner_;
+        fresh.setScene(nullptr);
+        if (!loadOrBuildScene(fresh, sources, cache_path_))
+            return sendError(fd, "Could not load the scene from " + sources.cloud_path);
+        fresh.shareScene();
+        planner_ = std::move(fresh);
+        sources_ = sources;
+
+        PlannerMessageWriter w;
+        w.put(static_cast<std::uint64_t>(planner_.obstacle_cloud->size()));
+        w.put(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
+        return sendMessage(fd, PlannerMessageType::SceneReloaded, w.payload);
+    }
+
+    const SceneSources& sources() const {
+        return sources_;
+    }
+
+private:
+    /**
+     * @brief Runs a request handler; an exception (e.g. bad_alloc) is reported to the client instead of ending the
+     *        service.
+     */
+    template <typename Handler>
+    bool guarded(int fd, Handler&& handler) {
+        try {
+            return handler();
+        }
+        catch (const std::exception& e) {
+            return sendError(fd, std::string("Request failed: ") + e.what());
+        }
+    }
+
+    bool sendError(int fd, const std::string& message) {
+        std::cerr << "[PlannerService] " << message << "\n";
+        PlannerMessageWriter w;
+        w.putString(message);
+        return sendMessage(fd, PlannerMessageType::Error, w.payload);
+    }
+
+    Planner& planner_;
+    SceneSources sources_;
+    std::string cache_path_;
+    std::string socket_path_;
+    int listen_fd_          = -1;
+    int receive_timeout_ms_ = PlannerReceiveTimeoutMs;
+};
+
+#endif  // PLANNER_SERVICE_HPP
@@ -0,0 +1,116 @@
+#ifndef PLANNER_SETUP_HPP
+#define PLANNER_SETUP_HPP
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "scene_cache.hpp"
+#include "trajectory_library.hpp"
+#include "waypoints_planner.hpp"
+
+/**
+ * @brief Sets the planner parameters of the vine pruning setup, shared by main.cpp and the planner daemon.
+ *
+ * Also gives the planner an empty trajectory_library with warm starting off, so that a run does not depend on earlier
+ * ones; the callers that persist a library load their file into it and select a WarmStartMode.
+ *
+ * @param planner The planner to configure.
+ */
+template <typename Planner>
+void configurePlanner(Planner& planner) {
+    using Scalar = typename Planner::IsometryT::Scalar;
+
+    // Pose parameters
+    planner.w_p      = 1e4;  // Positional tracking cost weight.
+    planner.w_q      = 1e2;  // Orientation tracking cost weight.
+    planner.w_p_term = 1e4;  // Terminal positional cost weight.
+    planner.w_q_term = 1e2;  // Terminal orientation cost weight.
+
+    // Look at goal parameters
+    planner.w_look_at_goal        = 1e2;  // Look at goal cost weight.
+    planner.look_at_goal_distance = 0.11;
+
+    // Collision parameters
+    planner.w_obs            = 1e3;  // Obstacle avoidance cost weight.
+    planner.collision_margin = 0.05;
+
+    // Camera parameters
+    planner.visibility_fov       = 60.0;  // Field of view in degrees.
+    planner.visibility_min_range = 0.07;
+    planner.visibility_max_range = 0.5;
+
+    // Visibility parameters
+    planner.min_visible_ratio = 0.1;
+    planner.alpha_visibility  = 0.2;  // Tuning parameter to control the saturation rate.
+
+    // Planner parameters
+    planner.max_iterations   = 20;
+    planner.solver_mode      = SolverMode::Cobyla;  // Cobyla, Mppi or MppiCobyla.
+    planner.nlopt_algorithm  = nlopt::LN_COBYLA;    // LD_SLSQP or LD_LBFGS use the analytic cost gradient.
+    planner.profiler.enabled = false;               // Per-phase timings and a Chrome trace (planner_trace.json).
+    planner.use_pose_cache   = false;               // Reuse collision and visibility results of nearby poses.
+
+    // Rotation integration of the controls: Euler angles, or exponential-map increments (ExpMap).
+    planner.rotation_integrator = RotationIntegrator::Euler;
+
+    // Warm start from the solutions of earlier runs: Off, Controls (first step only) or Chain (every step).
+    planner.trajectory_library = std::make_shared<TrajectoryLibrary>();
+    planner.warm_start         = WarmStartMode::Off;
+
+    // MPPI parameters
+    planner.num_samples   = 200;           // Number of candidate trajectories to sample.
+    planner.mppi_lambda   = Scalar(1.0);   // Temperature parameter.
+    planner.noise_std_pos = Scalar(0.01);  // Standard deviation for position noise.
+    planner.noise_std_ori = Scalar(0.05);  // Standard deviation for orientation noise.
+    planner.mppi_pruning  = true;          // Skip the collision and visibility queries of negligible candidates.
+
+    // Fusion parameters
+    planner.fusion_position_tolerance    = 0.03;
+    planner.fusion_orientation_tolerance = 0.1;
+
+    // Control bounds
+    planner.dp_max     = 0.025;
+    planner.dp_min     = -0.025;
+    planner.dtheta_max = 0.15;
+    planner.dtheta_min = -0.15;
+}
+
+/**
+ * @brief Pose of the cutter STL model in the camera frame.
+ */
+inline Eigen::Isometry3d cutterTransform() {
+    Eigen::Isometry3d cutter_transform = Eigen::Isometry3d::Identity();
+    cutter_transform.translation()     = Eigen::Vector3d(0.0, 0.08, 0.03);
+    Eigen::AngleAxisd Rzc(M_PI_2, Eigen::Vector3d::UnitZ());
+    Eigen::AngleAxisd Ryc(0, Eigen::Vector3d::UnitY());
+    Eigen::AngleAxisd Rxc(M_PI_2, Eigen::Vector3d::UnitX());
+    cutter_transform.linear() = (Rzc * Ryc * Rxc).matrix();
+    return cutter_transform;
+}
+
+/**
+ * @brief Scene sources of a configured planner: the obstacle cloud downsampled at 3 cm with its kd-tree and
+ *        distance field, and the collision box and points of the cutter placed by cutterTransform.
+ *
+ * @param planner    The configured planner; its collision margin and distance field resolution are used.
+ * @param cloud_path The obstacle cloud.
+ * @param mesh_path  The STL model of the cutter.
+ */
+template <typename Planner>
+SceneSources plannerSceneSources(const Planner& planner,
+                                 const std::string& cloud_path = "../data/vine_simple_streo_scan.pcd",
+                                 const std::string& mesh_path  = "../data/cutter.stl") {
+    SceneSources sources;
+    sources.cloud_path      = cloud_path;
+    sources.mesh_path       = mesh_path;
+    sources.leaf_size       = 0.03f;
+    sources.mesh_transform  = cutterTransform();
+    sources.mesh_margin     = planner.collision_margin;
+    sources.esdf_resolution = planner.esdf_resolution;
+    sources.esdf_bound      = planner.collision_margin;
+    return sources;
+}
+
+#endif  // PLANNER_SETUP_HPP
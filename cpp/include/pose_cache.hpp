@@ -0,0 +1,267 @@
+#ifndef POSE_CACHE_HPP
+#define POSE_CACHE_HPP
+
+#include <Eigen/Geometry>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * @brief Bounded, thread-safe cache of per-pose scalar results, keyed on a quantized pose.
+ *
+ * Positions are rounded to position_step and orientations to orientation_step (radians, through the components of
+ * the unit quaternion with non-negative w), so all poses within one quantization cell share an entry. The value of
+ * an entry is computed at the cell's representative pose (cellPose), not at the pose that happened to reach the cell
+ * first, so it depends only on the cell: concurrent users see the same values whatever the order of their lookups,
+ * and the error is bounded by the variation of the cached quantity over one cell.
+ *
+ * The entries are spread over independently locked shards, each with least-recently-used eviction, so MPPI worker
+ * threads can share one cache without serializing on a single lock.
+ */
+class PoseCache {
+public:
+    /// Quantized pose: three position cells and four quaternion cells.
+    using Key = std::array<std::int32_t, 7>;
+
+    /// Hit-rate statistics since the last clear() or resetStats().
+    struct Stats {
+        std::uint64_t hits      = 0;
+        std::uint64_t misses    = 0;
+        std::uint64_t evictions = 0;
+        std::size_t size        = 0;
+
+        double hitRate() const {
+            const std::uint64_t lookups = hits + misses;
+            return lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+        }
+    };
+
+    PoseCache() = default;
+
+    /**
+     * @brief Copies the configuration only; the copy starts empty.
+     */
+    PoseCache(const PoseCache& other) {
+        configure(other.position_step_, other.orientation_step_, other.capacity_);
+    }
+
+    PoseCache& operator=(const PoseCache& other) {
+        if (this != &other) {
+            configure(other.position_step_, other.orientation_step_, other.capacity_);
+            clear();
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Sets the quantization steps and capacity; the cache is cleared if any of them changes.
+     *
+     * @param position_step    Position cell size in metres.
+     * @param orientation_step Orientation cell size in radians.
+     * @param capacity         Maximum number of entries (0 disables the cache).
+     */
+    void configure(double position_step, double orientation_step, std::size_t capacity) {
+        if (position_step == position_step_ && orientation_step == orientation_step_ && capacity == capacity_) {
+            return;
+        }
+        position_step_    = position_step;
+        orientation_step_ = orientation_step;
+        capacity_         = capacity;
+        shard_capacity_   = (capacity + NumShards - 1) / NumShards;
+        clear();
+    }
+
+    /// True if the cache has a positive capacity and valid quantization steps.
+    bool enabled() const {
+        return capacity_ > 0 && position_step_ > 0.0 && orientation_step_ > 0.0;
+    }
+
+    /**
+     * @brief Quantizes a pose into a cache key.
+     */
+    template <typename Scalar>
+    Key key(const Eigen::Transform<Scalar, 3, Eigen::Isometry>& pose) const {
+        Eigen::Quaternion<Scalar> q(pose.rotation());
+        if (q.w() < Scalar(0))
+            q.coeffs() = -q.coeffs();
+
+        // A rotation by theta moves the quaternion by about theta / 2.
+        const double inv_pos = 1.0 / position_step_;
+        const double inv_ori = 2.0 / orientation_step_;
+        Key k;
+        for (int i = 0; i < 3; ++i) {
+            k[i] = static_cast<std::int32_t>(std::lround(static_cast<double>(pose.translation()(i)) * inv_pos));
+        }
+        for (int i = 0; i < 4; ++i) {
+            k[3 + i] = static_cast<std::int32_t>(std::lround(static_cast<double>(q.coeffs()(i)) * inv_ori));
+        }
+        return k;
+    }
+
+    /**
+     * @brief Representative pose of a key's cell: the quantized position and the normalized quantized quaternion.
+     */
+    template <typename Scalar>
+    Eigen::Transform<Scalar, 3, Eigen::Isometry> cellPose(const Key& k) const {
+        const double ori = 0.5 * orientation_step_;
+        Eigen::Quaternion<Scalar> q(Scalar(k[6] * ori), Scalar(k[3] * ori), Scalar(k[4] * ori), Scalar(k[5] * ori));
+        if (q.norm() > Scalar(0))
+            q.normalize();
+        else
+            q.setIdentity();
+        Eigen::Transform<Scalar, 3, Eigen::Isometry> pose = Eigen::Transform<Scalar, 3, Eigen::Isometry>::Identity();
+        pose.linear()                                     = q.toRotationMatrix();
+        for (int i = 0; i < 3; ++i) {
+            pose.translation()(i) = Scalar(k[i] * position_step_);
+        }
+        return pose;
+    }
+
+    /**
+     * @brief Looks up a key and marks it as recently used.
+     *
+     * @param k     The quantized pose.
+     * @param value Receives the cached value on a hit.
+     * @return True on a hit.
+     */
+    bool lookup(const Key& k, double& value) {
+        const std::size_t h = hash(k);
+        Shard& shard        = shards_[h % NumShards];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(k);
+            if (it != shard.index.end()) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+                value = it->second->second;
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    /**
+     * @brief Inserts a value, evicting the least recently used entry of the shard if it is full.
+     *
+     * If another thread inserted the same key in the meantime, the existing value is kept.
+     */
+    void insert(const Key& k, double value) {
+        if (!enabled())
+            return;
+        const std::size_t h = hash(k);
+        Shard& shard        = shards_[h % NumShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.index.count(k))
+            return;
+        if (shard.entries.size() >= shard_capacity_) {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        shard.entries.emplace_front(k, value);
+        shard.index.emplace(k, shard.entries.begin());
+    }
+
+    /**
+     * @brief Returns the cached value for a pose's cell, computing it at the cell's pose and inserting it on a miss.
+     *
+     * @param pose    The pose.
+     * @param compute Callable returning the value at the pose it is given: the cell's pose (cellPose), or pose
+     *                itself if the cache is disabled.
+     */
+    template <typename Scalar, typename Compute>
+    Scalar getOrCompute(const Eigen::Transform<Scalar, 3, Eigen::Isometry>& pose, Compute&& compute) {
+        if (!enabled())
+            return compute(pose);
+        const Key k = key(pose);
+        double value;
+        if (lookup(k, value))
+            return static_cast<Scalar>(value);
+        const Scalar result = compute(cellPose<Scalar>(k));
+        insert(k, static_cast<double>(result));
+        return result;
+    }
+
+    /**
+     * @brief Removes every entry and resets the statistics.
+     */
+    void clear() {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
+        }
+        resetStats();
+    }
+
+    /**
+     * @brief Resets the hit, miss and eviction counters.
+     */
+    void resetStats() {
+        hits_.store(0, std::memory_order_relaxed);
+        misses_.store(0, std::memory_order_relaxed);
+        evictions_.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Returns the hit-rate statistics and the current number of entries.
+     */
+    Stats stats() const {
+        Stats s;
+        s.hits      = hits_.load(std::memory_order_relaxed);
+        s.misses    = misses_.load(std::memory_order_relaxed);
+        s.evictions = evictions_.load(std::memory_order_relaxed);
+        for (const auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            s.size += shard.entries.size();
+        }
+        return s;
+    }
+
+private:
+    /// Number of independently locked shards.
+    static constexpr std::size_t NumShards = 16;
+
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const {
+            return hash(k);
+        }
+    };
+
+    /// One lock, one LRU list (most recent first) and its index.
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<std::pair<Key, double>> entries;
+        std::unordered_map<Key, std::list<std::pair<Key, double>>::iterator, KeyHash> index;
+    };
+
+    static std::size_t hash(const Key& k) {
+        // splitmix64 finalizer over the packed cells.
+        std::uint64_t h = 0x9e3779b97f4a7c15ULL;
+        for (std::int32_t cell : k) {
+            h ^= static_cast<std::uint32_t>(cell);
+            h += 0x9e3779b97f4a7c15ULL;
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            h ^= h >> 31;
+        }
+        return static_cast<std::size_t>(h);
+    }
+
+    double position_step_       = 0.0;
+    double orientation_step_    = 0.0;
+    std::size_t capacity_       = 0;
+    std::size_t shard_capacity_ = 0;
+    std::array<Shard, NumShards> shards_;
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> misses_{0};
+    std::atomic<std::uint64_t> evictions_{0};
+};
+
+#endif  // POSE_CACHE_HPP
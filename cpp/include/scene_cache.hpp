@@ -0,0 +1,404 @@
+#ifndef SCENE_CACHE_HPP
+#define SCENE_CACHE_HPP
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/io/pcd_io.h>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "esdf.hpp"
+#include "planner_profiler.hpp"
+
+/// Format version of the scene cache; files of any other version are rebuilt.
+constexpr std::uint32_t SceneCacheVersion = 1;
+
+/**
+ * @brief Fixed-size header at the start of a scene cache file.
+ *
+ * The sections follow at 64-byte aligned offsets, so that they can be used in place from the mapping. Values are
+ * stored in native byte order.
+ */
+struct SceneCacheHeader {
+    char magic[8];              // "WPSCENE" and a terminating zero.
+    std::uint32_t version;      // SceneCacheVersion.
+    std::uint32_t header_size;  // sizeof(SceneCacheHeader), guards against layout changes.
+    std::uint64_t source_hash;  // SceneSources::hash of the inputs the file was built from.
+    std::uint64_t file_size;    // Total size in bytes, guards against truncated files.
+
+    // Downsampled obstacle points and end-effector points (end-effector frame), x, y, z floats per point.
+    std::uint64_t num_points;
+    std::uint64_t points_offset;
+    std::uint64_t num_ee_points;
+    std::uint64_t ee_points_offset;
+    // End-effector collision box.
+    float box_min[4];
+    float box_max[4];
+
+    // Distance field of the obstacle points (see EsdfGrid), node distances x fastest.
+    float esdf_origin[3];
+    std::int32_t esdf_dims[3];
+    float esdf_resolution;
+    float esdf_bound;
+    std::uint64_t esdf_offset;
+};
+
+/**
+ * @brief Source files and preprocessing parameters of a scene; the cache is valid only for an identical set.
+ */
+struct SceneSources {
+    /// Obstacle point cloud (.pcd).
+    std::string cloud_path;
+    /// End-effector mesh (.stl).
+    std::string mesh_path;
+    /// Voxel leaf size for downsampling the cloud (0 keeps every point).
+    float leaf_size = 0.03f;
+    /// Pose of the mesh in the end-effector frame.
+    Eigen::Isometry3d mesh_transform = Eigen::Isometry3d::Identity();
+    /// Margin added to the end-effector collision box.
+    double mesh_margin = 0.0;
+    /// Grid spacing of the stored distance field.
+    double esdf_resolution = 0.01;
+    /// Clamp distance of the stored distance field (the planner uses its collision_margin).
+    double esdf_bound = 0.05;
+
+    /**
+     * @brief FNV-1a hash of the contents of both source files, the parameters and the format version.
+     *
+     * @return The hash, or 0 if a source file cannot be read.
+     */
+    std::uint64_t hash() const {
+        std::uint64_t h = 0xcbf29ce484222325ULL;
+        auto mix        = [&h](const void* data, std::size_t size) {
+            const unsigned char* bytes = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < size; ++i) {
+                h = (h ^ bytes[i]) * 0x100000001b3ULL;
+            }
+        };
+        for (const std::string* path : {&cloud_path, &mesh_path}) {
+            std::ifstream file(*path, std::ios::binary);
+            if (!file)
+                return 0;
+            std::vector<char> buffer(1 << 16);
+            while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+                mix(buffer.data(), static_cast<std::size_t>(file.gcount()));
+            }
+        }
+        const double params[] = {leaf_size, mesh_margin, esdf_resolution, esdf_bound};
+        mix(params, sizeof(params));
+        mix(mesh_transform.matrix().data(), 16 * sizeof(double));
+        mix(&SceneCacheVersion, sizeof(SceneCacheVersion));
+        return h;
+    }
+};
+
+/**
+ * @brief Read-only memory mapping of a scene cache file.
+ *
+ * The sections are validated on open and then read in place, without copying.
+ */
+class SceneCacheFile {
+public:
+    SceneCacheFile() = default;
+    SceneCacheFile(const SceneCacheFile&)            = delete;
+    SceneCacheFile& operator=(const SceneCacheFile&) = delete;
+
+    ~SceneCacheFile() {
+        close();
+    }
+
+    /**
+     * @brief Maps a cache file and checks its header.
+     *
+     * @param path          The cache file.
+     * @param expected_hash The hash of the current sources; a different stored hash rejects the file.
+     * @return False if the file is missing, truncated, of another version or built from other sources.
+     */
+    bool open(const std::string& path, std::uint64_t expected_hash) {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SceneCacheHeader)) {
+            ::close(fd);
+            return false;
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            return false;
+        }
+
+        const SceneCacheHeader& h = header();
+        const bool valid = std::memcmp(h.magic, "WPSCENE", 8) == 0 && h.version == SceneCacheVersion
+                           && h.header_size == sizeof(SceneCacheHeader) && h.file_size == size_
+                           && h.source_hash == expected_hash && expected_hash != 0
+                           && fits(h.points_offset, 3 * h.num_points * sizeof(float))
+                           && fits(h.ee_points_offset, 3 * h.num_ee_points * sizeof(float))
+                           && fits(h.esdf_offset, numEsdfNodes() * sizeof(float));
+        if (!valid)
+            close();
+        return valid;
+    }
+
+    /// Unmaps the file.
+    void close() {
+        if (data_)
+            ::munmap(data_, size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    /// True if a valid file is mapped.
+    bool isOpen() const {
+        return data_ != nullptr;
+    }
+
+    /// Header of the mapped file.
+    const SceneCacheHeader& header() const {
+        return *static_cast<const SceneCacheHeader*>(data_);
+    }
+
+    /// Obstacle points, 3 x num_points.
+    Eigen::Map<const Eigen::Matrix3Xf> points() const {
+        return {section<float>(header().points_offset), 3, static_cast<Eigen::Index>(header().num_points)};
+    }
+
+    /// End-effector points, 3 x num_ee_points.
+    Eigen::Map<const Eigen::Matrix3Xf> eePoints() const {
+        return {section<float>(header().ee_points_offset), 3, static_cast<Eigen::Index>(header().num_ee_points)};
+    }
+
+    /// Distance field nodes, x fastest.
+    const float* esdfValues() const {
+        return section<float>(header().esdf_offset);
+    }
+
+    /// Number of distance field nodes.
+    std::size_t numEsdfNodes() const {
+        const SceneCacheHeader& h = header();
+        if (h.esdf_dims[0] <= 0 || h.esdf_dims[1] <= 0 || h.esdf_dims[2] <= 0)
+            return 0;
+        return static_cast<std::size_t>(h.esdf_dims[0]) * h.esdf_dims[1] * h.esdf_dims[2];
+    }
+
+private:
+    template <typename T>
+    const T* section(std::uint64_t offset) const {
+        return reinterpret_cast<const T*>(static_cast<const char*>(data_) + offset);
+    }
+
+    bool fits(std::uint64_t offset, std::uint64_t bytes) const {
+        return offset % 64 == 0 && offset <= size_ && bytes <= size_ - offset;
+    }
+
+    void* data_       = nullptr;
+    std::size_t size_ = 0;
+};
+
+/**
+ * @brief Builds a scene from its sources: loads and downsamples the cloud, builds the kd-tree, loads the end-effector
+ *        mesh and builds the distance field.
+ *
+ * @param planner The planner to set up; its collision_margin should already be set.
+ * @param sources The source files and parameters.
+ * @return False if the point cloud could not be loaded.
+ */
+template <typename Planner>
+bool buildScene(Planner& planner, const SceneSources& sources) {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr original_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    if (pcl::io::loadPCDFile(sources.cloud_path, *original_cloud) == -1) {
+        std::cerr << "[buildScene] Couldn't read " << sources.cloud_path << "\n";
+        return false;
+    }
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    if (sources.leaf_size > 0) {
+        pcl::VoxelGrid<pcl::PointXYZ> voxel;
+        voxel.setInputCloud(original_cloud);
+        voxel.setLeafSize(sources.leaf_size, sources.leaf_size, sources.leaf_size);
+        voxel.filter(*cloud);
+    }
+    else {
+        *cloud = *original_cloud;
+    }
+
+    std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> kd_tree(new pcl::KdTreeFLANN<pcl::PointXYZ>);
+    kd_tree->setInputCloud(cloud);
+    planner.obstacle_cloud = cloud;
+    planner.kd_tree        = kd_tree;
+
+    using IsometryT = typename Planner::IsometryT;
+    using Scalar    = typename IsometryT::Scalar;
+    planner.updateEndEffectorFromSTL(sources.mesh_path,
+                                     IsometryT(sources.mesh_transform.matrix().template cast<Scalar>()),
+                                     static_cast<Scalar>(sources.mesh_margin));
+    planner.esdf.build(cloud, static_cast<float>(sources.esdf_resolution), static_cast<float>(sources.esdf_bound));
+    return true;
+}
+
+/**
+ * @brief Writes the scene of a planner (obstacle points, end-effector points and box, distance field) to a cache
+ *        file.
+ *
+ * @param planner A planner set up by buildScene.
+ * @param hash    SceneSources::hash of the sources the scene was built from.
+ * @param path    The cache file.
+ * @return False if the file could not be written.
+ */
+template <typename Planner>
+bool writeSceneCache(const Planner& planner, std::uint64_t hash, const std::string& path) {
+    auto align = [](std::uint64_t offset) { return (offset + 63) / 64 * 64; };
+
+    SceneCacheHeader h{};
+    std::memcpy(h.magic, "WPSCENE", 8);
+    h.version          = SceneCacheVersion;
+    h.header_size      = sizeof(SceneCacheHeader);
+    h.source_hash      = hash;
+    h.num_points       = planner.obstacle_cloud ? planner.obstacle_cloud->points.size() : 0;
+    h.points_offset    = align(sizeof(SceneCacheHeader));
+    h.num_ee_points    = planner.ee_mesh_cloud ? planner.ee_mesh_cloud->points.size() : 0;
+    h.ee_points_offset = align(h.points_offset + 3 * h.num_points * sizeof(float));
+    for (int i = 0; i < 4; ++i) {
+        h.box_min[i] = planner.box_min(i);
+        h.box_max[i] = planner.box_max(i);
+    }
+    const EsdfGrid& esdf = planner.esdf;
+    for (int i = 0; i < 3; ++i) {
+        h.esdf_origin[i] = esdf.origin()(i);
+        h.esdf_dims[i]   = esdf.empty() ? 0 : esdf.dims()(i);
+    }
+    h.esdf_resolution = esdf.resolution();
+    h.esdf_bound      = esdf.bound();
+    h.esdf_offset     = align(h.ee_points_offset + 3 * h.num_ee_points * sizeof(float));
+    h.file_size       = h.esdf_offset + esdf.numNodes() * sizeof(float);
+
+    std::vector<char> buffer(h.file_size, 0);
+    std::memcpy(buffer.data(), &h, sizeof(h));
+    float* points = reinterpret_cast<float*>(buffer.data() + h.points_offset);
+    for (std::size_t i = 0; i < h.num_points; ++i) {
+        const auto& pt    = planner.obstacle_cloud->points[i];
+        points[3 * i]     = pt.x;
+        points[3 * i + 1] = pt.y;
+        points[3 * i + 2] = pt.z;
+    }
+    float* ee_points = reinterpret_cast<float*>(buffer.data() + h.ee_points_offset);
+    for (std::size_t i = 0; i < h.num_ee_points; ++i) {
+        const auto& pt       = planner.ee_mesh_cloud->points[i];
+        ee_points[3 * i]     = pt.x;
+        ee_points[3 * i + 1] = pt.y;
+        ee_points[3 * i + 2] = pt.z;
+    }
+    if (esdf.numNodes() > 0) {
+        std::memcpy(buffer.data() + h.esdf_offset, esdf.values(), esdf.numNodes() * sizeof(float));
+    }
+
+    // Write to a temporary file and rename, so readers never map a partly written cache.
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.write(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+            return false;
+    }
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+/**
+ * @brief Sets up a planner from a cache file if it was built from the given sources.
+ *
+ * The distance field is used in place from the mapping. The obstacle points are copied into a PCL cloud (PCL clouds
+ * own their storage) and the kd-tree is rebuilt over them, which is cheap next to parsing and downsampling the scan.
+ *
+ * @param planner The planner to set up.
+ * @param hash    SceneSources::hash of the current sources.
+ * @param path    The cache file.
+ * @return False if the file is missing or stale; the planner is then left unchanged.
+ */
+template <typename Planner>
+bool loadSceneCache(Planner& planner, std::uint64_t hash, const std::string& path) {
+    auto file = std::make_shared<SceneCacheFile>();
+    if (!file->open(path, hash))
+        return false;
+    const SceneCacheHeader& h = file->header();
+
+    const auto points = file->points();
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    cloud->points.resize(points.cols());
+    for (Eigen::Index i = 0; i < points.cols(); ++i) {
+        cloud->points[i].x = points(0, i);
+        cloud->points[i].y = points(1, i);
+        cloud->points[i].z = points(2, i);
+    }
+    cloud->width  = static_cast<std::uint32_t>(cloud->points.size());
+    cloud->height = 1;
+
+    std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> kd_tree(new pcl::KdTreeFLANN<pcl::PointXYZ>);
+    kd_tree->setInputCloud(cloud);
+    planner.obstacle_cloud = cloud;
+    planner.kd_tree        = kd_tree;
+
+    const auto ee_points = file->eePoints();
+    pcl::PointCloud<pcl::PointXYZ>::Ptr ee_cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (Eigen::Index i = 0; i < ee_points.cols(); ++i) {
+        ee_cloud->points.emplace_back(ee_points(0, i), ee_points(1, i), ee_points(2, i));
+    }
+    planner.ee_mesh_cloud = ee_cloud;
+    planner.syncEndEffectorPoints();
+    planner.box_min = Eigen::Vector4f(h.box_min[0], h.box_min[1], h.box_min[2], h.box_min[3]);
+    planner.box_max = Eigen::Vector4f(h.box_max[0], h.box_max[1], h.box_max[2], h.box_max[3]);
+
+    if (file->numEsdfNodes() > 0) {
+        planner.esdf.attach(cloud,
+                            h.esdf_resolution,
+                            h.esdf_bound,
+                            Eigen::Vector3f(h.esdf_origin[0], h.esdf_origin[1], h.esdf_origin[2]),
+                            Eigen::Vector3i(h.esdf_dims[0], h.esdf_dims[1], h.esdf_dims[2]),
+                            file->esdfValues(),
+                            file);
+    }
+    return true;
+}
+
+/**
+ * @brief Loads a scene from its cache file, or builds it from the sources and writes the cache.
+ *
+ * @param planner The planner to set up; its collision_margin should already be set.
+ * @param sources The source files and parameters.
+ * @param path    The cache file.
+ * @return False if the scene could neither be loaded nor built.
+ */
+template <typename Planner>
+bool loadOrBuildScene(Planner& planner, const SceneSources& sources, const std::string& path) {
+    const std::uint64_t hash = sources.hash();
+    if (loadSceneCache(planner, hash, path)) {
+        PLANNER_LOG("[loadOrBuildScene] Loaded scene cache " << path << " (" << planner.obstacle_cloud->size()
+                    << " points)\n");
+        return true;
+    }
+    if (!buildScene(planner, sources))
+        return false;
+    if (writeSceneCache(planner, hash, path)) {
+        PLANNER_LOG("[loadOrBuildScene] Wrote scene cache " << path << "\n");
+    }
+    else {
+        std::cerr << "[loadOrBuildScene] Could not write scene cache " << path << "\n";
+    }
+    return true;
+}
+
+#endif  // SCENE_CACHE_HPP
@@ -0,0 +1,116 @@
+#ifndef SPHERE_TREE_HPP
+#define SPHERE_TREE_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+/**
+ * @brief Bounding-sphere hierarchy over a fixed point set, for culling groups of points far from every obstacle.
+ *
+ * The tree is built top-down: each node's points are split at the median of the longest axis of their bounding box
+ * until at most leaf_size points remain. A node stores the centre of its points' bounding box and the radius around
+ * it that encloses them, so a clearance of c + radius around the centre certifies a clearance of c for every point
+ * below the node. The points are kept in tree order, so each node covers a contiguous range of points(); index()
+ * maps that order back to the columns of the source matrix.
+ */
+class BoundingSphereTree {
+public:
+    struct Node {
+        Eigen::Vector3f center = Eigen::Vector3f::Zero();
+        float radius           = 0.0f;
+        /// Range [begin, end) of points() below the node.
+        int begin = 0;
+        int end   = 0;
+        /// Index of the second child (the first child directly follows its parent), or -1 for a leaf.
+        int right = -1;
+    };
+
+    /**
+     * @brief Builds the tree over the columns of a point matrix.
+     *
+     * @param points    The points (3 x N).
+     * @param leaf_size Maximum number of points of a leaf.
+     */
+    void build(const Eigen::Matrix3Xf& points, int leaf_size = 8) {
+        const int n = static_cast<int>(points.cols());
+        nodes_.clear();
+        index_.resize(n);
+        std::iota(index_.begin(), index_.end(), 0);
+        if (n > 0) {
+            nodes_.reserve(2 * (n / std::max(leaf_size, 1)) + 1);
+            buildNode(points, 0, n, std::max(leaf_size, 1));
+        }
+        points_.resize(3, n);
+        for (int j = 0; j < n; ++j) {
+            points_.col(j) = points.col(index_[j]);
+        }
+    }
+
+    void clear() {
+        nodes_.clear();
+        index_.clear();
+        points_.resize(3, 0);
+    }
+
+    bool empty() const {
+        return nodes_.empty();
+    }
+
+    /// Number of points the tree was built over.
+    Eigen::Index size() const {
+        return points_.cols();
+    }
+
+    /// Nodes in depth-first order; the root is nodes()[0].
+    const std::vector<Node>& nodes() const {
+        return nodes_;
+    }
+
+    /// The points in tree order.
+    const Eigen::Matrix3Xf& points() const {
+        return points_;
+    }
+
+    /// Column of the source matrix of each point in tree order.
+    const std::vector<int>& index() const {
+        return index_;
+    }
+
+private:
+    int buildNode(const Eigen::Matrix3Xf& points, int begin, int end, int leaf_size) {
+        Eigen::Vector3f min_pt = points.col(index_[begin]);
+        Eigen::Vector3f max_pt = min_pt;
+        for (int j = begin + 1; j < end; ++j) {
+            min_pt = min_pt.cwiseMin(points.col(index_[j]));
+            max_pt = max_pt.cwiseMax(points.col(index_[j]));
+        }
+        Node node;
+        node.center = 0.5f * (min_pt + max_pt);
+        node.begin  = begin;
+        node.end    = end;
+        for (int j = begin; j < end; ++j) {
+            node.radius = std::max(node.radius, (points.col(index_[j]) - node.center).norm());
+        }
+        const int id = static_cast<int>(nodes_.size());
+        nodes_.push_back(node);
+        if (end - begin <= leaf_size)
+            return id;
+
+        int axis;
+        (max_pt - min_pt).maxCoeff(&axis);
+        const int mid = begin + (end - begin) / 2;
+        std::nth_element(index_.begin() + begin, index_.begin() + mid, index_.begin() + end,
+                         [&points, axis](int a, int b) { return points(axis, a) < points(axis, b); });
+        buildNode(points, begin, mid, leaf_size);
+        nodes_[id].right = buildNode(points, mid, end, leaf_size);
+        return id;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<int> index_;
+    Eigen::Matrix3Xf points_;
+};
+
+#endif  // SPHERE_TREE_HPP
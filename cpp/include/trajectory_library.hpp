@@ -0,0 +1,353 @@
+#ifndef TRAJECTORY_LIBRARY_HPP
+#define TRAJECTORY_LIBRARY_HPP
+
+#include <Eigen/Geometry>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Format version of a saved trajectory library; files of any other version are not loaded.
+constexpr std::uint32_t TrajectoryLibraryVersion = 2;
+
+/**
+ * @brief How generateWaypoints uses PlannerMpc::trajectory_library.
+ */
+enum class WarmStartMode {
+    /// The library is neither read nor updated.
+    Off,
+    /// The first control sequence of the nearest stored solution seeds U.
+    Controls,
+    /// The control sequence of each step of the nearest stored solution seeds U at that step, so the plan retraces
+    /// the stored waypoint chain where it is still optimal.
+    Chain
+};
+
+/**
+ * @brief Library of solved queries for warm-starting similar ones, keyed on the goal pose relative to the start.
+ *
+ * The key of a query is the goal in the start frame: its translation and its rotation vector, the latter scaled by
+ * orientation_scale metres per radian. Lookups return the entry with the nearest key (a linear scan, which is
+ * negligible next to a plan for libraries of a few thousand entries) if it lies within max_distance. The controls
+ * and waypoints of an entry are stored in the start frame as well, so a match can be replayed from a different
+ * start.
+ *
+ * Each entry records the layout of its controls, and lookups only match entries of the querying planner's layout:
+ * the rotational controls of one rotation integrator mean something else to another.
+ *
+ * The library is thread-safe and is shared by the copies of a planner (queryContext, generateWaypointsBatch). It
+ * can be saved to and loaded from a file in native byte order.
+ */
+class TrajectoryLibrary {
+public:
+    /// Query key: goal translation and scaled rotation vector in the start frame.
+    using Key = std::array<double, 6>;
+
+    /// Layout of the controls of an entry.
+    struct Layout {
+        /// The RotationIntegrator that produced the rotational controls, as its integer value.
+        std::uint32_t rotation_integrator = 0;
+        /// Length of each control sequence (ActionDim * HorizonDim).
+        std::uint32_t control_size = 0;
+
+        bool operator==(const Layout& other) const {
+            return rotation_integrator == other.rotation_integrator && control_size == other.control_size;
+        }
+    };
+
+    /// One solved query.
+    struct Entry {
+        Key key{};
+        Layout layout;
+        /// Control sequence of each receding-horizon step, in the start frame.
+        std::vector<std::vector<double>> controls;
+        /// Waypoints of the plan, in the start frame.
+        std::vector<Eigen::Isometry3d> waypoints;
+        /// Iterations and cost evaluations of the cold solve the entry descends from, the baseline of the savings.
+        int baseline_iterations   = 0;
+        long baseline_evaluations = 0;
+        std::uint64_t last_used   = 0;
+    };
+
+    /// Warm-start statistics since the last clear() or resetStats().
+    struct Stats {
+        std::uint64_t queries = 0;
+        std::uint64_t hits    = 0;
+        /// Baseline iterations minus the iterations of the warm-started plans.
+        long iterations_saved = 0;
+        /// Baseline cost evaluations minus the evaluations of the warm-started plans.
+        long evaluations_saved = 0;
+        std::size_t size       = 0;
+
+        double hitRate() const {
+            return queries > 0 ? static_cast<double>(hits) / static_cast<double>(queries) : 0.0;
+        }
+    };
+
+    /// Largest key distance of a hit.
+    double max_distance = 0.05;
+    /// Metres per radian of relative rotation in the key.
+    double orientation_scale = 0.1;
+    /// Maximum number of entries; the least recently used entry is evicted.
+    std::size_t capacity = 4096;
+
+    /**
+     * @brief Key of a query: the goal pose in the start frame.
+     */
+    Key key(const Eigen::Isometry3d& start, const Eigen::Isometry3d& goal) const {
+        const Eigen::Isometry3d relative = start.inverse() * goal;
+        const Eigen::AngleAxisd rotation(relative.rotation());
+        const Eigen::Vector3d w = rotation.angle() * rotation.axis() * orientation_scale;
+        const Eigen::Vector3d t = relative.translation();
+        return {t.x(), t.y(), t.z(), w.x(), w.y(), w.z()};
+    }
+
+    /**
+     * @brief Finds the stored solution nearest to a query and counts the lookup.
+     *
+     * @param start  The start pose.
+     * @param goal   The goal pose.
+     * @param layout Layout of the querying planner's controls; entries of another layout are skipped.
+     * @param match  Receives a copy of the entry on a hit.
+     * @return True if an entry of the layout lies within max_distance.
+     */
+    bool lookup(const Eigen::Isometry3d& start, const Eigen::Isometry3d& goal, const Layout& layout, Entry& match) {
+        const Key k = key(start, goal);
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.queries;
+        const std::size_t i = nearest(k, max_distance, layout);
+        if (i == npos)
+            return false;
+        ++stats_.hits;
+        entries_[i].last_used = ++clock_;
+        match                 = entries_[i];
+        return true;
+    }
+
+    /**
+     * @brief Stores a solved query.
+     *
+     * An entry of the same layout for nearly the same query (within a quarter of max_distance) is replaced if the new
+     * solution needs fewer steps, so repeated queries do not fill the library with duplicates.
+     *
+     * @param start The start pose.
+     * @param goal  The goal pose.
+     * @param entry The solution with its layout; its key is set here.
+     */
+    void insert(const Eigen::Isometry3d& start, const Eigen::Isometry3d& goal, Entry entry) {
+        entry.key = key(start, goal);
+        std::lock_guard<std::mutex> lock(mutex_);
+        entry.last_used     = ++clock_;
+        const std::size_t i = nearest(entry.key, 0.25 * max_distance, entry.layout);
+        if (i != npos) {
+            if (entry.controls.size() < entries_[i].controls.size())
+                entries_[i] = std::move(entry);
+            else
+                entries_[i].last_used = entry.last_used;
+            return;
+        }
+        if (capacity == 0)
+            return;
+        if (entries_.size() >= capacity) {
+            std::size_t lru = 0;
+            for (std::size_t j = 1; j < entries_.size(); ++j) {
+                if (entries_[j].last_used < entries_[lru].last_used)
+                    lru = j;
+            }
+            entries_[lru] = std::move(entry);
+            return;
+        }
+        entries_.push_back(std::move(entry));
+    }
+
+    /**
+     * @brief Adds the outcome of a warm-started plan to the savings.
+     */
+    void recordSavings(const Entry& match, int iterations, long evaluations) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.iterations_saved += match.baseline_iterations - iterations;
+        stats_.evaluations_saved += match.baseline_evaluations - evaluations;
+    }
+
+    /**
+     * @brief Returns the warm-start statistics and the number of entries.
+     */
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats s = stats_;
+        s.size  = entries_.size();
+        return s;
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    /**
+     * @brief Resets the statistics; the entries are kept.
+     */
+    void resetStats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_ = Stats();
+    }
+
+    /**
+     * @brief Removes every entry and resets the statistics.
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        stats_ = Stats();
+    }
+
+    /**
+     * @brief Writes the entries to a file.
+     *
+     * @return False if the file could not be written.
+     */
+    bool save(const std::string& path) const {
+        std::vector<char> buffer;
+        auto put = [&buffer](const void* data, std::size_t size) {
+            buffer.insert(buffer.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const char magic[8]           = "WPTRAJ";
+            const std::uint32_t version   = TrajectoryLibraryVersion;
+            const std::uint64_t n_entries = entries_.size();
+            put(magic, sizeof(magic));
+            put(&version, sizeof(version));
+            put(&n_entries, sizeof(n_entries));
+            for (const Entry& e : entries_) {
+                const std::int64_t baseline[2] = {e.baseline_iterations, e.baseline_evaluations};
+                const std::uint64_t counts[3]  = {e.controls.size(),
+                                                  e.controls.empty() ? 0 : e.controls.front().size(),
+                                                  e.waypoints.size()};
+                put(e.key.data(), sizeof(e.key));
+                put(&e.layout, sizeof(e.layout));
+                put(baseline, sizeof(baseline));
+                put(counts, sizeof(counts));
+                for (const auto& u : e.controls) {
+                    put(u.data(), u.size() * sizeof(double));
+                }
+                for (const auto& w : e.waypoints) {
+                    // The top three rows of the matrix, column-major.
+                    const Eigen::Matrix<double, 3, 4> m = w.affine();
+                    put(m.data(), sizeof(double) * 12);
+                }
+            }
+        }
+        // Write to a temporary file and rename, so readers never see a partly written library.
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            if (!file.write(buffer.data(), static_cast<std::streamsize>(buffer.size())))
+                return false;
+        }
+        return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+    /**
+     * @brief Replaces the entries with those of a file written by save().
+     *
+     * @return False if the file is missing, of another version or malformed; the library is then left unchanged.
+     */
+    bool load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        const std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::size_t pos = 0;
+        auto get        = [&buffer, &pos](void* data, std::size_t size) {
+            if (size > buffer.size() - pos)
+                return false;
+            std::memcpy(data, buffer.data() + pos, size);
+            pos += size;
+            return true;
+        };
+
+        char magic[8];
+        std::uint32_t version   = 0;
+        std::uint64_t n_entries = 0;
+        if (!get(magic, sizeof(magic)) || std::strncmp(magic, "WPTRAJ", 8) != 0 || !get(&version, sizeof(version))
+            || version != TrajectoryLibraryVersion || !get(&n_entries, sizeof(n_entries)))
+            return false;
+        std::vector<Entry> entries;
+        for (std::uint64_t i = 0; i < n_entries; ++i) {
+            Entry e;
+            std::int64_t baseline[2];
+            std::uint64_t counts[3];
+            if (!get(e.key.data(), sizeof(e.key)) || !get(&e.layout, sizeof(e.layout))
+                || !get(baseline, sizeof(baseline)) || !get(counts, sizeof(counts)))
+                return false;
+            // Bound the counts by the remaining bytes before allocating.
+            const std::size_t remaining = (buffer.size() - pos) / sizeof(double);
+            if (counts[0] > remaining || counts[1] > remaining || counts[0] * counts[1] > remaining
+                || counts[2] > remaining / 12 || (counts[0] > 0 && counts[1] != e.layout.control_size))
+                return false;
+            e.baseline_iterations  = static_cast<int>(baseline[0]);
+            e.baseline_evaluations = static_cast<long>(baseline[1]);
+            e.controls.assign(counts[0], std::vector<double>(counts[1]));
+            for (auto& u : e.controls) {
+                if (!get(u.data(), u.size() * sizeof(double)))
+                    return false;
+            }
+            e.waypoints.resize(counts[2]);
+            for (auto& w : e.waypoints) {
+                Eigen::Matrix<double, 3, 4> m;
+                if (!get(m.data(), sizeof(double) * 12))
+                    return false;
+                w.setIdentity();
+                w.affine() = m;
+            }
+            entries.push_back(std::move(e));
+        }
+        if (pos != buffer.size())
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_ = std::move(entries);
+        clock_   = 0;
+        for (Entry& e : entries_) {
+            e.last_used = ++clock_;
+        }
+        return true;
+    }
+
+private:
+    static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+    /// Index of the entry of a layout nearest to k within radius, or npos; the caller holds the lock.
+    std::size_t nearest(const Key& k, double radius, const Layout& layout) const {
+        std::size_t best = npos;
+        double best_d2   = radius * radius;
+        for (std::size_t i = 0; i < entries_.size(); ++i) {
+            if (!(entries_[i].layout == layout))
+                continue;
+            double d2 = 0.0;
+            for (int j = 0; j < 6; ++j) {
+                const double d = entries_[i].key[j] - k[j];
+                d2 += d * d;
+            }
+            if (d2 <= best_d2) {
+                best    = i;
+                best_d2 = d2;
+            }
+        }
+        return best;
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+    Stats stats_;
+    std::uint64_t clock_ = 0;
+};
+
+#endif  // TRAJECTORY_LIBRARY_HPP
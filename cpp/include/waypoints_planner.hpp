@@ -3,11 +3,15 @@
 
 #include <Eigen/Dense>
 #include <algorithm>
+#include <array>
+#include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <nlopt.hpp>
 #include <pcl/conversions.h>  // For converting polygon meshes to point clouds
 #include <pcl/filters/crop_box.h>
@@ -17,8 +21,23 @@
 #include <pcl/kdtree/kdtree_flann.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
-#include <random>  // Added for MPPI noise sampling
+#include <unsupported/Eigen/AutoDiff>
 #include <vector>
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
+#include "esdf.hpp"
+#include "frustum_octree.hpp"
+#include "frustum_visibility.hpp"
+#include "mppi_noise.hpp"
+#include "obstacle_map.hpp"
+#include "occlusion_visibility.hpp"
+#include "planner_scene.hpp"
+#include "planner_profiler.hpp"
+#include "pose_cache.hpp"
+#include "sphere_tree.hpp"
+#include "trajectory_library.hpp"
 
 /**
  * @brief Builds a 4x4 homogeneous transform from a position and rpy Euler
@@ -30,14 +49,114 @@
 template <typename Scalar>
 Eigen::Transform<Scalar, 3, Eigen::Isometry> stateToIsometry(const Eigen::Matrix<Scalar, 3, 1>& translation,
                                                              const Eigen::Matrix<Scalar, 3, 1>& eulZYX) {
+    using std::cos;  // Found by ADL for Eigen::AutoDiffScalar.
+    using std::sin;
+    const Scalar cr = cos(eulZYX.x()), sr = sin(eulZYX.x());
+    const Scalar cp = cos(eulZYX.y()), sp = sin(eulZYX.y());
+    const Scalar cy = cos(eulZYX.z()), sy = sin(eulZYX.z());
     Eigen::Transform<Scalar, 3, Eigen::Isometry> T = Eigen::Transform<Scalar, 3, Eigen::Isometry>::Identity();
-    T.linear() = Eigen::AngleAxis<Scalar>(eulZYX.z(), Eigen::Matrix<Scalar, 3, 1>::UnitZ())
-                 * Eigen::AngleAxis<Scalar>(eulZYX.y(), Eigen::Matrix<Scalar, 3, 1>::UnitY())
-                 * Eigen::AngleAxis<Scalar>(eulZYX.x(), Eigen::Matrix<Scalar, 3, 1>::UnitX()).toRotationMatrix();
+    // Rz(yaw) * Ry(pitch) * Rx(roll), expanded; PlannerMpc::costBatch evaluates the same expressions per sample.
+    T.linear() << cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr,  //
+        sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr,            //
+        -sp, cp * sr, cp * cr;
     T.translation() = translation;
     return T;
 }
 
+/**
+ * @brief Partial derivatives of the stateToIsometry rotation Rz(yaw) * Ry(pitch) * Rx(roll).
+ *
+ * @param eulZYX The Euler angles (roll, pitch, yaw) in order.
+ * @return dR/droll, dR/dpitch and dR/dyaw.
+ */
+template <typename Scalar>
+std::array<Eigen::Matrix<Scalar, 3, 3>, 3> eulerRotationDerivatives(const Eigen::Matrix<Scalar, 3, 1>& eulZYX) {
+    const Scalar cr = std::cos(eulZYX.x()), sr = std::sin(eulZYX.x());
+    const Scalar cp = std::cos(eulZYX.y()), sp = std::sin(eulZYX.y());
+    const Scalar cy = std::cos(eulZYX.z()), sy = std::sin(eulZYX.z());
+    Eigen::Matrix<Scalar, 3, 3> Rx, Ry, Rz, dRx, dRy, dRz;
+    Rx << 1, 0, 0, 0, cr, -sr, 0, sr, cr;
+    Ry << cp, 0, sp, 0, 1, 0, -sp, 0, cp;
+    Rz << cy, -sy, 0, sy, cy, 0, 0, 0, 1;
+    dRx << 0, 0, 0, 0, -sr, -cr, 0, cr, -sr;
+    dRy << -sp, 0, cp, 0, 0, 0, -cp, 0, -sp;
+    dRz << -sy, -cy, 0, cy, -sy, 0, 0, 0, 0;
+    return {Rz * Ry * dRx, Rz * dRy * Rx, dRz * Ry * Rx};
+}
+
+/**
+ * @brief Skew-symmetric matrix of a 3-vector, so that skew(w) * v = w x v.
+ */
+template <typename Scalar>
+Eigen::Matrix<Scalar, 3, 3> skew(const Eigen::Matrix<Scalar, 3, 1>& w) {
+    Eigen::Matrix<Scalar, 3, 3> W;
+    W << Scalar(0), -w.z(), w.y(), w.z(), Scalar(0), -w.x(), -w.y(), w.x(), Scalar(0);
+    return W;
+}
+
+/**
+ * @brief SO(3) exponential map of a rotation vector (Rodrigues' formula).
+ *
+ * @param w The rotation vector (axis times angle).
+ * @return The rotation matrix.
+ */
+template <typename Scalar>
+Eigen::Matrix<Scalar, 3, 3> so3Exp(const Eigen::Matrix<Scalar, 3, 1>& w) {
+    const Scalar theta2 = w.squaredNorm();
+    Scalar a, b;  // sin(theta) / theta and (1 - cos(theta)) / theta^2, by their series near zero.
+    if (theta2 < Scalar(1e-12)) {
+        a = Scalar(1) - theta2 / Scalar(6);
+        b = Scalar(0.5) - theta2 / Scalar(24);
+    }
+    else {
+        const Scalar theta = std::sqrt(theta2);
+        a                  = std::sin(theta) / theta;
+        b                  = (Scalar(1) - std::cos(theta)) / theta2;
+    }
+    const Eigen::Matrix<Scalar, 3, 3> W = skew(w);
+    return Eigen::Matrix<Scalar, 3, 3>::Identity() + a * W + b * W * W;
+}
+
+/**
+ * @brief Left Jacobian of SO(3), with so3Exp(w + dw) = so3Exp(J * dw) * so3Exp(w) to first order.
+ *
+ * @param w The rotation vector.
+ * @return The Jacobian J.
+ */
+template <typename Scalar>
+Eigen::Matrix<Scalar, 3, 3> so3LeftJacobian(const Eigen::Matrix<Scalar, 3, 1>& w) {
+    const Scalar theta2 = w.squaredNorm();
+    Scalar b, c;  // (1 - cos(theta)) / theta^2 and (theta - sin(theta)) / theta^3.
+    if (theta2 < Scalar(1e-12)) {
+        b = Scalar(0.5) - theta2 / Scalar(24);
+        c = Scalar(1) / Scalar(6) - theta2 / Scalar(120);
+    }
+    else {
+        const Scalar theta = std::sqrt(theta2);
+        b                  = (Scalar(1) - std::cos(theta)) / theta2;
+        c                  = (theta - std::sin(theta)) / (theta2 * theta);
+    }
+    const Eigen::Matrix<Scalar, 3, 3> W = skew(w);
+    return Eigen::Matrix<Scalar, 3, 3>::Identity() + b * W + c * W * W;
+}
+
+/**
+ * @brief Partial derivatives of a rotation under the world-frame perturbation so3Exp(d) * R at d = 0.
+ *
+ * The counterpart of eulerRotationDerivatives for RotationIntegrator::ExpMap.
+ *
+ * @param R The rotation.
+ * @return dR/dd_x, dR/dd_y and dR/dd_z.
+ */
+template <typename Scalar>
+std::array<Eigen::Matrix<Scalar, 3, 3>, 3> tangentRotationDerivatives(const Eigen::Matrix<Scalar, 3, 3>& R) {
+    std::array<Eigen::Matrix<Scalar, 3, 3>, 3> dR;
+    for (int k = 0; k < 3; ++k) {
+        dR[k] = skew<Scalar>(Eigen::Matrix<Scalar, 3, 1>::Unit(k)) * R;
+    }
+    return dR;
+}
+
 /**
  * @brief Computes the 6D homogeneous error between two transforms.
  *
@@ -52,6 +171,7 @@ Eigen::Transform<Scalar, 3, Eigen::Isometry> stateToIsometry(const Eigen::Matrix
 template <typename Scalar>
 Eigen::Matrix<Scalar, 6, 1> homogeneousError(const Eigen::Transform<Scalar, 3, Eigen::Isometry>& H1,
                                              const Eigen::Transform<Scalar, 3, Eigen::Isometry>& H2) {
+    using std::atan2;  // Found by ADL for Eigen::AutoDiffScalar.
     Eigen::Matrix<Scalar, 6, 1> e = Eigen::Matrix<Scalar, 6, 1>::Zero();
 
     // Translational error
@@ -66,7 +186,7 @@ Eigen::Matrix<Scalar, 6, 1> homogeneousError(const Eigen::Transform<Scalar, 3, E
         if (eps_norm < 1e-3)
             e.tail(3) = (Scalar(0.75) - t / Scalar(12)) * eps;
         else
-            e.tail(3) = (std::atan2(eps_norm, t - Scalar(1)) / eps_norm) * eps;
+            e.tail(3) = (atan2(eps_norm, t - Scalar(1)) / eps_norm) * eps;
     }
     else {
         e.tail(3) = M_PI_2 * (Re.diagonal().array() + Scalar(1));
@@ -120,14 +240,7 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr getFrustrumCloud(const pcl::PointCloud<pcl::
     fc.setFarPlaneDistance(static_cast<float>(far_plane));
 
     // Rotate camera so that PCL "camera" aligns with X forward, Y left, Z up.
-    Eigen::Matrix4f camera_pose = pose.matrix().template cast<float>();
-    Eigen::Matrix4f cam2robot;
-    // cam2robot << 1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 0, 0, 1;
-    cam2robot << 0, 0, 1, 0, 0, -1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1;  // X right, Y down, Z forward
-    camera_pose = camera_pose * cam2robot;
-
-    // Apply the transform in PCL
-    fc.setCameraPose(camera_pose);
+    fc.setCameraPose(frustumCameraPose(pose));
 
     // Filter the points that lie within this frustum
     pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_out(new pcl::PointCloud<pcl::PointXYZ>());
@@ -175,6 +288,183 @@ std::size_t getPointsInBox(const pcl::PointCloud<pcl::PointXYZ>::ConstPtr& cloud
     return in_box->size();
 }
 
+/**
+ * @brief Nearest-obstacle distance backend used by the collision costs.
+ */
+enum class CollisionBackend {
+    /// Exact nearest-neighbour search in the obstacle kd-tree.
+    KdTree,
+    /// Trilinear lookup in a precomputed distance field of the obstacle cloud.
+    Esdf,
+    /// Search of obstacle_map within collision_margin; farther obstacles are reported at infinity.
+    VoxelMap
+};
+
+/**
+ * @brief Visible point count used by the visibility cost.
+ */
+enum class VisibilityBackend {
+    /// Every obstacle point inside the camera frustum.
+    Frustum,
+    /// Points inside the frustum that are not hidden behind other points (voxel ray casting).
+    Occlusion
+};
+
+/**
+ * @brief Preallocated buffers for batched end-effector collision queries.
+ *
+ * The buffers are resized on first use and then reused, so repeated queries with the same mesh do not allocate.
+ */
+struct CollisionWorkspace {
+    /// End-effector mesh points in the world frame (3 x N).
+    Eigen::Matrix3Xf points_world;
+    /// Nearest obstacle distance of each mesh point.
+    Eigen::VectorXf distances;
+    /// Nearest-neighbour search results for the kd-tree backend.
+    std::vector<int> nn_index   = std::vector<int>(1);
+    std::vector<float> nn_dist2 = std::vector<float>(1);
+    /// Traversal stack of the bounding-sphere broadphase.
+    std::vector<int> node_stack;
+    /// Work done with this workspace since it was last merged into the planner's profiler.
+    PlannerCounters counters;
+};
+
+/**
+ * @brief Optimizer used for each receding-horizon step of generateWaypoints.
+ */
+enum class SolverMode {
+    /// NLopt LN_COBYLA from the warm-start control sequence.
+    Cobyla,
+    /// One MPPI update from the warm-start control sequence.
+    Mppi,
+    /// An MPPI update whose result seeds a shorter COBYLA solve.
+    MppiCobyla
+};
+
+/**
+ * @brief Returns true if an NLopt algorithm supported by the planner uses the cost gradient.
+ */
+inline bool nloptUsesGradient(nlopt::algorithm algorithm) {
+    switch (algorithm) {
+        case nlopt::LD_SLSQP:
+        case nlopt::LD_LBFGS:
+        case nlopt::LD_MMA: return true;
+        default: return false;
+    }
+}
+
+/**
+ * @brief Returns a printable name for a solver mode.
+ */
+inline const char* solverModeName(SolverMode mode) {
+    switch (mode) {
+        case SolverMode::Cobyla: return "COBYLA";
+        case SolverMode::Mppi: return "MPPI";
+        case SolverMode::MppiCobyla: return "MPPI+COBYLA";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief How rollout integrates the rotational controls.
+ */
+enum class RotationIntegrator {
+    /// The controls are added to the roll, pitch and yaw angles; each stage rebuilds its rotation from the angles.
+    Euler,
+    /// The controls are rotation vectors applied in the world frame by the exponential map, R_{k+1} = Exp(u) R_k.
+    /// Each stage carries its rotation matrix, and the control bounds do not depend on the attitude.
+    ExpMap
+};
+
+/**
+ * @brief Returns a printable name for a rotation integrator.
+ */
+inline const char* rotationIntegratorName(RotationIntegrator integrator) {
+    switch (integrator) {
+        case RotationIntegrator::Euler: return "Euler";
+        case RotationIntegrator::ExpMap: return "ExpMap";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief How a generateWaypoints call ended.
+ */
+enum class PlanOutcome {
+    /// The tolerances were met; the last waypoint is the goal.
+    Converged,
+    /// max_iterations ran out; the last waypoint was snapped to the goal.
+    Snapped,
+    /// The time budget ran out; the waypoints end at the last pose reached.
+    TimedOut,
+    /// validate_segments found a motion between waypoints that is not certified collision free (see
+    /// SolverStats::first_unsafe_segment); the waypoints must not be executed as they are.
+    Unsafe
+};
+
+/**
+ * @brief Returns a printable name for a plan outcome.
+ */
+inline const char* planOutcomeName(PlanOutcome outcome) {
+    switch (outcome) {
+        case PlanOutcome::Converged: return "converged";
+        case PlanOutcome::Snapped: return "snapped";
+        case PlanOutcome::TimedOut: return "timed out";
+        case PlanOutcome::Unsafe: return "unsafe";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Result of a continuous collision check of the motion between two waypoints (see PlannerMpc::checkSegment).
+ */
+struct SegmentCheck {
+    /// True if the whole motion keeps segment_clearance from every obstacle.
+    bool collision_free = true;
+    /// Fraction of the motion certified free: where the clearance was lost, or where the step budget ran out.
+    double reached = 1.0;
+    /// Smallest clearance bound at the checked poses, capped at collision_margin.
+    double min_clearance = std::numeric_limits<double>::infinity();
+    /// Number of poses checked.
+    int steps = 0;
+    /// Number of nearest-obstacle queries (kd-tree, voxel map or distance field).
+    long queries = 0;
+};
+
+/**
+ * @brief Statistics of the last generateWaypoints call.
+ */
+struct SolverStats {
+    /// Solver used for the plan.
+    SolverMode mode = SolverMode::Cobyla;
+    /// Number of cost function evaluations.
+    long cost_evaluations = 0;
+    /// Number of receding-horizon iterations.
+    int iterations = 0;
+    /// Wall time of the planning loop in milliseconds.
+    double wall_time_ms = 0.0;
+    /// Position error of the last planned pose before the final waypoint is snapped to the goal.
+    double final_position_error = 0.0;
+    /// Orientation error of the last planned pose before the final waypoint is snapped to the goal.
+    double final_orientation_error = 0.0;
+    /// True if the tolerances were met before max_iterations.
+    bool converged = false;
+    /// Whether the plan converged, was snapped to the goal, ran out of time or failed segment validation.
+    PlanOutcome outcome = PlanOutcome::Snapped;
+    /// True if the plan was seeded from a trajectory library entry.
+    bool warm_started = false;
+    /// Fraction of the MPPI candidates abandoned by the cost bound (see PlannerMpc::mppi_pruning).
+    double pruned_fraction = 0.0;
+    /// Number of waypoint segments checked by PlannerMpc::checkSegment (see PlannerMpc::validate_segments).
+    int segments_checked = 0;
+    /// Number of checked segments not certified free of collision.
+    int unsafe_segments = 0;
+    /// Index i of the first such segment, from waypoint i to waypoint i + 1, or -1.
+    int first_unsafe_segment = -1;
+    /// Nearest-obstacle queries of the segment checks.
+    long segment_queries = 0;
+};
+
 /**
  * @brief PlannerMpc class implementing an NLMPC-style trajectory planner.
  *
@@ -194,6 +484,31 @@ class PlannerMpc {
 public:
     /// Type alias for the isometry using the specified scalar type.
     using IsometryT = Eigen::Transform<Scalar, 3, Eigen::Isometry>;
+    /// Control sequence with the controls of stage k at [ActionDim * k, ActionDim * (k + 1)).
+    using ActionSequence = Eigen::Matrix<Scalar, ActionDim * HorizonDim, 1>;
+    /// States of a rollout, one column per stage from the start state to the terminal state.
+    using StateTrajectory = Eigen::Matrix<Scalar, StateDim, HorizonDim + 1>;
+    /// Poses of a rollout, from the start pose to the terminal pose.
+    using PoseTrajectory = std::array<IsometryT, HorizonDim + 1>;
+    /// Partial derivatives of a stage rotation with respect to its three rotational coordinates.
+    using RotationDerivatives = std::array<Eigen::Matrix<Scalar, 3, 3>, 3>;
+    /// Control sequences of a batch, one per row; column j holds control j of every candidate.
+    using CandidateMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, ActionDim * HorizonDim>;
+    /// Pose of every candidate at every stage: rotation (row-major) and position in columns [12 k, 12 k + 12).
+    using StagePoseArray = Eigen::Array<Scalar, Eigen::Dynamic, 12 * (HorizonDim + 1)>;
+
+    /**
+     * @brief Scratch arrays of costBatch, one row per candidate and one contiguous column per component.
+     */
+    struct BatchWorkspace {
+        /// Stage state (position and Euler angles) of every candidate.
+        Eigen::Array<Scalar, Eigen::Dynamic, StateDim> states;
+        /// Stage rotation of every candidate, element (a, b) in column 3 * a + b; carried between stages by
+        /// RotationIntegrator::ExpMap.
+        Eigen::Array<Scalar, Eigen::Dynamic, 9> rotations;
+        /// Pose of every candidate at every stage (see StagePoseArray).
+        StagePoseArray stage_poses;
+    };
 
     /// Initial pose.
     IsometryT H_0 = IsometryT::Identity();
@@ -214,12 +529,25 @@ public:
 
     /// Tuning parameter to control the saturation rate.
     Scalar alpha_visibility = Scalar(0.2);
+    /// Width (in metres) of the smoothed frustum boundary in visibilityCost; 0 uses the exact point count.
+    Scalar visibility_smoothing = Scalar(0.0);
+    /// Boundary width used instead of a zero visibility_smoothing when nlopt_algorithm needs a gradient, which the
+    /// exact point count does not have (see visibilitySmoothing).
+    Scalar gradient_visibility_smoothing = Scalar(0.01);
     /// Field of view (in degrees) for visibility checking.
     Scalar visibility_fov = Scalar(60.0);
     /// Min plane distances for the visibility frustum.
     Scalar visibility_min_range = Scalar(0.0);
     /// Max plane distance for the visibility frustum.
     Scalar visibility_max_range = Scalar(0.5);
+    /// Frustum count or occlusion-aware count; the smoothed count (visibilitySmoothing() > 0) ignores occlusion.
+    VisibilityBackend visibility_backend = VisibilityBackend::Frustum;
+    /// Count the Frustum backend's points through visibility_octree instead of testing every point.
+    bool use_visibility_octree = true;
+    /// Smallest obstacle cloud counted through the octree; smaller clouds are faster to test point by point.
+    std::size_t visibility_octree_min_points = 4096;
+    /// Voxel size of the occupancy grid used by the Occlusion backend.
+    Scalar occlusion_resolution = Scalar(0.02);
 
     /// Percentage of points that must be visible.
     double min_visible_ratio = 0.5;
@@ -236,12 +564,25 @@ public:
     /// Obstacle avoidance cost weight.
     Scalar w_obs = Scalar(5.0);
 
-    /// Obstacle cloud for avoidance
+    /// Obstacle cloud for avoidance. The structures derived from it (visibility points and octree, occlusion grid,
+    /// distance field) are rebuilt when it is replaced or resized; after editing its points in place, call
+    /// invalidateScene() (and rebuild kd_tree).
     pcl::PointCloud<pcl::PointXYZ>::ConstPtr obstacle_cloud;
 
-    /// End-effector mesh cloud for collision checking.
-    pcl::PointCloud<pcl::PointXYZ>::Ptr ee_mesh_cloud =
-        pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>());
+    /// End-effector mesh cloud for collision checking. It may be shared with a PlannerScene and with copies of the
+    /// planner, so it is replaced rather than edited in place; call syncEndEffectorPoints() after replacing it.
+    pcl::PointCloud<pcl::PointXYZ>::ConstPtr ee_mesh_cloud =
+        pcl::PointCloud<pcl::PointXYZ>::ConstPtr(new pcl::PointCloud<pcl::PointXYZ>());
+
+    /// End-effector mesh points (3 x N) in the end-effector frame, mirrored from ee_mesh_cloud.
+    Eigen::Matrix3Xf ee_mesh_points;
+    /// Bounding-sphere hierarchy over ee_mesh_points, built with them.
+    BoundingSphereTree ee_sphere_tree;
+    /// Skip groups of mesh points whose bounding sphere is clear of obstacles (KdTree and VoxelMap backends).
+    bool use_collision_broadphase = true;
+
+    /// Scratch buffers for meshCollisionCost.
+    CollisionWorkspace collision_workspace;
 
     /// KD-tree for obstacle queries.
     std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> kd_tree;
@@ -249,6 +590,20 @@ public:
     /// Safety margin for collision avoidance.
     Scalar collision_margin = Scalar(0.05);
 
+    /// Backend for nearest-obstacle distance queries in the collision costs.
+    CollisionBackend collision_backend = CollisionBackend::KdTree;
+    /// Grid spacing of the distance field used by the Esdf backend.
+    Scalar esdf_resolution = Scalar(0.01);
+    /// Distance field of obstacle_cloud, clamped at collision_margin.
+    EsdfGrid esdf;
+
+    /// Incrementally updated obstacle map; when set, its points replace obstacle_cloud (see syncObstacleMap).
+    std::shared_ptr<VoxelObstacleMap> obstacle_map;
+    /// Version of obstacle_map the scene structures were last refreshed for.
+    std::uint64_t obstacle_map_version = 0;
+    /// Scratch list of the map slots changed since obstacle_map_version.
+    std::vector<std::uint32_t> obstacle_map_changes;
+
     // Box dimensions for collision checking (min and max in camera/end-effector frame).
     Eigen::Vector4f box_min = Eigen::Vector4f(-0.08, -0.08, -0.08, 1);
     Eigen::Vector4f box_max = Eigen::Vector4f(0.08, 0.08, 0.08, 1);
@@ -264,10 +619,94 @@ public:
     Scalar mppi_lambda   = Scalar(1.0);   // Temperature parameter.
     Scalar noise_std_pos = Scalar(0.01);  // Standard deviation for position noise.
     Scalar noise_std_ori = Scalar(0.05);  // Standard deviation for orientation noise.
+
+    /// Drop MPPI candidates whose partial cost rules out a noticeable weight before their collision and
+    /// visibility queries (see getActionMPPI).
+    bool mppi_pruning = false;
+    /// Pruning margin in units of mppi_lambda: a pruned candidate's weight would have been below exp(-margin).
+    Scalar mppi_prune_margin = Scalar(10.0);
+    /// Running counts of the MPPI candidates sampled and of those pruned.
+    long mppi_candidates = 0;
+    long mppi_pruned     = 0;
+
+    /// Source of the MPPI noise (see MppiNoiseSampler).
+    NoiseEngine noise_engine = NoiseEngine::Philox;
+    /// Scale of the MPPI noise at each horizon step, relative to noise_std_pos and noise_std_ori; steps past its
+    /// end use exp(-k).
+    std::vector<Scalar> noise_schedule;
+    /// Seed for the MPPI noise; equal seeds give identical MPPI results for any thread count, with or without
+    /// use_pose_cache.
+    std::uint64_t mppi_seed = 0;
+    /// Number of getActionMPPI calls since construction, mixed into the noise.
+    std::uint64_t mppi_call_count = 0;
+    /// Number of samples handed to a thread at a time.
+    int mppi_chunk_size = 16;
+    /// Number of threads used to evaluate MPPI samples (0 uses all available cores).
+    int num_threads = 0;
+    /// Per-thread scratch buffers for parallel cost evaluation.
+    std::vector<CollisionWorkspace> thread_workspaces;
+    /// Scratch arrays for costBatch on the calling thread.
+    BatchWorkspace batch_workspace;
+    /// Per-thread scratch arrays for costBatch in getActionMPPI.
+    std::vector<BatchWorkspace> thread_batch_workspaces;
+
+    /// Reuse mesh collision costs and visible point counts of poses within one quantization cell (see PoseCache).
+    /// The cached values are those of the cell's pose, so MPPI results stay independent of the thread count.
+    bool use_pose_cache = false;
+    /// Position cell size of the pose cache in metres.
+    Scalar cache_position_step = Scalar(1e-4);
+    /// Orientation cell size of the pose cache in radians.
+    Scalar cache_orientation_step = Scalar(1e-3);
+    /// Maximum number of entries of each pose cache.
+    std::size_t cache_capacity = 1 << 16;
+    /// Mesh collision costs by quantized pose.
+    PoseCache collision_cache;
+    /// Visible point counts by quantized pose.
+    PoseCache visibility_cache;
+    /// Obstacle cloud the caches were filled with; a different cloud clears them, as does a new cloud allocated at
+    /// the address of a released one.
+    std::weak_ptr<const pcl::PointCloud<pcl::PointXYZ>> pose_cache_cloud;
+    /// Cost parameters the caches were filled with; a change clears them.
+    std::array<double, 12> pose_cache_params{};
     // ********************************
 
+    /// Optimizer used by generateWaypoints.
+    SolverMode solver_mode = SolverMode::Cobyla;
+    /// Integration of the rotational controls in rollout and the cost functions.
+    RotationIntegrator rotation_integrator = RotationIntegrator::Euler;
+    /// NLopt algorithm used by getAction (LN_COBYLA, or a gradient-based LD_SLSQP / LD_LBFGS, which smooth the
+    /// visibility count; see visibilitySmoothing).
+    nlopt::algorithm nlopt_algorithm = nlopt::LN_COBYLA;
+    /// Maximum cost evaluations of a COBYLA solve.
+    int cobyla_max_evaluations = 200;
+    /// Maximum cost evaluations of the COBYLA refinement in SolverMode::MppiCobyla.
+    int hybrid_cobyla_max_evaluations = 50;
+    /// Number of COBYLA solves getAction runs in parallel from different seeds (see cobylaSeeds); each solve
+    /// gets the full evaluation budget and the best result is kept. 1 runs the single warm-started solve.
+    int cobyla_starts = 1;
+    /// Number of getAction calls with several starts since construction, mixed into the perturbed seeds.
+    std::uint64_t cobyla_call_count = 0;
+    /// Final cost of each COBYLA start of the last getAction call.
+    std::vector<Scalar> cobyla_start_costs;
+    /// Wall-clock budget of a generateWaypoints call in milliseconds (0 = unbounded); see PlanOutcome::TimedOut.
+    double time_budget_ms = 0.0;
+    /// Wall-clock budget of one solver step in milliseconds (0 = unbounded); MppiCobyla shares it between both.
+    double step_time_budget_ms = 0.0;
+    /// Deadline of the running generateWaypoints call; time_point::max() when unbounded.
+    std::chrono::steady_clock::time_point call_deadline = std::chrono::steady_clock::time_point::max();
+    /// Running count of cost evaluations made by getAction and getActionMPPI.
+    long cost_evaluations = 0;
+    /// Statistics of the last generateWaypoints call.
+    SolverStats stats;
+    /// Per-phase timings, counters and trace of the planning calls (disabled by default).
+    PlannerProfiler profiler;
+
     /// Maintained control sequence for warm-starting (size: ActionDim * HorizonDim).
     std::vector<Scalar> U;
+    /// Solved queries that seed U for similar ones (see TrajectoryLibrary); shared by the copies of the planner.
+    std::shared_ptr<TrajectoryLibrary> trajectory_library;
+    /// How generateWaypoints uses trajectory_library.
+    WarmStartMode warm_start = WarmStartMode::Chain;
 
     /// Convergence criteria for waypoint generation: position tolerance (1 cm).
     double position_tolerance = 1e-2;
@@ -279,9 +718,29 @@ public:
     double fusion_position_tolerance    = 1e-2;
     double fusion_orientation_tolerance = 0.1;
 
+    /// Check the motion between consecutive returned waypoints for collisions (see checkSegment).
+    bool validate_segments = true;
+    /// Clearance the end-effector mesh must keep from every obstacle along a checked segment.
+    Scalar segment_clearance = Scalar(0.005);
+    /// Maximum number of poses checked per segment; a segment that needs more is not certified.
+    int segment_max_steps = 64;
+
     pcl::PointCloud<pcl::PointXYZ>::Ptr collision_debug_cloud =
         pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>());
 
+    /// Structure-of-arrays copy of obstacle_cloud for counting visible points.
+    FrustumPointsSoA visibility_points;
+    /// Octree over obstacle_cloud for counting visible points hierarchically.
+    FrustumOctree visibility_octree;
+    /// Occupancy grid of obstacle_cloud for the Occlusion visibility backend.
+    OcclusionGrid occlusion_grid;
+
+    /// Shared read-only scene (see setScene); when set, its structures replace esdf, visibility_points,
+    /// visibility_octree and occlusion_grid, and prepareScene() builds nothing.
+    std::shared_ptr<const PlannerScene> scene;
+    /// Statistics of each query of the last generateWaypointsBatch call.
+    std::vector<SolverStats> batch_stats;
+
     /**
      * @brief Default constructor.
      */
@@ -309,237 +768,1792 @@ public:
     /**
      * @brief Rollouts the trajectory using the given control sequence.
      *
-     * Converts a std::vector<Scalar> control sequence (length = ActionDim * HorizonDim)
-     * into a dynamic Eigen representation and integrates the trajectory starting
-     * from H_0. Each state is represented as an Eigen::Matrix<Scalar, StateDim, 1>.
+     * Views a std::vector<Scalar> control sequence (length = ActionDim * HorizonDim)
+     * as an ActionSequence and integrates the trajectory starting from H_0. Each
+     * state is represented as an Eigen::Matrix<Scalar, StateDim, 1>.
      *
      * @param U_in The control sequence.
      * @return A vector of state vectors representing the trajectory.
      */
-    std::vector<Eigen::Matrix<Scalar, StateDim, 1>> rollout(const std::vector<Scalar>& U_in) {
+    std::vector<Eigen::Matrix<Scalar, StateDim, 1>> rollout(const std::vector<Scalar>& U_in) const {
+        StateTrajectory states;
+        rollout(Eigen::Map<const ActionSequence>(U_in.data()), states);
         std::vector<Eigen::Matrix<Scalar, StateDim, 1>> trajectory(HorizonDim + 1);
+        for (int k = 0; k <= HorizonDim; ++k) {
+            trajectory[k] = states.col(k);
+        }
+        return trajectory;
+    }
 
-        // Convert U_in into an Eigen matrix (ActionDim x HorizonDim)
-        Eigen::Matrix<Scalar, ActionDim, HorizonDim> U_mat;
-        for (int k = 0; k < HorizonDim; ++k) {
-            for (int i = 0; i < ActionDim; ++i) {
-                U_mat(i, k) = U_in[ActionDim * k + i];
+    /**
+     * @brief Rollouts the trajectory into a caller-provided fixed-size matrix, without allocating.
+     *
+     * @param U_in       The control sequence.
+     * @param trajectory Output states, column k is the state after k controls.
+     */
+    void rollout(const Eigen::Ref<const ActionSequence>& U_in, StateTrajectory& trajectory) const {
+        if (rotation_integrator == RotationIntegrator::ExpMap) {
+            // The states carry the Euler angles of the integrated rotations.
+            PoseTrajectory poses;
+            rolloutPoses(U_in, poses);
+            for (int k = 0; k <= HorizonDim; ++k) {
+                trajectory.col(k) << poses[k].translation(), mat_to_rpy_intrinsic(poses[k].linear());
             }
+            return;
         }
         // Simple integrator: next state = current state + control.
-        trajectory[0] << H_0.translation(), mat_to_rpy_intrinsic(H_0.rotation());
+        trajectory.col(0) << H_0.translation(), mat_to_rpy_intrinsic(H_0.linear());
         for (int k = 0; k < HorizonDim; ++k) {
-            trajectory[k + 1] = trajectory[k] + U_mat.col(k);
+            trajectory.col(k + 1) = trajectory.col(k) + U_in.template segment<ActionDim>(ActionDim * k);
         }
-        return trajectory;
     }
 
     /**
-     * @brief Computes the obstacle cost based on the distance from a query pose.
-     *
-     * The translation component of the pose is used to query the obstacle kd-tree.
+     * @brief Rollouts the poses of each stage of a std::vector<Scalar> control sequence.
      *
-     * @param pose The pose (as an isometry) at which to evaluate the obstacle cost.
-     * @return The computed obstacle cost.
+     * @param U_in The control sequence.
+     * @return The pose after k controls for k = 0 ... HorizonDim.
      */
-    Scalar obstacleCost(const IsometryT& pose) {
-        if (kd_tree && kd_tree->getInputCloud() && !kd_tree->getInputCloud()->points.empty()) {
-            pcl::PointXYZ query_pt;
-            Eigen::Matrix<Scalar, 3, 1> p = pose.translation();
-            query_pt.x                    = static_cast<float>(p(0));
-            query_pt.y                    = static_cast<float>(p(1));
-            query_pt.z                    = static_cast<float>(p(2));
-            std::vector<int> nn_index(1);
-            std::vector<float> nn_dist2(1);
-            int found = kd_tree->nearestKSearch(query_pt, 1, nn_index, nn_dist2);
-            if (found > 0) {
-                Scalar nearest_dist = std::sqrt(nn_dist2[0]);
-                if (nearest_dist < collision_margin) {
-                    Scalar diff = (Scalar(1.0) / nearest_dist) - (Scalar(1.0) / collision_margin);
-                    return Scalar(0.5) * w_obs * diff * diff;
-                }
-            }
-        }
-        return Scalar(0.0);
+    PoseTrajectory rolloutPoses(const std::vector<Scalar>& U_in) const {
+        PoseTrajectory poses;
+        rolloutPoses(Eigen::Map<const ActionSequence>(U_in.data()), poses);
+        return poses;
     }
 
     /**
-     * @brief Computes a detailed collision cost using the stored end-effector mesh.
+     * @brief Rollouts the poses of each stage with the selected rotation_integrator, without allocating.
      *
-     * Each point of the mesh is transformed into the world frame using the given pose.
+     * With RotationIntegrator::Euler the poses are those of the rollout states; with RotationIntegrator::ExpMap the
+     * positions are integrated additively and each rotation is the previous one times an exponential-map increment.
      *
-     * @param pose The current end-effector pose in world coordinates.
-     * @return A scalar cost representing the collision penalty.
+     * @param U_in  The control sequence.
+     * @param poses Output poses, element k is the pose after k controls.
      */
-    Scalar meshCollisionCost(const IsometryT& pose) {
-        Scalar total_cost = 0;
-        pcl::PointXYZ query_pt;
-
-        // Ensure we have a valid mesh cloud.
-        if (!ee_mesh_cloud || ee_mesh_cloud->empty())
-            return total_cost;
-
-        // For each point on the end-effector mesh...
-        for (const auto& pt : ee_mesh_cloud->points) {
-            // Transform the point into the world frame.
-            Eigen::Vector3f pt_vec(pt.x, pt.y, pt.z);
-            Eigen::Vector3f transformed_pt =
-                pose.rotation().template cast<float>() * pt_vec + pose.translation().template cast<float>();
-
-            query_pt.x = transformed_pt(0);
-            query_pt.y = transformed_pt(1);
-            query_pt.z = transformed_pt(2);
-
-            // Query the obstacle kd-tree for the nearest neighbor.
-            std::vector<int> nn_index(1);
-            std::vector<float> nn_dist2(1);
-            int found = kd_tree->nearestKSearch(query_pt, 1, nn_index, nn_dist2);
-            if (found > 0) {
-                Scalar nearest_dist = std::sqrt(nn_dist2[0]);
-                if (nearest_dist < collision_margin) {
-                    Scalar cost = (Scalar(1) / (2 * collision_margin)) * (nearest_dist - collision_margin)
-                                  * (nearest_dist - collision_margin);
-                    total_cost += w_obs * cost;
-                }
+    void rolloutPoses(const Eigen::Ref<const ActionSequence>& U_in, PoseTrajectory& poses) const {
+        if (rotation_integrator == RotationIntegrator::Euler) {
+            StateTrajectory trajectory;
+            rollout(U_in, trajectory);
+            for (int k = 0; k <= HorizonDim; ++k) {
+                poses[k] = stateToIsometry<Scalar>(trajectory.col(k).template head<3>(),
+                                                   trajectory.col(k).template tail<3>());
             }
+            return;
+        }
+        static_assert(ActionDim >= 6, "The exponential-map integrator needs 3 position and 3 rotation controls.");
+        poses[0]               = IsometryT::Identity();
+        poses[0].linear()      = H_0.linear();
+        poses[0].translation() = H_0.translation();
+        for (int k = 0; k < HorizonDim; ++k) {
+            const auto u               = U_in.template segment<ActionDim>(ActionDim * k);
+            poses[k + 1]               = IsometryT::Identity();
+            poses[k + 1].linear()      = so3Exp<Scalar>(u.template segment<3>(3)) * poses[k].linear();
+            poses[k + 1].translation() = poses[k].translation() + u.template head<3>();
         }
-        return total_cost;
     }
 
     /**
-     * @brief Returns a collision cost if any obstacle points lie in a
-     *        bounding box around the camera/end-effector.
-     *
-     * @param pose Current camera/end-effector pose in the world frame.
-     * @return Collision cost (0 if empty, >0 if some points found).
+     * @brief (Re)builds the distance field of obstacle_cloud used by the Esdf collision backend.
      */
-    Scalar boxCollisionCost(const IsometryT& pose) {
-        // Count the number of points inside the box.
-        std::size_t count = getPointsInBox<Scalar>(obstacle_cloud, pose, box_min, box_max);
-        Scalar n_points   = static_cast<Scalar>(count);
-
-        // Simple linear penalty based on the number of points.
-        Scalar cost = w_obs * n_points;
-        return cost;
+    void buildEsdf() {
+        esdf.build(obstacle_cloud, static_cast<float>(esdf_resolution), static_cast<float>(collision_margin));
     }
 
-    Scalar poseCost(const IsometryT& pose, Scalar wp, Scalar wq) {
-        // 1) Pose cost
-        auto e           = homogeneousError(pose, H_goal);
-        Scalar cost_pose = wp * e.head(3).squaredNorm() + wq * e.tail(3).squaredNorm();
+    /**
+     * @brief True inside an active OpenMP parallel region, where the scene structures are only read (see
+     *        prepareScene).
+     */
+    static bool inParallelRegion() {
+#ifdef _OPENMP
+        return omp_in_parallel();
+#else
+        return false;
+#endif
+    }
 
-        // 2) Look at goal cost: angle between the camera's +Z axis and (look_at_goal - cameraPos)
+    /**
+     * @brief Reports a scene structure that is stale inside a parallel region, where it cannot be rebuilt; reading it
+     *        as it is would give wrong costs without any sign. getAction, getActionMPPI and generateWaypointsBatch
+     *        prepare the scene before their parallel regions, so this only fires for callers that evaluate the
+     *        costs from their own threads without calling prepareScene() first.
+     *
+     * @param structure Name of the structure, for the message.
+     */
+    static void staleInParallelRegion(const char* structure) {
+        std::cerr << "[PlannerMpc] " << structure << " is stale inside a parallel region; call prepareScene() first.\n";
+        assert(false && "scene structure read inside a parallel region before prepareScene()");
+    }
 
-        Eigen::Vector3d look_at_goal =
-            H_goal.translation() + H_goal.rotation() * Eigen::Vector3d(0, 0, look_at_goal_distance);
-        Scalar cost_rot                      = Scalar(0);
-        Eigen::Matrix<Scalar, 3, 1> camera_z = pose.linear().col(2);
-        // Typically this is already unit-length if pose is orthonormal.
+    /**
+     * @brief Reports a structure of the bound scene that does not match this planner's cloud, backends or parameters,
+     *        e.g. after switching to a backend the scene was not shared with, or after the obstacle map changed.
+     *        The scene is read-only, so the structure cannot be rebuilt; unbind it with setScene(nullptr) first.
+     *
+     * @param structure Name of the structure, for the message.
+     */
+    static void staleInScene(const char* structure) {
+        std::cerr << "[PlannerMpc] " << structure << " of the bound scene does not match the planner; unbind the "
+                  << "scene with setScene(nullptr) before changing the obstacles, backends or their parameters.\n";
+        assert(false && "scene structure does not match the planner");
+    }
 
-        // Vector pointing from camera to look_at_goal
-        Eigen::Matrix<Scalar, 3, 1> dir = look_at_goal - pose.translation();
-        Scalar dist                     = dir.norm();
-        if (dist > Scalar(1e-8)) {
-            dir /= dist;  // normalize
-            // Dot product (clamp to [-1,1] for acos)
-            Scalar c = camera_z.dot(dir);
-            if (c > Scalar(1))
-                c = Scalar(1);
-            if (c < Scalar(-1))
-                c = Scalar(-1);
+    /// True if obstacle_cloud has points for the visibility structures to be built from.
+    bool hasObstaclePoints() const {
+        return obstacle_cloud && !obstacle_cloud->points.empty();
+    }
 
-            Scalar angle = std::acos(c);
-            cost_rot     = w_look_at_goal * angle * angle;
+    /**
+     * @brief Distance field of the Esdf backend: the bound scene's, or this planner's, built on first use outside a
+     *        parallel region.
+     */
+    const EsdfGrid& esdfGrid() {
+        const float resolution = static_cast<float>(esdf_resolution);
+        const float bound      = static_cast<float>(collision_margin);
+        if (scene) {
+            if (obstacle_cloud && !scene->esdf.isBuiltFrom(obstacle_cloud, resolution, bound))
+                staleInScene("The distance field");
+            return scene->esdf;
         }
-
-        return cost_pose + cost_rot;
+        if (!esdf.isBuiltFrom(obstacle_cloud, resolution, bound)) {
+            if (!inParallelRegion())
+                buildEsdf();
+            else if (obstacle_cloud)
+                staleInParallelRegion("The distance field");
+        }
+        return esdf;
     }
 
-    Scalar visibilityCost(const IsometryT& pose) {
-        // If no visibility cloud is provided, or it's empty, no visibility constraint can be enforced.
-        if (!obstacle_cloud || obstacle_cloud->points.empty()) {
-            return Scalar(0.0);
+    /**
+     * @brief Visibility points of the Frustum backend: the bound scene's, or this planner's, copied on first use
+     *        outside a parallel region.
+     */
+    const FrustumPointsSoA& visibilityPoints() {
+        if (scene) {
+            if (hasObstaclePoints() && !scene->visibility_points.isBuiltFrom(obstacle_cloud))
+                staleInScene("The visibility point buffer");
+            return scene->visibility_points;
+        }
+        if (!visibility_points.isBuiltFrom(obstacle_cloud)) {
+            if (!inParallelRegion())
+                visibility_points.setInputCloud(obstacle_cloud);
+            else if (hasObstaclePoints())
+                staleInParallelRegion("The visibility point buffer");
         }
+        return visibility_points;
+    }
 
-        // Count how many points are in the camera frustum.
-        std::size_t visible =
-            getFrustrumCloud(obstacle_cloud, visibility_fov, visibility_min_range, visibility_max_range, pose)->size();
+    /**
+     * @brief Visibility octree of the Frustum backend: the bound scene's, or this planner's, built on first use
+     *        outside a parallel region.
+     */
+    const FrustumOctree& visibilityOctree() {
+        if (scene) {
+            if (hasObstaclePoints() && !scene->visibility_octree.isBuiltFrom(obstacle_cloud))
+                staleInScene("The visibility octree");
+            return scene->visibility_octree;
+        }
+        if (!visibility_octree.isBuiltFrom(obstacle_cloud)) {
+            if (!inParallelRegion())
+                visibility_octree.setInputCloud(obstacle_cloud);
+            else if (hasObstaclePoints())
+                staleInParallelRegion("The visibility octree");
+        }
+        return visibility_octree;
+    }
 
-        // Convert to Scalar for safety in math:
-        Scalar v = static_cast<Scalar>(visible);
+    /**
+     * @brief True if the Frustum backend counts obstacle_cloud through visibility_octree.
+     *
+     * The points of obstacle_map are always tested one by one: the octree would be rebuilt after every map update,
+     * while the visibility points are updated from the changed slots only.
+     */
+    bool countsThroughOctree() const {
+        return use_visibility_octree && !obstacle_map && obstacle_cloud
+               && obstacle_cloud->points.size() >= visibility_octree_min_points;
+    }
 
-        // Soft constraint: if v is below min_visible_points, apply an exponential penalty.
-        // The tuning parameter 'alpha' determines how steep the cost grows.
-        Scalar delta = min_visible_points - v;
-        if (delta > 0) {
-            return std::exp(alpha_visibility * delta) - 1.0;
+    /**
+     * @brief Occupancy grid of the Occlusion backend: the bound scene's, or this planner's, built on first use
+     *        outside a parallel region.
+     */
+    const OcclusionGrid& occlusionGrid() {
+        if (scene) {
+            if (hasObstaclePoints()
+                && !scene->occlusion_grid.isBuiltFrom(obstacle_cloud, static_cast<float>(occlusion_resolution)))
+                staleInScene("The occlusion grid");
+            return scene->occlusion_grid;
         }
-        else {
-            return 0.0;
+        if (!occlusion_grid.isBuiltFrom(obstacle_cloud, static_cast<float>(occlusion_resolution))) {
+            if (!inParallelRegion())
+                occlusion_grid.build(obstacle_cloud, static_cast<float>(occlusion_resolution));
+            else if (hasObstaclePoints())
+                staleInParallelRegion("The occlusion grid");
         }
+        return occlusion_grid;
     }
 
     /**
-     * @brief Computes the total cost along the trajectory induced by the control sequence.
+     * @brief Distance from a point to the nearest obstacle using the selected collision backend.
      *
-     * This function assumes that the trajectory is represented as a vector of state vectors,
-     * where each state encodes position and orientation (in Euler angles). Each state is first
-     * converted to an isometry using stateToIsometry before being passed to the cost functions.
+     * With the Esdf backend the distance saturates at collision_margin, where all collision costs vanish.
      *
-     * @param x    The control sequence.
-     * @param grad The gradient of the cost (if required).
-     * @return The total cost.
+     * @param p The query point in world coordinates.
+     * @return The nearest obstacle distance, or infinity if there are no obstacles.
      */
-    Scalar cost(const std::vector<Scalar>& x, std::vector<Scalar>& grad) {
-        auto traj         = rollout(x);
-        Scalar total_cost = 0;
-        for (int k = 0; k <= HorizonDim; ++k) {
-            // Convert the k-th state (position and Euler angles) into an isometry.
-            IsometryT pose         = stateToIsometry<Scalar>(traj[k].template head<3>(), traj[k].template tail<3>());
-            double mesh_cost       = meshCollisionCost(pose);
-            double pose_cost       = poseCost(pose, w_p, w_q);
-            double visibility_cost = visibilityCost(pose);
-            total_cost += pose_cost + mesh_cost + visibility_cost;
+    Scalar obstacleDistance(const Eigen::Vector3f& p) {
+        if (collision_backend == CollisionBackend::Esdf) {
+            const EsdfGrid& grid = esdfGrid();
+            if (!grid.empty()) {
+                return static_cast<Scalar>(grid.distance(p));
+            }
         }
-        // Terminal cost
-        IsometryT pose_N =
-            stateToIsometry<Scalar>(traj[HorizonDim].template head<3>(), traj[HorizonDim].template tail<3>());
-        total_cost += poseCost(pose_N, w_p_term, w_q_term);
-        return total_cost;
+        else if (collision_backend == CollisionBackend::VoxelMap) {
+            if (obstacle_map) {
+                return static_cast<Scalar>(obstacle_map->nearestDistance(p, static_cast<float>(collision_margin)));
+            }
+        }
+        else if (kd_tree && kd_tree->getInputCloud() && !kd_tree->getInputCloud()->points.empty()) {
+            pcl::PointXYZ query_pt;
+            query_pt.x = p(0);
+            query_pt.y = p(1);
+            query_pt.z = p(2);
+            std::vector<int> nn_index(1);
+            std::vector<float> nn_dist2(1);
+            int found = kd_tree->nearestKSearch(query_pt, 1, nn_index, nn_dist2);
+            if (found > 0) {
+                return std::sqrt(static_cast<Scalar>(nn_dist2[0]));
+            }
+        }
+        return std::numeric_limits<Scalar>::infinity();
     }
 
     /**
-     * @brief Static cost wrapper for NLopt callback.
+     * @brief Nearest obstacle distances for a batch of points using the selected collision backend.
      *
-     * @param x The control sequence.
-     * @param grad The gradient of the cost.
-     * @param data Pointer to the PlannerMpc instance.
-     * @return The cost computed by the PlannerMpc instance.
+     * @param points    Query points in world coordinates (3 x N).
+     * @param workspace Scratch buffers; workspace.distances receives the N distances.
      */
-    static Scalar costWrapper(const std::vector<Scalar>& x, std::vector<Scalar>& grad, void* data) {
-        PlannerMpc* planner_ptr = reinterpret_cast<PlannerMpc*>(data);
-        return planner_ptr->cost(x, grad);
+    void obstacleDistances(const Eigen::Matrix3Xf& points, CollisionWorkspace& workspace) {
+        const Eigen::Index n = points.cols();
+        if (workspace.distances.size() != n) {
+            workspace.distances.resize(n);
+        }
+        if (collision_backend == CollisionBackend::Esdf) {
+            const EsdfGrid& grid = esdfGrid();
+            if (!grid.empty()) {
+                grid.distances(points, workspace.distances);
+                workspace.counters.esdf_queries += n;
+                return;
+            }
+        }
+        else if (collision_backend == CollisionBackend::VoxelMap) {
+            if (obstacle_map) {
+                const float radius = static_cast<float>(collision_margin);
+                for (Eigen::Index i = 0; i < n; ++i) {
+                    workspace.distances(i) = obstacle_map->nearestDistance(points.col(i), radius);
+                }
+                workspace.counters.nn_queries += n;
+                return;
+            }
+        }
+        else if (kd_tree && kd_tree->getInputCloud() && !kd_tree->getInputCloud()->points.empty()) {
+            pcl::PointXYZ query_pt;
+            for (Eigen::Index i = 0; i < n; ++i) {
+                query_pt.x = points(0, i);
+                query_pt.y = points(1, i);
+                query_pt.z = points(2, i);
+                int found  = kd_tree->nearestKSearch(query_pt, 1, workspace.nn_index, workspace.nn_dist2);
+                workspace.distances(i) =
+                    found > 0 ? std::sqrt(workspace.nn_dist2[0]) : std::numeric_limits<float>::infinity();
+            }
+            workspace.counters.nn_queries += n;
+            return;
+        }
+        workspace.distances.setConstant(std::numeric_limits<float>::infinity());
     }
 
     /**
-     * @brief Solves the MPC problem using NLopt and returns the optimized control
-     * sequence.
+     * @brief Computes the obstacle cost based on the distance from a query pose.
      *
-     * @param H0_in The initial pose.
-     * @return The optimized control sequence.
+     * The translation component of the pose is used to query the obstacle distance.
+     *
+     * @param pose The pose (as an isometry) at which to evaluate the obstacle cost.
+     * @return The computed obstacle cost.
+     */
+    Scalar obstacleCost(const IsometryT& pose) {
+        Scalar nearest_dist = obstacleDistance(pose.translation().template cast<float>());
+        if (nearest_dist < collision_margin) {
+            Scalar diff = (Scalar(1.0) / nearest_dist) - (Scalar(1.0) / collision_margin);
+            return Scalar(0.5) * w_obs * diff * diff;
+        }
+        return Scalar(0.0);
+    }
+
+    /**
+     * @brief Copies ee_mesh_cloud into the 3 x N ee_mesh_points matrix used by the batched collision query.
+     */
+    void syncEndEffectorPoints() {
+        const Eigen::Index n = ee_mesh_cloud ? static_cast<Eigen::Index>(ee_mesh_cloud->points.size()) : 0;
+        ee_mesh_points.resize(3, n);
+        for (Eigen::Index i = 0; i < n; ++i) {
+            const auto& pt = ee_mesh_cloud->points[i];
+            ee_mesh_points.col(i) << pt.x, pt.y, pt.z;
+        }
+        ee_sphere_tree.build(ee_mesh_points);
+    }
+
+    /**
+     * @brief Computes a detailed collision cost using the stored end-effector mesh.
+     *
+     * The bounding-sphere broadphase skips the parts of the mesh that are clear of obstacles; otherwise the whole
+     * mesh is transformed into the world frame with one 3 x N matrix product into the workspace, and the nearest
+     * obstacle distances are then queried as one batch.
+     *
+     * @param pose The current end-effector pose in world coordinates.
+     * @return A scalar cost representing the collision penalty.
+     */
+    Scalar meshCollisionCost(const IsometryT& pose) {
+        return meshCollisionCost(pose, collision_workspace);
+    }
+
+    /**
+     * @brief Computes the mesh collision cost using caller-provided scratch buffers.
+     *
+     * @param pose      The current end-effector pose in world coordinates.
+     * @param workspace Scratch buffers for the transformed points and distances.
+     * @return A scalar cost representing the collision penalty.
+     */
+    Scalar meshCollisionCost(const IsometryT& pose, CollisionWorkspace& workspace) {
+        // Ensure we have a valid mesh cloud.
+        if (!ee_mesh_cloud || ee_mesh_cloud->empty())
+            return Scalar(0);
+        if (ee_mesh_points.cols() != static_cast<Eigen::Index>(ee_mesh_cloud->points.size()))
+            syncEndEffectorPoints();
+        return meshCollisionCost(pose.linear().template cast<float>(), pose.translation().template cast<float>(),
+                                 workspace);
+    }
+
+    /**
+     * @brief Mesh collision cost of the synced end-effector points (ee_mesh_points) under a rigid transform.
+     *
+     * With use_collision_broadphase the KdTree and VoxelMap backends only query the points near an obstacle (see
+     * sphereTreeDistances). The Esdf backend always looks up every point: its field is clamped at collision_margin
+     * and cannot certify the larger clearance a sphere needs, and its lookups are O(1) anyway.
+     *
+     * @param R         The end-effector rotation.
+     * @param t         The end-effector position.
+     * @param workspace Scratch buffers for the transformed points and distances.
+     * @return A scalar cost representing the collision penalty.
+     */
+    Scalar meshCollisionCost(const Eigen::Matrix3f& R, const Eigen::Vector3f& t, CollisionWorkspace& workspace) {
+        Scalar total_cost = 0;
+
+        if (workspace.points_world.cols() != ee_mesh_points.cols())
+            workspace.points_world.resize(3, ee_mesh_points.cols());
+        if (use_collision_broadphase && collision_backend != CollisionBackend::Esdf
+            && ee_sphere_tree.size() == ee_mesh_points.cols() && !ee_sphere_tree.empty()) {
+            sphereTreeDistances(R, t, workspace);
+        }
+        else {
+            // Transform all mesh points into the world frame and query their distances as one batch.
+            workspace.points_world.noalias() = R * ee_mesh_points;
+            workspace.points_world.colwise() += t;
+            obstacleDistances(workspace.points_world, workspace);
+        }
+        for (Eigen::Index i = 0; i < workspace.distances.size(); ++i) {
+            Scalar nearest_dist = workspace.distances(i);
+            if (nearest_dist < collision_margin) {
+                Scalar cost = (Scalar(1) / (2 * collision_margin)) * (nearest_dist - collision_margin)
+                              * (nearest_dist - collision_margin);
+                total_cost += w_obs * cost;
+            }
+        }
+        return total_cost;
+    }
+
+    /**
+     * @brief Nearest obstacle distance of one point for the KdTree and VoxelMap backends.
+     *
+     * @param p         The query point in world coordinates.
+     * @param radius    Search radius of the VoxelMap backend; the kd-tree search is exact at any distance.
+     * @param workspace Scratch buffers for the kd-tree query.
+     * @return The distance, or infinity if no obstacle lies within the search.
+     */
+    float boundedObstacleDistance(const Eigen::Vector3f& p, float radius, CollisionWorkspace& workspace) {
+        if (collision_backend == CollisionBackend::VoxelMap) {
+            if (!obstacle_map)
+                return std::numeric_limits<float>::infinity();
+            ++workspace.counters.nn_queries;
+            return obstacle_map->nearestDistance(p, radius);
+        }
+        if (!kd_tree || !kd_tree->getInputCloud() || kd_tree->getInputCloud()->points.empty())
+            return std::numeric_limits<float>::infinity();
+        pcl::PointXYZ query_pt;
+        query_pt.x = p(0);
+        query_pt.y = p(1);
+        query_pt.z = p(2);
+        ++workspace.counters.nn_queries;
+        const int found = kd_tree->nearestKSearch(query_pt, 1, workspace.nn_index, workspace.nn_dist2);
+        return found > 0 ? std::sqrt(workspace.nn_dist2[0]) : std::numeric_limits<float>::infinity();
+    }
+
+    /**
+     * @brief Nearest obstacle distances of the end-effector points, descending ee_sphere_tree from the root.
+     *
+     * A node whose centre is at least collision_margin plus its radius from every obstacle only holds points with
+     * zero collision cost: its subtree is skipped, and its points keep distance infinity and a stale world
+     * position in the workspace. Only the points of leaves near an obstacle are transformed and queried, so a tool
+     * in free space costs one query. The distances below collision_margin equal those of obstacleDistances.
+     *
+     * @param R         The end-effector rotation.
+     * @param t         The end-effector position.
+     * @param workspace Scratch buffers; receives the world points and distances of the queried mesh points.
+     */
+    void sphereTreeDistances(const Eigen::Matrix3f& R, const Eigen::Vector3f& t, CollisionWorkspace& workspace) {
+        const auto& nodes  = ee_sphere_tree.nodes();
+        const auto& index  = ee_sphere_tree.index();
+        const float margin = static_cast<float>(collision_margin);
+        auto& stack        = workspace.node_stack;
+        if (workspace.distances.size() != ee_mesh_points.cols())
+            workspace.distances.resize(ee_mesh_points.cols());
+        workspace.distances.setConstant(std::numeric_limits<float>::infinity());
+        // The stack never holds more entries than there are nodes, so it allocates at most once.
+        stack.reserve(nodes.size());
+        stack.assign(1, 0);
+        while (!stack.empty()) {
+            const int id = stack.back();
+            stack.pop_back();
+            const BoundingSphereTree::Node& node = nodes[id];
+            const float reach                    = margin + node.radius;
+            if (boundedObstacleDistance(R * node.center + t, reach, workspace) >= reach)
+                continue;
+            if (node.right >= 0) {
+                stack.push_back(node.right);
+                stack.push_back(id + 1);
+                continue;
+            }
+            for (int j = node.begin; j < node.end; ++j) {
+                const int i                   = index[j];
+                const Eigen::Vector3f p       = R * ee_sphere_tree.points().col(j) + t;
+                workspace.points_world.col(i) = p;
+                workspace.distances(i)        = boundedObstacleDistance(p, margin, workspace);
+            }
+        }
+    }
+
+    /**
+     * @brief Lower bound of the clearance between the end-effector mesh and the obstacles, capped at
+     *        collision_margin.
+     *
+     * Descends ee_sphere_tree like sphereTreeDistances, but a node whose centre is d from the nearest obstacle
+     * bounds the clearance of all its points by d - radius, and once that bound reaches accept the node is not
+     * refined. Only the parts of the mesh closer than accept to an obstacle are queried point by point, so a tool
+     * in free space costs one query. Trilinear interpolation of the Esdf field can overestimate the distance by up
+     * to half a cell diagonal, so that much is taken off its values; its clamp at collision_margin stays a bound.
+     *
+     * @param R         The end-effector rotation.
+     * @param t         The end-effector position.
+     * @param accept    Clearance at which a sphere bound is good enough.
+     * @param workspace Scratch buffers for the queries.
+     * @return The clearance bound.
+     */
+    float toolClearance(const Eigen::Matrix3f& R,
+                        const Eigen::Vector3f& t,
+                        float accept,
+                        CollisionWorkspace& workspace) {
+        const float margin = static_cast<float>(collision_margin);
+        // Distance of a point to the nearest obstacle, capped at the search radius.
+        auto clearance = [&](const Eigen::Vector3f& p, float radius) {
+            if (collision_backend == CollisionBackend::Esdf) {
+                const EsdfGrid& grid = esdfGrid();
+                if (grid.empty())
+                    return radius;
+                ++workspace.counters.esdf_queries;
+                // The node distances are exact; in between, the interpolated value exceeds the true one by at most
+                // the distance to the cell's corners, which is largest at its centre.
+                const float interpolation_error = 0.5f * std::sqrt(3.0f) * grid.resolution();
+                return std::min(grid.distance(p) - interpolation_error, radius);
+            }
+            return std::min(boundedObstacleDistance(p, radius, workspace), radius);
+        };
+
+        float best = margin;
+        if (ee_sphere_tree.empty() || ee_sphere_tree.size() != ee_mesh_points.cols()) {
+            if (ee_mesh_points.cols() == 0)
+                return clearance(t, margin);
+            for (Eigen::Index j = 0; j < ee_mesh_points.cols(); ++j) {
+                best = std::min(best, clearance(R * ee_mesh_points.col(j) + t, best));
+            }
+            return best;
+        }
+        const auto& nodes = ee_sphere_tree.nodes();
+        auto& stack       = workspace.node_stack;
+        stack.reserve(nodes.size());
+        stack.assign(1, 0);
+        while (!stack.empty()) {
+            const int id = stack.back();
+            stack.pop_back();
+            const BoundingSphereTree::Node& node = nodes[id];
+            // A centre at least best + radius away cannot lower the bound.
+            const float bound = clearance(R * node.center + t, best + node.radius) - node.radius;
+            if (bound >= best)
+                continue;
+            if (bound >= accept) {
+                best = bound;
+                continue;
+            }
+            if (node.right >= 0) {
+                stack.push_back(node.right);
+                stack.push_back(id + 1);
+                continue;
+            }
+            for (int j = node.begin; j < node.end; ++j) {
+                best = std::min(best, clearance(R * ee_sphere_tree.points().col(j) + t, best));
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Continuous collision check of the end-effector motion between two poses by conservative advancement.
+     *
+     * The motion moves the position linearly and the rotation along the geodesic, so over the whole segment no
+     * mesh point travels farther than |dt| + theta * r_max, with r_max the largest distance of a mesh point from
+     * the end-effector origin. A clearance bound c at one pose (toolClearance) therefore keeps every point at least
+     * segment_clearance from the obstacles for the next (c - segment_clearance) / (|dt| + theta * r_max) of the
+     * segment, and the check jumps there instead of sampling the segment densely: far from obstacles a segment
+     * costs one or two poses, and the steps only shorten where the mesh comes close. A segment that needs more than
+     * segment_max_steps poses is reported as not collision free.
+     *
+     * @param from      The start pose of the motion.
+     * @param to        The end pose of the motion.
+     * @param workspace Scratch buffers for the queries.
+     * @return Whether the motion is collision free, and how far it was certified.
+     */
+    SegmentCheck checkSegment(const IsometryT& from, const IsometryT& to, CollisionWorkspace& workspace) {
+        SegmentCheck result;
+        const Eigen::Matrix3f R0 = from.linear().template cast<float>();
+        const Eigen::Vector3f t0 = from.translation().template cast<float>();
+        const Eigen::Vector3f dt = (to.translation() - from.translation()).template cast<float>();
+        const Eigen::AngleAxis<Scalar> turn(from.linear().transpose() * to.linear());
+        const Eigen::Vector3f axis = turn.axis().template cast<float>();
+        const float angle          = static_cast<float>(turn.angle());
+        const float r_max          = ee_mesh_points.cols() > 0 ? ee_mesh_points.colwise().norm().maxCoeff() : 0.0f;
+        const float motion         = dt.norm() + angle * r_max;
+        const float clearance      = static_cast<float>(segment_clearance);
+        // Sphere bounds that allow a quarter of the segment per step are not refined.
+        const float accept       = std::min(clearance + 0.25f * motion, static_cast<float>(collision_margin));
+        const long queries_start = workspace.counters.nn_queries + workspace.counters.esdf_queries;
+
+        float s = 0.0f;
+        while (true) {
+            const Eigen::Matrix3f R = R0 * Eigen::AngleAxisf(s * angle, axis).toRotationMatrix();
+            const float c           = toolClearance(R, t0 + s * dt, accept, workspace);
+            ++result.steps;
+            result.min_clearance = std::min(result.min_clearance, static_cast<double>(c));
+            if (c <= clearance || (s < 1.0f && result.steps >= segment_max_steps)) {
+                result.collision_free = false;
+                result.reached        = s;
+                break;
+            }
+            if (s >= 1.0f)
+                break;
+            s = motion > 0.0f ? std::min(1.0f, s + (c - clearance) / motion) : 1.0f;
+        }
+        result.queries = workspace.counters.nn_queries + workspace.counters.esdf_queries - queries_start;
+        return result;
+    }
+
+    /**
+     * @brief Gradient of the distance to the nearest obstacle with respect to the query point.
+     *
+     * @param p         The query point in world coordinates.
+     * @param workspace Scratch buffers for the kd-tree query.
+     * @return The unit direction away from the nearest obstacle point (kd-tree, voxel map) or the field gradient
+     *         (ESDF).
+     */
+    Eigen::Vector3f obstacleDistanceGradient(const Eigen::Vector3f& p, CollisionWorkspace& workspace) {
+        Eigen::Vector3f gradient = Eigen::Vector3f::Zero();
+        if (collision_backend == CollisionBackend::Esdf) {
+            const EsdfGrid& grid = esdfGrid();
+            if (!grid.empty()) {
+                grid.distanceAndGradient(p, gradient);
+                ++workspace.counters.esdf_queries;
+            }
+        }
+        else if (collision_backend == CollisionBackend::VoxelMap) {
+            if (obstacle_map) {
+                Eigen::Vector3f nearest;
+                ++workspace.counters.nn_queries;
+                const float dist = obstacle_map->nearestDistance(p, static_cast<float>(collision_margin), &nearest);
+                if (dist > 0.0f && std::isfinite(dist)) {
+                    gradient = (p - nearest) / dist;
+                }
+            }
+        }
+        else if (kd_tree && kd_tree->getInputCloud() && !kd_tree->getInputCloud()->points.empty()) {
+            pcl::PointXYZ query_pt;
+            query_pt.x = p(0);
+            query_pt.y = p(1);
+            query_pt.z = p(2);
+            ++workspace.counters.nn_queries;
+            if (kd_tree->nearestKSearch(query_pt, 1, workspace.nn_index, workspace.nn_dist2) > 0) {
+                const auto& nn         = kd_tree->getInputCloud()->points[workspace.nn_index[0]];
+                const Eigen::Vector3f d = p - Eigen::Vector3f(nn.x, nn.y, nn.z);
+                const float norm       = d.norm();
+                if (norm > 0.0f) {
+                    gradient = d / norm;
+                }
+            }
+        }
+        return gradient;
+    }
+
+    /**
+     * @brief Mesh collision cost of a state and its gradient with respect to the state.
+     *
+     * @param state     The state (position and Euler angles).
+     * @param workspace Scratch buffers for the collision query.
+     * @param grad      Output gradient with respect to the state.
+     * @return The cost.
+     */
+    Scalar meshCollisionCostGradient(const Eigen::Matrix<Scalar, 6, 1>& state,
+                                     CollisionWorkspace& workspace,
+                                     Eigen::Matrix<Scalar, 6, 1>& grad) {
+        const Eigen::Matrix<Scalar, 3, 1> eul = state.template tail<3>();
+        return meshCollisionCostGradient(stateToIsometry<Scalar>(state.template head<3>(), eul),
+                                         eulerRotationDerivatives<Scalar>(eul),
+                                         workspace,
+                                         grad);
+    }
+
+    /**
+     * @brief Mesh collision cost of a pose and its gradient with respect to the position and three rotational
+     *        coordinates.
+     *
+     * @param pose      The pose.
+     * @param dR        Derivatives of the rotation with respect to the rotational coordinates.
+     * @param workspace Scratch buffers for the collision query.
+     * @param grad      Output gradient.
+     * @return The cost.
+     */
+    Scalar meshCollisionCostGradient(const IsometryT& pose,
+                                     const RotationDerivatives& dR,
+                                     CollisionWorkspace& workspace,
+                                     Eigen::Matrix<Scalar, 6, 1>& grad) {
+        grad.setZero();
+        const Scalar total_cost = meshCollisionCost(pose, workspace);
+        if (total_cost == Scalar(0))
+            return total_cost;
+
+        // Chain rule through q_i = R p_i + t: dJ/dt = sum g_i, dJ/dtheta_k = sum(dR_k .* sum(g_i p_i^T)).
+        Eigen::Vector3f g_sum   = Eigen::Vector3f::Zero();
+        Eigen::Matrix3f g_outer = Eigen::Matrix3f::Zero();
+        for (Eigen::Index i = 0; i < workspace.distances.size(); ++i) {
+            const Scalar nearest_dist = workspace.distances(i);
+            if (nearest_dist < collision_margin) {
+                const float dcost_dd = static_cast<float>(w_obs * (nearest_dist - collision_margin) / collision_margin);
+                const Eigen::Vector3f g = dcost_dd * obstacleDistanceGradient(workspace.points_world.col(i), workspace);
+                g_sum += g;
+                g_outer.noalias() += g * ee_mesh_points.col(i).transpose();
+            }
+        }
+        grad.template head<3>() = g_sum.template cast<Scalar>();
+        for (int k = 0; k < 3; ++k) {
+            grad(3 + k) = dR[k].cwiseProduct(g_outer.template cast<Scalar>()).sum();
+        }
+        return total_cost;
+    }
+
+    /**
+     * @brief Returns a collision cost if any obstacle points lie in a
+     *        bounding box around the camera/end-effector.
+     *
+     * @param pose Current camera/end-effector pose in the world frame.
+     * @return Collision cost (0 if empty, >0 if some points found).
+     */
+    Scalar boxCollisionCost(const IsometryT& pose) {
+        // Count the number of points inside the box.
+        std::size_t count = getPointsInBox<Scalar>(obstacle_cloud, pose, box_min, box_max);
+        Scalar n_points   = static_cast<Scalar>(count);
+
+        // Simple linear penalty based on the number of points.
+        Scalar cost = w_obs * n_points;
+        return cost;
+    }
+
+    /**
+     * @brief Pose tracking and look-at-goal cost.
+     *
+     * Templated on the scalar type so that poseCostGradient can evaluate it with forward-mode autodiff.
+     *
+     * @param pose The pose at which to evaluate the cost.
+     * @param wp   Positional weight.
+     * @param wq   Orientation weight.
+     * @return The cost.
+     */
+    template <typename T>
+    T poseCost(const Eigen::Transform<T, 3, Eigen::Isometry>& pose, Scalar wp, Scalar wq) {
+        using std::acos;  // Found by ADL for Eigen::AutoDiffScalar.
+        const Eigen::Transform<T, 3, Eigen::Isometry> H_goal_t = H_goal.template cast<T>();
+
+        // 1) Pose cost
+        auto e      = homogeneousError(pose, H_goal_t);
+        T cost_pose = T(wp) * e.head(3).squaredNorm() + T(wq) * e.tail(3).squaredNorm();
+
+        // 2) Look at goal cost: angle between the camera's +Z axis and (look_at_goal - cameraPos)
+
+        Eigen::Matrix<T, 3, 1> look_at_goal =
+            H_goal_t.translation() + H_goal_t.rotation() * Eigen::Matrix<T, 3, 1>(T(0), T(0), T(look_at_goal_distance));
+        T cost_rot                      = T(0);
+        Eigen::Matrix<T, 3, 1> camera_z = pose.linear().col(2);
+        // Typically this is already unit-length if pose is orthonormal.
+
+        // Vector pointing from camera to look_at_goal
+        Eigen::Matrix<T, 3, 1> dir = look_at_goal - pose.translation();
+        T dist                     = dir.norm();
+        if (dist > T(1e-8)) {
+            dir /= dist;  // normalize
+            // Dot product (clamp to [-1,1] for acos)
+            T c = camera_z.dot(dir);
+            if (c > T(1))
+                c = T(1);
+            if (c < T(-1))
+                c = T(-1);
+
+            // acos has an infinite derivative at 1, where the cost is zero anyway.
+            if (c < T(1)) {
+                T angle  = acos(c);
+                cost_rot = T(w_look_at_goal) * angle * angle;
+            }
+        }
+
+        return cost_pose + cost_rot;
+    }
+
+    /**
+     * @brief Pose cost of a state and its gradient with respect to the state, by forward-mode autodiff.
+     *
+     * @param state The state (position and Euler angles).
+     * @param wp    Positional weight.
+     * @param wq    Orientation weight.
+     * @param grad  Output gradient with respect to the state.
+     * @return The cost.
+     */
+    Scalar poseCostGradient(const Eigen::Matrix<Scalar, 6, 1>& state,
+                            Scalar wp,
+                            Scalar wq,
+                            Eigen::Matrix<Scalar, 6, 1>& grad) {
+        using ADScalar = Eigen::AutoDiffScalar<Eigen::Matrix<Scalar, 6, 1>>;
+        Eigen::Matrix<ADScalar, 3, 1> p, eul;
+        for (int i = 0; i < 3; ++i) {
+            p(i)   = ADScalar(state(i), 6, i);
+            eul(i) = ADScalar(state(i + 3), 6, i + 3);
+        }
+        ADScalar c = poseCost(stateToIsometry<ADScalar>(p, eul), wp, wq);
+        grad       = c.derivatives();
+        return c.value();
+    }
+
+    /**
+     * @brief Pose cost of a pose and its gradient with respect to the position and three rotational coordinates.
+     *
+     * The rotation enters the autodiff evaluation to first order, R + sum_k theta_k dR_k, which is exact for the
+     * gradient at theta = 0.
+     *
+     * @param pose The pose.
+     * @param dR   Derivatives of the rotation with respect to the rotational coordinates.
+     * @param wp   Positional weight.
+     * @param wq   Orientation weight.
+     * @param grad Output gradient.
+     * @return The cost.
+     */
+    Scalar poseCostGradient(const IsometryT& pose,
+                            const RotationDerivatives& dR,
+                            Scalar wp,
+                            Scalar wq,
+                            Eigen::Matrix<Scalar, 6, 1>& grad) {
+        using ADScalar     = Eigen::AutoDiffScalar<Eigen::Matrix<Scalar, 6, 1>>;
+        using IsometryAD   = Eigen::Transform<ADScalar, 3, Eigen::Isometry>;
+        IsometryAD pose_ad = IsometryAD::Identity();
+        for (int i = 0; i < 3; ++i) {
+            pose_ad.translation()(i) = ADScalar(pose.translation()(i), 6, i);
+        }
+        for (int a = 0; a < 3; ++a) {
+            for (int b = 0; b < 3; ++b) {
+                ADScalar r(pose.linear()(a, b));
+                r.derivatives() << Scalar(0), Scalar(0), Scalar(0), dR[0](a, b), dR[1](a, b), dR[2](a, b);
+                pose_ad.linear()(a, b) = r;
+            }
+        }
+        ADScalar c = poseCost(pose_ad, wp, wq);
+        grad       = c.derivatives();
+        return c.value();
+    }
+    /**
+     * @brief Counts the obstacle points inside the camera frustum at the given pose.
+     *
+     * With the Frustum backend this equals getFrustrumCloud(...)->size(), but without building a filter or copying
+     * points; with use_visibility_octree (and a cloud of at least visibility_octree_min_points), octree cells
+     * entirely inside or outside the frustum are counted or skipped without testing their points. The Occlusion
+     * backend only counts the points that are not hidden behind other points.
+     *
+     * @param pose The camera pose in world coordinates.
+     * @return The number of visible obstacle points.
+     */
+    std::size_t countVisiblePoints(const IsometryT& pose) {
+        return countVisiblePoints(pose, visibilityFrustum());
+    }
+
+    /**
+     * @brief Counts the visible obstacle points with a precomputed frustum geometry (see visibilityFrustum).
+     *
+     * @param pose     The camera pose in world coordinates.
+     * @param geometry The frustum distances and extents.
+     * @return The number of visible obstacle points.
+     */
+    std::size_t countVisiblePoints(const IsometryT& pose, const FrustumGeometry& geometry) {
+        if (!obstacle_cloud || obstacle_cloud->points.empty()) {
+            return 0;
+        }
+        const FrustumPlanes planes = computeFrustumPlanes(geometry, pose);
+        if (visibility_backend == VisibilityBackend::Occlusion) {
+            return occlusionGrid().countVisible(planes, pose.translation().template cast<float>());
+        }
+        if (countsThroughOctree()) {
+            return visibilityOctree().countInFrustum(planes);
+        }
+        return visibilityPoints().countInFrustum(planes);
+    }
+
+    Scalar visibilityCost(const IsometryT& pose) {
+        // If no visibility cloud is provided, or it's empty, no visibility constraint can be enforced.
+        if (!obstacle_cloud || obstacle_cloud->points.empty()) {
+            return Scalar(0.0);
+        }
+        return visibilityPenalty(visibleCount(pose));
+    }
+
+    /**
+     * @brief Number of obstacle points in the camera frustum, smoothed if visibilitySmoothing() > 0.
+     *
+     * @param pose The camera pose in world coordinates.
+     * @return The (smoothed) count.
+     */
+    Scalar visibleCount(const IsometryT& pose) {
+        return visibleCount(pose, visibilityFrustum());
+    }
+
+    /**
+     * @brief visibleCount with a precomputed frustum geometry (see visibilityFrustum).
+     *
+     * @param pose     The camera pose in world coordinates.
+     * @param geometry The frustum distances and extents.
+     * @return The (smoothed) count.
+     */
+    Scalar visibleCount(const IsometryT& pose, const FrustumGeometry& geometry) {
+        if (visibilitySmoothing() > Scalar(0)) {
+            Eigen::Vector3f grad_q_sum;
+            Eigen::Matrix3f grad_q_outer;
+            return softCountVisiblePoints(pose, grad_q_sum, grad_q_outer);
+        }
+        // Convert to Scalar for safety in math:
+        return static_cast<Scalar>(countVisiblePoints(pose, geometry));
+    }
+
+    /**
+     * @brief Boundary width of the smoothed visibility count: visibility_smoothing, or
+     *        gradient_visibility_smoothing if that is 0 and nlopt_algorithm uses the cost gradient.
+     */
+    Scalar visibilitySmoothing() const {
+        if (visibility_smoothing <= Scalar(0) && nloptUsesGradient(nlopt_algorithm))
+            return gradient_visibility_smoothing;
+        return visibility_smoothing;
+    }
+
+    /**
+     * @brief Frustum distances and extents of the visibility cost, shared by all poses.
+     */
+    FrustumGeometry visibilityFrustum() const {
+        return FrustumGeometry(visibility_fov, visibility_min_range, visibility_max_range);
+    }
+
+    /**
+     * @brief Visibility penalty for a given number of visible points.
+     *
+     * @param v The number of visible points.
+     * @return The penalty.
+     */
+    Scalar visibilityPenalty(Scalar v) const {
+        // Soft constraint: if v is below min_visible_points, apply an exponential penalty.
+        // The tuning parameter 'alpha' determines how steep the cost grows.
+        Scalar delta = min_visible_points - v;
+        if (delta > 0) {
+            return std::exp(alpha_visibility * delta) - 1.0;
+        }
+        else {
+            return 0.0;
+        }
+    }
+
+    /**
+     * @brief Smoothed count of the obstacle points inside the camera frustum, with its derivatives.
+     *
+     * @param pose         The camera pose in world coordinates.
+     * @param grad_q_sum   Output sum of d(count)/dq over points, with q the point in the camera frame.
+     * @param grad_q_outer Output sum of (p - t) * d(count)/dq^T over points.
+     * @return The smoothed count, using visibilitySmoothing() as the boundary width.
+     */
+    Scalar softCountVisiblePoints(const IsometryT& pose, Eigen::Vector3f& grad_q_sum, Eigen::Matrix3f& grad_q_outer) {
+        return visibilityPoints().softCountInFrustum(pose.rotation().template cast<float>(),
+                                                     pose.translation().template cast<float>(),
+                                                     static_cast<float>(std::tan(visibility_fov * M_PI / 360.0)),
+                                                     static_cast<float>(visibility_min_range),
+                                                     static_cast<float>(visibility_max_range),
+                                                     static_cast<float>(visibilitySmoothing()),
+                                                     grad_q_sum,
+                                                     grad_q_outer);
+    }
+
+    /**
+     * @brief Visibility cost of a state and its gradient with respect to the state.
+     *
+     * The exact point count has zero gradient almost everywhere, so a useful gradient needs
+     * visibilitySmoothing() > 0; otherwise the gradient is zero.
+     *
+     * @param state The state (position and Euler angles).
+     * @param grad  Output gradient with respect to the state.
+     * @return The cost.
+     */
+    Scalar visibilityCostGradient(const Eigen::Matrix<Scalar, 6, 1>& state, Eigen::Matrix<Scalar, 6, 1>& grad) {
+        const Eigen::Matrix<Scalar, 3, 1> eul = state.template tail<3>();
+        return visibilityCostGradient(stateToIsometry<Scalar>(state.template head<3>(), eul),
+                                      eulerRotationDerivatives<Scalar>(eul),
+                                      grad);
+    }
+
+    /**
+     * @brief Visibility cost of a pose and its gradient with respect to the position and three rotational
+     *        coordinates.
+     *
+     * @param pose The pose.
+     * @param dR   Derivatives of the rotation with respect to the rotational coordinates.
+     * @param grad Output gradient.
+     * @return The cost.
+     */
+    Scalar visibilityCostGradient(const IsometryT& pose,
+                                  const RotationDerivatives& dR,
+                                  Eigen::Matrix<Scalar, 6, 1>& grad) {
+        grad.setZero();
+        if (!obstacle_cloud || obstacle_cloud->points.empty() || visibilitySmoothing() <= Scalar(0)) {
+            return visibilityCost(pose);
+        }
+
+        Eigen::Vector3f grad_q_sum;
+        Eigen::Matrix3f grad_q_outer;
+        Scalar v     = softCountVisiblePoints(pose, grad_q_sum, grad_q_outer);
+        Scalar delta = min_visible_points - v;
+        if (delta <= 0) {
+            return 0.0;
+        }
+        const Scalar cost     = std::exp(alpha_visibility * delta) - 1.0;
+        const Scalar dcost_dv = -alpha_visibility * std::exp(alpha_visibility * delta);
+
+        // q = R^T (p - t): dv/dt = -R * sum(dv/dq), dv/dtheta_k = sum(dR_k .* sum((p - t) dv/dq^T)).
+        grad.template head<3>() = -dcost_dv * (pose.rotation() * grad_q_sum.template cast<Scalar>());
+        for (int k = 0; k < 3; ++k) {
+            grad(3 + k) = dcost_dv * dR[k].cwiseProduct(grad_q_outer.template cast<Scalar>()).sum();
+        }
+        return cost;
+    }
+
+    /**
+     * @brief Points obstacle_cloud at the points of obstacle_map and refreshes what was derived from them.
+     *
+     * The map changes its cloud in place, so the caches keyed on the cloud cannot see an update by themselves. After
+     * a change only the map slots written since the last refresh are recopied into the visibility points (a full
+     * copy if the map's journal no longer reaches back that far), so the default path costs time proportional to
+     * the update. The occlusion grid and distance field are dropped (and rebuilt in full by prepareScene if their
+     * backend is selected) and the pose caches are cleared. The kd-tree is not used with the map; select
+     * CollisionBackend::VoxelMap for the collision queries. A bound scene is frozen, so nothing is refreshed while
+     * one is set, and a map update since the scene was shared is reported (see staleInScene).
+     */
+    void syncObstacleMap() {
+        if (!obstacle_map)
+            return;
+        if (scene) {
+            if (obstacle_map_version != obstacle_map->version())
+                staleInScene("The obstacle map");
+            return;
+        }
+        if (obstacle_cloud == obstacle_map->cloud() && obstacle_map_version == obstacle_map->version())
+            return;
+        obstacle_cloud = obstacle_map->cloud();
+        if (!obstacle_map->changedSlots(obstacle_map_version, obstacle_map_changes)
+            || !visibility_points.updatePoints(obstacle_cloud, obstacle_map_changes)) {
+            visibility_points.setInputCloud(obstacle_cloud);
+        }
+        obstacle_map_version = obstacle_map->version();
+        visibility_octree.clear();
+        occlusion_grid.clear();
+        esdf.clear();
+        collision_cache.clear();
+        visibility_cache.clear();
+    }
+
+    /**
+     * @brief Drops the structures derived from obstacle_cloud and the pose caches, so that they are rebuilt from its
+     *        current points.
+     *
+     * The derived structures only notice a new cloud or a new size; call this after editing the points of
+     * obstacle_cloud in place. The kd_tree belongs to the caller and has to be rebuilt as well. A bound scene is
+     * frozen and is not affected.
+     */
+    void invalidateScene() {
+        visibility_points.setInputCloud(nullptr);
+        visibility_octree.clear();
+        occlusion_grid.clear();
+        esdf.clear();
+        collision_cache.clear();
+        visibility_cache.clear();
+    }
+
+    /**
+     * @brief Builds every lazily cached scene structure used by the cost terms.
+     *
+     * After this call cost() only reads shared planner state, so it can be evaluated concurrently as long as each
+     * thread passes its own CollisionWorkspace and the scene members are not modified. The solvers call it before
+     * their parallel regions. Inside an OpenMP parallel region nothing is built lazily, and reading a structure
+     * that was not prepared fails an assertion (see staleInParallelRegion). Callers evaluating the costs from their
+     * own threads must call it first.
+     */
+    void prepareScene() {
+        syncObstacleMap();
+        if (!scene && obstacle_cloud && !obstacle_cloud->points.empty()) {
+            visibilityPoints();
+            if (countsThroughOctree() && visibility_backend == VisibilityBackend::Frustum)
+                visibilityOctree();
+            if (visibility_backend == VisibilityBackend::Occlusion)
+                occlusionGrid();
+        }
+        if (!scene && collision_backend == CollisionBackend::Esdf) {
+            esdfGrid();
+        }
+        if (ee_mesh_cloud && ee_mesh_points.cols() != static_cast<Eigen::Index>(ee_mesh_cloud->points.size())) {
+            syncEndEffectorPoints();
+        }
+        if (use_pose_cache) {
+            preparePoseCaches();
+        }
+    }
+
+    /**
+     * @brief Moves the prepared scene into a shared read-only PlannerScene and binds this planner to it.
+     *
+     * Builds what prepareScene() builds for the selected backends, then moves the derived structures into the scene
+     * without copying them. Further planners bind the scene with setScene (or are made by queryContext) and only own
+     * their parameters, warm start and scratch buffers. Release the scene with setScene(nullptr) before changing
+     * the obstacles or the end-effector mesh.
+     *
+     * @return The scene (the bound one if already shared).
+     */
+    std::shared_ptr<const PlannerScene> shareScene() {
+        if (scene)
+            return scene;
+        setScene(takeScene());
+        return scene;
+    }
+
+    /**
+     * @brief Prepares the scene and moves the derived structures into a new PlannerScene, leaving this planner
+     *        unbound and without them (see restoreScene).
+     */
+    std::shared_ptr<PlannerScene> takeScene() {
+        prepareScene();
+        auto shared               = std::make_shared<PlannerScene>();
+        shared->obstacle_cloud    = obstacle_cloud;
+        shared->kd_tree           = kd_tree;
+        shared->ee_mesh_cloud     = ee_mesh_cloud;
+        shared->ee_mesh_points    = ee_mesh_points;
+        shared->ee_sphere_tree    = ee_sphere_tree;
+        shared->esdf              = std::move(esdf);
+        shared->visibility_points = std::move(visibility_points);
+        shared->visibility_octree = std::move(visibility_octree);
+        shared->occlusion_grid    = std::move(occlusion_grid);
+        esdf.clear();
+        visibility_points = FrustumPointsSoA();
+        visibility_octree.clear();
+        occlusion_grid.clear();
+        return shared;
+    }
+
+    /**
+     * @brief Moves the derived structures of a scene made by takeScene back into this planner; no other planner may
+     *        use the scene any more.
+     */
+    void restoreScene(PlannerScene& taken) {
+        esdf              = std::move(taken.esdf);
+        visibility_points = std::move(taken.visibility_points);
+        visibility_octree = std::move(taken.visibility_octree);
+        occlusion_grid    = std::move(taken.occlusion_grid);
+    }
+
+    /**
+     * @brief Binds a shared scene: its cloud, kd-tree and end-effector mesh replace the planner's own.
+     *
+     * The pointers are shared, not copied; only the (small) end-effector point matrix is copied. Passing null
+     * unbinds the scene, after which the planner rebuilds its own structures on demand. The clouds stay shared
+     * after unbinding; they are read-only, and loading new obstacles or a new mesh replaces them.
+     *
+     * @param shared The scene, or null.
+     */
+    void setScene(std::shared_ptr<const PlannerScene> shared) {
+        scene = std::move(shared);
+        if (!scene)
+            return;
+        obstacle_cloud = scene->obstacle_cloud;
+        kd_tree        = scene->kd_tree;
+        ee_mesh_cloud  = scene->ee_mesh_cloud;
+        ee_mesh_points = scene->ee_mesh_points;
+        ee_sphere_tree = scene->ee_sphere_tree;
+        collision_cache.clear();
+        visibility_cache.clear();
+    }
+
+    /**
+     * @brief Returns a planner for one independent query: the parameters of this planner bound to a shared scene.
+     *
+     * The context starts without a warm start, pose cache entries, scratch buffers or profiler records, so it is
+     * cheap to make and its result depends only on the query. A bound planner (shareScene) hands out its scene;
+     * otherwise the context gets a scene of its own, made from a copy of this planner's prepared structures, and
+     * this planner stays unbound.
+     */
+    PlannerMpc queryContext() {
+        if (scene)
+            return contextOn(scene);
+        prepareScene();
+        PlannerMpc context = contextOn(nullptr);
+        context.shareScene();
+        return context;
+    }
+
+    /**
+     * @brief Copies this planner without its per-query state and binds the copy to a scene.
+     *
+     * @param shared The scene, or null to keep the copied structures.
+     */
+    PlannerMpc contextOn(std::shared_ptr<const PlannerScene> shared) const {
+        PlannerMpc context(*this);
+        context.U.clear();
+        context.collision_cache.clear();
+        context.visibility_cache.clear();
+        context.thread_workspaces.clear();
+        context.thread_batch_workspaces.clear();
+        context.batch_stats.clear();
+        context.collision_workspace = CollisionWorkspace();
+        context.cost_evaluations    = 0;
+        context.mppi_candidates     = 0;
+        context.mppi_pruned         = 0;
+        context.profiler.clear();
+        if (shared)
+            context.setScene(std::move(shared));
+        return context;
+    }
+
+    /**
+     * @brief Applies the pose cache settings and clears the caches if the scene or a cost parameter changed.
+     *
+     * Edits that keep the cloud pointer and size (e.g. moving points in place) are not detected; clear the caches
+     * explicitly after those.
+     */
+    void preparePoseCaches() {
+        collision_cache.configure(cache_position_step, cache_orientation_step, cache_capacity);
+        visibility_cache.configure(cache_position_step, cache_orientation_step, cache_capacity);
+        const std::array<double, 12> params = {
+            static_cast<double>(obstacle_cloud ? obstacle_cloud->points.size() : 0),
+            static_cast<double>(ee_mesh_points.cols()),
+            static_cast<double>(w_obs),
+            static_cast<double>(collision_margin),
+            static_cast<double>(collision_backend),
+            static_cast<double>(esdf_resolution),
+            static_cast<double>(visibility_fov),
+            static_cast<double>(visibility_min_range),
+            static_cast<double>(visibility_max_range),
+            static_cast<double>(visibilitySmoothing()),
+            static_cast<double>(visibility_backend),
+            static_cast<double>(occlusion_resolution)};
+        if (pose_cache_cloud.lock() != obstacle_cloud || pose_cache_params != params) {
+            collision_cache.clear();
+            visibility_cache.clear();
+            pose_cache_cloud  = obstacle_cloud;
+            pose_cache_params = params;
+        }
+    }
+
+    /**
+     * @brief Computes the total cost along the trajectory induced by the control sequence.
+     *
+     * The stage poses come from rolloutPoses, which integrates the rotations as selected by rotation_integrator,
+     * and are passed to the cost functions.
+     *
+     * @param x    The control sequence.
+     * @param grad The gradient of the cost (if required).
+     * @return The total cost.
+     */
+    Scalar cost(const std::vector<Scalar>& x, std::vector<Scalar>& grad) {
+        return cost(x, grad, collision_workspace);
+    }
+
+    /**
+     * @brief Computes the total cost using caller-provided collision scratch buffers.
+     *
+     * Safe to call concurrently from several threads after prepareScene(), given one workspace per thread. With
+     * use_pose_cache the collision and visibility terms are looked up in the pose caches; the gradient path always
+     * evaluates them exactly.
+     *
+     * @param x         The control sequence.
+     * @param grad      The gradient of the cost (if required).
+     * @param workspace Scratch buffers for the collision query.
+     * @return The total cost.
+     */
+    Scalar cost(const std::vector<Scalar>& x, std::vector<Scalar>& grad, CollisionWorkspace& workspace) {
+        if (!grad.empty())
+            return costGradient(x, grad, workspace);
+        return cost(Eigen::Map<const ActionSequence>(x.data()), workspace);
+    }
+
+    /**
+     * @brief Computes the total cost of a fixed-size control sequence.
+     *
+     * The rollout lives on the stack and the collision query reuses the workspace buffers, so after the first call
+     * with a workspace (and prepareScene()) an evaluation does not allocate. This holds for the Esdf and VoxelMap
+     * collision backends and the Frustum visibility backend with use_pose_cache off; PCL's kd-tree search allocates
+     * a query buffer per call, and the pose caches allocate on insertion.
+     *
+     * @param x         The control sequence.
+     * @param workspace Scratch buffers for the collision query.
+     * @return The total cost.
+     */
+    Scalar cost(const Eigen::Ref<const ActionSequence>& x, CollisionWorkspace& workspace) {
+        ++workspace.counters.cost_evaluations;
+        const bool timed = profiler.enabled;
+        PoseTrajectory poses;
+        rolloutPoses(x, poses);
+        Scalar total_cost = 0;
+        for (int k = 0; k <= HorizonDim; ++k) {
+            const IsometryT& pose  = poses[k];
+            double mesh_cost       = 0.0;
+            double pose_cost       = 0.0;
+            double visibility_cost = 0.0;
+            {
+                PhaseTimer timer(timed, workspace.counters.collision_ns);
+                if (use_pose_cache)
+                    mesh_cost = collision_cache.getOrCompute(
+                        pose, [&](const IsometryT& cell) { return meshCollisionCost(cell, workspace); });
+                else
+                    mesh_cost = meshCollisionCost(pose, workspace);
+            }
+            {
+                PhaseTimer timer(timed, workspace.counters.pose_ns);
+                pose_cost = poseCost(pose, w_p, w_q);
+            }
+            {
+                PhaseTimer timer(timed, workspace.counters.visibility_ns);
+                if (use_pose_cache && obstacle_cloud && !obstacle_cloud->points.empty())
+                    visibility_cost = visibilityPenalty(
+                        visibility_cache.getOrCompute(pose, [&](const IsometryT& cell) { return visibleCount(cell); }));
+                else
+                    visibility_cost = visibilityCost(pose);
+            }
+            total_cost += pose_cost + mesh_cost + visibility_cost;
+        }
+        // Terminal cost
+        PhaseTimer timer(timed, workspace.counters.pose_ns);
+        total_cost += poseCost(poses[HorizonDim], w_p_term, w_q_term);
+        return total_cost;
+    }
+
+    /**
+     * @brief Computes cost() for a batch of candidate control sequences.
+     *
+     * @param candidates Control sequences, one per row.
+     * @return The cost of each candidate.
      */
-    std::vector<Scalar> getAction(const IsometryT& H0_in) {
-        H_0 = H0_in;
-        if (HorizonDim <= 0) {
-            std::cerr << "[PlannerMpc::getAction] HorizonDim <= 0.\n";
-            return {};
+    Eigen::Matrix<Scalar, Eigen::Dynamic, 1> costBatch(const Eigen::Ref<const CandidateMatrix>& candidates) {
+        Eigen::Matrix<Scalar, Eigen::Dynamic, 1> costs(candidates.rows());
+        costBatch(candidates, costs, collision_workspace, batch_workspace);
+        return costs;
+    }
+
+    /**
+     * @brief Computes cost() for a batch of candidate control sequences using caller-provided scratch buffers.
+     *
+     * The rollouts, rotations, pose errors and look-at-goal terms are computed stage by stage for all candidates at
+     * once, in loops over contiguous per-component arrays. The start state, the look-at point, the frustum geometry
+     * and the synced end-effector points are set up once per batch; only the collision and visibility queries
+     * remain per candidate. The results agree with cost() up to rounding.
+     *
+     * All terms are non-negative, so the cheap pose terms of every stage are summed first and bound a candidate's
+     * cost from below. The collision and visibility queries then run stage by stage, and a candidate is abandoned
+     * with cost infinity as soon as its partial cost exceeds the bound.
+     *
+     * Thread safety and allocation behaviour are those of cost(), given one workspace pair per thread; the batch
+     * arrays are reused while the batch size stays the same.
+     *
+     * @param candidates Control sequences, one per row.
+     * @param costs      Output cost of each candidate.
+     * @param workspace  Scratch buffers for the collision queries.
+     * @param batch      Scratch arrays for the structure-of-arrays terms.
+     * @param bound      Costs above it are not completed (infinity evaluates every candidate in full).
+     * @return The number of candidates abandoned at the bound.
+     */
+    Eigen::Index costBatch(const Eigen::Ref<const CandidateMatrix>& candidates,
+                           Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> costs,
+                           CollisionWorkspace& workspace,
+                           BatchWorkspace& batch,
+                           Scalar bound = std::numeric_limits<Scalar>::infinity()) {
+        costBatchPoses(candidates, costs, workspace, batch);
+        return costBatchQueries(batch.stage_poses, costs, workspace, bound);
+    }
+
+    /**
+     * @brief Adds the collision and visibility terms of costBatch to the pose terms computed by costBatchPoses.
+     *
+     * @param stage_poses The stage poses of the candidates, as costBatchPoses keeps them.
+     * @param costs       Partial cost of each candidate from costBatchPoses; receives the full cost.
+     * @param workspace   Scratch buffers for the collision queries.
+     * @param bound       Costs above it are not completed (infinity evaluates every candidate in full).
+     * @return The number of candidates abandoned at the bound.
+     */
+    Eigen::Index costBatchQueries(const Eigen::Ref<const StagePoseArray>& stage_poses,
+                                  Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> costs,
+                                  CollisionWorkspace& workspace,
+                                  Scalar bound = std::numeric_limits<Scalar>::infinity()) {
+        const Eigen::Index K = stage_poses.rows();
+        workspace.counters.cost_evaluations += K;
+
+        // Collision and visibility queries of each candidate pose, stage by stage while below the bound.
+        const bool timed              = profiler.enabled;
+        const FrustumGeometry frustum = visibilityFrustum();
+        const bool has_mesh           = ee_mesh_cloud && !ee_mesh_cloud->empty();
+        const bool has_cloud          = obstacle_cloud && !obstacle_cloud->points.empty();
+        if (has_mesh && ee_mesh_points.cols() != static_cast<Eigen::Index>(ee_mesh_cloud->points.size()))
+            syncEndEffectorPoints();
+        Eigen::Index abandoned = 0;
+        for (Eigen::Index i = 0; i < K; ++i) {
+            for (int k = 0; k <= HorizonDim; ++k) {
+                if (costs[i] > bound) {
+                    costs[i] = std::numeric_limits<Scalar>::infinity();
+                    ++abandoned;
+                    break;
+                }
+                const auto q   = stage_poses.row(i).template segment<12>(12 * k);
+                IsometryT pose = IsometryT::Identity();
+                pose.linear() << q[0], q[1], q[2], q[3], q[4], q[5], q[6], q[7], q[8];
+                pose.translation() << q[9], q[10], q[11];
+                {
+                    PhaseTimer timer(timed, workspace.counters.collision_ns);
+                    if (use_pose_cache)
+                        costs[i] += collision_cache.getOrCompute(
+                            pose, [&](const IsometryT& cell) { return meshCollisionCost(cell, workspace); });
+                    else if (has_mesh)
+                        costs[i] += meshCollisionCost(pose.linear().template cast<float>(),
+                                                      pose.translation().template cast<float>(),
+                                                      workspace);
+                }
+                if (has_cloud) {
+                    PhaseTimer timer(timed, workspace.counters.visibility_ns);
+                    if (use_pose_cache)
+                        costs[i] += visibilityPenalty(visibility_cache.getOrCompute(
+                            pose, [&](const IsometryT& cell) { return visibleCount(cell, frustum); }));
+                    else
+                        costs[i] += visibilityPenalty(visibleCount(pose, frustum));
+                }
+            }
         }
-        if (static_cast<int>(U.size()) != ActionDim * HorizonDim)
-            U.assign(ActionDim * HorizonDim, Scalar(0));
+        return abandoned;
+    }
 
-        int dim = ActionDim * HorizonDim;
-        nlopt::opt opt(nlopt::LN_COBYLA, dim);
-        opt.set_min_objective(costWrapper, this);
+    /**
+     * @brief The pose tracking and look-at-goal terms of costBatch, summed over the stages.
+     *
+     * A lower bound of the full cost of each candidate; the stage poses are kept in batch.stage_poses.
+     *
+     * @param candidates Control sequences, one per row.
+     * @param costs      Output partial cost of each candidate.
+     * @param workspace  Receives the timing of the pose terms.
+     * @param batch      Scratch arrays for the structure-of-arrays terms.
+     */
+    void costBatchPoses(const Eigen::Ref<const CandidateMatrix>& candidates,
+                        Eigen::Ref<Eigen::Matrix<Scalar, Eigen::Dynamic, 1>> costs,
+                        CollisionWorkspace& workspace,
+                        BatchWorkspace& batch) {
+        static_assert(StateDim == 6 && ActionDim == 6, "The batched cost assumes a 6D pose integrator.");
+        const Eigen::Index K = candidates.rows();
+        const bool timed     = profiler.enabled;
+        batch.states.resize(K, StateDim);
+        batch.rotations.resize(K, 9);
+        batch.stage_poses.resize(K, 12 * (HorizonDim + 1));
+        costs.setZero();
+
+        // Shared setup.
+        Eigen::Matrix<Scalar, StateDim, 1> state_0;
+        state_0 << H_0.translation(), mat_to_rpy_intrinsic(H_0.linear());
+        const Eigen::Matrix<Scalar, 3, 3> G = H_goal.rotation();
+        const Eigen::Matrix<Scalar, 3, 1> g = H_goal.translation();
+        const Eigen::Matrix<Scalar, 3, 1> look_at =
+            g + G * Eigen::Matrix<Scalar, 3, 1>(Scalar(0), Scalar(0), look_at_goal_distance);
+
+        const Scalar* p[3]   = {batch.states.col(0).data(), batch.states.col(1).data(), batch.states.col(2).data()};
+        const Scalar* eul[3] = {batch.states.col(3).data(), batch.states.col(4).data(), batch.states.col(5).data()};
+        Scalar* r[9];
+        for (int m = 0; m < 9; ++m)
+            r[m] = batch.rotations.col(m).data();
+        Scalar* out = costs.data();
+
+        for (int k = 0; k <= HorizonDim; ++k) {
+            {
+                PhaseTimer timer(timed, workspace.counters.pose_ns);
+                // Simple integrator: the stage state is the start state plus the preceding controls.
+                if (k == 0)
+                    batch.states.rowwise() = state_0.transpose().array();
+                else
+                    batch.states += candidates.template middleCols<ActionDim>(ActionDim * (k - 1)).array();
+
+                if (rotation_integrator == RotationIntegrator::ExpMap) {
+                    // Exponential-map increment of the previous stage rotation, as in rolloutPoses.
+                    if (k == 0) {
+                        for (int m = 0; m < 9; ++m)
+                            batch.rotations.col(m).setConstant(H_0.linear()(m / 3, m % 3));
+                    }
+                    else {
+                        for (Eigen::Index i = 0; i < K; ++i) {
+                            const Eigen::Matrix<Scalar, 3, 1> w =
+                                candidates.row(i).template segment<3>(ActionDim * (k - 1) + 3).transpose();
+                            Eigen::Matrix<Scalar, 3, 3> R;
+                            R << r[0][i], r[1][i], r[2][i], r[3][i], r[4][i], r[5][i], r[6][i], r[7][i], r[8][i];
+                            const Eigen::Matrix<Scalar, 3, 3> R_next = so3Exp<Scalar>(w) * R;
+                            for (int m = 0; m < 9; ++m)
+                                r[m][i] = R_next(m / 3, m % 3);
+                        }
+                    }
+                }
+                else {
+                    // Rz(yaw) * Ry(pitch) * Rx(roll), as in stateToIsometry.
+                    for (Eigen::Index i = 0; i < K; ++i) {
+                        const Scalar cr = std::cos(eul[0][i]), sr = std::sin(eul[0][i]);
+                        const Scalar cp = std::cos(eul[1][i]), sp = std::sin(eul[1][i]);
+                        const Scalar cy = std::cos(eul[2][i]), sy = std::sin(eul[2][i]);
+                        r[0][i]         = cy * cp;
+                        r[1][i]         = cy * sp * sr - sy * cr;
+                        r[2][i]         = cy * sp * cr + sy * sr;
+                        r[3][i]         = sy * cp;
+                        r[4][i]         = sy * sp * sr + cy * cr;
+                        r[5][i]         = sy * sp * cr - cy * sr;
+                        r[6][i]         = -sp;
+                        r[7][i]         = cp * sr;
+                        r[8][i]         = cp * cr;
+                    }
+                }
+
+                // poseCost for every candidate; the last stage also carries the terminal pose cost.
+                const bool terminal = k == HorizonDim;
+                const Scalar wp     = terminal ? w_p + w_p_term : w_p;
+                const Scalar wq     = terminal ? w_q + w_q_term : w_q;
+                const Scalar w_look = terminal ? 2 * w_look_at_goal : w_look_at_goal;
+                for (Eigen::Index i = 0; i < K; ++i) {
+                    // Translational and rotational error as in homogeneousError, with Re = R * G^T.
+                    const Scalar ex = p[0][i] - g.x(), ey = p[1][i] - g.y(), ez = p[2][i] - g.z();
+                    Scalar re[9];
+                    for (int a = 0; a < 3; ++a) {
+                        for (int b = 0; b < 3; ++b) {
+                            re[3 * a + b] =
+                                r[3 * a][i] * G(b, 0) + r[3 * a + 1][i] * G(b, 1) + r[3 * a + 2][i] * G(b, 2);
+                        }
+                    }
+                    const Scalar t        = re[0] + re[4] + re[8];
+                    const Scalar e0       = re[7] - re[5];
+                    const Scalar e1       = re[2] - re[6];
+                    const Scalar e2       = re[3] - re[1];
+                    const Scalar eps2     = e0 * e0 + e1 * e1 + e2 * e2;
+                    const Scalar eps_norm = std::sqrt(eps2);
+                    Scalar rot2;
+                    if (t > -0.99 || eps_norm > 1e-10) {
+                        const Scalar f = eps_norm < 1e-3 ? Scalar(0.75) - t / Scalar(12)
+                                                         : std::atan2(eps_norm, t - Scalar(1)) / eps_norm;
+                        rot2           = f * f * eps2;
+                    }
+                    else {
+                        const Scalar d0 = re[0] + Scalar(1), d1 = re[4] + Scalar(1), d2 = re[8] + Scalar(1);
+                        rot2           = Scalar(M_PI_2 * M_PI_2) * (d0 * d0 + d1 * d1 + d2 * d2);
+                    }
+                    Scalar c_stage = wp * (ex * ex + ey * ey + ez * ez) + wq * rot2;
+
+                    // Look at goal: angle between the camera's +Z axis and (look_at - camera position).
+                    const Scalar dx   = look_at.x() - p[0][i];
+                    const Scalar dy   = look_at.y() - p[1][i];
+                    const Scalar dz   = look_at.z() - p[2][i];
+                    const Scalar dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+                    if (dist > Scalar(1e-8)) {
+                        const Scalar dot = (r[2][i] * dx + r[5][i] * dy + r[8][i] * dz) / dist;
+                        const Scalar c   = std::max(Scalar(-1), std::min(Scalar(1), dot));
+                        if (c < Scalar(1)) {
+                            const Scalar angle = std::acos(c);
+                            c_stage += w_look * angle * angle;
+                        }
+                    }
+                    out[i] += c_stage;
+                }
+
+                // Keep the stage poses for the collision and visibility queries.
+                for (int m = 0; m < 9; ++m)
+                    batch.stage_poses.col(12 * k + m) = batch.rotations.col(m);
+                for (int m = 0; m < 3; ++m)
+                    batch.stage_poses.col(12 * k + 9 + m) = batch.states.col(m);
+            }
+        }
+    }
+
+    /**
+     * @brief Computes the total cost and its analytic gradient with respect to the control sequence.
+     *
+     * Each term returns its gradient with respect to the stage position and three rotational coordinates (the Euler
+     * angles, or a world-frame rotation increment with RotationIntegrator::ExpMap). With the Euler integrator every
+     * state is the start state plus the sum of the preceding controls, so dJ/du_j is the sum of dJ/ds_k over the
+     * stages k > j. With the exponential map the rotation increment u_j turns every later rotation R_k by the same
+     * R_k R_{j+1}^T, so its rotational gradient is J_l(u_j)^T R_{j+1} sum_k R_k^T dJ/dtheta_k (see so3LeftJacobian).
+     * The visibility term uses the smoothed count (see visibilitySmoothing).
+     *
+     * @param x         The control sequence.
+     * @param grad      Output gradient (size ActionDim * HorizonDim).
+     * @param workspace Scratch buffers for the collision query.
+     * @return The total cost.
+     */
+    Scalar costGradient(const std::vector<Scalar>& x, std::vector<Scalar>& grad, CollisionWorkspace& workspace) {
+        static_assert(StateDim == 6 && ActionDim == 6, "Analytic gradients assume a 6D pose integrator.");
+        ++workspace.counters.cost_evaluations;
+        const bool timed   = profiler.enabled;
+        const bool exp_map = rotation_integrator == RotationIntegrator::ExpMap;
+        const Eigen::Map<const ActionSequence> U_in(x.data());
+        PoseTrajectory poses;
+        rolloutPoses(U_in, poses);
+        StateTrajectory traj;
+        if (!exp_map)
+            rollout(U_in, traj);
+        Scalar total_cost = 0;
+        // Euler: dJ/ds summed over the stages walked so far. ExpMap: the position part likewise, the rotation part
+        // as sum_k R_k^T dJ/dtheta_k.
+        Eigen::Matrix<Scalar, 6, 1> grad_state = Eigen::Matrix<Scalar, 6, 1>::Zero();
+        Eigen::Matrix<Scalar, 6, 1> grad_stage, grad_term;
+        grad.assign(ActionDim * HorizonDim, Scalar(0));
+
+        // The start state does not depend on the controls.
+        const IsometryT& pose_0 = poses[0];
+        {
+            PhaseTimer timer(timed, workspace.counters.collision_ns);
+            total_cost += meshCollisionCost(pose_0, workspace);
+        }
+        {
+            PhaseTimer timer(timed, workspace.counters.pose_ns);
+            total_cost += poseCost(pose_0, w_p, w_q);
+        }
+        {
+            PhaseTimer timer(timed, workspace.counters.visibility_ns);
+            total_cost += visibilityCost(pose_0);
+        }
+
+        // Walk the horizon backwards, accumulating the stage gradients into the controls that precede stage k.
+        for (int k = HorizonDim; k >= 1; --k) {
+            const IsometryT& pose = poses[k];
+            const RotationDerivatives dR =
+                exp_map ? tangentRotationDerivatives<Scalar>(pose.linear())
+                        : eulerRotationDerivatives<Scalar>(Eigen::Matrix<Scalar, 3, 1>(traj.col(k).template tail<3>()));
+            {
+                PhaseTimer timer(timed, workspace.counters.collision_ns);
+                total_cost += meshCollisionCostGradient(pose, dR, workspace, grad_stage);
+            }
+            {
+                PhaseTimer timer(timed, workspace.counters.pose_ns);
+                total_cost += poseCostGradient(pose, dR, w_p, w_q, grad_term);
+                grad_stage += grad_term;
+                if (k == HorizonDim) {
+                    // Terminal cost
+                    total_cost += poseCostGradient(pose, dR, w_p_term, w_q_term, grad_term);
+                    grad_stage += grad_term;
+                }
+            }
+            {
+                PhaseTimer timer(timed, workspace.counters.visibility_ns);
+                total_cost += visibilityCostGradient(pose, dR, grad_term);
+                grad_stage += grad_term;
+            }
+            Eigen::Map<Eigen::Matrix<Scalar, 6, 1>> grad_k(grad.data() + ActionDim * (k - 1));
+            if (exp_map) {
+                grad_state.template head<3>() += grad_stage.template head<3>();
+                grad_state.template tail<3>() += pose.linear().transpose() * grad_stage.template tail<3>();
+                const Eigen::Matrix<Scalar, 3, 1> u_rot = U_in.template segment<3>(ActionDim * (k - 1) + 3);
+                const Eigen::Matrix<Scalar, 3, 1> g_rot =
+                    so3LeftJacobian<Scalar>(u_rot).transpose() * (pose.linear() * grad_state.template tail<3>());
+                grad_k << grad_state.template head<3>(), g_rot;
+            }
+            else {
+                grad_state += grad_stage;
+                grad_k = grad_state;
+            }
+        }
+        return total_cost;
+    }
+
+    /**
+     * @brief Moves the work counters of every collision workspace into profiler.totals.
+     */
+    void collectCounters() {
+        profiler.totals += collision_workspace.counters;
+        collision_workspace.counters = PlannerCounters();
+        for (auto& workspace : thread_workspaces) {
+            profiler.totals += workspace.counters;
+            workspace.counters = PlannerCounters();
+        }
+    }
+
+    /**
+     * @brief Static cost wrapper for NLopt callback.
+     *
+     * @param x The control sequence.
+     * @param grad The gradient of the cost.
+     * @param data Pointer to the PlannerMpc instance.
+     * @return The cost computed by the PlannerMpc instance.
+     */
+    static Scalar costWrapper(const std::vector<Scalar>& x, std::vector<Scalar>& grad, void* data) {
+        PlannerMpc* planner_ptr = reinterpret_cast<PlannerMpc*>(data);
+        return planner_ptr->cost(x, grad);
+    }
+
+    /**
+     * @brief A planner and the collision workspace one NLopt solve evaluates its costs with.
+     */
+    struct SolveContext {
+        PlannerMpc* planner;
+        CollisionWorkspace* workspace;
+    };
+
+    /**
+     * @brief NLopt callback evaluating the cost on the workspace of a SolveContext.
+     */
+    static Scalar contextCostWrapper(const std::vector<Scalar>& x, std::vector<Scalar>& grad, void* data) {
+        SolveContext* context = reinterpret_cast<SolveContext*>(data);
+        return context->planner->cost(x, grad, *context->workspace);
+    }
+
+    /**
+     * @brief Deadline of a solver step starting now: step_time_budget_ms from now, capped by call_deadline.
+     *
+     * @return The deadline, or time_point::max() if neither budget is set.
+     */
+    std::chrono::steady_clock::time_point stepDeadline() const {
+        std::chrono::steady_clock::time_point deadline = call_deadline;
+        if (step_time_budget_ms > 0.0) {
+            const auto budget = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(step_time_budget_ms));
+            deadline = std::min(deadline, std::chrono::steady_clock::now() + budget);
+        }
+        return deadline;
+    }
+
+    /**
+     * @brief Initial control sequences of the COBYLA starts of getAction.
+     *
+     * In order: the warm start U, the zero sequence, a goal-directed sequence that moves from H_0 straight towards
+     * H_goal as fast as the control bounds allow, and copies of U perturbed with the MPPI noise scales (noise_std_pos,
+     * noise_std_ori and noise_schedule). The perturbations are drawn from mppi_seed and cobyla_call_count with the
+     * top bit of the call set, a call stream MPPI never reaches, so they change with every multi-start getAction
+     * call and differ from the MPPI candidates of the same call in MppiCobyla; every sequence is clipped to the
+     * control bounds.
+     *
+     * @param count Number of sequences.
+     * @return The first count sequences of that list.
+     */
+    std::vector<std::vector<Scalar>> cobylaSeeds(int count) {
+        const int dim = ActionDim * HorizonDim;
+        if (static_cast<int>(U.size()) != dim)
+            U.assign(dim, Scalar(0));
+        auto lower = [&](int j) { return j < 3 ? dp_min : dtheta_min; };
+        auto upper = [&](int j) { return j < 3 ? dp_max : dtheta_max; };
+
+        std::vector<std::vector<Scalar>> seeds;
+        seeds.reserve(count);
+        seeds.push_back(U);
+        if (count > 1)
+            seeds.emplace_back(dim, Scalar(0));
+        if (count > 2) {
+            // The rotational controls are Euler angle increments, or world-frame rotation vectors (ExpMap).
+            const Eigen::Matrix<Scalar, 6, 1> to_goal = -homogeneousError(H_0, H_goal);
+            Eigen::Matrix<Scalar, 6, 1> remaining     = to_goal;
+            if (rotation_integrator == RotationIntegrator::Euler) {
+                const Eigen::Matrix<Scalar, 3, 1> turn =
+                    mat_to_rpy_intrinsic(H_goal.linear()) - mat_to_rpy_intrinsic(H_0.linear());
+                remaining.template tail<3>() =
+                    turn.unaryExpr([](Scalar a) { return std::remainder(a, Scalar(2 * M_PI)); });
+            }
+            std::vector<Scalar> seed(dim, Scalar(0));
+            for (int k = 0; k < HorizonDim; ++k) {
+                for (int b = 0; b < 6; b += 3) {
+                    // Shorten the remaining translation or rotation to the bounds, keeping its direction.
+                    Scalar scale = 1;
+                    for (int j = b; j < b + 3; ++j) {
+                        if (remaining(j) > upper(j))
+                            scale = std::min(scale, upper(j) / remaining(j));
+                        else if (remaining(j) < lower(j))
+                            scale = std::min(scale, lower(j) / remaining(j));
+                    }
+                    for (int j = b; j < b + 3; ++j) {
+                        seed[ActionDim * k + j] = std::min(std::max(scale * remaining(j), lower(j)), upper(j));
+                        remaining(j) -= seed[ActionDim * k + j];
+                    }
+                }
+            }
+            seeds.push_back(std::move(seed));
+        }
+        if (count > 3) {
+            const MppiNoiseSampler sampler(NoiseEngine::Philox, dim, mppi_seed, cobyla_call_count | (1ull << 63));
+            Eigen::Matrix<Scalar, 1, ActionDim * HorizonDim> noise;
+            for (int s = 3; s < count; ++s) {
+                sampler.sample(static_cast<std::uint64_t>(s), noise);
+                std::vector<Scalar> seed(U);
+                for (int k = 0; k < HorizonDim; ++k) {
+                    for (int j = 0; j < 6; ++j) {
+                        const int idx = ActionDim * k + j;
+                        const Scalar step =
+                            noise(idx) * (j < 3 ? noise_std_pos : noise_std_ori) * noiseScheduleScale(k);
+                        seed[idx] = std::min(std::max(seed[idx] + step, lower(j)), upper(j));
+                    }
+                }
+                seeds.push_back(std::move(seed));
+            }
+        }
+        return seeds;
+    }
+
+    /**
+     * @brief Runs one bounded NLopt solve (nlopt_algorithm) in place.
+     *
+     * @param x               The initial control sequence; receives the solution.
+     * @param minf            Receives the cost of the solution, or infinity if NLopt failed.
+     * @param evaluations     Receives the number of cost evaluations.
+     * @param max_evaluations Maximum number of cost evaluations.
+     * @param deadline        Deadline of the solve; time_point::max() if unbounded.
+     * @param workspace       Scratch buffers for the cost evaluations.
+     * @return The NLopt result code.
+     */
+    nlopt::result solveCobyla(std::vector<Scalar>& x,
+                              Scalar& minf,
+                              int& evaluations,
+                              int max_evaluations,
+                              std::chrono::steady_clock::time_point deadline,
+                              CollisionWorkspace& workspace) {
+        const int dim = ActionDim * HorizonDim;
+        nlopt::opt opt(nlopt_algorithm, dim);
+        SolveContext context{this, &workspace};
+        opt.set_min_objective(contextCostWrapper, &context);
 
         // Bounds
         std::vector<Scalar> lb(dim), ub(dim);
@@ -558,26 +2572,112 @@ public:
         opt.set_lower_bounds(lb);
         opt.set_upper_bounds(ub);
         opt.set_xtol_rel(1e-6);
-        opt.set_maxeval(200);
+        opt.set_maxeval(max_evaluations);
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            // NLopt returns the best point found when the time runs out; a zero maxtime would mean unbounded.
+            const double remaining = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+            opt.set_maxtime(std::max(remaining, 1e-6));
+        }
 
-        std::vector<Scalar> U_opt = U;  // warm start
-        Scalar minf               = 0;
+        nlopt::result result = nlopt::FAILURE;
+        minf                 = std::numeric_limits<Scalar>::infinity();
         try {
-            auto result = opt.optimize(U_opt, minf);
-            std::cout << "[PlannerMpc::getAction] Converged. Cost = " << minf << " (nlopt code: " << result << ")\n";
+            result = opt.optimize(x, minf);
         }
         catch (std::exception& e) {
+            minf = std::numeric_limits<Scalar>::infinity();
             std::cerr << "[PlannerMpc::getAction] NLopt failed: " << e.what() << std::endl;
         }
+        evaluations = opt.get_numevals();
+        return result;
+    }
+
+    /**
+     * @brief Solves the MPC problem using NLopt and returns the optimized control
+     * sequence.
+     *
+     * @param H0_in The initial pose.
+     * @return The optimized control sequence.
+     */
+    std::vector<Scalar> getAction(const IsometryT& H0_in) {
+        return getAction(H0_in, cobyla_max_evaluations);
+    }
+
+    /**
+     * @brief Solves the MPC problem with COBYLA under a given evaluation budget.
+     *
+     * With cobyla_starts above one, the solve runs from each of the cobylaSeeds on num_threads threads (all cores
+     * if 0), each with the full budget and the step deadline, and the solution of lowest cost is kept (the earliest
+     * seed on ties), so the warm-started solve is one of the candidates. The final cost of every start is left in
+     * cobyla_start_costs.
+     *
+     * @param H0_in           The initial pose.
+     * @param max_evaluations Maximum number of cost evaluations.
+     * @return The optimized control sequence.
+     */
+    std::vector<Scalar> getAction(const IsometryT& H0_in, int max_evaluations) {
+        ScopedSpan span(profiler, "getAction");
+        H_0 = H0_in;
+        if (HorizonDim <= 0) {
+            std::cerr << "[PlannerMpc::getAction] HorizonDim <= 0.\n";
+            return {};
+        }
+        if (static_cast<int>(U.size()) != ActionDim * HorizonDim)
+            U.assign(ActionDim * HorizonDim, Scalar(0));
+        prepareScene();
+
+        const int starts    = std::max(cobyla_starts, 1);
+        const auto deadline = stepDeadline();
+        std::vector<std::vector<Scalar>> seeds =
+            starts > 1 ? cobylaSeeds(starts) : std::vector<std::vector<Scalar>>{U};  // warm start
+        if (starts > 1)
+            ++cobyla_call_count;
+        std::vector<int> evaluations(starts, 0);
+        cobyla_start_costs.assign(starts, std::numeric_limits<Scalar>::infinity());
+        if (starts == 1) {
+            auto result = solveCobyla(
+                seeds[0], cobyla_start_costs[0], evaluations[0], max_evaluations, deadline, collision_workspace);
+            PLANNER_LOG("[PlannerMpc::getAction] Converged. Cost = " << cobyla_start_costs[0]
+                        << " (nlopt code: " << result << ")\n");
+        }
+        else {
+            // Each start solves on its own workspace; cost() is read-only on the planner after prepareScene().
+            int threads = 1;
+#ifdef _OPENMP
+            threads = std::min(starts, num_threads > 0 ? num_threads : omp_get_max_threads());
+#endif
+            if (static_cast<int>(thread_workspaces.size()) < threads)
+                thread_workspaces.resize(threads);
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+            for (int s = 0; s < starts; ++s) {
+                int tid = 0;
+#ifdef _OPENMP
+                tid = omp_get_thread_num();
+#endif
+                solveCobyla(
+                    seeds[s], cobyla_start_costs[s], evaluations[s], max_evaluations, deadline, thread_workspaces[tid]);
+            }
+        }
+        // The lowest cost wins; ties go to the earlier start, so the result does not depend on the thread count.
+        const auto best = static_cast<int>(
+            std::min_element(cobyla_start_costs.begin(), cobyla_start_costs.end()) - cobyla_start_costs.begin());
+        std::vector<Scalar> U_opt = seeds[best];
+        for (int n : evaluations) {
+            cost_evaluations += n;
+        }
+        collectCounters();
+        if (starts > 1) {
+            PLANNER_LOG("[PlannerMpc::getAction] Best of " << starts << " starts: " << best
+                        << ", cost = " << cobyla_start_costs[best] << "\n");
+        }
 
-        // Check final pose error
-        auto traj  = rollout(U_opt);
-        auto p_N   = traj[HorizonDim].template head<3>();
-        auto eul_N = traj[HorizonDim].template tail<3>();
-        auto H_N   = stateToIsometry<Scalar>(p_N, eul_N);
-        auto err   = homogeneousError(H_N, H_goal);
-        std::cout << "[PlannerMpc::getAction] Final pos error: " << err.head(3).norm()
-                  << ", ori error: " << err.tail(3).norm() << "\n";
+        if (plannerLogging()) {
+            // Check final pose error
+            const IsometryT H_N = rolloutPoses(U_opt)[HorizonDim];
+            auto err            = homogeneousError(H_N, H_goal);
+            PLANNER_LOG("[PlannerMpc::getAction] Final pos error: " << err.head(3).norm()
+                        << ", ori error: " << err.tail(3).norm() << "\n");
+        }
 
         // Recede horizon
         if (HorizonDim > 1) {
@@ -593,7 +2693,17 @@ public:
         return U_opt;
     }
 
+    /**
+     * @brief Scale of the MPPI noise at horizon step k: noise_schedule[k], or exp(-k) past its end.
+     */
+    Scalar noiseScheduleScale(int k) const {
+        if (k < static_cast<int>(noise_schedule.size()))
+            return noise_schedule[k];
+        return std::exp(-Scalar(k));
+    }
+
     std::vector<Scalar> getActionMPPI(const IsometryT& H0_in) {
+        ScopedSpan span(profiler, "getActionMPPI");
         H_0 = H0_in;
         if (HorizonDim <= 0) {
             std::cerr << "[PlannerMpc::getAction] HorizonDim <= 0.\n";
@@ -608,66 +2718,161 @@ public:
         int N         = num_samples;
         Scalar lambda = mppi_lambda;
 
-        // Set up noise standard deviations per control dimension.
+        // Noise scale and control bounds per entry of the control sequence.
         // (For the simple integrator, assume first 3 entries are position and the next 3 are orientation.)
-        std::vector<Scalar> noise_std(ActionDim);
-        for (int i = 0; i < 3; ++i)
-            noise_std[i] = noise_std_pos;
-        for (int i = 3; i < ActionDim; ++i)
-            noise_std[i] = noise_std_ori;
+        using SequenceArray = Eigen::Array<Scalar, 1, ActionDim * HorizonDim>;
+        SequenceArray noise_scale, lower, upper;
+        for (int k = 0; k < HorizonDim; ++k) {
+            const Scalar step_scale = noiseScheduleScale(k);
+            for (int j = 0; j < ActionDim; ++j) {
+                const int idx    = k * ActionDim + j;
+                noise_scale(idx) = (j < 3 ? noise_std_pos : noise_std_ori) * step_scale;
+                lower(idx)       = j < 3 ? dp_min : dtheta_min;
+                upper(idx)       = j < 3 ? dp_max : dtheta_max;
+            }
+        }
+        const Eigen::Map<const SequenceArray> mean(U.data());
 
         // Prepare containers for candidates and costs.
-        std::vector<std::vector<Scalar>> candidates(N, std::vector<Scalar>(dim, 0));
-        std::vector<Scalar> candidate_costs(N, 0);
-
-// Parallelize the candidate sampling and evaluation.
-#pragma omp parallel for
-        for (int i = 0; i < N; ++i) {
-            // Each thread creates its own random number generator.
-            std::random_device rd;
-            std::mt19937 gen(rd() + i);
-            // For each candidate, sample a control sequence.
-            for (int k = 0; k < HorizonDim; ++k) {
-                for (int j = 0; j < ActionDim; ++j) {
-                    int idx      = k * ActionDim + j;
-                    Scalar noise = 0;
-                    // Create local normal distribution based on control type.
-                    if (j < 3) {  // Position noise.
-                        std::normal_distribution<Scalar> dist(0.0, noise_std_pos);
-                        noise = dist(gen) * std::exp(-Scalar(k));
-                    }
-                    else {  // Orientation noise.
-                        std::normal_distribution<Scalar> dist(0.0, noise_std_ori);
-                        noise = dist(gen) * std::exp(-Scalar(k));
-                    }
-                    candidates[i][idx] = U[idx] + noise;
-                    // Clip the candidate values to respect control bounds.
-                    if (j < 3)  // position bounds
-                        candidates[i][idx] = std::max(dp_min, std::min(dp_max, candidates[i][idx]));
-                    else  // orientation bounds
-                        candidates[i][idx] = std::max(dtheta_min, std::min(dtheta_max, candidates[i][idx]));
+        CandidateMatrix candidates(N, dim);
+        Eigen::Matrix<Scalar, Eigen::Dynamic, 1> candidate_costs(N);
+        // With pruning, the stage poses of the pose terms, reused by the collision and visibility queries.
+        StagePoseArray stage_poses(mppi_pruning ? N : 0, 12 * (HorizonDim + 1));
+
+        // Build the shared scene caches up front so cost() is read-only inside the parallel region.
+        prepareScene();
+        int threads = 1;
+#ifdef _OPENMP
+        threads = num_threads > 0 ? num_threads : omp_get_max_threads();
+#endif
+        if (static_cast<int>(thread_workspaces.size()) < threads)
+            thread_workspaces.resize(threads);
+        if (static_cast<int>(thread_batch_workspaces.size()) < threads)
+            thread_batch_workspaces.resize(threads);
+
+        // The noise of a sample is a function of (mppi_seed, call, sample index), so it does not depend on which
+        // thread draws it or on the number of threads. Samples are handed to the threads in fixed chunks.
+        const int chunk_size        = std::max(1, mppi_chunk_size);
+        const int num_chunks        = (N + chunk_size - 1) / chunk_size;
+        const std::uint64_t call_id = mppi_call_count++;
+        const MppiNoiseSampler sampler(noise_engine, dim, mppi_seed, call_id);
+        // Past the step deadline the remaining chunks are dropped; the first chunk always runs.
+        const auto deadline = stepDeadline();
+        const bool bounded  = deadline != std::chrono::steady_clock::time_point::max();
+        long evaluated      = 0;
+        long pruned         = 0;
+        bool best_in_batch  = false;
+
+// Sample the candidates; with pruning, also their pose terms, a lower bound of their cost, and their stage poses.
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+        for (int c = 0; c < num_chunks; ++c) {
+            int tid = 0;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+#endif
+            const int begin = c * chunk_size;
+            const int end   = std::min(N, (c + 1) * chunk_size);
+            for (int i = begin; i < end; ++i) {
+                // Draw the standard normal row, then scale it around the mean sequence and clip it to the bounds.
+                sampler.sample(static_cast<std::uint64_t>(i), candidates.row(i));
+                candidates.row(i) = (mean + candidates.row(i).array() * noise_scale).max(lower).min(upper).matrix();
+            }
+            if (mppi_pruning) {
+                costBatchPoses(candidates.middleRows(begin, end - begin),
+                               candidate_costs.segment(begin, end - begin),
+                               thread_workspaces[tid],
+                               thread_batch_workspaces[tid]);
+                stage_poses.middleRows(begin, end - begin) = thread_batch_workspaces[tid].stage_poses;
+            }
+        }
+
+        // The full cost of the candidate with the lowest pose terms bounds the lowest cost from above. A candidate
+        // whose partial cost exceeds that by mppi_prune_margin * lambda would get a weight below exp(-margin); it
+        // is abandoned with zero weight. The bound depends only on the samples, not on the evaluation order.
+        Scalar bound      = std::numeric_limits<Scalar>::infinity();
+        Eigen::Index best = -1;
+        Eigen::Matrix<Scalar, 1, 1> best_cost;
+        Eigen::Matrix<Scalar, 1, ActionDim * HorizonDim> best_row;
+        if (mppi_pruning) {
+            candidate_costs.minCoeff(&best);
+            best_row  = candidates.row(best);
+            best_cost = candidate_costs.row(best);
+            costBatchQueries(stage_poses.row(best), best_cost, collision_workspace);
+            ++cost_evaluations;
+            bound = best_cost(0) + mppi_prune_margin * lambda;
+        }
+
+// Evaluate the candidates with the batched cost, chunk by chunk.
+#pragma omp parallel for schedule(dynamic) num_threads(threads) reduction(+ : evaluated, pruned)
+        for (int c = 0; c < num_chunks; ++c) {
+            int tid = 0;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+#endif
+            const int begin = c * chunk_size;
+            const int end   = std::min(N, (c + 1) * chunk_size);
+            if (bounded && c > 0 && std::chrono::steady_clock::now() >= deadline) {
+                // Zero weight in the average below.
+                candidates.middleRows(begin, end - begin).setZero();
+                candidate_costs.segment(begin, end - begin).setConstant(std::numeric_limits<Scalar>::infinity());
+                continue;
+            }
+            if (!mppi_pruning) {
+                costBatch(candidates.middleRows(begin, end - begin),
+                          candidate_costs.segment(begin, end - begin),
+                          thread_workspaces[tid],
+                          thread_batch_workspaces[tid]);
+                evaluated += end - begin;
+                continue;
+            }
+            // The pose terms are in candidate_costs already, and the candidate that set the bound is done.
+            const int skip = best >= begin && best < end ? static_cast<int>(best) : end;
+            for (const int first : {begin, skip + 1}) {
+                const int last = first == begin ? skip : end;
+                if (first < last) {
+                    pruned += costBatchQueries(stage_poses.middleRows(first, last - first),
+                                               candidate_costs.segment(first, last - first),
+                                               thread_workspaces[tid],
+                                               bound);
                 }
             }
-            std::vector<Scalar> grad;  // Unused here.
-            candidate_costs[i] = cost(candidates[i], grad);
+            evaluated += end - begin;
+            if (skip < end)
+                best_in_batch = true;  // Only one chunk holds it.
+        }
+        cost_evaluations += best_in_batch ? evaluated - 1 : evaluated;
+        mppi_candidates += evaluated;
+        mppi_pruned += pruned;
+        collectCounters();
+        if (best >= 0) {
+            // The candidate that set the bound keeps the cost computed for it (its chunk skips it), even if the
+            // deadline dropped its chunk, so at least one candidate is never pruned.
+            candidates.row(best)  = best_row;
+            candidate_costs(best) = best_cost(0);
         }
 
         // Compute weights based on cost.
-        Scalar min_cost = *std::min_element(candidate_costs.begin(), candidate_costs.end());
-        std::vector<Scalar> weights(N, 0);
-        Scalar weight_sum = 0;
-        for (int i = 0; i < N; ++i) {
-            weights[i] = std::exp(-(candidate_costs[i] - min_cost) / lambda);
-            weight_sum += weights[i];
+        Scalar min_cost = candidate_costs.minCoeff();
+        std::vector<Scalar> U_opt(U);
+        if (!std::isfinite(min_cost)) {
+            std::cerr << "[PlannerMpc::getActionMPPI] No candidate has a finite cost; keeping the mean sequence.\n";
         }
-        for (int i = 0; i < N; ++i)
-            weights[i] /= weight_sum;
-
-        // Update the control sequence by taking the weighted average.
-        std::vector<Scalar> U_opt(dim, 0);
-        for (int i = 0; i < N; ++i) {
-            for (int j = 0; j < dim; ++j) {
-                U_opt[j] += weights[i] * candidates[i][j];
+        else {
+            std::vector<Scalar> weights(N, 0);
+            Scalar weight_sum = 0;
+            for (int i = 0; i < N; ++i) {
+                weights[i] = std::exp(-(candidate_costs[i] - min_cost) / lambda);
+                weight_sum += weights[i];
+            }
+            for (int i = 0; i < N; ++i)
+                weights[i] /= weight_sum;
+
+            // Update the control sequence by taking the weighted average.
+            std::fill(U_opt.begin(), U_opt.end(), Scalar(0));
+            for (int i = 0; i < N; ++i) {
+                for (int j = 0; j < dim; ++j) {
+                    U_opt[j] += weights[i] * candidates(i, j);
+                }
             }
         }
 
@@ -686,6 +2891,43 @@ public:
         return U_opt;
     }
 
+    /**
+     * @brief Runs one MPPI update and refines its result with a short COBYLA solve.
+     *
+     * The MPPI average lands near the basin of the optimum, so COBYLA needs far fewer evaluations
+     * (hybrid_cobyla_max_evaluations) than from the plain warm start.
+     *
+     * @param H0_in The initial pose.
+     * @return The optimized control sequence.
+     */
+    std::vector<Scalar> getActionHybrid(const IsometryT& H0_in) {
+        // Both solvers share one step budget.
+        const auto saved_deadline = call_deadline;
+        call_deadline             = stepDeadline();
+        std::vector<Scalar> U_opt = getActionMPPI(H0_in);
+        if (!U_opt.empty()) {
+            U     = U_opt;
+            U_opt = getAction(H0_in, hybrid_cobyla_max_evaluations);
+        }
+        call_deadline = saved_deadline;
+        return U_opt;
+    }
+
+    /**
+     * @brief Computes the next control sequence with the optimizer selected by solver_mode.
+     *
+     * @param H0_in The initial pose.
+     * @return The optimized control sequence.
+     */
+    std::vector<Scalar> getActionForMode(const IsometryT& H0_in) {
+        switch (solver_mode) {
+            case SolverMode::Mppi: return getActionMPPI(H0_in);
+            case SolverMode::MppiCobyla: return getActionHybrid(H0_in);
+            case SolverMode::Cobyla:
+            default: return getAction(H0_in);
+        }
+    }
+
     /**
      * @brief Post-process the generated waypoints and fuse consecutive waypoints that are close together.
      *
@@ -700,6 +2942,7 @@ public:
      * @return A vector of fused waypoints.
      */
     std::vector<IsometryT> fuseWaypoints(const std::vector<IsometryT>& waypoints) {
+        ScopedSpan span(profiler, "fuseWaypoints");
         std::vector<IsometryT> fused;
         if (waypoints.empty())
             return fused;
@@ -716,7 +2959,7 @@ public:
                 // fused.back().translation() = (fused.back().translation() + waypoints[i].translation()) /
                 // Scalar(2);
                 // For rotation: if the difference is very small, simply keep the existing rotation.
-                std::cout << "[PlannerMpc::fuseWaypoints] Fused waypoints at index " << i << std::endl;
+                PLANNER_LOG("[PlannerMpc::fuseWaypoints] Fused waypoints at index " << i << "\n");
             }
             else {
                 fused.push_back(waypoints[i]);
@@ -727,6 +2970,54 @@ public:
         return fused;
     }
 
+    /**
+     * @brief Rotates the translational controls of a sequence, and the rotational ones of the exponential map, by R.
+     *
+     * Converts control sequences between the world frame and the start frame of a trajectory library entry. The
+     * Euler-angle increments of RotationIntegrator::Euler are not vectors and are kept as they are.
+     */
+    std::vector<double> rotateControls(std::vector<double> u, const Eigen::Matrix3d& R) const {
+        for (int k = 0; k < HorizonDim; ++k) {
+            Eigen::Map<Eigen::Vector3d> dp(u.data() + ActionDim * k);
+            dp = R * dp;
+            if (rotation_integrator == RotationIntegrator::ExpMap) {
+                Eigen::Map<Eigen::Vector3d> w(u.data() + ActionDim * k + 3);
+                w = R * w;
+            }
+        }
+        return u;
+    }
+
+    /**
+     * @brief Whether H_0 is the pose a library entry reached before a step, within the fusion tolerances.
+     */
+    bool onLibraryChain(const TrajectoryLibrary::Entry& entry, int step, const Eigen::Isometry3d& start_pose) const {
+        if (step >= static_cast<int>(entry.waypoints.size()))
+            return false;
+        const Eigen::Isometry3d expected = start_pose * entry.waypoints[step];
+        const Eigen::Isometry3d current  = H_0.template cast<double>();
+        const double position_error      = (current.translation() - expected.translation()).norm();
+        const double orientation_error   = Eigen::AngleAxisd(current.linear() * expected.linear().transpose()).angle();
+        return position_error <= fusion_position_tolerance && orientation_error <= fusion_orientation_tolerance;
+    }
+
+    /**
+     * @brief Records the savings of a warm-started plan and stores a converged one in trajectory_library.
+     *
+     * A warm-started solution keeps the baseline of the cold solve its seed descends from, so the savings of later
+     * hits are measured against planning without the library.
+     */
+    void updateTrajectoryLibrary(const Eigen::Isometry3d& start, const Eigen::Isometry3d& goal,
+                                 const TrajectoryLibrary::Entry& match, TrajectoryLibrary::Entry solution) {
+        if (stats.warm_started)
+            trajectory_library->recordSavings(match, stats.iterations, stats.cost_evaluations);
+        if (stats.outcome != PlanOutcome::Converged)
+            return;
+        solution.baseline_iterations  = stats.warm_started ? match.baseline_iterations : stats.iterations;
+        solution.baseline_evaluations = stats.warm_started ? match.baseline_evaluations : stats.cost_evaluations;
+        trajectory_library->insert(start, goal, std::move(solution));
+    }
+
     /**
      * @brief Generates waypoints by running the MPC loop from the initial pose to
      * the goal pose, while also computing time statistics and visibility metrics.
@@ -735,78 +3026,256 @@ public:
      * criteria or the maximum number of iterations is reached. Returns a vector
      * of waypoints representing the trajectory.
      *
+     * With time_budget_ms set the loop also stops once the budget is spent and returns the waypoints reached so
+     * far, without snapping to the goal; step_time_budget_ms bounds each solver step. stats.outcome tells the
+     * three endings apart.
+     *
+     * With a trajectory_library the plan is seeded from the nearest solved query (see WarmStartMode), and a
+     * converged plan is added to the library.
+     *
+     * With validate_segments the motion between consecutive returned waypoints is checked by checkSegment; the
+     * segments that are not collision free are counted in stats and logged, and stats.outcome is PlanOutcome::Unsafe.
+     * The waypoints are returned as they are, and an unsafe plan is not added to the trajectory library.
+     *
      * @param init The initial pose.
      * @param goal The goal pose.
      * @return A vector of IsometryT waypoints representing the planned trajectory.
      */
     std::vector<IsometryT> generateWaypoints(const IsometryT& init, const IsometryT& goal) {
+        ScopedSpan span(profiler, "generateWaypoints");
         // Start timer
         auto start_time = std::chrono::high_resolution_clock::now();
 
         H_0    = init;
         H_goal = goal;
 
+        stats                        = SolverStats();
+        stats.mode                   = solver_mode;
+        const long evaluations_start = cost_evaluations;
+        const long candidates_start  = mppi_candidates;
+        const long pruned_start      = mppi_pruned;
+        call_deadline                = std::chrono::steady_clock::time_point::max();
+        if (time_budget_ms > 0.0) {
+            call_deadline = std::chrono::steady_clock::now()
+                            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double, std::milli>(time_budget_ms));
+        }
+
+        syncObstacleMap();
         min_visible_points = static_cast<int>(min_visible_ratio * obstacle_cloud->points.size());
-        std::cout << "[PlannerMpc::generateWaypoints] Minimum visible points: " << min_visible_points << std::endl;
+        PLANNER_LOG("[PlannerMpc::generateWaypoints] Minimum visible points: " << min_visible_points << "\n");
+
+        // Seed from the nearest solved query; its steps are followed while the plan stays on its chain.
+        const bool use_library             = trajectory_library && warm_start != WarmStartMode::Off;
+        const Eigen::Isometry3d start_pose = init.template cast<double>();
+        // Entries of another rotation integrator or horizon are misses.
+        const TrajectoryLibrary::Layout layout{static_cast<std::uint32_t>(rotation_integrator),
+                                               static_cast<std::uint32_t>(ActionDim * HorizonDim)};
+        TrajectoryLibrary::Entry match;
+        bool follow_match  = use_library
+                             && trajectory_library->lookup(start_pose, goal.template cast<double>(), layout, match)
+                             && !match.controls.empty();
+        stats.warm_started = follow_match;
+        TrajectoryLibrary::Entry solution;
+        solution.layout = layout;
 
         std::vector<IsometryT> waypoints{H_0};
         int iter = 0;
         for (iter = 0; iter < max_iterations; ++iter) {
-            auto U_opt                      = getAction(H_0);
-            auto states                     = rollout(U_opt);
-            auto next_s                     = states[1];  // receding-horizon step
-            Eigen::Matrix<Scalar, 3, 1> p   = next_s.head(3);
-            Eigen::Matrix<Scalar, 3, 1> eul = next_s.tail(3);
-
-            IsometryT H_next = stateToIsometry(p, eul);
+            const auto iter_start           = PlannerProfiler::Clock::now();
+            const PlannerCounters iter_base = profiler.totals;
+            if (follow_match) {
+                const bool chained = warm_start == WarmStartMode::Chain && onLibraryChain(match, iter, start_pose);
+                follow_match       = iter < static_cast<int>(match.controls.size()) && (iter == 0 || chained);
+                if (follow_match) {
+                    const std::vector<double> u = rotateControls(match.controls[iter], start_pose.linear());
+                    U.assign(u.begin(), u.end());
+                }
+            }
+            auto U_opt = getActionForMode(H_0);
+            if (use_library) {
+                solution.waypoints.push_back(start_pose.inverse() * H_0.template cast<double>());
+                solution.controls.push_back(
+                    rotateControls(std::vector<double>(U_opt.begin(), U_opt.end()), start_pose.linear().transpose()));
+            }
+            IsometryT H_next = rolloutPoses(U_opt)[1];  // receding-horizon step
             auto err         = homogeneousError(H_next, H_goal);
             double pos_err   = err.head(3).norm();
             double ori_err   = err.tail(3).norm();
 
-            std::cout << "[PlannerMpc::generateWaypoints] Iter " << (iter + 1) << " -> pos_err=" << pos_err
-                      << ", ori_err=" << ori_err << "\n";
+            PLANNER_LOG("[PlannerMpc::generateWaypoints] Iter " << (iter + 1) << " -> pos_err=" << pos_err
+                        << ", ori_err=" << ori_err << "\n");
+            if (profiler.enabled) {
+                const auto iter_end = PlannerProfiler::Clock::now();
+                IterationProfile record;
+                record.iteration    = iter + 1;
+                record.wall_time_ms = std::chrono::duration<double, std::milli>(iter_end - iter_start).count();
+                record.counters     = profiler.totals - iter_base;
+                profiler.iterations.push_back(record);
+                profiler.addSpan("iteration", iter_start, iter_end);
+                profiler.addCounterSample(iter_end);
+            }
+
+            stats.iterations              = iter + 1;
+            stats.final_position_error    = pos_err;
+            stats.final_orientation_error = ori_err;
+            stats.converged               = pos_err < position_tolerance && ori_err < orientation_tolerance;
 
             if ((pos_err < position_tolerance && ori_err < orientation_tolerance) || iter == max_iterations - 1) {
                 waypoints.back() = H_goal;  // Snap final
-                std::cout << "[PlannerMpc::generateWaypoints] Converged in " << (iter + 1) << " iterations.\n";
+                stats.outcome    = stats.converged ? PlanOutcome::Converged : PlanOutcome::Snapped;
+                PLANNER_LOG("[PlannerMpc::generateWaypoints] Converged in " << (iter + 1) << " iterations.\n");
                 break;
             }
             else {
                 H_0 = H_next;
                 waypoints.push_back(H_0);
             }
+            if (std::chrono::steady_clock::now() >= call_deadline) {
+                stats.outcome = PlanOutcome::TimedOut;
+                PLANNER_LOG("[PlannerMpc::generateWaypoints] Time budget spent after " << (iter + 1)
+                            << " iterations.\n");
+                break;
+            }
         }
+        call_deadline = std::chrono::steady_clock::time_point::max();
 
         // End timer
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto planning_duration_ms =
-            std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
-
-        // Compute visibility metric across all generated waypoints
-        double sum_visible = 0.0;
-        if (obstacle_cloud && !obstacle_cloud->points.empty()) {
-            for (const auto& wp : waypoints) {
-                std::size_t visible_count =
-                    getFrustrumCloud(obstacle_cloud, visibility_fov, visibility_min_range, visibility_max_range, wp)
-                        ->size();
-                sum_visible += static_cast<double>(visible_count);
-            }
-        }
-        double avg_visible_per_waypoint =
-            (waypoints.empty()) ? 0.0 : (sum_visible / static_cast<double>(waypoints.size()));
-
-        // Print out the results
-        std::cout << "[PlannerMpc::generateWaypoints] "
-                  << "Planning took " << planning_duration_ms << " ms. "
-                  << "Number of waypoints: " << waypoints.size() << std::endl;
-        std::cout << "[PlannerMpc::generateWaypoints] "
-                  << "Average visible points per waypoint: " << avg_visible_per_waypoint << std::endl;
+        auto end_time          = std::chrono::high_resolution_clock::now();
+        stats.wall_time_ms     = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        stats.cost_evaluations = cost_evaluations - evaluations_start;
+        if (mppi_candidates > candidates_start) {
+            stats.pruned_fraction = static_cast<double>(mppi_pruned - pruned_start)
+                                    / static_cast<double>(mppi_candidates - candidates_start);
+        }
         // Fuse waypoints that are close together.
         waypoints = fuseWaypoints(waypoints);
 
+        // The costs only see the waypoints; check the motion between them as well.
+        if (validate_segments) {
+            ScopedSpan validate_span(profiler, "checkSegments");
+            for (std::size_t i = 0; i + 1 < waypoints.size(); ++i) {
+                const SegmentCheck check = checkSegment(waypoints[i], waypoints[i + 1], collision_workspace);
+                ++stats.segments_checked;
+                stats.segment_queries += check.queries;
+                if (check.collision_free)
+                    continue;
+                if (stats.unsafe_segments++ == 0)
+                    stats.first_unsafe_segment = static_cast<int>(i);
+                PLANNER_LOG("[PlannerMpc::generateWaypoints] Segment " << i << " -> " << (i + 1)
+                            << " is not collision free past " << check.reached << " of its motion (clearance "
+                            << check.min_clearance << ").\n");
+            }
+            collectCounters();
+            if (stats.unsafe_segments > 0)
+                stats.outcome = PlanOutcome::Unsafe;
+        }
+
+        if (use_library)
+            updateTrajectoryLibrary(start_pose, goal.template cast<double>(), match, std::move(solution));
+
+        if (plannerLogging()) {
+            auto planning_duration_ms =
+                std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+
+            // Compute visibility metric across all generated waypoints
+            double sum_visible = 0.0;
+            if (obstacle_cloud && !obstacle_cloud->points.empty()) {
+                for (const auto& wp : waypoints) {
+                    std::size_t visible_count = countVisiblePoints(wp);
+                    sum_visible += static_cast<double>(visible_count);
+                }
+            }
+            double avg_visible_per_waypoint =
+                (waypoints.empty()) ? 0.0 : (sum_visible / static_cast<double>(waypoints.size()));
+
+            // Print out the results
+            PLANNER_LOG("[PlannerMpc::generateWaypoints] "
+                        << "Planning took " << planning_duration_ms << " ms. "
+                        << "Number of waypoints: " << waypoints.size() << "\n");
+            PLANNER_LOG("[PlannerMpc::generateWaypoints] "
+                        << "Average visible points per waypoint: " << avg_visible_per_waypoint << "\n");
+            PLANNER_LOG("[PlannerMpc::generateWaypoints] Solver "
+                        << solverModeName(stats.mode) << " (" << planOutcomeName(stats.outcome)
+                        << "): " << stats.cost_evaluations << " cost evaluations, "
+                        << stats.wall_time_ms << " ms, final pos_err=" << stats.final_position_error
+                        << ", ori_err=" << stats.final_orientation_error << "\n");
+            if (mppi_pruning) {
+                PLANNER_LOG("[PlannerMpc::generateWaypoints] MPPI candidates pruned: " << stats.pruned_fraction
+                            << "\n");
+            }
+            if (use_pose_cache) {
+                const PoseCache::Stats collision_stats  = collision_cache.stats();
+                const PoseCache::Stats visibility_stats = visibility_cache.stats();
+                PLANNER_LOG("[PlannerMpc::generateWaypoints] Pose cache hit rate: collision "
+                            << collision_stats.hitRate() << " (" << collision_stats.size << " entries), visibility "
+                            << visibility_stats.hitRate() << " (" << visibility_stats.size << " entries)\n");
+            }
+            if (use_library) {
+                const TrajectoryLibrary::Stats library_stats = trajectory_library->stats();
+                PLANNER_LOG("[PlannerMpc::generateWaypoints] Trajectory library hit rate: "
+                            << library_stats.hitRate() << " (" << library_stats.size << " entries), iterations saved "
+                            << library_stats.iterations_saved << ", evaluations saved "
+                            << library_stats.evaluations_saved << "\n");
+            }
+        }
+
         return waypoints;
     }
 
+    /**
+     * @brief Plans independent (start, goal) pairs concurrently against one shared scene.
+     *
+     * Runs generateWaypoints for each pair on its own query context, spread over num_threads threads (all cores if
+     * 0); each query evaluates its MPPI samples on a single thread. The contexts share the bound scene, or else a
+     * scene taken from this planner for the call (takeScene) and moved back afterwards, so an unbound planner stays
+     * unbound and keeps following obstacle_map and its backend settings. The queries start from the same parameters
+     * and no warm start, so the results do not depend on the thread count, unless they share a trajectory_library,
+     * which the queries read and fill in completion order. The statistics of each query are stored in batch_stats,
+     * and their work counters are added to profiler.totals.
+     *
+     * @param starts The initial poses.
+     * @param goals  The goal poses, one per initial pose.
+     * @return The waypoints of each query.
+     */
+    std::vector<std::vector<IsometryT>> generateWaypointsBatch(const std::vector<IsometryT>& starts,
+                                                               const std::vector<IsometryT>& goals) {
+        if (starts.size() != goals.size()) {
+            std::cerr << "[PlannerMpc::generateWaypointsBatch] Mismatched sizes: " << starts.size() << " starts, "
+                      << goals.size() << " goals.\n";
+            return {};
+        }
+        ScopedSpan span(profiler, "generateWaypointsBatch");
+        const int n = static_cast<int>(starts.size());
+        std::vector<std::vector<IsometryT>> results(n);
+        batch_stats.assign(n, SolverStats());
+        const std::shared_ptr<PlannerScene> taken = scene ? nullptr : takeScene();
+        {
+            const PlannerMpc base = contextOn(scene ? scene : taken);
+#ifdef _OPENMP
+            const int threads = num_threads > 0 ? num_threads : omp_get_max_threads();
+#endif
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+            for (int q = 0; q < n; ++q) {
+                PlannerMpc context(base);
+                context.num_threads = 1;
+                results[q]          = context.generateWaypoints(starts[q], goals[q]);
+                batch_stats[q]      = context.stats;
+#pragma omp critical(planner_batch_totals)
+                {
+                    cost_evaluations += context.cost_evaluations;
+                    mppi_candidates += context.mppi_candidates;
+                    mppi_pruned += context.mppi_pruned;
+                    profiler.totals += context.profiler.totals;
+                }
+            }
+        }
+        if (taken)
+            restoreScene(*taken);
+        return results;
+    }
+
     /**
      * @brief Updates the end-effector collision box dimensions and detailed mesh from an STL file.
      *
@@ -885,9 +3354,9 @@ public:
         // Update internal box dimensions.
         box_min = min_pt;
         box_max = max_pt;
-        std::cout << "[PlannerMpc::updateEndEffectorFromSTL] Updated box dimensions:\n"
-                  << "  box_min: " << box_min.transpose() << "\n"
-                  << "  box_max: " << box_max.transpose() << std::endl;
+        PLANNER_LOG("[PlannerMpc::updateEndEffectorFromSTL] Updated box dimensions:\n"
+                    << "  box_min: " << box_min.transpose() << "\n"
+                    << "  box_max: " << box_max.transpose() << "\n");
 
         // Downsample the point cloud using a VoxelGrid filter.
         pcl::VoxelGrid<pcl::PointXYZ> voxel_filter;
@@ -896,13 +3365,11 @@ public:
         voxel_filter.setLeafSize(leaf_size, leaf_size, leaf_size);
         pcl::PointCloud<pcl::PointXYZ>::Ptr cloud_downsampled(new pcl::PointCloud<pcl::PointXYZ>());
         voxel_filter.filter(*cloud_downsampled);
-        std::cout << "[PlannerMpc::updateEndEffectorFromSTL] Downsampled point cloud from " << cloud->points.size()
-                  << " to " << cloud_downsampled->points.size() << " points.\n";
+        PLANNER_LOG("[PlannerMpc::updateEndEffectorFromSTL] Downsampled point cloud from "
+                    << cloud->points.size() << " to " << cloud_downsampled->points.size() << " points.\n");
 
-        // Clear the existing stored end-effector mesh cloud.
-        ee_mesh_cloud->clear();
-
-        // Transform each downsampled point and store it.
+        // Transform each downsampled point into a new mesh cloud; the current one may be shared with a scene.
+        pcl::PointCloud<pcl::PointXYZ>::Ptr mesh_cloud(new pcl::PointCloud<pcl::PointXYZ>());
         for (const auto& pt : cloud_downsampled->points) {
             pcl::PointXYZ pt_transformed;
             Eigen::Vector4f p(pt.x, pt.y, pt.z, 1.0f);
@@ -910,11 +3377,14 @@ public:
             pt_transformed.x        = p_trans[0];
             pt_transformed.y        = p_trans[1];
             pt_transformed.z        = p_trans[2];
-            ee_mesh_cloud->points.push_back(pt_transformed);
+            mesh_cloud->points.push_back(pt_transformed);
         }
+        ee_mesh_cloud = mesh_cloud;
+
+        syncEndEffectorPoints();
 
-        std::cout << "[PlannerMpc::updateEndEffectorFromSTL] Stored " << ee_mesh_cloud->points.size()
-                  << " mesh points for collision checking.\n";
+        PLANNER_LOG("[PlannerMpc::updateEndEffectorFromSTL] Stored " << ee_mesh_cloud->points.size()
+                    << " mesh points for collision checking.\n");
     }
 };
 
@@ -9,89 +9,47 @@
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 
+#include "../include/planner_setup.hpp"
+#include "../include/scene_cache.hpp"
 #include "../include/waypoints_planner.hpp"
 
-int main() {
+// Usage: motion_planning [trajectory library]
+// Given a trajectory library file, the planner warm-starts from the solutions stored in it and saves the library
+// back on exit, so later runs depend on earlier ones. Without it every run starts cold and is reproducible.
+int main(int argc, char** argv) {
     const size_t StateDim   = 6;
     const size_t ActionDim  = 6;
     const size_t HorizonDim = 1;
     PlannerMpc<StateDim, ActionDim, HorizonDim, double> planner;
 
-    // 1) Load original cloud
-    pcl::PointCloud<pcl::PointXYZ>::Ptr originalCloud(new pcl::PointCloud<pcl::PointXYZ>);
-    if (pcl::io::loadPCDFile("../data/vine_simple_streo_scan.pcd", *originalCloud) == -1) {
+    // Cost weights, camera, solver and MPPI parameters of the vine pruning setup (see planner_setup.hpp).
+    configurePlanner(planner);
+
+    // Warm start from the solutions of earlier runs, only if a library file was given.
+    const std::string library_filename = argc > 1 ? argv[1] : "";
+    if (!library_filename.empty()) {
+        planner.warm_start = WarmStartMode::Chain;
+        if (planner.trajectory_library->load(library_filename)) {
+            std::cout << "[INFO] Loaded " << planner.trajectory_library->size() << " solutions from "
+                      << library_filename << "\n";
+        }
+    }
+
+    // Load the scene: the obstacle cloud downsampled at 3 cm with its kd-tree and distance field, and the collision
+    // box and points of the end effector from its STL model. The STL model is placed in the camera frame by
+    // cutterTransform(); modify it if a different pose is desired. The preprocessed scene is memory-mapped from
+    // vine_simple_streo_scan.scene (see tools/src/build_scene_cache.cpp), which is rebuilt whenever a source file or
+    // parameter changes.
+    const Eigen::Isometry3d cutter_transform = cutterTransform();
+    const SceneSources scene                 = plannerSceneSources(planner);
+    auto start_scene                         = std::chrono::high_resolution_clock::now();
+    if (!loadOrBuildScene(planner, scene, "vine_simple_streo_scan.scene")) {
         PCL_ERROR("Couldn't read file .pcd\n");
         return -1;
     }
-
-    // 2) Downsample
-    pcl::PointCloud<pcl::PointXYZ>::Ptr downsampled_cloud(new pcl::PointCloud<pcl::PointXYZ>);
-    pcl::VoxelGrid<pcl::PointXYZ> voxel;
-    voxel.setInputCloud(originalCloud);
-    voxel.setLeafSize(0.03, 0.03, 0.03);
-    voxel.filter(*downsampled_cloud);
-
-    // 3) Build KD-tree
-    std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> kd_tree(new pcl::KdTreeFLANN<pcl::PointXYZ>);
-    kd_tree->setInputCloud(downsampled_cloud);
-
-    // 4) Assign to planner
-    planner.obstacle_cloud = downsampled_cloud;
-    planner.kd_tree        = kd_tree;
-
-    // Pose parameters
-    planner.w_p      = 1e4;  // Positional tracking cost weight.
-    planner.w_q      = 1e2;  // Orientation tracking cost weight.
-    planner.w_p_term = 1e4;  // Terminal positional cost weight.
-    planner.w_q_term = 1e2;  // Terminal orientation cost weight.
-
-    // Look at goal parameters
-    planner.w_look_at_goal        = 1e2;  // Look at goal cost weight.
-    planner.look_at_goal_distance = 0.11;
-
-    // Collision parameters
-    planner.w_obs            = 1e3;  // Obstacle avoidance cost weight.
-    planner.collision_margin = 0.05;
-
-    // Camera parameters
-    planner.visibility_fov       = 60.0;  // Field of view in degrees.
-    planner.visibility_min_range = 0.07;
-    planner.visibility_max_range = 0.5;
-
-    // Visibility parameters
-    planner.min_visible_ratio = 0.1;
-    planner.alpha_visibility  = 0.2;  // Tuning parameter to control the saturation rate.
-
-    // Planner parameters
-    planner.max_iterations = 20;
-
-    // MPPI parameters
-    planner.num_samples   = 200;           // Number of candidate trajectories to sample.
-    planner.mppi_lambda   = double(1.0);   // Temperature parameter.
-    planner.noise_std_pos = double(0.01);  // Standard deviation for position noise.
-    planner.noise_std_ori = double(0.05);  // Standard deviation for orientation noise.
-
-    // Fusion parameters
-    planner.fusion_position_tolerance    = 0.03;
-    planner.fusion_orientation_tolerance = 0.1;
-
-    // 6) Set control bounds
-    planner.dp_max     = 0.025;
-    planner.dp_min     = -0.025;
-    planner.dtheta_max = 0.15;
-    planner.dtheta_min = -0.15;
-
-    // 7) Update the collision box from the STL model of the end effector.
-    // Here we load the STL file from "../data/cutter.stl" and apply a rigid transform to it to position it correctly in
-    // the camera frame. Modify cutter_transform if a different pose is desired.
-    Eigen::Isometry3d cutter_transform = Eigen::Isometry3d::Identity();
-    cutter_transform.translation()     = Eigen::Vector3d(0.0, 0.08, 0.03);
-    Eigen::AngleAxisd Rzc(M_PI_2, Eigen::Vector3d::UnitZ());
-    Eigen::AngleAxisd Ryc(0, Eigen::Vector3d::UnitY());
-    Eigen::AngleAxisd Rxc(M_PI_2, Eigen::Vector3d::UnitX());
-    cutter_transform.linear() = (Rzc * Ryc * Rxc).matrix();
-    double collision_margin   = 0.005;
-    planner.updateEndEffectorFromSTL("../data/cutter.stl", cutter_transform, planner.collision_margin);
+    auto end_scene = std::chrono::high_resolution_clock::now();
+    std::cout << "[INFO] Scene set up in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_scene - start_scene).count() << " ms\n";
 
     // Save the box dimensions to a file for later visualization.
     std::ofstream box_file("cutter_box.txt");
@@ -253,12 +211,7 @@ int main() {
         // Loop over all goals' waypoints
         for (const auto& waypoints_for_goal : all_waypoints) {
             for (const auto& wp : waypoints_for_goal) {
-                std::size_t visible_count = getFrustrumCloud(planner.obstacle_cloud,
-                                                             planner.visibility_fov,
-                                                             planner.visibility_min_range,
-                                                             planner.visibility_max_range,
-                                                             wp)
-                                                ->size();
+                std::size_t visible_count = planner.countVisiblePoints(wp);
                 sum_visible_all += static_cast<double>(visible_count);
                 count_waypoints++;
             }
@@ -277,6 +230,23 @@ int main() {
     std::cout << "Total planning for all goals took "
               << std::chrono::duration_cast<std::chrono::milliseconds>(end_total - start_total).count() << " ms.\n";
 
+    if (!library_filename.empty()) {
+        const TrajectoryLibrary::Stats library_stats = planner.trajectory_library->stats();
+        std::cout << "[Trajectory library] Hit rate " << library_stats.hitRate() << " (" << library_stats.hits << "/"
+                  << library_stats.queries << "), iterations saved " << library_stats.iterations_saved
+                  << ", cost evaluations saved " << library_stats.evaluations_saved << "\n";
+        if (planner.trajectory_library->save(library_filename)) {
+            std::cout << "[INFO] Saved " << library_stats.size << " solutions to " << library_filename << "\n";
+        }
+    }
+
+    if (planner.profiler.enabled) {
+        planner.profiler.print(std::cout);
+        if (planner.profiler.writeChromeTrace("planner_trace.json")) {
+            std::cout << "[INFO] Wrote Chrome trace to planner_trace.json\n";
+        }
+    }
+
 
     return 0;
 }
@@ -0,0 +1,67 @@
+#include <Eigen/Dense>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    using Planner = PlannerMpc<6, 6, 2, double>;
+
+    void setupScene(Planner& planner) {
+        std::mt19937 gen(16);
+        setupRandomScene(planner, gen, 2000, Eigen::Vector3f(0.2f, 0.2f, 0.1f), Eigen::Vector3f(0.0f, 0.0f, 0.4f), 50);
+        planner.solver_mode = SolverMode::Mppi;
+        planner.num_threads = 1;
+    }
+}  // namespace
+
+TEST_CASE("Anytime planning stops at the time budget", "[anytime]") {
+    Planner planner;
+    setupScene(planner);
+    const Eigen::Isometry3d start = Eigen::Isometry3d::Identity();
+    const Eigen::Isometry3d goal  = stateToIsometry<double>(Eigen::Vector3d(1.0, 1.0, 0.0), Eigen::Vector3d::Zero());
+
+    SECTION("Without a budget the iterations run out and the goal is snapped") {
+        planner.num_samples    = 32;
+        planner.max_iterations = 3;
+        const auto waypoints   = planner.generateWaypoints(start, goal);
+        CHECK(planner.stats.outcome == PlanOutcome::Snapped);
+        CHECK_FALSE(planner.stats.converged);
+        CHECK(waypoints.back().isApprox(goal));
+    }
+
+    SECTION("A call budget returns the poses reached so far") {
+        planner.num_samples         = 256;
+        planner.max_iterations      = 100000;
+        planner.time_budget_ms      = 20.0;
+        planner.step_time_budget_ms = 5.0;
+        // Far enough that no machine converges within the budget.
+        const Eigen::Isometry3d far_goal =
+            stateToIsometry<double>(Eigen::Vector3d(10.0, 10.0, 0.0), Eigen::Vector3d::Zero());
+        const auto waypoints = planner.generateWaypoints(start, far_goal);
+        CHECK(planner.stats.outcome == PlanOutcome::TimedOut);
+        CHECK(planner.stats.iterations < 100000);
+        // One step may overrun the call budget by its own budget plus the first MPPI chunk; the bound is loose so a
+        // loaded machine does not fail it, and only catches a budget that is ignored.
+        CHECK(planner.stats.wall_time_ms < 10000.0);
+        REQUIRE(waypoints.size() >= 2);
+        CHECK_FALSE(waypoints.back().isApprox(far_goal));
+        CHECK(planner.call_deadline == std::chrono::steady_clock::time_point::max());
+    }
+
+    SECTION("MPPI drops the chunks past the step deadline") {
+        planner.num_samples         = 4096;
+        planner.mppi_chunk_size     = 16;
+        planner.step_time_budget_ms = 1e-6;
+        const long before           = planner.cost_evaluations;
+        const auto U_opt            = planner.getActionMPPI(start);
+        REQUIRE(U_opt.size() == 12);
+        for (double u : U_opt) {
+            CHECK(std::isfinite(u));
+        }
+        CHECK(planner.cost_evaluations - before >= 16);
+        CHECK(planner.cost_evaluations - before < 4096);
+    }
+}
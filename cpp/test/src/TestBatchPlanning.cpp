@@ -0,0 +1,120 @@
+#include <Eigen/Dense>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+TEST_CASE("Batch planning shares the scene and matches single queries", "[batch]") {
+    using Planner = PlannerMpc<6, 6, 2, double>;
+    Planner planner;
+    std::mt19937 gen(15);
+    setupRandomScene(planner, gen);
+    planner.solver_mode       = SolverMode::Mppi;
+    planner.num_samples       = 64;
+    planner.max_iterations    = 4;
+    planner.min_visible_ratio = 0.2;
+
+    std::vector<Eigen::Isometry3d> starts, goals;
+    for (int q = 0; q < 4; ++q) {
+        starts.push_back(stateToIsometry<double>(Eigen::Vector3d(0.02 * q, 0.0, 0.0), Eigen::Vector3d::Zero()));
+        goals.push_back(stateToIsometry<double>(Eigen::Vector3d(0.1, 0.05 * q, 0.1), Eigen::Vector3d(0.0, 0.1, 0.2)));
+    }
+    // An independent planner with its own copy of the scene structures.
+    const Planner reference = planner;
+
+    planner.num_threads = 1;
+    const auto serial   = planner.generateWaypointsBatch(starts, goals);
+    CHECK_FALSE(planner.scene);  // The batch scene is moved back, not left bound.
+    CHECK(planner.visibility_points.size() == planner.obstacle_cloud->size());
+    REQUIRE(planner.batch_stats.size() == 4);
+
+    planner.num_threads = 4;
+    const auto parallel = planner.generateWaypointsBatch(starts, goals);
+    REQUIRE(serial.size() == 4);
+    REQUIRE(parallel.size() == 4);
+    for (int q = 0; q < 4; ++q) {
+        CHECK(planner.batch_stats[q].iterations > 0);
+        Planner single       = reference;
+        single.num_threads   = 1;
+        const auto waypoints = single.generateWaypoints(starts[q], goals[q]);
+        REQUIRE(serial[q].size() == waypoints.size());
+        REQUIRE(parallel[q].size() == waypoints.size());
+        for (std::size_t i = 0; i < waypoints.size(); ++i) {
+            CHECK(serial[q][i].isApprox(parallel[q][i], 1e-12));
+            CHECK(serial[q][i].isApprox(waypoints[i], 1e-9));
+        }
+    }
+
+    // The shared scene serves a planner bound to it directly.
+    const auto shared = planner.shareScene();
+    REQUIRE(shared);
+    CHECK(shared->obstacle_cloud == planner.obstacle_cloud);
+    CHECK(shared->visibility_points.size() == planner.obstacle_cloud->size());
+    CHECK(planner.visibility_points.size() == 0);  // Moved into the scene, not copied.
+    Planner bound, unshared = reference;
+    bound.setScene(shared);
+    const Eigen::Isometry3d camera = Eigen::Isometry3d::Identity();
+    CHECK(bound.obstacle_cloud == planner.obstacle_cloud);
+    CHECK(bound.countVisiblePoints(camera) == unshared.countVisiblePoints(camera));
+    CHECK(bound.countVisiblePoints(camera) > 0);
+
+    // Unbinding and loading a new mesh leaves the shared scene as it was.
+    const std::size_t scene_mesh_points = shared->ee_mesh_cloud->size();
+    bound.setScene(nullptr);
+    addRandomEndEffector(bound, gen, 10);
+    CHECK(bound.ee_mesh_cloud->size() == scene_mesh_points + 10);
+    CHECK(shared->ee_mesh_cloud->size() == scene_mesh_points);
+    CHECK(shared->ee_mesh_points.cols() == static_cast<Eigen::Index>(scene_mesh_points));
+}
+
+TEST_CASE("A batch leaves the planner following the obstacle map and its backends", "[batch]") {
+    using Planner = PlannerMpc<6, 6, 1, double>;
+    Planner planner;
+    std::mt19937 gen(16);
+    auto map = std::make_shared<VoxelObstacleMap>(0.02f);
+    map->insert(*randomBoxCloud(gen, 400, Eigen::Vector3f::Constant(0.1f), Eigen::Vector3f(0.0f, 0.0f, 0.25f)));
+    planner.obstacle_map      = map;
+    planner.collision_backend = CollisionBackend::VoxelMap;
+    planner.collision_margin  = 0.05;
+    addRandomEndEffector(planner, gen);
+    planner.solver_mode    = SolverMode::Mppi;
+    planner.num_samples    = 32;
+    planner.max_iterations = 2;
+
+    const std::vector<Eigen::Isometry3d> starts(2, Eigen::Isometry3d::Identity());
+    const std::vector<Eigen::Isometry3d> goals(
+        2, stateToIsometry<double>(Eigen::Vector3d(0.05, 0.0, 0.05), Eigen::Vector3d::Zero()));
+    REQUIRE(planner.generateWaypointsBatch(starts, goals).size() == 2);
+    REQUIRE_FALSE(planner.scene);
+
+    // A map update after the batch reaches the visibility count.
+    const Eigen::Isometry3d camera = Eigen::Isometry3d::Identity();
+    planner.prepareScene();
+    const std::size_t before = planner.countVisiblePoints(camera);
+    map->insert(*randomBoxCloud(gen, 300, Eigen::Vector3f::Constant(0.05f), Eigen::Vector3f(0.0f, 0.0f, 0.3f)));
+    planner.prepareScene();
+    CHECK(planner.obstacle_cloud->size() == map->size());
+    CHECK(planner.countVisiblePoints(camera) > before);
+
+    // Backends the batch did not use are built on demand, and agree with an unshared planner.
+    Planner reference;
+    setObstacleCloud(reference,
+                     pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>(*map->cloud())));
+    reference.collision_margin = planner.collision_margin;
+    reference.ee_mesh_cloud    = planner.ee_mesh_cloud;
+    reference.syncEndEffectorPoints();
+    planner.collision_backend   = CollisionBackend::Esdf;
+    reference.collision_backend = CollisionBackend::Esdf;
+    planner.visibility_backend   = VisibilityBackend::Occlusion;
+    reference.visibility_backend = VisibilityBackend::Occlusion;
+    planner.prepareScene();
+    CHECK_FALSE(planner.esdf.empty());
+    CHECK(planner.countVisiblePoints(camera) == reference.countVisiblePoints(camera));
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    pose.translation()     = Eigen::Vector3d(0.0, 0.0, 0.25);
+    CHECK(planner.meshCollisionCost(pose) > 0.0);
+    CHECK(planner.meshCollisionCost(pose) == Approx(reference.meshCollisionCost(pose)).margin(1e-9));
+}
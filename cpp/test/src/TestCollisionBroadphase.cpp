@@ -0,0 +1,87 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../include/sphere_tree.hpp"
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+TEST_CASE("Bounding spheres enclose the points below them", "[broadphase]") {
+    std::mt19937 gen(20);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    Eigen::Matrix3Xf points(3, 237);
+    for (int i = 0; i < points.cols(); ++i) {
+        points.col(i) << 0.1f * unit(gen), 0.02f * unit(gen), 0.05f * unit(gen);
+    }
+    BoundingSphereTree tree;
+    tree.build(points, 8);
+    REQUIRE(tree.size() == points.cols());
+
+    std::vector<int> seen(points.cols(), 0);
+    for (const auto& node : tree.nodes()) {
+        for (int j = node.begin; j < node.end; ++j) {
+            CHECK((tree.points().col(j) - node.center).norm() <= node.radius + 1e-6f);
+            CHECK(tree.points().col(j) == points.col(tree.index()[j]));
+        }
+        if (node.right < 0) {
+            CHECK(node.end - node.begin <= 8);
+            for (int j = node.begin; j < node.end; ++j) {
+                ++seen[tree.index()[j]];
+            }
+        }
+        else {
+            // The children split the parent's range.
+            const auto& left  = tree.nodes()[&node - tree.nodes().data() + 1];
+            const auto& right = tree.nodes()[node.right];
+            CHECK(left.begin == node.begin);
+            CHECK(left.end == right.begin);
+            CHECK(right.end == node.end);
+        }
+    }
+    CHECK(std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+}
+
+TEST_CASE("The collision broadphase matches the per-point cost and skips free space", "[broadphase]") {
+    using Planner = PlannerMpc<6, 6, 1, double>;
+    std::mt19937 gen(20);
+    const auto cloud =
+        randomBoxCloud(gen, 500, Eigen::Vector3f(0.1f, 0.1f, 0.02f), Eigen::Vector3f(0.0f, 0.0f, 0.3f));
+    auto map = std::make_shared<VoxelObstacleMap>(0.02f);
+    map->insert(*cloud);
+
+    Planner planner;
+    planner.collision_margin = 0.05;
+    setObstacleCloud(planner, cloud);
+    addRandomEndEffector(planner, gen, 200, Eigen::Vector3f(0.08f, 0.01f, 0.03f));
+    const auto backend = GENERATE(CollisionBackend::KdTree, CollisionBackend::VoxelMap);
+    planner.collision_backend = backend;
+    if (backend == CollisionBackend::VoxelMap)
+        planner.obstacle_map = map;
+    Planner brute = planner;
+    brute.use_collision_broadphase = false;
+
+    CollisionWorkspace workspace;
+    CollisionWorkspace brute_workspace;
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    int touching = 0;
+    for (int s = 0; s < 50; ++s) {
+        Eigen::Matrix<double, 6, 1> state;
+        state << 0.15 * unit(gen), 0.15 * unit(gen), 0.3 + 0.15 * unit(gen), unit(gen), unit(gen), unit(gen);
+        Eigen::Matrix<double, 6, 1> grad, brute_grad;
+        const double cost = planner.meshCollisionCostGradient(state, workspace, grad);
+        CHECK(cost == Approx(brute.meshCollisionCostGradient(state, brute_workspace, brute_grad)).epsilon(1e-5));
+        CHECK((grad - brute_grad).norm() <= 1e-5 * (1.0 + brute_grad.norm()));
+        touching += cost > 0.0;
+    }
+    CHECK(touching > 0);
+
+    // A tool far from every obstacle costs a single query.
+    planner.collision_workspace = CollisionWorkspace();
+    Eigen::Isometry3d far       = Eigen::Isometry3d::Identity();
+    far.translation()           = Eigen::Vector3d(0.0, 0.0, 1.0);
+    CHECK(planner.meshCollisionCost(far) == 0.0);
+    CHECK(planner.collision_workspace.counters.nn_queries == 1);
+}
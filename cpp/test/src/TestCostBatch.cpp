@@ -0,0 +1,129 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    /// Obstacle blob in front of the start pose and a tool mesh reaching into it.
+    template <typename Planner>
+    void setupScene(Planner& planner, std::mt19937& gen) {
+        setupRandomScene(planner,
+                         gen,
+                         400,
+                         Eigen::Vector3f(0.1f, 0.1f, 0.1f),
+                         Eigen::Vector3f(0.0f, 0.0f, 0.25f),
+                         30,
+                         Eigen::Vector3f::Constant(0.04f),
+                         Eigen::Vector3f(0.0f, 0.0f, 0.06f));
+    }
+}  // namespace
+
+TEST_CASE("Batched cost matches the per-sample cost", "[cost]") {
+    using Planner = PlannerMpc<6, 6, 4, double>;
+    Planner planner;
+    std::mt19937 gen(21);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    setupScene(planner, gen);
+    planner.min_visible_points = 300;
+    planner.alpha_visibility   = 0.01;
+    planner.H_0.translation()  = Eigen::Vector3d(0.02, -0.03, 0.05);
+    planner.H_goal = stateToIsometry<double>(Eigen::Vector3d(0.2, 0.1, 0.1), Eigen::Vector3d(0.3, -0.2, 0.5));
+    planner.collision_backend   = GENERATE(CollisionBackend::KdTree, CollisionBackend::Esdf);
+    planner.rotation_integrator = GENERATE(RotationIntegrator::Euler, RotationIntegrator::ExpMap);
+    planner.prepareScene();
+
+    // Small controls near the start and large rotations that take the other branches of the orientation error.
+    const int K = 40;
+    Planner::CandidateMatrix candidates(K, 24);
+    for (int i = 0; i < K; ++i) {
+        const double scale = i < K / 2 ? 0.05 : 0.8;
+        for (int j = 0; j < 24; ++j) {
+            candidates(i, j) = scale * unit(gen);
+        }
+    }
+    candidates.row(0).setZero();
+
+    const Eigen::VectorXd costs = planner.costBatch(candidates);
+    REQUIRE(costs.size() == K);
+    CollisionWorkspace workspace;
+    for (int i = 0; i < K; ++i) {
+        const Planner::ActionSequence U = candidates.row(i).transpose();
+        CHECK(costs(i) == Approx(planner.cost(U, workspace)).epsilon(1e-9));
+    }
+
+    // A sub-block of rows (as used by the MPPI chunks) gives the same costs.
+    Eigen::VectorXd block_costs(10);
+    Planner::BatchWorkspace batch;
+    planner.costBatch(candidates.middleRows(5, 10), block_costs, workspace, batch);
+    for (int i = 0; i < 10; ++i) {
+        CHECK(block_costs(i) == Approx(costs(5 + i)).epsilon(1e-12));
+    }
+
+    // With a bound, candidates above it are abandoned at infinity and the others are unchanged.
+    std::vector<double> sorted(costs.data(), costs.data() + K);
+    std::sort(sorted.begin(), sorted.end());
+    const double bound = sorted[K / 2];
+    Eigen::VectorXd bounded_costs(K);
+    const Eigen::Index abandoned = planner.costBatch(candidates, bounded_costs, workspace, batch, bound);
+    CHECK(abandoned == (costs.array() > bound).count());
+    for (int i = 0; i < K; ++i) {
+        if (costs(i) > bound)
+            CHECK(std::isinf(bounded_costs(i)));
+        else
+            CHECK(bounded_costs(i) == Approx(costs(i)).epsilon(1e-12));
+    }
+}
+
+TEST_CASE("MPPI pruning keeps the update and skips far candidates", "[cost]") {
+    using Planner = PlannerMpc<6, 6, 2, double>;
+    Planner planner;
+    std::mt19937 gen(21);
+    setupScene(planner, gen);
+    planner.num_samples = 256;
+    planner.num_threads = 2;
+    planner.H_goal      = stateToIsometry<double>(Eigen::Vector3d(0.2, 0.1, 0.1), Eigen::Vector3d(0.3, -0.2, 0.5));
+
+    Planner pruning = planner;
+    pruning.mppi_pruning = true;
+    const std::vector<double> full   = planner.getActionMPPI(Eigen::Isometry3d::Identity());
+    const std::vector<double> pruned = pruning.getActionMPPI(Eigen::Isometry3d::Identity());
+    REQUIRE(pruned.size() == full.size());
+    for (std::size_t j = 0; j < full.size(); ++j) {
+        CHECK(pruned[j] == Approx(full[j]).margin(1e-6));
+    }
+    CHECK(pruning.mppi_candidates == 256);
+    // The candidate that set the bound is evaluated once, not again in its chunk.
+    CHECK(pruning.cost_evaluations == 256);
+    CHECK(pruning.mppi_pruned > 0);
+    CHECK(pruning.profiler.totals.nn_queries < planner.profiler.totals.nn_queries);
+}
+
+TEST_CASE("MPPI pruning keeps a finite update when the step deadline drops chunks", "[cost]") {
+    using Planner = PlannerMpc<6, 6, 2, double>;
+    Planner planner;
+    std::mt19937 gen(21);
+    setupScene(planner, gen);
+    planner.H_goal = stateToIsometry<double>(Eigen::Vector3d(0.2, 0.1, 0.1), Eigen::Vector3d(0.3, -0.2, 0.5));
+    // Only the first chunk of one candidate runs before the deadline, and it is pruned unless it set the bound.
+    planner.num_samples         = 256;
+    planner.num_threads         = 1;
+    planner.mppi_chunk_size     = 1;
+    planner.mppi_pruning        = true;
+    planner.mppi_prune_margin   = 0.0;
+    planner.step_time_budget_ms = 1e-9;
+
+    for (int call = 0; call < 5; ++call) {
+        const std::vector<double> U_opt = planner.getActionMPPI(Eigen::Isometry3d::Identity());
+        REQUIRE(U_opt.size() == 12);
+        for (std::size_t j = 0; j < U_opt.size(); ++j) {
+            CHECK(std::isfinite(U_opt[j]));
+            CHECK(std::isfinite(planner.U[j]));
+        }
+    }
+    CHECK(planner.mppi_candidates == 5);
+}
@@ -0,0 +1,165 @@
+#include <Eigen/Dense>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    using Planner = PlannerMpc<6, 6, 3, double>;
+
+    // Builds a small synthetic scene: a random obstacle blob in front of the camera and a box-shaped tool mesh.
+    void setupScene(Planner& planner) {
+        std::mt19937 gen(3);
+        setupRandomScene(planner,
+                         gen,
+                         400,
+                         Eigen::Vector3f(0.1f, 0.1f, 0.1f),
+                         Eigen::Vector3f(0.0f, 0.0f, 0.25f),
+                         30,
+                         Eigen::Vector3f::Constant(0.04f),
+                         Eigen::Vector3f(0.0f, 0.0f, 0.06f));
+
+        planner.w_p                  = 1e2;
+        planner.w_q                  = 1e1;
+        planner.w_p_term             = 1e3;
+        planner.w_q_term             = 1e2;
+        planner.w_look_at_goal       = 1e1;
+        planner.w_obs                = 1e2;
+        planner.collision_margin     = 0.05;
+        planner.visibility_min_range = 0.07;
+        planner.visibility_max_range = 0.5;
+        planner.min_visible_points   = 450;
+        planner.alpha_visibility     = 0.01;
+        planner.visibility_smoothing = 0.01;
+
+        planner.H_0               = Eigen::Isometry3d::Identity();
+        planner.H_0.translation() = Eigen::Vector3d(0.02, -0.03, 0.05);
+        planner.H_goal = stateToIsometry<double>(Eigen::Vector3d(0.2, 0.1, 0.1), Eigen::Vector3d(0.3, -0.2, 0.5));
+    }
+
+    // Central finite-difference gradient of the cost.
+    std::vector<double> finiteDifferenceGradient(Planner& planner, const std::vector<double>& U, double h) {
+        std::vector<double> grad(U.size()), no_grad;
+        for (std::size_t i = 0; i < U.size(); ++i) {
+            std::vector<double> U_plus = U, U_minus = U;
+            U_plus[i] += h;
+            U_minus[i] -= h;
+            grad[i] = (planner.cost(U_plus, no_grad) - planner.cost(U_minus, no_grad)) / (2 * h);
+        }
+        return grad;
+    }
+
+    void checkGradient(Planner& planner, double h, double rel_tol) {
+        std::mt19937 gen(11);
+        std::uniform_real_distribution<double> unit(-1.0, 1.0);
+        for (int trial = 0; trial < 5; ++trial) {
+            std::vector<double> U(6 * 3);
+            for (std::size_t i = 0; i < U.size(); ++i) {
+                U[i] = (i % 6 < 3 ? 0.02 : 0.1) * unit(gen);
+            }
+            std::vector<double> grad(U.size()), no_grad;
+            const double value = planner.cost(U, grad);
+            CHECK(value == Approx(planner.cost(U, no_grad)).epsilon(1e-6));
+
+            const std::vector<double> fd = finiteDifferenceGradient(planner, U, h);
+            Eigen::Map<const Eigen::VectorXd> g(grad.data(), grad.size());
+            Eigen::Map<const Eigen::VectorXd> g_fd(fd.data(), fd.size());
+            INFO("analytic: " << g.transpose() << "\nfinite difference: " << g_fd.transpose());
+            CHECK(g_fd.norm() > 0.0);
+            CHECK((g - g_fd).norm() <= rel_tol * std::max(1.0, g_fd.norm()));
+        }
+    }
+}  // namespace
+
+TEST_CASE("Pose cost gradient matches finite differences", "[gradient]") {
+    Planner planner;
+    setupScene(planner);
+    planner.rotation_integrator = GENERATE(RotationIntegrator::Euler, RotationIntegrator::ExpMap);
+    planner.w_obs              = 0.0;
+    planner.min_visible_points = 0;
+    checkGradient(planner, 1e-6, 1e-5);
+}
+
+TEST_CASE("Collision cost gradient matches finite differences", "[gradient]") {
+    Planner planner;
+    setupScene(planner);
+    planner.rotation_integrator = GENERATE(RotationIntegrator::Euler, RotationIntegrator::ExpMap);
+    planner.w_p = planner.w_q = planner.w_p_term = planner.w_q_term = planner.w_look_at_goal = 0.0;
+    planner.min_visible_points                                                          = 0;
+
+    SECTION("KD-tree backend") {
+        planner.collision_backend = CollisionBackend::KdTree;
+        checkGradient(planner, 1e-5, 1e-2);
+    }
+    SECTION("ESDF backend") {
+        planner.collision_backend = CollisionBackend::Esdf;
+        planner.esdf_resolution   = 0.005;
+        checkGradient(planner, 1e-5, 5e-2);
+    }
+}
+
+TEST_CASE("Smoothed visibility cost gradient matches finite differences", "[gradient]") {
+    Planner planner;
+    setupScene(planner);
+    planner.rotation_integrator = GENERATE(RotationIntegrator::Euler, RotationIntegrator::ExpMap);
+    planner.w_p = planner.w_q = planner.w_p_term = planner.w_q_term = planner.w_look_at_goal = 0.0;
+    planner.w_obs                                                                       = 0.0;
+    checkGradient(planner, 1e-5, 1e-2);
+}
+
+TEST_CASE("Full cost gradient matches finite differences", "[gradient]") {
+    Planner planner;
+    setupScene(planner);
+    planner.rotation_integrator = GENERATE(RotationIntegrator::Euler, RotationIntegrator::ExpMap);
+    checkGradient(planner, 1e-5, 1e-2);
+}
+
+TEST_CASE("Gradient algorithms smooth the visibility count when visibility_smoothing is 0", "[gradient]") {
+    Planner planner;
+    setupScene(planner);
+    planner.visibility_smoothing = 0.0;
+    CHECK(planner.visibilitySmoothing() == 0.0);
+
+    planner.nlopt_algorithm = nlopt::LD_SLSQP;
+    CHECK(planner.visibilitySmoothing() == planner.gradient_visibility_smoothing);
+    planner.w_p = planner.w_q = planner.w_p_term = planner.w_q_term = planner.w_look_at_goal = 0.0;
+    planner.w_obs                                                                       = 0.0;
+    std::vector<double> U(6 * 3, 0.01), grad(U.size());
+    planner.cost(U, grad);
+    CHECK(Eigen::Map<const Eigen::VectorXd>(grad.data(), grad.size()).norm() > 0.0);
+    checkGradient(planner, 1e-5, 1e-2);
+}
+
+TEST_CASE("Smoothed visibility gradient skips non-finite points", "[gradient]") {
+    Planner clean, planner;
+    setupScene(clean);
+    setupScene(planner);
+    planner.w_p = planner.w_q = planner.w_p_term = planner.w_q_term = planner.w_look_at_goal = 0.0;
+    planner.w_obs                                                                       = 0.0;
+
+    clean.w_p = clean.w_q = clean.w_p_term = clean.w_q_term = clean.w_look_at_goal = 0.0;
+    clean.w_obs                                                                    = 0.0;
+
+    // The NaNs of an organized cloud, one of them in front of the camera in x and y.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>(*planner.obstacle_cloud));
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    cloud->points.emplace_back(nan, nan, nan);
+    cloud->points.emplace_back(0.0f, 0.0f, nan);
+    cloud->points.emplace_back(0.0f, std::numeric_limits<float>::infinity(), 0.25f);
+    cloud->is_dense = false;
+    setObstacleCloud(planner, cloud);
+
+    std::vector<double> U(6 * 3, 0.01), grad(U.size()), clean_grad(U.size());
+    const double value = planner.cost(U, grad);
+    CHECK(std::isfinite(value));
+    CHECK(value == Approx(clean.cost(U, clean_grad)));
+    for (std::size_t i = 0; i < U.size(); ++i) {
+        CHECK(std::isfinite(grad[i]));
+        CHECK(grad[i] == Approx(clean_grad[i]).margin(1e-9));
+    }
+    checkGradient(planner, 1e-5, 1e-2);
+}
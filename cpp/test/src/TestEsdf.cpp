@@ -0,0 +1,34 @@
+#include <Eigen/Dense>
+#include <cmath>
+
+#include "../../include/esdf.hpp"
+#include "catch2/catch.hpp"
+
+TEST_CASE("Distance field coarsens a grid above max_nodes", "[esdf]") {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    cloud->points.emplace_back(0.0f, 0.0f, 0.0f);
+    cloud->points.emplace_back(2.0f, 1.0f, 0.5f);
+
+    // 2 x 1 x 0.5 m at 1 cm needs about 1.6e6 nodes with the padding.
+    EsdfGrid esdf;
+    esdf.max_nodes = 100000;
+    esdf.build(cloud, 0.01f, 0.05f);
+    REQUIRE_FALSE(esdf.empty());
+    CHECK(esdf.numNodes() <= 100000);
+    CHECK(esdf.resolution() > 0.01f);
+    CHECK(esdf.isBuiltFrom(cloud, 0.01f, 0.05f));
+    CHECK(esdf.distance(Eigen::Vector3f(2.0f, 1.0f, 0.5f)) < 0.5f * std::sqrt(3.0f) * esdf.resolution());
+    CHECK(esdf.distance(Eigen::Vector3f(1.0f, 0.5f, 0.25f)) == 0.05f);
+
+    // The node count of a far outlier no longer overflows int.
+    cloud->points.emplace_back(2000.0f, 2000.0f, 2000.0f);
+    esdf.build(cloud, 0.01f, 0.05f);
+    CHECK(esdf.numNodes() <= 100000);
+    CHECK(esdf.numNodes() == static_cast<std::size_t>(esdf.dims().cast<std::int64_t>().prod()));
+
+    // Within the cap the requested spacing is kept.
+    esdf.max_nodes = std::int64_t(1) << 28;
+    cloud->points.pop_back();
+    esdf.build(cloud, 0.02f, 0.05f);
+    CHECK(esdf.resolution() == 0.02f);
+}
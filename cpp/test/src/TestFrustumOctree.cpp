@@ -0,0 +1,179 @@
+#include <Eigen/Dense>
+#include <cmath>
+#include <limits>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "../../include/frustum_octree.hpp"
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+
+TEST_CASE("Octree frustum count equals the per-point count", "[visibility]") {
+    std::mt19937 gen(23);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (int i = 0; i < 20000; ++i) {
+        cloud->points.emplace_back(0.3f * unit(gen), 0.3f * unit(gen), 0.3f + 0.2f * unit(gen));
+    }
+    // A regular grid puts many points exactly on cell boundaries, and duplicates stop the subdivision.
+    for (float x = -0.2f; x <= 0.2f; x += 0.01f) {
+        for (float y = -0.2f; y <= 0.2f; y += 0.01f) {
+            cloud->points.emplace_back(x, y, 0.25f);
+        }
+    }
+    for (int i = 0; i < 100; ++i) {
+        cloud->points.emplace_back(0.05f, 0.0f, 0.2f);
+    }
+    cloud->points.emplace_back(std::numeric_limits<float>::quiet_NaN(), 0.0f, 0.2f);
+
+    FrustumPointsSoA points;
+    points.setInputCloud(cloud);
+    FrustumOctree octree;
+    octree.setInputCloud(cloud, 16);
+    REQUIRE(octree.isBuiltFrom(cloud));
+    CHECK(octree.nodes().front().end - octree.nodes().front().begin == cloud->size() - 1);
+
+    std::size_t total_tested = 0;
+    std::size_t total_count  = 0;
+    for (int s = 0; s < 200; ++s) {
+        // Cameras behind the cloud looking roughly along +Z.
+        const Eigen::Isometry3d pose = stateToIsometry<double>(
+            Eigen::Vector3d(0.1 * unit(gen), 0.1 * unit(gen), -0.2 + 0.1 * unit(gen)),
+            Eigen::Vector3d(0.3 * unit(gen), 0.3 * unit(gen), 0.3 * unit(gen)));
+        const FrustumPlanes planes = computeFrustumPlanes(60.0, 0.05, 0.5 + 0.3 * unit(gen), pose);
+        std::size_t tested         = 0;
+        const std::size_t count    = octree.countInFrustum(planes, &tested);
+        CHECK(count == points.countInFrustum(planes));
+        total_tested += tested;
+        total_count += count;
+    }
+    // Most of the counted points come from cells entirely inside the frustum.
+    CHECK(total_count > 0);
+    CHECK(total_tested < total_count);
+}
+
+TEST_CASE("Visible point counts do not depend on the octree", "[visibility]") {
+    PlannerMpc<6, 6, 1, double> planner;
+    std::mt19937 gen(23);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (int i = 0; i < 5000; ++i) {
+        cloud->points.emplace_back(0.2f * unit(gen), 0.2f * unit(gen), 0.4f + 0.1f * unit(gen));
+    }
+    planner.obstacle_cloud = cloud;
+    for (int s = 0; s < 50; ++s) {
+        const Eigen::Isometry3d pose = stateToIsometry<double>(
+            Eigen::Vector3d(0.1 * unit(gen), 0.1 * unit(gen), 0.1 * unit(gen)),
+            Eigen::Vector3d(0.3 * unit(gen), 0.3 * unit(gen), 0.3 * unit(gen)));
+        planner.use_visibility_octree = true;
+        const std::size_t count       = planner.countVisiblePoints(pose);
+        planner.use_visibility_octree = false;
+        CHECK(count == planner.countVisiblePoints(pose));
+    }
+}
+
+TEST_CASE("Visible point counts follow an in-place cloud edit after invalidateScene", "[visibility]") {
+    PlannerMpc<6, 6, 1, double> planner;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (int i = 0; i < 100; ++i) {
+        cloud->points.emplace_back(0.001f * i, 0.0f, 0.3f);
+    }
+    planner.obstacle_cloud = cloud;
+    const Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    planner.use_visibility_octree = GENERATE(true, false);
+    REQUIRE(planner.countVisiblePoints(pose) == 100);
+
+    // Moving the points behind the camera keeps the cloud's address and size, which the rebuild check cannot see.
+    for (auto& point : cloud->points) {
+        point.z = -0.3f;
+    }
+    planner.invalidateScene();
+    CHECK(planner.countVisiblePoints(pose) == 0);
+}
+
+TEST_CASE("Frustum counts agree with getFrustrumCloud near the frustum planes", "[visibility]") {
+    std::mt19937 gen(123);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    const double fov = 60.0, near_plane = 0.05, far_plane = 0.5;
+    const double slope = std::tan(fov * M_PI / 360.0);
+
+    std::vector<Eigen::Isometry3d> poses;
+    for (int s = 0; s < 40; ++s) {
+        poses.push_back(stateToIsometry<double>(Eigen::Vector3d(0.1 * unit(gen), 0.1 * unit(gen), 0.1 * unit(gen)),
+                                                Eigen::Vector3d(0.5 * unit(gen), 0.5 * unit(gen), 3.0 * unit(gen))));
+    }
+
+    // Points on and within a few float roundings of the six faces of every frustum, so that the plane tests are
+    // decided by their rounding, plus a uniform background.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (const auto& pose : poses) {
+        const Eigen::Matrix4f camera = frustumCameraPose(pose);
+        const Eigen::Vector3d view   = camera.block<3, 1>(0, 0).cast<double>();
+        const Eigen::Vector3d up     = camera.block<3, 1>(0, 1).cast<double>();
+        const Eigen::Vector3d right  = camera.block<3, 1>(0, 2).cast<double>();
+        const Eigen::Vector3d T      = camera.block<3, 1>(0, 3).cast<double>();
+        for (int i = 0; i < 300; ++i) {
+            const int face = i % 6;
+            double depth   = near_plane + (far_plane - near_plane) * 0.5 * (1.0 + unit(gen));
+            double u       = unit(gen);
+            double v       = unit(gen);
+            if (face == 0)
+                depth = near_plane;
+            else if (face == 1)
+                depth = far_plane;
+            else if (face == 2)
+                u = 1.0;
+            else if (face == 3)
+                u = -1.0;
+            else if (face == 4)
+                v = 1.0;
+            else
+                v = -1.0;
+            const Eigen::Vector3d p = T + depth * (view + slope * (u * up + v * right));
+            const double jitter     = (i / 6) % 3 == 0 ? 0.0 : 1e-6 * unit(gen);
+            cloud->points.emplace_back(static_cast<float>(p.x() + jitter),
+                                       static_cast<float>(p.y() - jitter),
+                                       static_cast<float>(p.z() + jitter));
+        }
+    }
+    for (int i = 0; i < 5000; ++i) {
+        cloud->points.emplace_back(0.6 * unit(gen), 0.6 * unit(gen), 0.6 * unit(gen));
+    }
+
+    FrustumPointsSoA points;
+    points.setInputCloud(cloud);
+    FrustumOctree octree;
+    octree.setInputCloud(cloud, 8);
+
+    std::size_t total = 0;
+    for (const auto& pose : poses) {
+        const FrustumPlanes planes = computeFrustumPlanes(fov, near_plane, far_plane, pose);
+        const std::size_t expected = getFrustrumCloud(cloud, fov, near_plane, far_plane, pose)->size();
+        CHECK(points.countInFrustum(planes) == expected);
+        CHECK(octree.countInFrustum(planes) == expected);
+        total += expected;
+    }
+    CHECK(total > 0);
+}
+
+TEST_CASE("A released cloud never matches the octree built from it", "[visibility]") {
+    using Cloud = pcl::PointCloud<pcl::PointXYZ>;
+    Cloud points;
+    for (int i = 0; i < 100; ++i) {
+        points.points.emplace_back(0.01f * i, 0.0f, 0.3f);
+    }
+    // Both clouds live in the same storage, as if the allocator handed the released address out again.
+    alignas(Cloud) unsigned char storage[sizeof(Cloud)];
+    auto make = [&storage, &points]() {
+        return Cloud::ConstPtr(new (storage) Cloud(points), [](const Cloud* c) { c->~Cloud(); });
+    };
+
+    Cloud::ConstPtr cloud = make();
+    FrustumOctree octree;
+    octree.setInputCloud(cloud);
+    REQUIRE(octree.isBuiltFrom(cloud));
+    cloud.reset();
+    cloud = make();
+    CHECK_FALSE(octree.isBuiltFrom(cloud));
+}
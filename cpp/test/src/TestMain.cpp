@@ -1,4 +1,4 @@
-#define CATCH_MAIN
+#define CATCH_CONFIG_MAIN
 #include <Eigen/Dense>
 
 #include "catch2/catch.hpp"
@@ -0,0 +1,102 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../../include/mppi_noise.hpp"
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+
+TEST_CASE("Philox and the inverse normal CDF match their references", "[noise]") {
+    // Known-answer vector of the Random123 distribution.
+    const auto r = philox4x32({0, 0, 0, 0}, {0, 0});
+    CHECK(r[0] == 0x6627e8d5u);
+    CHECK(r[1] == 0xe169c58du);
+    CHECK(r[2] == 0xbc57ac4cu);
+    CHECK(r[3] == 0x9b00dbd8u);
+
+    for (double p : {1e-9, 1e-4, 0.01, 0.02425, 0.1, 0.3, 0.5, 0.7, 0.975, 0.99, 1.0 - 1e-6}) {
+        const double x = inverseNormalCdf(p);
+        CHECK(0.5 * std::erfc(-x / std::sqrt(2.0)) == Approx(p).epsilon(1e-7));
+    }
+}
+
+TEST_CASE("Noise engines give reproducible standard normal rows", "[noise]") {
+    const auto engine = GENERATE(NoiseEngine::Philox, NoiseEngine::Sobol, NoiseEngine::Halton);
+    const int dim     = 30;  // Past the Sobol table, so the Philox fallback is covered too.
+    const int n       = 4096;
+    MppiNoiseSampler sampler(engine, dim, 7, 3);
+    Eigen::MatrixXd noise(n, dim);
+    for (int i = 0; i < n; ++i) {
+        sampler.sample(i, noise.row(i));
+    }
+    for (int j = 0; j < dim; ++j) {
+        CHECK(std::abs(noise.col(j).mean()) < 0.1);
+        CHECK(noise.col(j).squaredNorm() / n == Approx(1.0).margin(0.1));
+    }
+
+    // A row only depends on (seed, call, index); another call gives other noise.
+    Eigen::RowVectorXd row(dim);
+    MppiNoiseSampler(engine, dim, 7, 3).sample(1234, row);
+    CHECK(row == noise.row(1234));
+    MppiNoiseSampler(engine, dim, 7, 4).sample(1234, row);
+    CHECK(row != noise.row(1234));
+
+    // Every bit of the 64-bit call counts.
+    for (std::uint64_t call : {3ull | (1ull << 63), 3ull ^ (1ull << 48), 3ull | (1ull << 32)}) {
+        MppiNoiseSampler(engine, dim, 7, call).sample(1234, row);
+        CHECK(row != noise.row(1234));
+    }
+}
+
+TEST_CASE("Sobol noise is stratified", "[noise]") {
+    // The first 2^m points of each dimension fill every interval of width 2^-m once, and the first two dimensions
+    // fill every square of a 4 x 4 grid once in 16 points; the inverse CDF keeps the order, so the strata are
+    // recovered through the normal CDF.
+    const int dim = MppiNoiseSampler::SobolDimensions;
+    const int n   = 64;
+    MppiNoiseSampler sampler(NoiseEngine::Sobol, dim, 11, 0);
+    Eigen::MatrixXd u(n, dim);
+    for (int i = 0; i < n; ++i) {
+        sampler.sample(i, u.row(i));
+    }
+    u = u.unaryExpr([](double x) { return 0.5 * std::erfc(-x / std::sqrt(2.0)); });
+    for (int j = 0; j < dim; ++j) {
+        std::vector<int> cells(n, 0);
+        for (int i = 0; i < n; ++i) {
+            ++cells[static_cast<int>(u(i, j) * n)];
+        }
+        CHECK(std::count(cells.begin(), cells.end(), 1) == n);
+    }
+    std::vector<int> squares(16, 0);
+    for (int i = 0; i < 16; ++i) {
+        ++squares[4 * static_cast<int>(u(i, 0) * 4) + static_cast<int>(u(i, 1) * 4)];
+    }
+    CHECK(std::count(squares.begin(), squares.end(), 1) == 16);
+}
+
+TEST_CASE("MPPI noise follows the schedule and not the thread count", "[noise]") {
+    using Planner = PlannerMpc<6, 6, 2, double>;
+    Planner planner;
+    planner.num_samples  = 200;
+    planner.noise_engine = GENERATE(NoiseEngine::Philox, NoiseEngine::Sobol, NoiseEngine::Halton);
+    planner.H_goal       = stateToIsometry<double>(Eigen::Vector3d(0.2, 0.1, 0.1), Eigen::Vector3d(0.3, -0.2, 0.5));
+
+    Planner one_thread  = planner;
+    Planner two_threads = planner;
+
+    one_thread.num_threads  = 1;
+    two_threads.num_threads = 2;
+    CHECK(one_thread.getActionMPPI(Eigen::Isometry3d::Identity())
+          == two_threads.getActionMPPI(Eigen::Isometry3d::Identity()));
+
+    // Without noise on the second step its controls stay at the mean.
+    planner.noise_schedule = {1.0, 0.0};
+    const std::vector<double> U = planner.getActionMPPI(Eigen::Isometry3d::Identity());
+    double first_step = 0.0;
+    for (int j = 0; j < 6; ++j) {
+        first_step += std::abs(U[j]);
+        CHECK(U[6 + j] == 0.0);
+    }
+    CHECK(first_step > 0.0);
+}
@@ -0,0 +1,105 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    using Planner = PlannerMpc<6, 6, 4, double>;
+
+    void setupScene(Planner& planner) {
+        std::mt19937 gen(25);
+        setupRandomScene(planner, gen, 1000, Eigen::Vector3f(0.2f, 0.2f, 0.1f), Eigen::Vector3f(0.0f, 0.0f, 0.4f), 30);
+        planner.H_goal = stateToIsometry<double>(Eigen::Vector3d(0.15, -0.1, 0.2), Eigen::Vector3d(0.2, -0.1, 0.3));
+    }
+}  // namespace
+
+TEST_CASE("COBYLA seeds cover the warm start, zero, the goal and perturbations", "[multistart]") {
+    Planner planner;
+    setupScene(planner);
+    planner.rotation_integrator = GENERATE(RotationIntegrator::Euler, RotationIntegrator::ExpMap);
+    planner.U.assign(24, 0.01);
+
+    const auto seeds = planner.cobylaSeeds(6);
+    REQUIRE(seeds.size() == 6);
+    CHECK(seeds[0] == planner.U);
+    CHECK(std::all_of(seeds[1].begin(), seeds[1].end(), [](double u) { return u == 0.0; }));
+    for (const auto& seed : seeds) {
+        REQUIRE(seed.size() == 24);
+        for (int k = 0; k < 4; ++k) {
+            for (int j = 0; j < 6; ++j) {
+                const double u = seed[6 * k + j];
+                CHECK(u >= (j < 3 ? planner.dp_min : planner.dtheta_min));
+                CHECK(u <= (j < 3 ? planner.dp_max : planner.dtheta_max));
+            }
+        }
+    }
+
+    // The goal is within reach of the horizon, so the goal-directed seed ends on it.
+    const Eigen::Isometry3d end = planner.rolloutPoses(seeds[2])[4];
+    CHECK(homogeneousError(end, planner.H_goal).norm() < 1e-9);
+
+    // The perturbed seeds differ from each other and change with every multi-start getAction call.
+    CHECK(seeds[3] != seeds[0]);
+    CHECK(seeds[3] != seeds[4]);
+    CHECK(planner.cobylaSeeds(6) == seeds);
+    ++planner.cobyla_call_count;
+    CHECK(planner.cobylaSeeds(6)[3] != seeds[3]);
+}
+
+TEST_CASE("COBYLA seeds do not reuse the MPPI noise of the same call", "[multistart]") {
+    // In MppiCobyla both call counts advance together, so the perturbations must not be the MPPI candidates.
+    Planner planner;
+    planner.U.assign(24, 0.0);
+    planner.noise_std_pos = planner.noise_std_ori = 1e-3;
+    for (std::uint64_t call : {0ull, 1ull, 5ull}) {
+        planner.cobyla_call_count = call;
+        const auto seeds          = planner.cobylaSeeds(8);
+        const MppiNoiseSampler mppi(NoiseEngine::Philox, 24, planner.mppi_seed, call);
+        Eigen::Matrix<double, 1, 24> noise;
+        for (int s = 3; s < 8; ++s) {
+            mppi.sample(static_cast<std::uint64_t>(s), noise);
+            // The seeds are the noise scaled per step; compare the first step, where the scale is one.
+            for (int j = 0; j < 6; ++j) {
+                CHECK(seeds[s][j] != Approx(noise(j) * 1e-3).margin(1e-12));
+            }
+        }
+    }
+}
+
+TEST_CASE("Multi-start COBYLA keeps the best start", "[multistart]") {
+    Planner planner;
+    setupScene(planner);
+    planner.cobyla_max_evaluations = 60;
+
+    Planner single                 = planner;
+    const std::vector<double> base = single.getAction(Eigen::Isometry3d::Identity());
+    REQUIRE(single.cobyla_start_costs.size() == 1);
+    CHECK(single.cobyla_call_count == 0);
+
+    planner.cobyla_starts = 5;
+    Planner one_thread    = planner;
+    Planner two_threads   = planner;
+
+    one_thread.num_threads  = 1;
+    two_threads.num_threads = 2;
+
+    const std::vector<double> U_opt = one_thread.getAction(Eigen::Isometry3d::Identity());
+    CHECK(two_threads.getAction(Eigen::Isometry3d::Identity()) == U_opt);
+    CHECK(two_threads.cobyla_start_costs == one_thread.cobyla_start_costs);
+    CHECK(one_thread.cobyla_call_count == 1);
+
+    // The first start is the single warm-started solve, and each start has its own budget.
+    const auto& costs = one_thread.cobyla_start_costs;
+    REQUIRE(costs.size() == 5);
+    CHECK(costs[0] == single.cobyla_start_costs[0]);
+    CHECK(*std::min_element(costs.begin(), costs.end()) <= costs[0]);
+    std::vector<double> grad;
+    CHECK(one_thread.cost(U_opt, grad) == Approx(*std::min_element(costs.begin(), costs.end())));
+    CHECK(one_thread.cost_evaluations > single.cost_evaluations);
+    if (U_opt != base)
+        CHECK(one_thread.cost(U_opt, grad) < costs[0]);
+}
@@ -0,0 +1,158 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    pcl::PointCloud<pcl::PointXYZ> randomScan(std::mt19937& gen, const Eigen::Vector3f& centre, int n) {
+        std::uniform_real_distribution<float> unit(-0.1f, 0.1f);
+        pcl::PointCloud<pcl::PointXYZ> scan;
+        for (int i = 0; i < n; ++i) {
+            scan.points.emplace_back(centre.x() + unit(gen), centre.y() + unit(gen), centre.z() + unit(gen));
+        }
+        return scan;
+    }
+
+    // Nearest map point by brute force, or infinity beyond the radius.
+    float bruteForceDistance(const pcl::PointCloud<pcl::PointXYZ>& cloud, const Eigen::Vector3f& p, float radius) {
+        float best = std::numeric_limits<float>::infinity();
+        for (const auto& pt : cloud.points) {
+            best = std::min(best, (Eigen::Vector3f(pt.x, pt.y, pt.z) - p).norm());
+        }
+        return best <= radius ? best : std::numeric_limits<float>::infinity();
+    }
+}  // namespace
+
+TEST_CASE("Voxel obstacle map inserts and removes scan batches", "[obstacle_map]") {
+    std::mt19937 gen(11);
+    const auto scan_a = randomScan(gen, Eigen::Vector3f(0.0f, 0.0f, 0.3f), 400);
+    const auto scan_b = randomScan(gen, Eigen::Vector3f(0.12f, 0.0f, 0.3f), 400);
+
+    VoxelObstacleMap map(0.02f);
+    const auto a = map.insert(scan_a);
+    const auto b = map.insert(scan_b);
+    CHECK(map.numBatches() == 2);
+    CHECK(map.cloud()->size() == map.size());
+
+    std::uniform_real_distribution<float> unit(-0.2f, 0.2f);
+    for (int i = 0; i < 50; ++i) {
+        const Eigen::Vector3f p(0.06f + unit(gen), unit(gen), 0.3f + unit(gen));
+        CHECK(map.nearestDistance(p, 0.05f) == bruteForceDistance(*map.cloud(), p, 0.05f));
+    }
+
+    // Removing a batch leaves the same map as inserting only the other one (up to rounding of the centroids).
+    VoxelObstacleMap only_b(0.02f);
+    only_b.insert(scan_b);
+    const std::uint64_t version = map.version();
+    REQUIRE(map.remove(a));
+    CHECK_FALSE(map.remove(a));
+    CHECK(map.version() > version);
+    REQUIRE(map.size() == only_b.size());
+    for (const auto& pt : map.cloud()->points) {
+        const Eigen::Vector3f p(pt.x, pt.y, pt.z);
+        CHECK(only_b.nearestDistance(p, 0.05f) < 1e-5f);
+    }
+
+    REQUIRE(map.remove(b));
+    CHECK(map.size() == 0);
+    CHECK(map.cloud()->empty());
+    CHECK(std::isinf(map.nearestDistance(Eigen::Vector3f(0.0f, 0.0f, 0.3f), 0.05f)));
+}
+
+TEST_CASE("Obstacle map lists the slots changed since a version", "[obstacle_map]") {
+    std::mt19937 gen(13);
+    VoxelObstacleMap map(0.02f);
+    const auto first = map.insert(randomScan(gen, Eigen::Vector3f(0.0f, 0.0f, 0.3f), 300));
+
+    // Bring a copy of the cloud up to date from the changed slots only.
+    pcl::PointCloud<pcl::PointXYZ> copy = *map.cloud();
+    std::uint64_t version                = map.version();
+    std::vector<std::uint32_t> slots;
+    auto update = [&] {
+        REQUIRE(map.changedSlots(version, slots));
+        CHECK(slots.size() < map.size());
+        copy.points.resize(map.cloud()->size());
+        for (std::uint32_t i : slots) {
+            if (i < copy.size())
+                copy.points[i] = map.cloud()->points[i];
+        }
+        version = map.version();
+        for (std::size_t i = 0; i < copy.size(); ++i) {
+            CHECK(copy.points[i].getVector3fMap() == map.cloud()->points[i].getVector3fMap());
+        }
+    };
+    map.insert(randomScan(gen, Eigen::Vector3f(0.05f, 0.0f, 0.3f), 20));
+    const auto third = map.insert(randomScan(gen, Eigen::Vector3f(0.3f, 0.0f, 0.3f), 20));
+    update();
+    REQUIRE(map.remove(third));
+    update();
+    CHECK(map.changedSlots(version, slots));
+    CHECK(slots.empty());
+
+    // Once the journal has been dropped an old copy has to be rebuilt.
+    const std::uint64_t old_version = version;
+    REQUIRE(map.remove(first));
+    for (int i = 0; i < 20; ++i) {
+        map.remove(map.insert(randomScan(gen, Eigen::Vector3f(0.0f, 0.0f, 0.3f), 100)));
+    }
+    CHECK_FALSE(map.changedSlots(old_version, slots));
+    map.clear();
+    CHECK_FALSE(map.changedSlots(old_version, slots));
+    CHECK(map.changedSlots(map.version(), slots));
+}
+
+TEST_CASE("Planner uses the obstacle map for collision and visibility", "[obstacle_map]") {
+    std::mt19937 gen(12);
+    auto map = std::make_shared<VoxelObstacleMap>(0.02f);
+    map->insert(randomScan(gen, Eigen::Vector3f(0.0f, 0.0f, 0.25f), 500));
+
+    PlannerMpc<6, 6, 1, double> planner;
+    planner.obstacle_map      = map;
+    planner.collision_backend = CollisionBackend::VoxelMap;
+    planner.collision_margin  = 0.05;
+    addRandomEndEffector(planner, gen);
+    planner.prepareScene();
+    REQUIRE(planner.obstacle_cloud == map->cloud());
+
+    // Same collision cost as the kd-tree over a copy of the map points.
+    PlannerMpc<6, 6, 1, double> reference;
+    auto snapshot = [&] {
+        setObstacleCloud(reference,
+                         pcl::PointCloud<pcl::PointXYZ>::Ptr(new pcl::PointCloud<pcl::PointXYZ>(*map->cloud())));
+        reference.collision_margin = planner.collision_margin;
+        reference.ee_mesh_cloud    = planner.ee_mesh_cloud;
+        reference.syncEndEffectorPoints();
+    };
+    snapshot();
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    for (int i = 0; i < 20; ++i) {
+        pose.translation() = Eigen::Vector3d(0.12 * unit(gen), 0.12 * unit(gen), 0.25 + 0.12 * unit(gen));
+        CHECK(planner.meshCollisionCost(pose) == Approx(reference.meshCollisionCost(pose)).margin(1e-9));
+    }
+
+    // A new batch is seen by the visibility count after the next prepareScene.
+    Eigen::Isometry3d camera = Eigen::Isometry3d::Identity();
+    const std::size_t before = planner.countVisiblePoints(camera);
+    CHECK(before == reference.countVisiblePoints(camera));
+    const auto batch = map->insert(randomScan(gen, Eigen::Vector3f(0.0f, 0.0f, 0.4f), 300));
+    planner.prepareScene();
+    snapshot();
+    CHECK(planner.countVisiblePoints(camera) == reference.countVisiblePoints(camera));
+    CHECK(planner.countVisiblePoints(camera) > before);
+
+    // The visibility points are updated from the changed slots, also when the map shrinks, and the map is never
+    // counted through the octree.
+    planner.visibility_octree_min_points = 0;
+    REQUIRE(map->remove(batch));
+    planner.prepareScene();
+    snapshot();
+    CHECK_FALSE(planner.countsThroughOctree());
+    CHECK(planner.visibility_points.size() == map->size());
+    CHECK(planner.countVisiblePoints(camera) == reference.countVisiblePoints(camera));
+}
@@ -0,0 +1,119 @@
+#include <Eigen/Dense>
+#include <limits>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+
+namespace {
+    // Adds a square grid of points in the plane z = depth.
+    void addWall(pcl::PointCloud<pcl::PointXYZ>& cloud, float depth, float half_size, float spacing) {
+        for (float x = -half_size; x <= half_size; x += spacing) {
+            for (float y = -half_size; y <= half_size; y += spacing) {
+                cloud.points.emplace_back(x, y, depth);
+            }
+        }
+    }
+}  // namespace
+
+TEST_CASE("Occlusion count hides points behind a wall", "[visibility]") {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr front(new pcl::PointCloud<pcl::PointXYZ>);
+    addWall(*front, 0.2f, 0.1f, 0.005f);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr both(new pcl::PointCloud<pcl::PointXYZ>(*front));
+    addWall(*both, 0.3f, 0.05f, 0.005f);
+
+    // Camera at the origin looking along +Z, so the back wall is entirely behind the front wall.
+    const Eigen::Isometry3d camera = Eigen::Isometry3d::Identity();
+    const FrustumPlanes planes     = computeFrustumPlanes(60.0, 0.05, 0.5, camera);
+
+    FrustumPointsSoA all_points;
+    all_points.setInputCloud(both);
+    const std::size_t in_frustum = all_points.countInFrustum(planes);
+    FrustumPointsSoA front_points;
+    front_points.setInputCloud(front);
+    const std::size_t front_in_frustum = front_points.countInFrustum(planes);
+    REQUIRE(in_frustum > front_in_frustum);
+
+    OcclusionGrid grid;
+    grid.build(both, 0.01f);
+    CHECK(grid.countVisible(planes, Eigen::Vector3f::Zero()) == front_in_frustum);
+
+    // Without the occluder every point in the frustum is visible.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr back(new pcl::PointCloud<pcl::PointXYZ>);
+    addWall(*back, 0.3f, 0.05f, 0.005f);
+    FrustumPointsSoA back_points;
+    back_points.setInputCloud(back);
+    grid.build(back, 0.01f);
+    CHECK(grid.countVisible(planes, Eigen::Vector3f::Zero()) == back_points.countInFrustum(planes));
+}
+
+TEST_CASE("Occlusion backend matches the frustum count on an unoccluded cloud", "[visibility]") {
+    PlannerMpc<6, 6, 1, double> planner;
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    addWall(*cloud, 0.25f, 0.2f, 0.01f);
+    planner.obstacle_cloud       = cloud;
+    planner.visibility_min_range = 0.05;
+    planner.visibility_max_range = 0.5;
+
+    Eigen::Isometry3d pose = Eigen::Isometry3d::Identity();
+    pose.translation()     = Eigen::Vector3d(0.03, -0.02, 0.0);
+    const std::size_t frustum_count = planner.countVisiblePoints(pose);
+    REQUIRE(frustum_count > 0);
+
+    planner.visibility_backend   = VisibilityBackend::Occlusion;
+    planner.occlusion_resolution = 0.02;
+    CHECK(planner.countVisiblePoints(pose) == frustum_count);
+}
+
+TEST_CASE("Occlusion grid skips non-finite points", "[visibility]") {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr finite(new pcl::PointCloud<pcl::PointXYZ>);
+    addWall(*finite, 0.2f, 0.1f, 0.005f);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>(*finite));
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    cloud->points.emplace_back(nan, nan, nan);
+    cloud->points.emplace_back(0.0f, nan, 0.2f);
+    cloud->points.emplace_back(0.0f, std::numeric_limits<float>::infinity(), 0.2f);
+
+    const FrustumPlanes planes = computeFrustumPlanes(60.0, 0.05, 0.5, Eigen::Isometry3d::Identity());
+    FrustumPointsSoA points;
+    points.setInputCloud(cloud);
+
+    OcclusionGrid reference;
+    reference.build(finite, 0.01f);
+    OcclusionGrid grid;
+    grid.build(cloud, 0.01f);
+    CHECK(grid.numOccupied() == reference.numOccupied());
+    CHECK(grid.countVisible(planes, Eigen::Vector3f::Zero()) == points.countInFrustum(planes));
+    CHECK(grid.countVisible(planes, Eigen::Vector3f::Zero())
+          == reference.countVisible(planes, Eigen::Vector3f::Zero()));
+
+    // A cloud with no finite point builds an empty grid.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr only_nan(new pcl::PointCloud<pcl::PointXYZ>);
+    only_nan->points.emplace_back(nan, nan, nan);
+    grid.build(only_nan, 0.01f);
+    CHECK(grid.empty());
+    CHECK(grid.countVisible(planes, Eigen::Vector3f::Zero()) == 0);
+}
+
+TEST_CASE("Occlusion grid coarsens to fit max_voxels", "[visibility]") {
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    addWall(*cloud, 0.2f, 0.1f, 0.005f);
+    const FrustumPlanes planes = computeFrustumPlanes(60.0, 0.05, 0.5, Eigen::Isometry3d::Identity());
+    FrustumPointsSoA points;
+    points.setInputCloud(cloud);
+
+    // Within the cap the requested voxel size is kept.
+    OcclusionGrid grid;
+    grid.build(cloud, 0.01f);
+    CHECK(grid.resolution() == 0.01f);
+
+    // A far outlier would need about 8e15 voxels at 1 cm.
+    cloud->points.emplace_back(2000.0f, 2000.0f, 2000.0f);
+    grid.max_voxels = 100000;
+    grid.build(cloud, 0.01f);
+    REQUIRE_FALSE(grid.empty());
+    CHECK(grid.numVoxels() <= 100000);
+    CHECK(grid.numVoxels() == static_cast<std::size_t>(grid.dims().cast<std::int64_t>().prod()));
+    CHECK(grid.resolution() > 0.01f);
+    CHECK(grid.isBuiltFrom(cloud, 0.01f));
+    CHECK(grid.countVisible(planes, Eigen::Vector3f::Zero()) == points.countInFrustum(planes));
+}
@@ -0,0 +1,167 @@
+#include <Eigen/Dense>
+#include <limits>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "../../include/planner_service.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+TEST_CASE("Plan requests round-trip through the protocol", "[service]") {
+    PlanRequest request;
+    request.start = stateToIsometry<double>(Eigen::Vector3d(0.1, -0.2, 0.7), Eigen::Vector3d(-1.5, 0.1, 0.3));
+    request.goals.push_back(stateToIsometry<double>(Eigen::Vector3d(0.2, 0.4, 0.7), Eigen::Vector3d(0.2, 0.0, 1.0)));
+    request.goals.push_back(Eigen::Isometry3d::Identity());
+    request.overrides = {{PlannerParameter::MaxIterations, 5.0}, {PlannerParameter::SolverMode, 1.0}};
+    PlannerMessageWriter w;
+    request.encode(w);
+
+    PlanRequest decoded;
+    PlannerMessageReader r(w.payload);
+    REQUIRE(decoded.decode(r));
+    CHECK(decoded.start.isApprox(request.start, 1e-12));
+    REQUIRE(decoded.goals.size() == 2);
+    CHECK(decoded.goals[0].isApprox(request.goals[0], 1e-12));
+    CHECK(decoded.overrides == request.overrides);
+
+    // Truncated or padded payloads are rejected.
+    std::vector<char> truncated(w.payload.begin(), w.payload.end() - 1);
+    PlannerMessageReader rt(truncated);
+    CHECK_FALSE(PlanRequest().decode(rt));
+    std::vector<char> padded = w.payload;
+    padded.push_back(0);
+    PlannerMessageReader rp(padded);
+    CHECK_FALSE(PlanRequest().decode(rp));
+}
+
+TEST_CASE("Out-of-range overrides and poses are rejected", "[service]") {
+    PlannerMpc<6, 6, 2, double> planner;
+    const std::vector<std::pair<PlannerParameter, double>> rejected = {
+        {PlannerParameter::MaxIterations, 1e12},
+        {PlannerParameter::MaxIterations, 0.0},
+        {PlannerParameter::NumSamples, 1e12},
+        {PlannerParameter::MppiLambda, 0.0},
+        {PlannerParameter::NoiseStdPosition, -0.01},
+        {PlannerParameter::NoiseStdOrientation, -0.01},
+        {PlannerParameter::MaxStepPosition, -0.1},
+        {PlannerParameter::MaxStepOrientation, -0.1},
+        {PlannerParameter::WeightPosition, std::numeric_limits<double>::quiet_NaN()}};
+    for (const auto& o : rejected) {
+        CHECK_FALSE(applyPlannerParameter(planner, o.first, o.second));
+    }
+    CHECK(planner.dp_min <= planner.dp_max);
+    CHECK(applyPlannerParameter(planner, PlannerParameter::NumSamples, 64.0));
+    CHECK(planner.num_samples == 64);
+
+    PlannerMessageWriter w;
+    w.putPose(Eigen::Isometry3d::Identity());
+    w.payload.resize(w.payload.size() - 7 * sizeof(double));
+    w.put(std::numeric_limits<double>::infinity());
+    for (double v : {0.0, 0.0, 1.0, 0.0, 0.0, 0.0}) {
+        w.put(v);
+    }
+    PlannerMessageReader r(w.payload);
+    Eigen::Isometry3d pose;
+    CHECK_FALSE(r.getPose(pose));
+}
+
+TEST_CASE("The planner service streams waypoints and keeps its scene across requests", "[service]") {
+    using Planner = PlannerMpc<6, 6, 2, double>;
+    Planner planner;
+    std::mt19937 gen(17);
+    setupRandomScene(planner, gen);
+    planner.solver_mode    = SolverMode::Mppi;
+    planner.num_samples    = 32;
+    planner.max_iterations = 20;
+    planner.num_threads    = 1;
+
+    PlannerService<Planner> service(planner, SceneSources(), "");
+    REQUIRE(planner.scene);
+    const auto scene = planner.scene;
+
+    int fds[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    bool keep_running = true;
+    std::thread server([&] { keep_running = service.serveConnection(fds[0]); });
+    const int client = fds[1];
+
+    PlanRequest request;
+    request.start = Eigen::Isometry3d::Identity();
+    request.goals.push_back(stateToIsometry<double>(Eigen::Vector3d(0.1, 0.0, 0.05), Eigen::Vector3d::Zero()));
+    request.goals.push_back(stateToIsometry<double>(Eigen::Vector3d(0.1, 0.1, 0.05), Eigen::Vector3d(0.0, 0.0, 0.2)));
+    request.overrides = {{PlannerParameter::MaxIterations, 3.0}};
+    REQUIRE(sendMessage(client, PlannerMessageType::Plan, request));
+
+    // Waypoints of each goal, then its GoalDone, then PlanDone.
+    PlannerMessageType type;
+    std::vector<char> payload;
+    std::vector<std::vector<Eigen::Isometry3d>> waypoints(2);
+    std::vector<GoalDoneMessage> goals_done;
+    while (receiveMessage(client, type, payload) && type != PlannerMessageType::PlanDone) {
+        PlannerMessageReader r(payload);
+        if (type == PlannerMessageType::Waypoint) {
+            WaypointMessage wp;
+            REQUIRE(wp.decode(r));
+            REQUIRE(wp.goal == goals_done.size());
+            CHECK(wp.index == waypoints[wp.goal].size());
+            waypoints[wp.goal].push_back(wp.pose);
+        }
+        else {
+            REQUIRE(type == PlannerMessageType::GoalDone);
+            goals_done.emplace_back();
+            REQUIRE(goals_done.back().decode(r));
+        }
+    }
+    REQUIRE(type == PlannerMessageType::PlanDone);
+    REQUIRE(goals_done.size() == 2);
+    for (int g = 0; g < 2; ++g) {
+        CHECK(goals_done[g].num_waypoints == waypoints[g].size());
+        CHECK(goals_done[g].iterations <= 3);  // The override applied.
+        REQUIRE(waypoints[g].size() >= 2);
+    }
+    CHECK(waypoints[0].front().isApprox(request.start, 1e-9));
+    CHECK(waypoints[1].front().isApprox(waypoints[0][waypoints[0].size() - 2], 1e-9));
+    // The request planned on its own context: the planner and its scene are unchanged.
+    CHECK(planner.max_iterations == 20);
+    CHECK(planner.scene == scene);
+
+    // An invalid override and a failed reload are reported; the scene stays.
+    request.overrides = {{PlannerParameter::NumSamples, 0.0}};
+    REQUIRE(sendMessage(client, PlannerMessageType::Plan, request));
+    REQUIRE(receiveMessage(client, type, payload));
+    CHECK(type == PlannerMessageType::Error);
+    SceneReloadRequest reload;
+    reload.cloud_path = "missing.pcd";
+    REQUIRE(sendMessage(client, PlannerMessageType::ReloadScene, reload));
+    REQUIRE(receiveMessage(client, type, payload));
+    CHECK(type == PlannerMessageType::Error);
+    CHECK(planner.scene == scene);
+
+    REQUIRE(sendMessage(client, PlannerMessageType::Shutdown));
+    REQUIRE(receiveMessage(client, type, payload));
+    CHECK(type == PlannerMessageType::Ok);
+    server.join();
+    CHECK_FALSE(keep_running);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST_CASE("An idle connection is closed after the receive timeout", "[service]") {
+    using Planner = PlannerMpc<6, 6, 1, double>;
+    Planner planner;
+    std::mt19937 gen(17);
+    setupRandomScene(planner, gen);
+    PlannerService<Planner> service(planner, SceneSources(), "");
+    service.setReceiveTimeout(50);
+
+    int fds[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    // The client never sends; the service gives up on it and keeps running.
+    CHECK(service.serveConnection(fds[0]));
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
@@ -0,0 +1,176 @@
+#include <Eigen/Dense>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    Eigen::Isometry3d pose(double x, double y, double z, double roll, double pitch, double yaw) {
+        return stateToIsometry<double>(Eigen::Vector3d(x, y, z), Eigen::Vector3d(roll, pitch, yaw));
+    }
+}  // namespace
+
+TEST_CASE("Pose cache quantizes position and orientation", "[pose_cache]") {
+    PoseCache cache;
+    cache.configure(1e-3, 1e-2, 1024);
+    REQUIRE(cache.enabled());
+
+    const Eigen::Isometry3d H = pose(0.1, 0.2, 0.3, 0.1, -0.2, 0.3);
+    CHECK(cache.key(H) == cache.key(pose(0.1 + 1e-5, 0.2, 0.3, 0.1, -0.2, 0.3 + 1e-5)));
+    CHECK(cache.key(H) != cache.key(pose(0.1 + 2e-3, 0.2, 0.3, 0.1, -0.2, 0.3)));
+    CHECK(cache.key(H) != cache.key(pose(0.1, 0.2, 0.3, 0.1, -0.2, 0.3 + 5e-2)));
+
+    // Values are computed at the cell's pose, whichever pose of the cell comes first.
+    int computed = 0;
+    auto compute = [&](const Eigen::Isometry3d& cell) {
+        ++computed;
+        CHECK(cell.isApprox(cache.cellPose<double>(cache.key(H)), 1e-12));
+        return 42.0;
+    };
+    CHECK(cache.getOrCompute(pose(0.1 + 1e-5, 0.2, 0.3, 0.1, -0.2, 0.3), compute) == 42.0);
+    CHECK(cache.getOrCompute(H, compute) == 42.0);
+    CHECK(computed == 1);
+    CHECK(cache.stats().hits == 1);
+    CHECK(cache.stats().misses == 1);
+    CHECK(cache.stats().hitRate() == Approx(0.5));
+
+    // The cell's pose is within half a cell of the poses it stands for.
+    const Eigen::Isometry3d cell = cache.cellPose<double>(cache.key(H));
+    CHECK((cell.translation() - H.translation()).cwiseAbs().maxCoeff() <= 0.5e-3 + 1e-12);
+    CHECK(Eigen::AngleAxisd(cell.linear().transpose() * H.linear()).angle() < 2e-2);
+}
+
+TEST_CASE("Pose cache evicts beyond its capacity", "[pose_cache]") {
+    PoseCache cache;
+    cache.configure(1e-3, 1e-2, 64);
+    for (int i = 0; i < 1000; ++i) {
+        cache.getOrCompute(pose(0.01 * i, 0.0, 0.0, 0.0, 0.0, 0.0),
+                           [&](const Eigen::Isometry3d&) { return double(i); });
+    }
+    const PoseCache::Stats stats = cache.stats();
+    CHECK(stats.size <= 64);
+    CHECK(stats.misses == 1000);
+    CHECK(stats.evictions == 1000 - stats.size);
+
+    // The most recent entry survives.
+    double value = 0.0;
+    CHECK(cache.lookup(cache.key(pose(0.01 * 999, 0.0, 0.0, 0.0, 0.0, 0.0)), value));
+    CHECK(value == 999.0);
+}
+
+TEST_CASE("Pose cache is safe to share between threads", "[pose_cache]") {
+    PoseCache cache;
+    cache.configure(1e-3, 1e-2, 256);
+
+    std::vector<Eigen::Isometry3d> poses;
+    for (int i = 0; i < 500; ++i) {
+        poses.push_back(pose(0.01 * (i % 100), 0.0, 0.0, 0.0, 0.0, 0.1 * (i % 7)));
+    }
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (std::size_t j = 0; j < poses.size(); ++j) {
+                const Eigen::Isometry3d& H    = poses[(j * (t + 1)) % poses.size()];
+                const Eigen::Isometry3d cell = cache.cellPose<double>(cache.key(H));
+                const double expected        = cell.translation().x() + 10.0 * cell.rotation()(1, 0);
+                const double value           = cache.getOrCompute(
+                    H, [](const Eigen::Isometry3d& P) { return P.translation().x() + 10.0 * P.rotation()(1, 0); });
+                if (std::abs(value - expected) > 1e-12)
+                    ++wrong;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const PoseCache::Stats stats = cache.stats();
+    CHECK(wrong == 0);
+    CHECK(stats.hits + stats.misses == 4 * poses.size());
+    CHECK(stats.size <= 256);
+}
+
+TEST_CASE("Cached cost matches the exact cost", "[pose_cache]") {
+    PlannerMpc<6, 6, 3, double> planner;
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    setupRandomScene(planner,
+                     gen,
+                     300,
+                     Eigen::Vector3f(0.1f, 0.1f, 0.1f),
+                     Eigen::Vector3f(0.0f, 0.0f, 0.2f),
+                     20,
+                     Eigen::Vector3f::Constant(0.03f),
+                     Eigen::Vector3f(0.0f, 0.0f, 0.05f));
+    planner.min_visible_points = 250;
+    planner.H_0.translation()  = Eigen::Vector3d(0.0, 0.0, 0.05);
+
+    std::vector<std::vector<double>> samples;
+    for (int i = 0; i < 20; ++i) {
+        std::vector<double> U(6 * 3);
+        for (auto& u : U) {
+            u = 0.02 * unit(gen);
+        }
+        samples.push_back(U);
+    }
+    std::vector<double> no_grad, exact;
+    for (const auto& U : samples) {
+        exact.push_back(planner.cost(U, no_grad));
+    }
+
+    planner.use_pose_cache         = true;
+    planner.cache_position_step    = 1e-7;
+    planner.cache_orientation_step = 1e-7;
+    planner.prepareScene();
+    for (int pass = 0; pass < 2; ++pass) {
+        for (std::size_t i = 0; i < samples.size(); ++i) {
+            CHECK(planner.cost(samples[i], no_grad) == Approx(exact[i]).epsilon(1e-9));
+        }
+    }
+    // Every pose of the second pass is a hit.
+    CHECK(planner.collision_cache.stats().hits >= samples.size() * 4);
+    CHECK(planner.visibility_cache.stats().hits >= samples.size() * 4);
+
+    // Changing a cost parameter invalidates the caches.
+    planner.w_obs *= 2;
+    planner.prepareScene();
+    CHECK(planner.collision_cache.stats().size == 0);
+}
+
+TEST_CASE("Cached MPPI results do not depend on the thread count", "[pose_cache]") {
+    PlannerMpc<6, 6, 3, double> planner;
+    std::mt19937 gen(9);
+    setupRandomScene(planner,
+                     gen,
+                     300,
+                     Eigen::Vector3f(0.1f, 0.1f, 0.1f),
+                     Eigen::Vector3f(0.0f, 0.0f, 0.2f),
+                     20,
+                     Eigen::Vector3f::Constant(0.03f),
+                     Eigen::Vector3f(0.0f, 0.0f, 0.05f));
+    planner.min_visible_points = 250;
+    planner.num_samples        = 256;
+    planner.mppi_chunk_size    = 4;
+    planner.noise_std_pos      = 0.002;
+    planner.noise_std_ori      = 0.01;
+    // Coarse cells, so that samples of different chunks share entries.
+    planner.use_pose_cache         = true;
+    planner.cache_position_step    = 2e-2;
+    planner.cache_orientation_step = 2e-1;
+
+    auto one_thread   = planner;
+    auto four_threads = planner;
+
+    one_thread.num_threads   = 1;
+    four_threads.num_threads = 4;
+    for (int call = 0; call < 3; ++call) {
+        CHECK(four_threads.getActionMPPI(Eigen::Isometry3d::Identity())
+              == one_thread.getActionMPPI(Eigen::Isometry3d::Identity()));
+    }
+    CHECK(one_thread.collision_cache.stats().hits > 0);
+    CHECK(four_threads.collision_cache.stats().hits > 0);
+}
@@ -0,0 +1,52 @@
+#include <Eigen/Dense>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+
+TEST_CASE("Exponential-map rollout composes rotation increments", "[integrator]") {
+    using Planner = PlannerMpc<6, 6, 3, double>;
+    Planner planner;
+    planner.rotation_integrator = RotationIntegrator::ExpMap;
+    // Start at pitch 90 degrees, where roll and yaw increments of the Euler integrator act on the same axis.
+    planner.H_0 = stateToIsometry<double>(Eigen::Vector3d(0.1, 0.2, 0.3), Eigen::Vector3d(0.2, M_PI_2, -0.4));
+
+    std::mt19937 gen(18);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    Planner::ActionSequence U;
+    for (int i = 0; i < U.size(); ++i) {
+        U(i) = 0.1 * unit(gen);
+    }
+    Planner::PoseTrajectory poses;
+    planner.rolloutPoses(U, poses);
+
+    Eigen::Isometry3d expected = planner.H_0;
+    CHECK(poses[0].isApprox(expected, 1e-15));
+    for (int k = 0; k < 3; ++k) {
+        const Eigen::Vector3d dp = U.segment<3>(6 * k), w = U.segment<3>(6 * k + 3);
+        expected.linear()        = Eigen::AngleAxisd(w.norm(), w.normalized()).toRotationMatrix() * expected.linear();
+        expected.translation() += dp;
+        CHECK(poses[k + 1].isApprox(expected, 1e-12));
+        // A control of a given size turns the pose by that angle, whatever the attitude.
+        CHECK(Eigen::AngleAxisd(poses[k + 1].linear() * poses[k].linear().transpose()).angle() ==
+              Approx(w.norm()).epsilon(1e-9));
+    }
+
+    // The states of rollout() describe the same poses.
+    Planner::StateTrajectory states;
+    planner.rollout(U, states);
+    for (int k = 0; k <= 3; ++k) {
+        const Eigen::Isometry3d pose =
+            stateToIsometry<double>(states.col(k).head<3>().eval(), states.col(k).tail<3>().eval());
+        CHECK(pose.isApprox(poses[k], 1e-9));
+    }
+
+    // Small rotations: the series branch of the exponential map and its left Jacobian.
+    const Eigen::Vector3d w_small(1e-8, -2e-8, 3e-8);
+    CHECK(so3Exp<double>(w_small).isApprox(Eigen::AngleAxisd(w_small.norm(), w_small.normalized()).toRotationMatrix()));
+    const Eigen::Vector3d w(0.3, -0.2, 0.4), dw(1e-7, 2e-7, -1e-7);
+    const Eigen::Matrix3d lhs = so3Exp<double>(w + dw);
+    const Eigen::Matrix3d rhs = so3Exp<double>(so3LeftJacobian<double>(w) * dw) * so3Exp<double>(w);
+    CHECK((lhs - rhs).norm() < 1e-12);
+}
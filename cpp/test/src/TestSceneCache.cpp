@@ -0,0 +1,65 @@
+#include <Eigen/Dense>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "../../include/scene_cache.hpp"
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+TEST_CASE("Scene cache round-trips the scene and rejects stale files", "[scene_cache]") {
+    // Stand-in source files; only their contents enter the hash.
+    const std::string cloud_path = "test_scene_cloud.tmp";
+    const std::string mesh_path  = "test_scene_mesh.tmp";
+    const std::string cache_path = "test_scene.scene";
+    std::ofstream(cloud_path) << "cloud v1";
+    std::ofstream(mesh_path) << "mesh v1";
+    SceneSources sources;
+    sources.cloud_path = cloud_path;
+    sources.mesh_path  = mesh_path;
+
+    PlannerMpc<6, 6, 1, double> planner;
+    std::mt19937 gen(3);
+    const auto cloud       = randomBoxCloud(gen, 200, Eigen::Vector3f::Constant(0.1f), Eigen::Vector3f::Zero());
+    planner.obstacle_cloud = cloud;
+    addRandomEndEffector(planner, gen, 10, Eigen::Vector3f::Constant(0.02f));
+    planner.box_min = Eigen::Vector4f(-0.1f, -0.2f, -0.3f, 1.0f);
+    planner.buildEsdf();
+    REQUIRE(writeSceneCache(planner, sources.hash(), cache_path));
+
+    PlannerMpc<6, 6, 1, double> loaded;
+    REQUIRE(loadSceneCache(loaded, sources.hash(), cache_path));
+    REQUIRE(loaded.obstacle_cloud->size() == cloud->size());
+    CHECK(loaded.obstacle_cloud->points[7].y == cloud->points[7].y);
+    REQUIRE(loaded.ee_mesh_points.cols() == 10);
+    CHECK(loaded.ee_mesh_points(2, 4) == planner.ee_mesh_cloud->points[4].z);
+    CHECK(loaded.box_min.isApprox(planner.box_min));
+    REQUIRE(loaded.kd_tree);
+
+    // The mapped distance field answers like the built one and is not rebuilt by the collision queries.
+    loaded.collision_backend  = CollisionBackend::Esdf;
+    planner.collision_backend = CollisionBackend::Esdf;
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    for (int i = 0; i < 20; ++i) {
+        const Eigen::Vector3f p(0.15f * unit(gen), 0.15f * unit(gen), 0.15f * unit(gen));
+        CHECK(loaded.obstacleDistance(p) == planner.obstacleDistance(p));
+    }
+    CHECK(loaded.esdf.isBuiltFrom(loaded.obstacle_cloud,
+                                  static_cast<float>(loaded.esdf_resolution),
+                                  static_cast<float>(loaded.collision_margin)));
+
+    // A changed source file or parameter invalidates the cache.
+    std::ofstream(cloud_path) << "cloud v2";
+    PlannerMpc<6, 6, 1, double> stale;
+    CHECK_FALSE(loadSceneCache(stale, sources.hash(), cache_path));
+    CHECK_FALSE(stale.obstacle_cloud);
+    std::ofstream(cloud_path) << "cloud v1";
+    sources.leaf_size = 0.02f;
+    CHECK_FALSE(loadSceneCache(stale, sources.hash(), cache_path));
+
+    std::remove(cloud_path.c_str());
+    std::remove(mesh_path.c_str());
+    std::remove(cache_path.c_str());
+}
@@ -0,0 +1,162 @@
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+namespace {
+    using Planner = PlannerMpc<6, 6, 1, double>;
+
+    /// Smallest exact mesh clearance over densely sampled poses of the motion checkSegment interpolates.
+    double denseClearance(const Planner& planner,
+                          const pcl::KdTreeFLANN<pcl::PointXYZ>& kd_tree,
+                          const Eigen::Isometry3d& from,
+                          const Eigen::Isometry3d& to) {
+        const Eigen::AngleAxisd turn(from.linear().transpose() * to.linear());
+        std::vector<int> index(1);
+        std::vector<float> dist2(1);
+        double clearance = std::numeric_limits<double>::infinity();
+        for (int k = 0; k <= 200; ++k) {
+            const double s = k / 200.0;
+            const Eigen::Matrix3d R =
+                from.linear() * Eigen::AngleAxisd(s * turn.angle(), turn.axis()).toRotationMatrix();
+            const Eigen::Vector3d t = from.translation() + s * (to.translation() - from.translation());
+            for (Eigen::Index j = 0; j < planner.ee_mesh_points.cols(); ++j) {
+                const Eigen::Vector3d p = R * planner.ee_mesh_points.col(j).cast<double>() + t;
+                kd_tree.nearestKSearch(pcl::PointXYZ(p.x(), p.y(), p.z()), 1, index, dist2);
+                clearance = std::min(clearance, std::sqrt(static_cast<double>(dist2[0])));
+            }
+        }
+        return clearance;
+    }
+}  // namespace
+
+TEST_CASE("Conservative advancement finds collisions between clear waypoints", "[segment]") {
+    std::mt19937 gen(24);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    // A plate of obstacle points at z = 0.3 with 5 mm spacing.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (float x = -0.1f; x <= 0.1f; x += 0.005f) {
+        for (float y = -0.1f; y <= 0.1f; y += 0.005f) {
+            cloud->points.emplace_back(x, y, 0.3f);
+        }
+    }
+    auto map = std::make_shared<VoxelObstacleMap>(0.02f);
+    map->insert(*cloud);
+
+    Planner planner;
+    planner.collision_margin = 0.05;
+    setObstacleCloud(planner, cloud);
+    addRandomEndEffector(planner, gen, 100, Eigen::Vector3f(0.04f, 0.01f, 0.02f));
+    const auto backend = GENERATE(CollisionBackend::KdTree, CollisionBackend::VoxelMap, CollisionBackend::Esdf);
+    planner.collision_backend = backend;
+    if (backend == CollisionBackend::VoxelMap)
+        planner.obstacle_map = map;
+    planner.prepareScene();
+    CollisionWorkspace workspace;
+
+    SECTION("A motion through the plate is caught, although both ends are far from it") {
+        const Eigen::Isometry3d from =
+            stateToIsometry<double>(Eigen::Vector3d(0.0, 0.0, 0.2), Eigen::Vector3d(0.0, 0.0, 0.0));
+        const Eigen::Isometry3d to =
+            stateToIsometry<double>(Eigen::Vector3d(0.02, 0.0, 0.4), Eigen::Vector3d(0.0, 0.0, 0.15));
+        CHECK(planner.meshCollisionCost(from) == 0.0);
+        CHECK(planner.meshCollisionCost(to) == 0.0);
+        const SegmentCheck check = planner.checkSegment(from, to, workspace);
+        CHECK_FALSE(check.collision_free);
+        // The tool reaches 2 cm below the plate just before the middle of the motion.
+        CHECK(check.reached > 0.3);
+        CHECK(check.reached < 0.5);
+        CHECK(check.min_clearance <= planner.segment_clearance);
+    }
+
+    SECTION("A motion in free space takes a few long steps") {
+        const Eigen::Isometry3d from =
+            stateToIsometry<double>(Eigen::Vector3d(0.0, 0.0, 0.5), Eigen::Vector3d(0.0, 0.0, 0.0));
+        const Eigen::Isometry3d to =
+            stateToIsometry<double>(Eigen::Vector3d(0.025, 0.0, 0.5), Eigen::Vector3d(0.15, 0.0, 0.0));
+        const SegmentCheck check = planner.checkSegment(from, to, workspace);
+        CHECK(check.collision_free);
+        CHECK(check.reached == 1.0);
+        if (backend == CollisionBackend::Esdf) {
+            // The field is clamped at collision_margin and shrunk by its interpolation error, so the spheres never
+            // bound the tool and each step looks up every point for a smaller clearance.
+            CHECK(check.steps <= 6);
+        }
+        else {
+            CHECK(check.steps <= 3);
+            CHECK(check.queries == check.steps);
+        }
+    }
+
+    SECTION("Certified motions keep the clearance at every pose") {
+        // The voxel map answers for its own points, one per voxel.
+        pcl::KdTreeFLANN<pcl::PointXYZ> reference;
+        reference.setInputCloud(backend == CollisionBackend::VoxelMap ? map->cloud() : cloud);
+        int certified = 0;
+        int caught    = 0;
+        for (int s = 0; s < 40; ++s) {
+            const Eigen::Isometry3d from = stateToIsometry<double>(
+                Eigen::Vector3d(0.1 * unit(gen), 0.1 * unit(gen), 0.3 + 0.06 * unit(gen)),
+                Eigen::Vector3d(unit(gen), unit(gen), unit(gen)));
+            const Eigen::Isometry3d to = from
+                                         * stateToIsometry<double>(
+                                             Eigen::Vector3d(0.025 * unit(gen), 0.025 * unit(gen), 0.025 * unit(gen)),
+                                             Eigen::Vector3d(0.15 * unit(gen), 0.15 * unit(gen), 0.15 * unit(gen)));
+            const SegmentCheck check = planner.checkSegment(from, to, workspace);
+            const double dense       = denseClearance(planner, reference, from, to);
+            if (check.collision_free) {
+                CHECK(dense >= planner.segment_clearance - 1e-6);
+                ++certified;
+            }
+            else {
+                CHECK(check.reached < 1.0);
+                ++caught;
+            }
+        }
+        CHECK(certified > 0);
+        CHECK(caught > 0);
+    }
+}
+
+TEST_CASE("generateWaypoints checks the motion between its waypoints", "[segment]") {
+    using SegmentPlanner = PlannerMpc<6, 6, 2, double>;
+    std::mt19937 gen(24);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (float x = -0.2f; x <= 0.2f; x += 0.01f) {
+        for (float y = -0.2f; y <= 0.2f; y += 0.01f) {
+            cloud->points.emplace_back(x, y, 0.4f);
+        }
+    }
+
+    SegmentPlanner planner;
+    setObstacleCloud(planner, cloud);
+    addRandomEndEffector(planner, gen, 50);
+    planner.solver_mode    = SolverMode::Mppi;
+    planner.num_threads    = 1;
+    planner.num_samples    = 32;
+    planner.max_iterations = 2;
+
+    // The goal behind the plate is snapped to after two steps, so the last segment crosses it.
+    const Eigen::Isometry3d start = Eigen::Isometry3d::Identity();
+    const Eigen::Isometry3d goal  = stateToIsometry<double>(Eigen::Vector3d(0.0, 0.0, 0.8), Eigen::Vector3d::Zero());
+    const auto waypoints          = planner.generateWaypoints(start, goal);
+    REQUIRE(waypoints.size() >= 2);
+    CHECK(planner.stats.segments_checked == static_cast<int>(waypoints.size()) - 1);
+    CHECK(planner.stats.unsafe_segments == 1);
+    CHECK(planner.stats.first_unsafe_segment == static_cast<int>(waypoints.size()) - 2);
+    CHECK(planner.stats.segment_queries > 0);
+    CHECK(planner.stats.outcome == PlanOutcome::Unsafe);
+
+    planner.validate_segments = false;
+    planner.generateWaypoints(start, goal);
+    CHECK(planner.stats.segments_checked == 0);
+    CHECK(planner.stats.first_unsafe_segment == -1);
+    CHECK(planner.stats.outcome != PlanOutcome::Unsafe);
+}
@@ -0,0 +1,117 @@
+#include <Eigen/Dense>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../../include/trajectory_library.hpp"
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+TEST_CASE("The trajectory library finds the nearest relative query and persists", "[library]") {
+    TrajectoryLibrary library;
+    const Eigen::Isometry3d start =
+        stateToIsometry<double>(Eigen::Vector3d(0.3, -0.1, 0.5), Eigen::Vector3d(0.4, -0.2, 1.1));
+    const Eigen::Isometry3d goal =
+        start * stateToIsometry<double>(Eigen::Vector3d(0.1, 0.05, 0.0), Eigen::Vector3d(0.0, 0.0, 0.3));
+
+    const TrajectoryLibrary::Layout layout{static_cast<std::uint32_t>(RotationIntegrator::Euler), 6};
+    TrajectoryLibrary::Entry entry;
+    entry.layout              = layout;
+    entry.controls            = {{0.01, 0.0, 0.0, 0.0, 0.0, 0.1}, {0.02, 0.0, 0.0, 0.0, 0.0, 0.0}};
+    entry.waypoints           = {Eigen::Isometry3d::Identity(), start.inverse() * goal};
+    entry.baseline_iterations = 9;
+    library.insert(start, goal, entry);
+    // A near-duplicate with more steps does not replace the entry.
+    entry.controls.push_back(entry.controls.back());
+    library.insert(start, goal, entry);
+    REQUIRE(library.size() == 1);
+
+    // The key is relative: the same query from another start hits; a different goal misses.
+    const Eigen::Isometry3d moved =
+        stateToIsometry<double>(Eigen::Vector3d(-0.2, 0.4, 0.1), Eigen::Vector3d(-1.0, 0.3, 0.2));
+    TrajectoryLibrary::Entry match;
+    REQUIRE(library.lookup(moved, moved * start.inverse() * goal, layout, match));
+    CHECK(match.controls.size() == 2);
+    CHECK(match.baseline_iterations == 9);
+    CHECK_FALSE(library.lookup(start, start, layout, match));
+    // Controls of another rotation integrator or length never match.
+    const TrajectoryLibrary::Layout exp_map{static_cast<std::uint32_t>(RotationIntegrator::ExpMap), 6};
+    CHECK_FALSE(library.lookup(start, goal, exp_map, match));
+    CHECK_FALSE(library.lookup(start, goal, {layout.rotation_integrator, 12}, match));
+    library.recordSavings(match, 4, 0);
+    TrajectoryLibrary::Stats stats = library.stats();
+    CHECK(stats.queries == 4);
+    CHECK(stats.hits == 1);
+    CHECK(stats.hitRate() == Approx(0.25));
+    CHECK(stats.iterations_saved == 5);
+
+    // Save and load round-trip; truncated files are rejected and leave the library unchanged.
+    const std::string path = "test_trajectory_library.bin";
+    REQUIRE(library.save(path));
+    TrajectoryLibrary loaded;
+    REQUIRE(loaded.load(path));
+    CHECK_FALSE(loaded.lookup(start, goal, exp_map, match));
+    REQUIRE(loaded.lookup(start, goal, layout, match));
+    CHECK(match.layout == layout);
+    REQUIRE(match.controls.size() == 2);
+    CHECK(match.controls[0] == entry.controls[0]);
+    REQUIRE(match.waypoints.size() == 2);
+    CHECK(match.waypoints[1].isApprox(start.inverse() * goal, 1e-15));
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size() - 8);
+    CHECK_FALSE(loaded.load(path));
+    CHECK(loaded.size() == 1);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Repeated queries are warm-started from the trajectory library", "[library]") {
+    using Planner = PlannerMpc<6, 6, 1, double>;
+    Planner planner;
+    std::mt19937 gen(19);
+    setupRandomScene(planner, gen);
+    planner.solver_mode         = SolverMode::Mppi;
+    planner.num_samples         = 64;
+    planner.max_iterations      = 40;
+    planner.num_threads         = 1;
+    planner.rotation_integrator = RotationIntegrator::ExpMap;
+    planner.trajectory_library  = std::make_shared<TrajectoryLibrary>();
+
+    const Eigen::Isometry3d start = Eigen::Isometry3d::Identity();
+    const Eigen::Isometry3d goal =
+        stateToIsometry<double>(Eigen::Vector3d(0.08, 0.02, 0.05), Eigen::Vector3d(0.0, 0.0, 0.2));
+    planner.U.clear();
+    planner.generateWaypoints(start, goal);
+    const SolverStats cold = planner.stats;
+    REQUIRE(cold.outcome == PlanOutcome::Converged);
+    CHECK_FALSE(cold.warm_started);
+    REQUIRE(planner.trajectory_library->size() == 1);
+
+    // The repeated query retraces the stored chain.
+    planner.U.clear();
+    planner.generateWaypoints(start, goal);
+    CHECK(planner.stats.warm_started);
+    CHECK(planner.stats.iterations <= cold.iterations);
+    const TrajectoryLibrary::Stats stats = planner.trajectory_library->stats();
+    CHECK(stats.queries == 2);
+    CHECK(stats.hits == 1);
+    CHECK(stats.iterations_saved == cold.iterations - planner.stats.iterations);
+
+    // WarmStartMode::Off neither reads nor fills the library.
+    planner.warm_start = WarmStartMode::Off;
+    planner.generateWaypoints(start, goal);
+    CHECK_FALSE(planner.stats.warm_started);
+    CHECK(planner.trajectory_library->stats().queries == 2);
+
+    // A planner integrating Euler angles does not replay the stored rotation vectors.
+    planner.warm_start          = WarmStartMode::Chain;
+    planner.rotation_integrator = RotationIntegrator::Euler;
+    planner.U.clear();
+    planner.generateWaypoints(start, goal);
+    CHECK_FALSE(planner.stats.warm_started);
+    CHECK(planner.trajectory_library->stats().hits == 1);
+}
@@ -0,0 +1,176 @@
+#include <Eigen/Dense>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "../../include/waypoints_planner.hpp"
+#include "catch2/catch.hpp"
+#include "test_scene.hpp"
+
+// Global allocation counter. The test binary is linked with --wrap for the C allocation functions (see
+// CMakeLists.txt), so the std::malloc of Eigen's dynamic matrices and of Eigen::aligned_allocator (used by
+// pcl::PointCloud) is counted. --wrap only redirects references inside the linked objects, and libstdc++'s own
+// operator new calls the real malloc, so the global operator new is also replaced here to allocate through the
+// wrapped functions. Only the difference across a measured block is checked, so the rest of the tests are unaffected.
+namespace {
+    std::atomic<std::size_t> allocation_count{0};
+}  // namespace
+
+extern "C" {
+void* __real_malloc(std::size_t size);
+void* __real_calloc(std::size_t count, std::size_t size);
+void* __real_realloc(void* p, std::size_t size);
+void* __real_aligned_alloc(std::size_t alignment, std::size_t size);
+int __real_posix_memalign(void** p, std::size_t alignment, std::size_t size);
+
+void* __wrap_malloc(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __real_malloc(size);
+}
+void* __wrap_calloc(std::size_t count, std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+void* __wrap_realloc(void* p, std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __real_realloc(p, size);
+}
+void* __wrap_aligned_alloc(std::size_t alignment, std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __real_aligned_alloc(alignment, size);
+}
+int __wrap_posix_memalign(void** p, std::size_t alignment, std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __real_posix_memalign(p, alignment, size);
+}
+}
+
+namespace {
+    void* countedAlloc(std::size_t size) {
+        if (void* p = std::malloc(size ? size : 1))
+            return p;
+        throw std::bad_alloc();
+    }
+
+    void* countedAlignedAlloc(std::size_t size, std::align_val_t align) {
+        const std::size_t alignment = static_cast<std::size_t>(align);
+        if (void* p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+            return p;
+        throw std::bad_alloc();
+    }
+}  // namespace
+
+void* operator new(std::size_t size) {
+    return countedAlloc(size);
+}
+void* operator new[](std::size_t size) {
+    return countedAlloc(size);
+}
+void* operator new(std::size_t size, std::align_val_t align) {
+    return countedAlignedAlloc(size, align);
+}
+void* operator new[](std::size_t size, std::align_val_t align) {
+    return countedAlignedAlloc(size, align);
+}
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+TEST_CASE("Fixed-size and batched cost evaluation do not allocate", "[cost]") {
+    using Planner = PlannerMpc<6, 6, 4, double>;
+    Planner planner;
+    std::mt19937 gen(9);
+    const auto cloud = randomBoxCloud(gen, 500, Eigen::Vector3f::Constant(0.1f), Eigen::Vector3f(0.0f, 0.0f, 0.2f));
+    planner.obstacle_cloud = cloud;
+    addRandomEndEffector(planner, gen, 30, Eigen::Vector3f::Constant(0.03f), Eigen::Vector3f(0.0f, 0.0f, 0.05f));
+    planner.min_visible_points = 200;
+    planner.H_0.translation()  = Eigen::Vector3d(0.0, 0.0, 0.05);
+    planner.H_goal.translation() = Eigen::Vector3d(0.05, 0.02, 0.1);
+
+    const auto backend = GENERATE(CollisionBackend::Esdf, CollisionBackend::VoxelMap);
+    planner.collision_backend = backend;
+    if (backend == CollisionBackend::VoxelMap) {
+        planner.obstacle_map = std::make_shared<VoxelObstacleMap>(0.01f);
+        planner.obstacle_map->insert(*cloud);
+    }
+    planner.prepareScene();
+
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<Planner::ActionSequence> samples(50);
+    std::vector<std::vector<double>> samples_vec;
+    for (auto& U : samples) {
+        for (int i = 0; i < U.size(); ++i) {
+            U(i) = 0.02 * unit(gen);
+        }
+        samples_vec.emplace_back(U.data(), U.data() + U.size());
+    }
+    Planner::CandidateMatrix candidates(static_cast<Eigen::Index>(samples.size()), 24);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        candidates.row(static_cast<Eigen::Index>(i)) = samples[i].transpose();
+    }
+    CollisionWorkspace workspace;
+    Planner::BatchWorkspace batch;
+    Eigen::VectorXd batch_costs(candidates.rows());
+    std::vector<double> no_grad;
+    const double warm_up = planner.cost(samples.front(), workspace);
+    planner.costBatch(candidates, batch_costs, workspace, batch);
+
+    double sum                 = 0.0;
+    const std::size_t before   = allocation_count.load();
+    for (const auto& U : samples) {
+        sum += planner.cost(U, workspace);
+    }
+    for (const auto& U : samples_vec) {
+        sum += planner.cost(U, no_grad, workspace);
+    }
+    planner.costBatch(candidates, batch_costs, workspace, batch);
+    Planner::StateTrajectory trajectory;
+    planner.rollout(samples.back(), trajectory);
+    const std::size_t allocations = allocation_count.load() - before;
+
+    CHECK(allocations == 0);
+
+    // The counter sees both the C allocations of Eigen and the operator new of the standard containers.
+    const std::size_t eigen_before = allocation_count.load();
+    const Eigen::MatrixXf dynamic = Eigen::MatrixXf::Random(3, 1000);
+    CHECK(std::isfinite(dynamic.sum()));
+    CHECK(allocation_count.load() > eigen_before);
+    const std::size_t vector_before = allocation_count.load();
+    const std::vector<int> heap(1000, 1);
+    CHECK(heap.back() == 1);
+    CHECK(allocation_count.load() > vector_before);
+    CHECK(std::isfinite(sum));
+    CHECK(sum > 0.0);
+    CHECK(planner.cost(samples.front(), workspace) == warm_up);
+    CHECK(planner.cost(samples_vec.front(), no_grad, workspace) == warm_up);
+
+    // The vector rollout matches the fixed-size one.
+    const auto states = planner.rollout(samples_vec.back());
+    for (int k = 0; k <= 4; ++k) {
+        CHECK(states[k].isApprox(trajectory.col(k)));
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef TEST_SCENE_HPP
+#define TEST_SCENE_HPP
+
+#include <Eigen/Dense>
+#include <memory>
+#include <pcl/kdtree/kdtree_flann.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <random>
+
+/**
+ * @brief Uniformly random points in an axis-aligned box.
+ *
+ * @param gen         Random generator; the scene is a function of its state.
+ * @param num_points  Number of points.
+ * @param half_extent Half the box size along each axis.
+ * @param centre      Centre of the box.
+ * @return The points.
+ */
+inline pcl::PointCloud<pcl::PointXYZ>::Ptr randomBoxCloud(std::mt19937& gen,
+                                                          int num_points,
+                                                          const Eigen::Vector3f& half_extent,
+                                                          const Eigen::Vector3f& centre) {
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+    for (int i = 0; i < num_points; ++i) {
+        cloud->points.emplace_back(centre.x() + half_extent.x() * unit(gen),
+                                   centre.y() + half_extent.y() * unit(gen),
+                                   centre.z() + half_extent.z() * unit(gen));
+    }
+    return cloud;
+}
+
+/**
+ * @brief Sets the planner's obstacle cloud and a kd-tree over it.
+ */
+template <typename Planner>
+void setObstacleCloud(Planner& planner, const pcl::PointCloud<pcl::PointXYZ>::Ptr& cloud) {
+    std::shared_ptr<pcl::KdTreeFLANN<pcl::PointXYZ>> kd_tree(new pcl::KdTreeFLANN<pcl::PointXYZ>);
+    kd_tree->setInputCloud(cloud);
+    planner.obstacle_cloud = cloud;
+    planner.kd_tree        = kd_tree;
+}
+
+/**
+ * @brief Adds uniformly random end-effector points in a box around the end-effector frame.
+ *
+ * @param planner     The planner.
+ * @param gen         Random generator.
+ * @param num_points  Number of points.
+ * @param half_extent Half the box size along each axis.
+ * @param centre      Centre of the box in the end-effector frame.
+ */
+template <typename Planner>
+void addRandomEndEffector(Planner& planner,
+                          std::mt19937& gen,
+                          int num_points                     = 20,
+                          const Eigen::Vector3f& half_extent = Eigen::Vector3f::Constant(0.03f),
+                          const Eigen::Vector3f& centre      = Eigen::Vector3f::Zero()) {
+    const auto points = randomBoxCloud(gen, num_points, half_extent, centre);
+    pcl::PointCloud<pcl::PointXYZ>::Ptr mesh(new pcl::PointCloud<pcl::PointXYZ>(*planner.ee_mesh_cloud));
+    mesh->points.insert(mesh->points.end(), points->points.begin(), points->points.end());
+    planner.ee_mesh_cloud = mesh;
+    planner.syncEndEffectorPoints();
+}
+
+/**
+ * @brief Random scene of the unit tests: a box of obstacle points in front of the start pose, with a kd-tree, and a
+ *        random end-effector point cloud drawn after it from the same generator.
+ *
+ * @param planner         The planner.
+ * @param gen             Random generator.
+ * @param num_points      Number of obstacle points.
+ * @param half_extent     Half the obstacle box size along each axis.
+ * @param centre          Centre of the obstacle box.
+ * @param num_mesh_points Number of end-effector points.
+ * @param mesh_extent     Half the end-effector box size along each axis.
+ * @param mesh_centre     Centre of the end-effector box in the end-effector frame.
+ */
+template <typename Planner>
+void setupRandomScene(Planner& planner,
+                      std::mt19937& gen,
+                      int num_points                     = 400,
+                      const Eigen::Vector3f& half_extent = Eigen::Vector3f(0.1f, 0.1f, 0.1f),
+                      const Eigen::Vector3f& centre      = Eigen::Vector3f(0.0f, 0.0f, 0.35f),
+                      int num_mesh_points                = 20,
+                      const Eigen::Vector3f& mesh_extent = Eigen::Vector3f::Constant(0.03f),
+                      const Eigen::Vector3f& mesh_centre = Eigen::Vector3f::Zero()) {
+    setObstacleCloud(planner, randomBoxCloud(gen, num_points, half_extent, centre));
+    addRandomEndEffector(planner, gen, num_mesh_points, mesh_extent, mesh_centre);
+}
+
+#endif  // TEST_SCENE_HPP
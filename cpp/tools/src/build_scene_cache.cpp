@@ -0,0 +1,56 @@
+#include <Eigen/Dense>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../../include/planner_setup.hpp"
+#include "../../include/scene_cache.hpp"
+#include "../../include/waypoints_planner.hpp"
+
+// Preprocesses a scan and the end-effector mesh into a scene cache that main.cpp maps at start-up.
+//
+// Usage: build_scene_cache [cloud.pcd] [mesh.stl] [output] [leaf_size] [esdf_resolution] [collision_margin]
+// The defaults and the mesh pose are those of main.cpp (plannerSceneSources), so the written cache is the one main.cpp
+// looks for.
+int main(int argc, char** argv) {
+    PlannerMpc<6, 6, 1, double> planner;
+    configurePlanner(planner);
+    if (argc > 5)
+        planner.esdf_resolution = std::stod(argv[5]);
+    if (argc > 6)
+        planner.collision_margin = std::stod(argv[6]);
+
+    SceneSources sources   = plannerSceneSources(planner,
+                                               argc > 1 ? argv[1] : "../data/vine_simple_streo_scan.pcd",
+                                               argc > 2 ? argv[2] : "../data/cutter.stl");
+    const std::string path = argc > 3 ? argv[3] : "vine_simple_streo_scan.scene";
+    if (argc > 4)
+        sources.leaf_size = std::stof(argv[4]);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!buildScene(planner, sources)) {
+        return -1;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "[build_scene_cache] Built scene (" << planner.obstacle_cloud->size() << " points, "
+              << planner.ee_mesh_cloud->size() << " end-effector points, " << planner.esdf.numNodes()
+              << " distance field nodes) in " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms\n";
+
+    if (!writeSceneCache(planner, sources.hash(), path)) {
+        std::cerr << "[build_scene_cache] Could not write " << path << "\n";
+        return -1;
+    }
+
+    // Time the load path the planner takes on the next start.
+    PlannerMpc<6, 6, 1, double> loaded;
+    start = std::chrono::high_resolution_clock::now();
+    if (!loadSceneCache(loaded, sources.hash(), path)) {
+        std::cerr << "[build_scene_cache] Could not read back " << path << "\n";
+        return -1;
+    }
+    end = std::chrono::high_resolution_clock::now();
+    std::cout << "[build_scene_cache] Wrote " << path << "; loading it takes "
+              << std::chrono::duration<double, std::milli>(end - start).count() << " ms (including the source hash)\n";
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <Eigen/Dense>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "../../include/planner_service.hpp"
+#include "../../include/planner_setup.hpp"
+#include "../../include/scene_cache.hpp"
+#include "../../include/waypoints_planner.hpp"
+
+// Keeps the scene of main.cpp in memory and serves plan requests over a Unix-domain socket (see planner_service.hpp
+// for the protocol), so that a caller pays only for the planning of each request.
+//
+// Usage: planner_daemon [socket] [cloud.pcd] [mesh.stl] [scene cache] [trajectory library]
+// The planner is configured as in main.cpp (configurePlanner); requests can override its parameters. The daemon
+// warm-starts from the trajectory library and saves it on shutdown.
+int main(int argc, char** argv) {
+    const std::string socket_path  = argc > 1 ? argv[1] : "/tmp/motion_planning.sock";
+    const std::string cache_path   = argc > 4 ? argv[4] : "vine_simple_streo_scan.scene";
+    const std::string library_path = argc > 5 ? argv[5] : "trajectory_library.bin";
+
+    PlannerMpc<6, 6, 1, double> planner;
+    configurePlanner(planner);
+    planner.warm_start = WarmStartMode::Chain;
+    planner.trajectory_library->load(library_path);
+
+    const SceneSources sources = plannerSceneSources(planner,
+                                                     argc > 2 ? argv[2] : "../data/vine_simple_streo_scan.pcd",
+                                                     argc > 3 ? argv[3] : "../data/cutter.stl");
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!loadOrBuildScene(planner, sources, cache_path)) {
+        std::cerr << "[planner_daemon] Could not load the scene from " << sources.cloud_path << "\n";
+        return -1;
+    }
+    PlannerService<PlannerMpc<6, 6, 1, double>> service(planner, sources, cache_path);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "[planner_daemon] Scene ready in " << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms\n";
+
+    if (!service.listen(socket_path)) {
+        return -1;
+    }
+    service.run();
+    const TrajectoryLibrary::Stats library_stats = planner.trajectory_library->stats();
+    std::cout << "[planner_daemon] Trajectory library hit rate " << library_stats.hitRate() << " ("
+              << library_stats.hits << "/" << library_stats.queries << "), iterations saved "
+              << library_stats.iterations_saved << "\n";
+    if (!planner.trajectory_library->save(library_path)) {
+        std::cerr << "[planner_daemon] Could not save the trajectory library to " << library_path << "\n";
+    }
+    std::cout << "[planner_daemon] Shut down\n";
+    return 0;
+}